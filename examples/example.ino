@@ -33,14 +33,14 @@ void setup()
 {
     // start serial
     // From the body board, we have two serial ports:
+    // (ReceiveMessage sets the timeout of each read from the size of the
+    // frame and SPINE_BAUD_RATE)
     Serial1.begin(3000000, SERIAL_8N1, RXD1, TXD1);
-    Serial1.setTimeout(100);
     Serial1.setRxBufferSize(2048);
     Serial1.setTxBufferSize(2048);
 
     // To the head board is 3000000 baud, 8N1, RXD, TXD
     Serial2.begin(3000000, SERIAL_8N1, RXD2, TXD2);
-    Serial2.setTimeout(100);
     Serial2.setRxBufferSize(2048);
     Serial2.setTxBufferSize(2048);
 }
@@ -49,7 +49,8 @@ void setup()
 
 /** The main task for the body board.
 
-    This task will keep receiving and processing messages from the head board.
+    This task will keep receiving and processing messages from the body board
+    and the head board, forwarding each to the other.
 
     What this isnt good at is sending messages to the head board on its own.
 
@@ -58,10 +59,16 @@ void setup()
  */
 void loop()
 {
+    // rather than poll, sleep until the next frame is due
+    SleepUntilNextFrame(Serial1, Serial2);
+
     // keep receiving and processing messages
     // receive and process message
     ReceiveAndRewriteB2HMessage(Serial1, Serial2);
 
+    // and the same for messages from the head board to the body board
+    ReceiveAndRewriteH2BMessage(Serial2, Serial1);
+
     // See if there is USB serial data to forward to the head board
     auto numBytes = std::min(Serial.available(), 31);
     if (numBytes > 0)
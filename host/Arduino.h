@@ -0,0 +1,34 @@
+/* The Arduino definitions needed to build the framing on a host
+   Copyright 2024 Randall Maas
+*//**@file
+    @brief The Arduino definitions needed to build the framing on a host.
+
+    This is just enough of the Arduino core to build spine.cpp and capi.cpp
+    into a library for Linux (see capi.h).  It is not used on the Arduino.
+*/
+#pragma once
+#include <inttypes.h>
+#include <stddef.h>
+#include <string.h>
+
+/// The byte stream that the messages are received from and sent to
+class Stream
+{
+public:
+    virtual ~Stream() {}
+
+    /// The number of bytes ready to read
+    virtual int available() = 0;
+
+    /// Read a byte, -1 if there is none
+    virtual int read() = 0;
+
+    /// Read bytes into a buffer, returning the number read
+    virtual size_t readBytes(uint8_t* buffer, size_t length) = 0;
+
+    /// Set the time (in milliseconds) that readBytes waits for the bytes
+    virtual void setTimeout(unsigned long) {}
+
+    /// Write bytes, returning the number written
+    virtual size_t write(const uint8_t* buffer, size_t size) = 0;
+};
@@ -0,0 +1,128 @@
+/* Measure the call overhead of the C interface
+   Copyright 2024 Randall Maas
+*//**@file
+    @brief Measure the call overhead of the C interface.
+
+    This feeds data frames from the body board into a link, and times the
+    frames taken out with spine_poll() and spine_release(), and with
+    spine_dispatch().  It also times checking the frames against a filter
+    expression, in frames per second.  It is built against the library (see
+    capi.h):
+
+    @code
+    gcc -O2 -Isrc host/bench.c -L. -lspine -o spine-bench
+    @endcode
+*/
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include "capi.h"
+
+/// The number of frames to time
+#define NUM_FRAMES (200000)
+
+/// The message type of a data frame
+#define DATA_FRAME (0x6466)
+
+/// The size of a data frame from the body board
+#define DATA_FRAME_SIZE (768)
+
+/// The number of frames fed at a time
+#define FRAMES_PER_FEED (16)
+
+
+/** The monotonic time
+    @return the time (in nanoseconds)
+*/
+static uint64_t now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t) ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+
+/** Count the frames passed to the callback
+    @param frame the frame
+    @param context the count
+*/
+static void count(const spine_frame* frame, void* context)
+{
+    (void) frame;
+    ++*(unsigned long*) context;
+}
+
+
+int main(void)
+{
+    // a run of data frames, fed a run at a time
+    static uint8_t payload[DATA_FRAME_SIZE];
+    static uint8_t frames[FRAMES_PER_FEED][DATA_FRAME_SIZE+12];
+    size_t frame_size = 0;
+    for (int idx = 0; idx < FRAMES_PER_FEED; idx++)
+    {
+        memcpy(payload, &idx, sizeof(idx));
+        frame_size = spine_encode(SPINE_B2H, DATA_FRAME, payload, sizeof(payload), frames[idx], sizeof(frames[idx]));
+    }
+    if (!frame_size)
+    {
+        fprintf(stderr, "can't encode the frames\n");
+        return 1;
+    }
+
+    // poll and release
+    spine_link* link = spine_open_buffer(SPINE_B2H);
+    unsigned long num = 0;
+    uint64_t polling_ns = 0;
+    while (num < NUM_FRAMES)
+    {
+        spine_feed(link, frames[0], sizeof(frames), now_ns());
+        uint64_t start = now_ns();
+        spine_frame frame;
+        while (spine_poll(link, &frame) > 0)
+        {
+            spine_release(link, &frame);
+            num++;
+        }
+        polling_ns += now_ns() - start;
+    }
+    spine_close(link);
+    printf("poll/release: %lu frames, %.1f ns/frame\n", num, (double) polling_ns / num);
+
+    // dispatch
+    link = spine_open_buffer(SPINE_B2H);
+    unsigned long dispatched = 0;
+    spine_set_callback(link, count, &dispatched);
+    uint64_t dispatch_ns = 0;
+    while (dispatched < NUM_FRAMES)
+    {
+        spine_feed(link, frames[0], sizeof(frames), now_ns());
+        uint64_t start = now_ns();
+        spine_dispatch(link);
+        dispatch_ns += now_ns() - start;
+    }
+    spine_close(link);
+    printf("dispatch:     %lu frames, %.1f ns/frame\n", dispatched, (double) dispatch_ns / dispatched);
+
+    // filter
+    spine_filter* filter = spine_filter_compile("cliffSense[2] < 200 && onCharger == 0", SPINE_B2H, NULL);
+    if (!filter)
+    {
+        fprintf(stderr, "can't compile the filter\n");
+        return 1;
+    }
+    link = spine_open_buffer(SPINE_B2H);
+    spine_feed(link, frames[0], sizeof(frames), now_ns());
+    spine_frame frame;
+    spine_poll(link, &frame);
+    unsigned long matched = 0;
+    uint64_t start = now_ns();
+    for (num = 0; num < NUM_FRAMES; num++)
+        matched += spine_filter_match(filter, &frame);
+    uint64_t filter_ns = now_ns() - start;
+    spine_release(link, &frame);
+    spine_close(link);
+    spine_filter_free(filter);
+    printf("filter:       %lu frames, %lu matched, %.0f frames/s\n", num, matched, num * 1e9 / filter_ns);
+    return 0;
+}
@@ -0,0 +1,123 @@
+/* Measure the speed up of searching a capture with the block index
+   Copyright 2024 Randall Maas
+*//**@file
+    @brief Measure the speed up of searching a capture with the block index.
+
+    This writes a capture of data frames from the body board (a day at 200
+    frames a second is about 13GB), with a few rare events in it, and times a
+    search for them reading every block, and skipping the blocks with the
+    index (see capture.h):
+
+    @code
+    g++ -std=c++17 -O2 -Ihost -Isrc src/schema.cpp src/filter.cpp src/capture.cpp host/capture-bench.cpp -o capture-bench
+    ./capture-bench /tmp/bench.cap 4096 "i2cFault != 0"
+    @endcode
+
+    The arguments are the path of the capture, its size in megabytes, and the
+    filter expression.  The capture is only written if it doesn't exist.
+    The file cache should be dropped between runs for the times to include
+    reading the disk.
+*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include "capture.h"
+
+using namespace Spine;
+
+/// The number of data frames between the rare events
+#define EVENT_INTERVAL (1000000)
+
+
+/** The monotonic time
+    @return the time (in seconds)
+*/
+static double now()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+
+/** Write the capture
+    @param path the path of the capture
+    @param megabytes the size of the capture
+    @return true on success, false on error
+*/
+static bool writeCapture(const char* path, size_t megabytes)
+{
+    static CaptureWriter writer;
+    if (!writer.open(path))
+        return false;
+    B2HDataFrame frame = {};
+    size_t numFrames = megabytes * 1024 * 1024 / (sizeof(frame) + sizeof(CaptureRecord));
+    for (size_t idx = 0; idx < numFrames; idx++)
+    {
+        // a day of 5ms frames, with a fault and a shutdown now and then
+        frame.sequenceNumber = (uint32_t) idx;
+        frame.battery_volt   = (int16_t)(3500 + idx / 100000 % 700);
+        frame.onCharger      = idx / 720000 % 2;
+        frame.i2cFault       = idx % EVENT_INTERVAL == 12345 ? 1 : 0;
+        frame.shutdown       = idx % (3*EVENT_INTERVAL) == 54321 ? 1 : 0;
+        frame.cliffSense[2]  = (uint16_t)(idx * 7 % 1000);
+        if (!writer.write(true, MessageType::dataFrame, (const uint8_t*) &frame, sizeof(frame), idx * 5000000ULL))
+            return false;
+    }
+    return writer.close();
+}
+
+
+/** Search the capture
+    @param path the path of the capture
+    @param filter the filter
+    @param useIndex true to skip the blocks with the index
+*/
+static void search(const char* path, const Filter& filter, bool useIndex)
+{
+    static CaptureReader reader;
+    if (!reader.open(path))
+    {
+        fprintf(stderr, "can't read %s\n", path);
+        exit(1);
+    }
+    auto start = now();
+    size_t numFrames = 0, numMatched = 0;
+    CaptureFrame frame;
+    while (reader.next(frame, useIndex ? &filter : nullptr))
+    {
+        numFrames++;
+        numMatched += filter.match(frame.type, frame.payload, frame.size);
+    }
+    auto seconds = now() - start;
+    printf("%-10s %zu matched, %zu blocks, %zu skipped, %.3f s\n", useIndex ? "indexed:" : "scanned:",
+           numMatched, reader.numBlocks, reader.numSkipped, seconds);
+}
+
+
+int main(int argc, char** argv)
+{
+    const char* path       = argc > 1 ? argv[1] : "bench.cap";
+    size_t      megabytes  = argc > 2 ? strtoul(argv[2], nullptr, 10) : 1024;
+    const char* expression = argc > 3 ? argv[3] : "i2cFault != 0";
+
+    Filter filter;
+    if (!filter.compile(expression))
+    {
+        fprintf(stderr, "%s\n%*s^ %s\n", expression, (int) filter.errorPos, "", filter.error);
+        return 1;
+    }
+
+    auto file = fopen(path, "rb");
+    if (file)
+        fclose(file);
+    else if (!writeCapture(path, megabytes))
+    {
+        fprintf(stderr, "can't write %s\n", path);
+        return 1;
+    }
+
+    search(path, filter, false);
+    search(path, filter, true);
+    return 0;
+}
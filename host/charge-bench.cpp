@@ -0,0 +1,196 @@
+/* Measure the speed of analysing captures for charging dock sessions
+   Copyright 2024 Randall Maas
+*//**@file
+    @brief Measure the speed of analysing captures for charging dock sessions.
+
+    This writes captures of the raw bytes from the body board (if they don't
+    exist), with the robot docking, charging and undocking over and over,
+    and times a batch job that analyses them for the sessions (see charge.h),
+    first on one thread and then on a thread per core, each thread taking
+    the next capture and analysing it with its own analyser:
+
+    @code
+    g++ -std=c++17 -O2 -pthread -Ihost -Isrc src/spine.cpp src/charge.cpp host/charge-bench.cpp -o charge-bench
+    ./charge-bench 256 /tmp/charge0.bin /tmp/charge1.bin /tmp/charge2.bin /tmp/charge3.bin
+    @endcode
+
+    The first argument is the size of each capture in megabytes, and the rest
+    are the paths of the captures.  The file cache should be dropped between
+    runs for the times to include reading the disk.
+
+    Most of the time goes in checking the CRC of each frame, with the sliced
+    CRC on the host (see crc.h).  A thread scans about 1.2 GB/s, so the batch
+    scales with the cores: 4 GB/s takes about 4 cores, with a disk that keeps
+    up.
+*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <atomic>
+#include <thread>
+#include <vector>
+#include "crc.h"
+#include "charge.h"
+
+using namespace Spine;
+
+/// The number of bytes read from a capture at a time
+#define READ_SIZE (1024*1024)
+
+/// The number of frames in each docking cycle: about 10 minutes docked
+/// and 2 minutes away
+#define CYCLE_FRAMES (36000)
+#define DOCKED_FRAMES (30000)
+
+
+/** The monotonic time
+    @return the time (in seconds)
+*/
+static double now()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+
+/** Write a capture of the raw bytes from the body board
+    @param path the path of the capture
+    @param megabytes the size of the capture
+    @return true on success, false on error
+*/
+static bool writeCapture(const char* path, size_t megabytes)
+{
+    auto file = fopen(path, "wb");
+    if (!file)
+        return false;
+
+    static uint8_t frame[payload_ofs + sizeof(B2HDataFrame) + 4] = {0xAA, 'B', '2', 'H',
+        (uint8_t) MessageType::dataFrame, (uint8_t)((uint16_t) MessageType::dataFrame >> 8),
+        (uint8_t) sizeof(B2HDataFrame), (uint8_t)(sizeof(B2HDataFrame) >> 8)};
+    B2HDataFrame data = {};
+    uint64_t limit = (uint64_t) megabytes * 1024 * 1024;
+    for (uint32_t idx = 0; (uint64_t) idx * sizeof(frame) < limit; idx++)
+    {
+        // on the contacts for most of the cycle, charging a little after
+        // docking; the battery rises while it charges
+        auto phase = idx % CYCLE_FRAMES;
+        bool docked = phase < DOCKED_FRAMES;
+        data.sequenceNumber = idx;
+        data.onCharger      = docked;
+        data.charging       = docked && phase >= 100;
+        data.charger_volt   = (int16_t)(docked ? 3600 : 0);
+        data.battery_volt   = (int16_t)(2600 + (docked ? phase / 100 : (CYCLE_FRAMES - phase) / 20));
+        memcpy(frame + payload_ofs, &data, sizeof(data));
+        auto crc = Crc32(CRC32_INITIAL, frame + payload_ofs, sizeof(data));
+        memcpy(frame + payload_ofs + sizeof(data), &crc, 4);
+        fwrite(frame, sizeof(frame), 1, file);
+    }
+    bool ok = !ferror(file);
+    return !fclose(file) && ok;
+}
+
+
+/// The results of a batch
+struct Batch
+{
+    /// The number of bytes analysed
+    std::atomic<uint64_t> numBytes;
+
+    /// The number of sessions, and those that were successful
+    std::atomic<uint32_t> numSessions, numSuccessful;
+
+    /// The number of captures that couldn't be read
+    std::atomic<uint32_t> numErrors;
+};
+
+
+/** Analyse captures, taking the next one until there are none left
+    @param paths the paths of the captures
+    @param next the index of the next capture to take
+    @param batch the results
+*/
+static void analyse(const std::vector<const char*>& paths, std::atomic<size_t>& next, Batch& batch)
+{
+    std::vector<uint8_t> buffer(READ_SIZE);
+    for (size_t idx; (idx = next++) < paths.size();)
+    {
+        auto file = fopen(paths[idx], "rb");
+        if (!file)
+        {
+            batch.numErrors++;
+            continue;
+        }
+
+        // the bytes of a frame not yet complete are carried over to the
+        // front of the buffer
+        ChargeAnalyser analyser;
+        size_t used = 0;
+        for (size_t numRead; (numRead = fread(buffer.data() + used, 1, buffer.size() - used, file)) > 0;)
+        {
+            batch.numBytes += numRead;
+            used += numRead;
+            auto examined = analyser.scan(buffer.data(), used);
+            memmove(buffer.data(), buffer.data() + examined, used - examined);
+            used -= examined;
+        }
+        analyser.finish();
+        if (ferror(file))
+            batch.numErrors++;
+        fclose(file);
+        batch.numSessions   += analyser.stats.numSessions;
+        batch.numSuccessful += analyser.stats.numSuccessful;
+    }
+}
+
+
+/** Analyse the captures in a batch, and report the rate
+    @param paths the paths of the captures
+    @param numThreads the number of threads
+    @return true on success, false if a capture couldn't be read
+*/
+static bool run(const std::vector<const char*>& paths, unsigned numThreads)
+{
+    Batch batch = {};
+    std::atomic<size_t> next(0);
+    std::vector<std::thread> threads;
+    auto start = now();
+    for (unsigned idx = 0; idx < numThreads; idx++)
+        threads.emplace_back(analyse, std::cref(paths), std::ref(next), std::ref(batch));
+    for (auto& thread : threads)
+        thread.join();
+    auto seconds = now() - start;
+
+    printf("%2u threads: %u sessions, %u successful, %.3f s, %.2f GB/s\n", numThreads,
+           (unsigned) batch.numSessions, (unsigned) batch.numSuccessful, seconds, batch.numBytes / seconds / 1e9);
+    return !batch.numErrors;
+}
+
+
+int main(int argc, char** argv)
+{
+    size_t megabytes = argc > 1 ? strtoul(argv[1], nullptr, 10) : 256;
+    std::vector<const char*> paths(argv + (argc > 1 ? 2 : argc), argv + argc);
+    if (paths.empty())
+        paths = {"charge0.bin", "charge1.bin", "charge2.bin", "charge3.bin"};
+
+    for (auto path : paths)
+    {
+        auto file = fopen(path, "rb");
+        if (file)
+            fclose(file);
+        else if (!writeCapture(path, megabytes))
+        {
+            fprintf(stderr, "can't write %s\n", path);
+            return 1;
+        }
+    }
+
+    unsigned numThreads = std::thread::hardware_concurrency();
+    bool ok = run(paths, 1);
+    ok = run(paths, numThreads ? numThreads : 1) && ok;
+    if (!ok)
+        fprintf(stderr, "can't read all of the captures\n");
+    return ok ? 0 : 1;
+}
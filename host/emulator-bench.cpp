@@ -0,0 +1,104 @@
+/* Measure a closed loop against the body board emulator
+   Copyright 2024 Randall Maas
+*//**@file
+    @brief Measure a closed loop against the body board emulator.
+
+    This runs a simple head board controller against the emulator (see
+    emulator.h), with the frames going through the framing in both
+    directions: the controller drives the robot up to the box ahead, stopping
+    short of it by the time of flight range, backs off, and nods the head as
+    it goes.  It reports how much faster than real time the loop runs:
+
+    @code
+    g++ -std=c++17 -O2 -Ihost -Isrc src/spine.cpp src/emulator.cpp host/emulator-bench.cpp -o emulator-bench
+    ./emulator-bench 600
+    @endcode
+*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "frames.h"
+#include "emulator.h"
+
+using namespace Spine;
+
+
+/** The monotonic time
+    @return the time (in seconds)
+*/
+static double now()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+
+/** Limit a duty cycle to full scale
+    @param power the duty cycle
+    @return the limited duty cycle
+*/
+static int16_t limit(int32_t power)
+{
+    return (int16_t)(power > 32767 ? 32767 : power < -32767 ? -32767 : power);
+}
+
+
+int main(int argc, char** argv)
+{
+    double seconds = argc > 1 ? atof(argv[1]) : 600;
+    auto numFrames = (uint32_t)(seconds * 1e6 / B2H_FRAME_PERIOD_US);
+
+    static BodyEmulator body;
+    uint8_t command[payload_ofs + sizeof(H2BDataFrame) + 4];
+    H2BDataFrame data;
+    memset(&data, 0, sizeof(data));
+    B2HDataFrame feedback;
+    memset(&feedback, 0, sizeof(feedback));
+    uint32_t numDecoded = 0, numStops = 0;
+    bool backingOff = false;
+
+    auto start = now();
+    for (uint32_t idx = 0; idx < numFrames; idx++)
+    {
+        // drive up to the box, stop short of it, and back off
+        auto range = feedback.prox_status ? 0xFFFF : feedback.prox_range_mm;
+        if (!backingOff && range < 50)
+        {
+            backingOff = true;
+            numStops++;
+        }
+        else if (backingOff && range > 150)
+            backingOff = false;
+        int16_t drive = backingOff ? -12000 : range > 100 ? 20000 : 6000;
+
+        // nod the head, about once a second
+        int32_t target = idx / 195 % 2 ? 600 : -200;
+        int16_t head = limit((target - feedback.motor[(int) Motor::backRight].position) * 1000);
+
+        data.sequenceNumber = idx;
+        data.motorPower[(int) Motor::frontLeft ] = drive;
+        data.motorPower[(int) Motor::frontRight] = drive;
+        data.motorPower[(int) Motor::backRight ] = head;
+        auto frame = buildFrame<sizeof(H2BDataFrame)>("H2B", MessageType::dataFrame, (const uint8_t*) &data);
+        memcpy(command, frame.data(), sizeof(command));
+        body.receive(command, sizeof(command));
+        body.step();
+
+        // decode the feedback as the head board would
+        MessageType message_type;
+        size_t payload_size;
+        auto ptr = B2H::FindMessage(body.frame.data(), body.frame.size(), message_type, payload_size);
+        if (message_type != MessageType::dataFrame)
+            continue;
+        memcpy(&feedback, ptr + payload_ofs, sizeof(feedback));
+        numDecoded++;
+    }
+    auto elapsed = now() - start;
+
+    double simulated = body.now_us * 1e-6;
+    printf("%.1f s simulated in %.3f s: %.0fx real time, %.0f frames/s\n", simulated, elapsed, simulated / elapsed, numFrames / elapsed);
+    printf("%u commands applied, %u frames decoded, %u stops at the box\n", body.numCommands, numDecoded, numStops);
+    return numDecoded == numFrames ? 0 : 1;
+}
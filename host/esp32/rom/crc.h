@@ -0,0 +1,22 @@
+/* The ESP32 ROM CRC, for building the framing on a host
+   Copyright 2024 Randall Maas
+*//**@file
+    @brief The ESP32 ROM CRC, for building the framing on a host.
+
+    The framing uses the ROM's crc32_le().  On the host it is computed with
+    the slice-by-8 equivalent in crc.h, as the host tools check the frames of
+    whole captures.
+*/
+#pragma once
+#include "../../../src/crc.h"
+
+/** Compute the CRC-32 of some bytes, the same as the ROM's crc32_le()
+    @param crc the initial value (or the CRC of the preceding bytes)
+    @param buf the bytes
+    @param len the number of bytes
+    @return the CRC
+*/
+inline uint32_t crc32_le(uint32_t crc, const uint8_t* buf, uint32_t len)
+{
+    return Spine::Crc32Sliced(crc, buf, len);
+}
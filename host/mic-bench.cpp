@@ -0,0 +1,88 @@
+/* Measure the lossless coding of the microphone samples in a capture
+   Copyright 2024 Randall Maas
+*//**@file
+    @brief Measure the lossless coding of the microphone samples in a capture.
+
+    This codes the microphone samples of the data frames in a capture file
+    (see capture.h), checks that each block decodes to the same samples, and
+    reports the compression ratio and the coding and decoding speeds:
+
+    @code
+    g++ -std=c++17 -O2 -Ihost -Isrc src/schema.cpp src/filter.cpp src/capture.cpp src/miccodec.cpp host/mic-bench.cpp -o mic-bench
+    ./mic-bench day.cap
+    @endcode
+*/
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include "capture.h"
+#include "miccodec.h"
+
+using namespace Spine;
+
+
+/** The monotonic time
+    @return the time (in seconds)
+*/
+static double now()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+
+int main(int argc, char** argv)
+{
+    if (argc < 2)
+    {
+        fprintf(stderr, "usage: %s capture\n", argv[0]);
+        return 1;
+    }
+    static CaptureReader reader;
+    if (!reader.open(argv[1]))
+    {
+        fprintf(stderr, "can't read %s\n", argv[1]);
+        return 1;
+    }
+
+    MicEncoder encoder;
+    MicDecoder decoder;
+    double encoding = 0, decoding = 0;
+    CaptureFrame frame;
+    while (reader.next(frame))
+    {
+        if (!frame.b2h || frame.type != MessageType::dataFrame || frame.size != sizeof(B2HDataFrame))
+            continue;
+        B2HDataFrame data;
+        memcpy(&data, frame.payload, sizeof(data));
+
+        uint8_t block[micBlockMaxSize];
+        auto start = now();
+        auto size = encoder.encode(data, block, sizeof(block));
+        auto middle = now();
+        uint32_t sequenceNumber;
+        int16_t samples[micBlockSamples];
+        auto used = decoder.decode(block, size, sequenceNumber, samples);
+        decoding += now() - middle;
+        encoding += middle - start;
+
+        if (!size || used != size || memcmp(samples, data.mic_samples, sizeof(samples)))
+        {
+            fprintf(stderr, "frame %u doesn't decode to the same samples\n", (unsigned) data.sequenceNumber);
+            return 1;
+        }
+    }
+
+    if (!encoder.numBlocks)
+    {
+        fprintf(stderr, "no data frames in %s\n", argv[1]);
+        return 1;
+    }
+    double megabytes = encoder.numSampleBytes / 1e6;
+    printf("%zu frames, %zu gaps (%zu frames missing)\n", encoder.numBlocks, decoder.numGaps, decoder.numMissing);
+    printf("ratio:    %.3f (%.1f MB to %.1f MB)\n", (double) encoder.numCodedBytes / encoder.numSampleBytes, megabytes, encoder.numCodedBytes / 1e6);
+    printf("coding:   %.1f MB/s\n", megabytes / encoding);
+    printf("decoding: %.1f MB/s\n", megabytes / decoding);
+    return 0;
+}
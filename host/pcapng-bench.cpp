@@ -0,0 +1,146 @@
+/* Measure the speed of converting a capture to pcapng, and reading it back
+   Copyright 2024 Randall Maas
+*//**@file
+    @brief Measure the speed of converting a capture to pcapng, and reading it back.
+
+    This writes a capture of data frames in both directions (if it doesn't
+    exist), converts it to a pcapng file (see pcapng.h), and reads the
+    pcapng file back through a filter, timing each:
+
+    @code
+    g++ -std=c++17 -O2 -Ihost -Isrc src/schema.cpp src/filter.cpp src/capture.cpp src/pcapng.cpp host/pcapng-bench.cpp -o pcapng-bench
+    ./pcapng-bench /tmp/bench.cap /tmp/bench.pcapng 1024 "battery_volt > 3505"
+    @endcode
+
+    The arguments are the path of the capture, the path of the pcapng file,
+    the size of the capture in megabytes, and the filter expression (on the
+    frames from the body board).  The file cache should be dropped between
+    runs for the times to include reading the disk.
+*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include "capture.h"
+#include "pcapng.h"
+
+using namespace Spine;
+
+
+/** The monotonic time
+    @return the time (in seconds)
+*/
+static double now()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+
+/** Write the capture
+    @param path the path of the capture
+    @param megabytes the size of the capture
+    @return true on success, false on error
+*/
+static bool writeCapture(const char* path, size_t megabytes)
+{
+    static CaptureWriter writer;
+    if (!writer.open(path))
+        return false;
+    B2HDataFrame body = {};
+    H2BDataFrame head = {};
+    size_t numFrames = megabytes * 1024 * 1024 / (sizeof(body) + sizeof(head) + 2*sizeof(CaptureRecord));
+    for (size_t idx = 0; idx < numFrames; idx++)
+    {
+        // a frame each way every 5ms
+        body.sequenceNumber   = head.sequenceNumber = (uint32_t) idx;
+        body.battery_volt     = (int16_t)(3500 + idx / 100000 % 700);
+        body.cliffSense[2]    = (uint16_t)(idx * 7 % 1000);
+        head.motorPower[0]    = (int16_t)(idx % 2000 - 1000);
+        if (!writer.write(true , MessageType::dataFrame, (const uint8_t*) &body, sizeof(body), idx * 5000000ULL)
+         || !writer.write(false, MessageType::dataFrame, (const uint8_t*) &head, sizeof(head), idx * 5000000ULL + 1000))
+            return false;
+    }
+    return writer.close();
+}
+
+
+/** The size of a file
+    @param path the path of the file
+    @return the size (in bytes)
+*/
+static double fileSize(const char* path)
+{
+    auto file = fopen(path, "rb");
+    if (!file)
+        return 0;
+    fseek(file, 0, SEEK_END);
+    double size = (double) ftell(file);
+    fclose(file);
+    return size;
+}
+
+
+int main(int argc, char** argv)
+{
+    const char* capturePath = argc > 1 ? argv[1] : "bench.cap";
+    const char* pcapngPath  = argc > 2 ? argv[2] : "bench.pcapng";
+    size_t      megabytes   = argc > 3 ? strtoul(argv[3], nullptr, 10) : 1024;
+    const char* expression  = argc > 4 ? argv[4] : "battery_volt > 3505";
+
+    Filter filter;
+    if (!filter.compile(expression))
+    {
+        fprintf(stderr, "%s\n%*s^ %s\n", expression, (int) filter.errorPos, "", filter.error);
+        return 1;
+    }
+
+    auto file = fopen(capturePath, "rb");
+    if (file)
+        fclose(file);
+    else if (!writeCapture(capturePath, megabytes))
+    {
+        fprintf(stderr, "can't write %s\n", capturePath);
+        return 1;
+    }
+
+    // convert the capture
+    static CaptureReader capture;
+    static PcapngWriter  writer;
+    if (!capture.open(capturePath) || !writer.open(pcapngPath))
+    {
+        fprintf(stderr, "can't convert %s to %s\n", capturePath, pcapngPath);
+        return 1;
+    }
+    auto start = now();
+    CaptureFrame frame;
+    while (capture.next(frame))
+        if (!writer.write(frame.b2h, frame.type, frame.payload, frame.size, frame.timestamp_ns))
+        {
+            fprintf(stderr, "can't write %s\n", pcapngPath);
+            return 1;
+        }
+    writer.close();
+    auto seconds = now() - start;
+    auto size = fileSize(pcapngPath);
+    printf("converted: %zu frames, %.3f s, %.2f GB/s\n", writer.numFrames, seconds, size / seconds / 1e9);
+
+    // read it back
+    static PcapngReader reader;
+    if (!reader.open(pcapngPath))
+    {
+        fprintf(stderr, "can't read %s\n", pcapngPath);
+        return 1;
+    }
+    start = now();
+    size_t numFrames = 0, numMatched = 0;
+    PcapngFrame read;
+    while (reader.next(read))
+    {
+        numFrames++;
+        numMatched += read.b2h && filter.match(read.type, read.payload, read.size);
+    }
+    seconds = now() - start;
+    printf("read:      %zu frames, %zu matched, %.3f s, %.2f GB/s\n", numFrames, numMatched, seconds, size / seconds / 1e9);
+    return 0;
+}
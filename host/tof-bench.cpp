@@ -0,0 +1,85 @@
+/* Measure the time of flight reconstruction
+   Copyright 2024 Randall Maas
+*//**@file
+    @brief Measure the time of flight reconstruction.
+
+    This reconstructs the counts and reflectivity of a sweep of time of flight
+    readings, and accumulates them into the histograms (see tof.h), and
+    reports the time taken by each, per reading:
+
+    @code
+    g++ -std=c++17 -O2 -Ihost -Isrc src/tof.cpp host/tof-bench.cpp -o tof-bench
+    ./tof-bench 10000000
+    @endcode
+
+    The argument is the number of readings.  A snapshot of the histograms is
+    taken every 1000 readings, as a consumer on another task might.
+*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "tof.h"
+
+using namespace Spine;
+
+/// The number of different readings swept through
+#define NUM_READINGS (4096)
+
+
+/** The monotonic time
+    @return the time (in seconds)
+*/
+static double now()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+
+int main(int argc, char** argv)
+{
+    uint32_t numReadings = argc > 1 ? (uint32_t) strtoul(argv[1], nullptr, 10) : 10000000;
+
+    // a sweep of targets out to 2.5m, of varied reflectivity; some of the
+    // readings aren't valid
+    static B2HDataFrame frames[NUM_READINGS];
+    for (unsigned idx = 0; idx < NUM_READINGS; idx++)
+    {
+        auto& frame = frames[idx];
+        memset(&frame, 0, sizeof(frame));
+        frame.sequenceNumber       = idx;
+        frame.prox_status          = idx % 17 ? 0 : 4;
+        frame.prox_range_mm        = (uint16_t)(20 + idx * 2480 / NUM_READINGS);
+        frame.prox_signalRate_mcps = (uint16_t)(128 + idx * 37 % 8000);
+        frame.prox_ambient         = (uint16_t)(64 + idx % 200);
+        frame.prox_SPADCount       = (uint16_t)((4 + idx % 40) * 256);
+        frame.prox_sampleCount     = (uint16_t)(10 + idx % 30);
+    }
+
+    // reconstruct alone
+    uint64_t sum = 0;
+    auto start = now();
+    for (uint32_t idx = 0; idx < numReadings; idx++)
+        sum += TofReconstruction::reconstruct(frames[idx % NUM_READINGS], defaultTofConfig).reflectivity;
+    auto reconstructing = now() - start;
+
+    // reconstruct, accumulate and publish, with the odd snapshot
+    static TofReconstruction tof;
+    start = now();
+    for (uint32_t idx = 0; idx < numReadings; idx++)
+    {
+        tof.update(frames[idx % NUM_READINGS]);
+        if (idx % 1000 == 0)
+            sum += tof.snapshot().numReadings;
+    }
+    auto updating = now() - start;
+
+    auto histogram = tof.snapshot();
+    printf("reconstruct: %.1f ns/reading\n", reconstructing * 1e9 / numReadings);
+    printf("update:      %.1f ns/reading\n", updating * 1e9 / numReadings);
+    printf("%u readings, %u in the first bin, %u beyond the last (checksum %llu)\n", histogram.numReadings,
+           histogram.bin[0].count, histogram.bin[TOF_BIN_COUNT-1].count, (unsigned long long) sum);
+    return histogram.numReadings == numReadings ? 0 : 1;
+}
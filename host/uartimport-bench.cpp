@@ -0,0 +1,163 @@
+/* Measure the speed of importing logic analyser exports into a capture
+   Copyright 2024 Randall Maas
+*//**@file
+    @brief Measure the speed of importing logic analyser exports into a capture.
+
+    This writes an export of the bytes on both lines, as a CSV and in the
+    binary form (if they don't exist), with a frame each way every 5ms and
+    a little noise, and times importing each into a capture (see
+    uartimport.h):
+
+    @code
+    g++ -std=c++17 -O2 -Ihost -Isrc src/spine.cpp src/schema.cpp src/filter.cpp src/capture.cpp src/uartimport.cpp host/uartimport-bench.cpp -o uartimport-bench
+    ./uartimport-bench /tmp/bench.csv /tmp/bench.bin /tmp/bench.cap 1024
+    @endcode
+
+    The arguments are the paths of the CSV export, the binary export and the
+    capture, and the size of the CSV in megabytes.  The file cache should be
+    dropped between runs for the times to include reading the disk.
+*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "crc.h"
+#include "uartimport.h"
+
+using namespace Spine;
+
+/// The time of a byte at 3Mbaud (in nanoseconds)
+#define BYTE_TIME_NS (3333)
+
+
+/** The monotonic time
+    @return the time (in seconds)
+*/
+static double now()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+
+/** Build a frame
+    @param frame the frame
+    @param b2h true for a frame from the body board
+    @param payload the payload of a data frame
+    @param size the size of the payload
+    @return the size of the frame
+*/
+static size_t buildFrame(uint8_t* frame, bool b2h, const void* payload, size_t size)
+{
+    const uint8_t header[payload_ofs] = {0xAA, (uint8_t)(b2h ? 'B' : 'H'), '2', (uint8_t)(b2h ? 'H' : 'B'),
+                                         (uint8_t) MessageType::dataFrame, (uint8_t)((uint16_t) MessageType::dataFrame >> 8),
+                                         (uint8_t) size, (uint8_t)(size >> 8)};
+    memcpy(frame, header, payload_ofs);
+    memcpy(frame + payload_ofs, payload, size);
+    auto crc = Crc32(CRC32_INITIAL, frame + payload_ofs, size);
+    memcpy(frame + payload_ofs + size, &crc, 4);
+    return payload_ofs + size + 4;
+}
+
+
+/** Write the exports
+    @param csvPath the path of the CSV export
+    @param binaryPath the path of the binary export
+    @param megabytes the size of the CSV export
+    @return true on success, false on error
+*/
+static bool writeExports(const char* csvPath, const char* binaryPath, size_t megabytes)
+{
+    auto csv    = fopen(csvPath, "wb");
+    auto binary = fopen(binaryPath, "wb");
+    if (!csv || !binary)
+        return false;
+    fprintf(csv, "Time [s],Channel,Value\n");
+
+    static uint8_t body[payload_ofs + sizeof(B2HDataFrame) + 4], head[payload_ofs + sizeof(H2BDataFrame) + 4];
+    B2HDataFrame bodyFrame = {};
+    H2BDataFrame headFrame = {};
+    uint64_t limit = (uint64_t) megabytes * 1024 * 1024;
+    for (uint32_t idx = 0; (uint64_t) ftell(csv) < limit; idx++)
+    {
+        bodyFrame.sequenceNumber = headFrame.sequenceNumber = idx;
+        bodyFrame.battery_volt   = (int16_t)(3500 + idx % 700);
+        headFrame.motorPower[0]  = (int16_t)(idx % 2000 - 1000);
+        auto bodySize = buildFrame(body, true , &bodyFrame, sizeof(bodyFrame));
+        auto headSize = buildFrame(head, false, &headFrame, sizeof(headFrame));
+
+        // the head board's frame goes out while the body board's arrives,
+        // after a byte of noise
+        uint64_t start_ns = idx * 5000000ULL;
+        size_t b = 0, h = 0;
+        uint64_t bodyTime = start_ns + BYTE_TIME_NS, headTime = start_ns + 5 * BYTE_TIME_NS / 2;
+        UartRecord noise = {start_ns, 0, 0x55};
+        fwrite(&noise, sizeof(noise), 1, binary);
+        fprintf(csv, "%llu.%09llu,B2H,0x55\n", (unsigned long long)(start_ns / 1000000000ULL), (unsigned long long)(start_ns % 1000000000ULL));
+        while (b < bodySize || h < headSize)
+        {
+            bool fromBody = h >= headSize || (b < bodySize && bodyTime <= headTime);
+            auto& time_ns = fromBody ? bodyTime : headTime;
+            UartRecord record = {time_ns, (uint8_t)(fromBody ? 0 : 1), fromBody ? body[b++] : head[h++]};
+            fwrite(&record, sizeof(record), 1, binary);
+            fprintf(csv, "%llu.%09llu,%s,0x%02X\n", (unsigned long long)(time_ns / 1000000000ULL), (unsigned long long)(time_ns % 1000000000ULL),
+                    fromBody ? "B2H" : "H2B", record.value);
+            time_ns += BYTE_TIME_NS;
+        }
+    }
+    bool ok = !ferror(csv) && !ferror(binary);
+    ok = !fclose(csv) && ok;
+    return !fclose(binary) && ok;
+}
+
+
+/** Import an export, and report the rate
+    @param path the path of the export
+    @param capturePath the path of the capture
+    @param binary true for the binary form
+*/
+static void import(const char* path, const char* capturePath, bool binary)
+{
+    static UartImporter  importer;
+    static CaptureWriter writer;
+    if (!writer.open(capturePath))
+    {
+        fprintf(stderr, "can't write %s\n", capturePath);
+        exit(1);
+    }
+    auto start = now();
+    bool ok = binary ? importer.importBinary(path, writer) : importer.importCsv(path, writer);
+    ok = writer.close() && ok;
+    auto seconds = now() - start;
+    if (!ok)
+    {
+        fprintf(stderr, "can't import %s\n", path);
+        exit(1);
+    }
+    printf("%-7s %zu rows, %zu bad, %zu frames, %zu bytes skipped, %.3f s, %.1f MB/s\n", binary ? "binary:" : "csv:",
+           importer.numRows, importer.numBadRows, importer.numFrames, importer.numSkipped, seconds,
+           importer.numInputBytes / seconds / 1e6);
+}
+
+
+int main(int argc, char** argv)
+{
+    const char* csvPath     = argc > 1 ? argv[1] : "bench.csv";
+    const char* binaryPath  = argc > 2 ? argv[2] : "bench.bin";
+    const char* capturePath = argc > 3 ? argv[3] : "bench.cap";
+    size_t      megabytes   = argc > 4 ? strtoul(argv[4], nullptr, 10) : 1024;
+
+    auto file = fopen(csvPath, "rb");
+    if (file)
+        fclose(file);
+    else if (!writeExports(csvPath, binaryPath, megabytes))
+    {
+        fprintf(stderr, "can't write %s and %s\n", csvPath, binaryPath);
+        return 1;
+    }
+
+    import(csvPath, capturePath, false);
+    import(binaryPath, capturePath, true);
+    return 0;
+}
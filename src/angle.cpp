@@ -0,0 +1,131 @@
+/* Lift and head angle tracking
+   Copyright 2024 Randall Maas
+*//**@file
+    @brief Lift and head angle tracking.
+
+    This file contains the implementation of the angle tracker: converting
+    the encoder positions to angles, estimating the velocity, and referencing
+    the axes against their hard stops.
+*/
+#include <string.h>
+#include <Arduino.h>
+#include "angle.h"
+
+namespace Spine {
+
+/// The default calibration of the head
+const AxisConfig defaultHeadConfig =
+{
+    // ticks per radian: an estimate of the encoder through the gearing
+    1000.0f,
+    // about -22 degrees to 45 degrees, the head's published travel
+    -0.38f, 0.785f,
+    // about 1 degree, a few ticks of slack at the stops
+    0.0175f
+};
+
+/// The default calibration of the lift
+const AxisConfig defaultLiftConfig =
+{
+    // ticks per radian: the same estimate as the head
+    1000.0f,
+    // about -11 degrees to 60 degrees, the arm's travel from resting to
+    // raised
+    -0.2f, 1.05f,
+    // about 1 degree, as for the head
+    0.0175f
+};
+
+
+/** Create the angle tracker
+    @param headConfig the calibration of the head
+    @param liftConfig the calibration of the lift
+*/
+AngleTracker::AngleTracker(const AxisConfig& headConfig, const AxisConfig& liftConfig)
+    : numFrames(0), numUpdates(0), lastFrame_us(0)
+{
+    memset(&headAxis, 0, sizeof(headAxis));
+    memset(&liftAxis, 0, sizeof(liftAxis));
+    headAxis.config = headConfig;
+    liftAxis.config = liftConfig;
+}
+
+
+/** Update the angles from a data frame
+    @param frame the data frame from the body board
+    @param arrival_us the time (in microseconds) that the frame arrived
+    @return true if either axis was updated, false if not.
+*/
+bool AngleTracker::update(const B2HDataFrame& frame, uint32_t arrival_us)
+{
+    // The encoder deltas are since the previous frame
+    auto elapsed_us = numFrames ? arrival_us - lastFrame_us : 0;
+    lastFrame_us = arrival_us;
+    numFrames++;
+
+    bool headUpdated = update(headAxis, head, frame, Motor::backRight, frame.headEncoderChanged, elapsed_us);
+    bool liftUpdated = update(liftAxis, lift, frame, Motor::backLeft , frame.liftEncoderChanged, elapsed_us);
+    return headUpdated || liftUpdated;
+}
+
+
+/** Update an axis
+    @param axis the axis to update
+    @param out where to publish the state
+    @param frame the data frame
+    @param motor the motor of the axis
+    @param changed true if the encoder changed in this frame
+    @param elapsed_us the time since the previous frame (in microseconds)
+    @return true if the axis was updated
+*/
+bool AngleTracker::update(Axis& axis, Seqlock<AxisState>& out, const B2HDataFrame& frame, Motor motor, bool changed, uint32_t elapsed_us)
+{
+    auto& state = axis.state;
+    if (!changed)
+    {
+        // Nothing moved.  The only thing to do is to report that the axis
+        // stopped, once.
+        if (state.velocity == 0.0f)
+            return false;
+        state.sequenceNumber = frame.sequenceNumber;
+        state.velocity = 0.0f;
+        out.write(state);
+        numUpdates++;
+        return true;
+    }
+
+    // Convert the encoder position to an angle
+    auto& config = axis.config;
+    auto& encoder = frame.motor[(int)motor];
+    auto position = encoder.position;
+    auto angle = (float)(position - axis.zeroPosition) / config.ticksPerRadian;
+
+    // If the axis went past a stop, the zero was off; reference it to the stop
+    if (angle < config.minAngle)
+    {
+        axis.zeroPosition = position - (int32_t)(config.minAngle * config.ticksPerRadian);
+        angle = config.minAngle;
+        state.calibrated = 1;
+    }
+    else if (angle > config.maxAngle)
+    {
+        axis.zeroPosition = position - (int32_t)(config.maxAngle * config.ticksPerRadian);
+        angle = config.maxAngle;
+        state.calibrated = 1;
+    }
+    state.atMinLimit = angle <= config.minAngle + config.limitTolerance;
+    state.atMaxLimit = angle >= config.maxAngle - config.limitTolerance;
+
+    // Estimate the velocity from the motion since the previous frame
+    if (elapsed_us > 0)
+        state.velocity = (float) encoder.delta * 1.0e6f / (config.ticksPerRadian * (float) elapsed_us);
+    state.angle = angle;
+    state.sequenceNumber = frame.sequenceNumber;
+
+    // Publish the new state
+    out.write(state);
+    numUpdates++;
+    return true;
+}
+
+}
@@ -0,0 +1,139 @@
+/* Lift and head angle tracking
+   Copyright 2024 Randall Maas
+*//**@file
+    @brief Lift and head angle tracking.
+
+    The body board sets the headEncoderChanged and liftEncoderChanged bits in
+    its data frame when those motors have moved.  The angle tracker only does
+    work on frames where the bit for an axis is set; on the other frames
+    nothing has changed, so there is nothing to recompute.
+
+    Each axis has a calibration (ticks per radian and the angle of the hard
+    stops).  The encoders are relative, so the angle is only trustworthy after
+    the axis has been driven against one of its stops.  When the encoder goes
+    past a stop, the tracker takes that as the reference and re-zeros the
+    axis there.
+
+    The state of each axis is published through a sequence lock, so other
+    tasks can read it without stalling the receive task.
+*/
+#pragma once
+#include <inttypes.h>
+#include "spine.h"
+#include "seqlock.h"
+
+namespace Spine {
+
+/// The calibration of a lift or head axis
+struct AxisConfig
+{
+    /// The encoder ticks per radian of motion at the output
+    float ticksPerRadian;
+
+    /// The angle of the lower hard stop (in radians)
+    float minAngle;
+
+    /// The angle of the upper hard stop (in radians)
+    float maxAngle;
+
+    /// How close to a stop (in radians) counts as being at the limit
+    float limitTolerance;
+};
+
+/// The default calibrations of the head and lift.  The ticks per radian is
+/// a guess at the gearing, so the angles can be off by a scale factor until
+/// it is calibrated; the limits are the published travel.
+extern const AxisConfig defaultHeadConfig;
+extern const AxisConfig defaultLiftConfig;
+
+
+/// The published state of a lift or head axis
+struct AxisState
+{
+    /// The sequence number of the data frame the state was computed from
+    uint32_t sequenceNumber;
+
+    /// The angle of the axis (in radians)
+    float angle;
+
+    /// The angular velocity of the axis (in radians/second)
+    float velocity;
+
+    /// The axis is at (or was driven into) its lower stop
+    uint8_t atMinLimit:1,
+
+    /// The axis is at (or was driven into) its upper stop
+            atMaxLimit:1,
+
+    /// The axis has been referenced against a stop, so the angle is absolute
+            calibrated:1;
+};
+
+
+/** Track the angle of the lift and head from the encoders.
+*/
+class AngleTracker
+{
+public:
+    /** Create the angle tracker
+        @param headConfig the calibration of the head
+        @param liftConfig the calibration of the lift
+    */
+    AngleTracker(const AxisConfig& headConfig = defaultHeadConfig, const AxisConfig& liftConfig = defaultLiftConfig);
+
+    /** Update the angles from a data frame
+        @param frame the data frame from the body board
+        @param arrival_us the time (in microseconds) that the frame arrived
+        @return true if either axis was updated, false if not.
+    */
+    bool update(const B2HDataFrame& frame, uint32_t arrival_us);
+
+    /// The state of the head, for other tasks to read
+    Seqlock<AxisState> head;
+
+    /// The state of the lift, for other tasks to read
+    Seqlock<AxisState> lift;
+
+    /// The number of data frames seen
+    uint32_t numFrames;
+
+    /// The number of axis updates computed.  Recomputing on every frame
+    /// would be 2*numFrames.
+    uint32_t numUpdates;
+
+private:
+    /// The working state of an axis
+    struct Axis
+    {
+        /// The calibration
+        AxisConfig config;
+
+        /// The encoder position at the zero angle
+        int32_t zeroPosition;
+
+        /// The last published state
+        AxisState state;
+    };
+
+    /** Update an axis
+        @param axis the axis to update
+        @param out where to publish the state
+        @param frame the data frame
+        @param motor the motor of the axis
+        @param changed true if the encoder changed in this frame
+        @param elapsed_us the time since the previous frame (in microseconds)
+        @return true if the axis was updated
+    */
+    bool update(Axis& axis, Seqlock<AxisState>& out, const B2HDataFrame& frame, Motor motor, bool changed, uint32_t elapsed_us);
+
+    /// The time the previous frame arrived
+    uint32_t lastFrame_us;
+
+    /// The head axis
+    Axis headAxis;
+
+    /// The lift axis
+    Axis liftAxis;
+};
+
+}
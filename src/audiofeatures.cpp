@@ -0,0 +1,268 @@
+/* Log-mel and MFCC features of the microphone audio, for keyword spotting
+   Copyright 2024 Randall Maas
+*//**@file
+    @brief Log-mel and MFCC features of the microphone audio, for keyword spotting.
+
+    This file contains the mel band tables (computed at compile time), and
+    the feature computation.
+*/
+#include <string.h>
+#include <math.h>
+#include <Arduino.h>
+#include "audiofeatures.h"
+
+namespace Spine {
+
+static_assert(FEATURE_FFT_SIZE >= FEATURE_FRAME_LENGTH, "The FFT must hold the frame");
+static_assert(FEATURE_MEL_HIGH_HZ <= MICROPHONE_SAMPLE_RATE/2, "The mel bands must be below the Nyquist frequency");
+
+/// The default settings: 160 samples (about 10ms) between frames, and
+/// 13 MFCCs
+const FeatureConfig defaultFeatureConfig =
+{
+    // hop
+    160,
+    // pre-emphasis
+    0.97f,
+    // MFCCs
+    13
+};
+
+/// Pi
+static constexpr double pi = 3.14159265358979323846;
+
+/// The smallest band power, so that the log is finite
+#define MIN_POWER (1e-10f)
+
+
+/** The natural log, at compile time
+    @param x the value, more than 0
+    @return the log
+*/
+static constexpr double constLog(double x)
+{
+    // bring x into [1, 2), then the series of 2 atanh((x-1)/(x+1))
+    double result = 0;
+    while (x >= 2) { x /= 2; result += 0.69314718055994530942; }
+    while (x < 1)  { x *= 2; result -= 0.69314718055994530942; }
+    double y = (x - 1) / (x + 1), term = y;
+    for (int idx = 1; idx < 60; idx += 2, term *= y*y)
+        result += 2 * term / idx;
+    return result;
+}
+
+/** The exponential, at compile time
+    @param x the value
+    @return e to the x
+*/
+static constexpr double constExp(double x)
+{
+    // e^x = (e^(x/2^n))^(2^n), with the series for the small value
+    int halvings = 0;
+    while (x > 0.5 || x < -0.5) { x /= 2; halvings++; }
+    double result = 1, term = 1;
+    for (int idx = 1; idx < 20; idx++)
+    {
+        term *= x / idx;
+        result += term;
+    }
+    while (halvings--)
+        result *= result;
+    return result;
+}
+
+/// The mel scale of a frequency (in Hz)
+static constexpr double toMel(double hz) { return 1127 * constLog(1 + hz/700); }
+
+/// The frequency (in Hz) of a point on the mel scale
+static constexpr double fromMel(double mel) { return 700 * (constExp(mel/1127) - 1); }
+
+
+/// A triangular mel band, over the FFT bins
+struct MelBand
+{
+    /// The first and last FFT bins in the band
+    uint16_t first, last;
+
+    /// The edges and peak of the triangle (in FFT bins)
+    float left, centre, right;
+};
+
+/// The mel bands
+struct MelBands
+{
+    MelBand bands[FEATURE_MEL_BANDS];
+};
+
+/** Compute the mel bands, evenly spaced on the mel scale
+    @return the mel bands
+*/
+static constexpr MelBands melBands()
+{
+    MelBands result = {};
+    double low = toMel(FEATURE_MEL_LOW_HZ), high = toMel(FEATURE_MEL_HIGH_HZ);
+    double edges[FEATURE_MEL_BANDS+2] = {};
+    for (size_t idx = 0; idx < FEATURE_MEL_BANDS+2; idx++)
+        edges[idx] = fromMel(low + (high - low) * idx / (FEATURE_MEL_BANDS+1)) * FEATURE_FFT_SIZE / MICROPHONE_SAMPLE_RATE;
+    for (size_t idx = 0; idx < FEATURE_MEL_BANDS; idx++)
+    {
+        auto& band = result.bands[idx];
+        band.left   = (float) edges[idx];
+        band.centre = (float) edges[idx+1];
+        band.right  = (float) edges[idx+2];
+        band.first  = (uint16_t) edges[idx] + 1;
+        band.last   = (uint16_t) edges[idx+2];
+        // the narrow low bands may fall between bins; take the nearest one
+        if (band.first > band.last)
+            band.first = band.last = (uint16_t)(edges[idx+1] + 0.5);
+    }
+    return result;
+}
+
+/// The mel bands, computed at compile time
+static constexpr MelBands mel = melBands();
+static_assert(mel.bands[FEATURE_MEL_BANDS-1].last <= FEATURE_FFT_SIZE/2, "The mel bands must be within the spectrum");
+
+
+/** The weight of an FFT bin in a mel band
+    @param band the band
+    @param bin the FFT bin
+    @return the weight, 0 to 1
+*/
+static inline float weight(const MelBand& band, size_t bin)
+{
+    float w = bin <= band.centre ? (bin - band.left) / (band.centre - band.left)
+                                 : (band.right - bin) / (band.right - band.centre);
+    // the nearest bin of a narrow band
+    return w > 0 ? w : (band.first == band.last ? 1.0f : 0.0f);
+}
+
+
+/** Create the feature extractor
+    @param config the settings
+*/
+FeatureExtractor::FeatureExtractor(const FeatureConfig& config)
+    : numFrames(0), numDropped(0), config(config), numSamples(0), numSkip(0), previous(0), sampleNumber(0)
+    , numWritten(0), numRead(0)
+{
+    if (!this->config.hop)
+        this->config.hop = 1;
+    if (this->config.numCoefficients > FEATURE_MEL_BANDS)
+        this->config.numCoefficients = FEATURE_MEL_BANDS;
+
+    for (size_t idx = 0; idx < FEATURE_FRAME_LENGTH; idx++)
+        window[idx] = (float)(0.5 - 0.5*cos(2*pi*idx / FEATURE_FRAME_LENGTH));
+
+    // the orthonormal DCT-II
+    for (size_t coefficient = 0; coefficient < FEATURE_MEL_BANDS; coefficient++)
+        for (size_t band = 0; band < FEATURE_MEL_BANDS; band++)
+            dct[coefficient][band] = (float)(sqrt((coefficient ? 2.0 : 1.0) / FEATURE_MEL_BANDS)
+                                             * cos(pi * coefficient * (band + 0.5) / FEATURE_MEL_BANDS));
+    memset(samples, 0, sizeof(samples));
+    memset(ring, 0, sizeof(ring));
+}
+
+
+/** Add samples
+    @param in the samples
+    @param count the number of samples
+
+    A feature frame is computed each time another hop samples have been
+    added (once the first frame length has been added).
+*/
+void FeatureExtractor::push(const int16_t* in, size_t count)
+{
+    for (size_t idx = 0; idx < count; idx++)
+    {
+        float value = in[idx] * (1.0f/32768);
+        float previousValue = previous;
+        previous = value;
+        sampleNumber++;
+        if (numSkip)
+        {
+            numSkip--;
+            continue;
+        }
+        samples[numSamples++] = value - config.preEmphasis * previousValue;
+        if (numSamples < FEATURE_FRAME_LENGTH)
+            continue;
+
+        compute();
+
+        // slide the frame along by the hop, skipping any samples past the
+        // end of the frame
+        size_t keep = config.hop < FEATURE_FRAME_LENGTH ? FEATURE_FRAME_LENGTH - config.hop : 0;
+        memmove(samples, samples + FEATURE_FRAME_LENGTH - keep, keep*sizeof(samples[0]));
+        numSamples = keep;
+        numSkip = config.hop > FEATURE_FRAME_LENGTH ? config.hop - FEATURE_FRAME_LENGTH : 0;
+    }
+}
+
+
+/// Compute the features of the samples, and put them in the ring
+void FeatureExtractor::compute()
+{
+    numFrames++;
+    auto written = numWritten.load(std::memory_order_relaxed);
+    if (written - numRead.load(std::memory_order_acquire) >= FEATURE_RING_FRAMES)
+    {
+        numDropped++;
+        return;
+    }
+
+    // the windowed frame, padded with zeros
+    for (size_t idx = 0; idx < FEATURE_FRAME_LENGTH; idx++)
+        frame[idx] = samples[idx] * window[idx];
+    memset(frame + FEATURE_FRAME_LENGTH, 0, (FEATURE_FFT_SIZE - FEATURE_FRAME_LENGTH)*sizeof(frame[0]));
+
+    fft.forward(frame, spectrum);
+
+    // the log power in each mel band
+    for (size_t idx = 0; idx < FEATURE_MEL_BANDS; idx++)
+    {
+        auto& band = mel.bands[idx];
+        float power = 0;
+        for (size_t bin = band.first; bin <= band.last; bin++)
+            power += weight(band, bin) * (spectrum[2*bin]*spectrum[2*bin] + spectrum[2*bin+1]*spectrum[2*bin+1]);
+        logPower[idx] = logf(power > MIN_POWER ? power : MIN_POWER);
+    }
+
+    // the features
+    auto& out = ring[written % FEATURE_RING_FRAMES];
+    out.sampleNumber = sampleNumber;
+    out.count = config.numCoefficients ? config.numCoefficients : FEATURE_MEL_BANDS;
+    for (size_t idx = 0; idx < out.count; idx++)
+    {
+        float value = logPower[idx];
+        if (config.numCoefficients)
+        {
+            value = 0;
+            for (size_t band = 0; band < FEATURE_MEL_BANDS; band++)
+                value += dct[idx][band] * logPower[band];
+        }
+#if FEATURE_FIXED_POINT
+        value *= FEATURE_FIXED_SCALE;
+        out.values[idx] = (Feature)(value > INT16_MAX ? INT16_MAX : value < INT16_MIN ? INT16_MIN : lroundf(value));
+#else
+        out.values[idx] = value;
+#endif
+    }
+    numWritten.store(written + 1, std::memory_order_release);
+}
+
+
+/** Take the oldest feature frame out of the ring
+    @param frame the feature frame
+    @return true if there was one, false if the ring is empty
+*/
+bool FeatureExtractor::pop(FeatureFrame& frame)
+{
+    auto read = numRead.load(std::memory_order_relaxed);
+    if (read == numWritten.load(std::memory_order_acquire))
+        return false;
+    frame = ring[read % FEATURE_RING_FRAMES];
+    numRead.store(read + 1, std::memory_order_release);
+    return true;
+}
+
+}
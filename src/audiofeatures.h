@@ -0,0 +1,164 @@
+/* Log-mel and MFCC features of the microphone audio, for keyword spotting
+   Copyright 2024 Randall Maas
+*//**@file
+    @brief Log-mel and MFCC features of the microphone audio, for keyword spotting.
+
+    The feature extractor takes a stream of audio samples at 15625 Hz (one
+    microphone, or the output of the beamformer) and emits a feature frame
+    every hop samples.  Each feature frame is computed over the last
+    FEATURE_FRAME_LENGTH samples:
+
+    1. pre-emphasis, to lift the high frequencies (done as the samples
+       arrive)
+    2. a Hann window
+    3. a real FFT of FEATURE_FFT_SIZE points (see fft.h)
+    4. the power in each of FEATURE_MEL_BANDS triangular mel bands, from
+       FEATURE_MEL_LOW_HZ to FEATURE_MEL_HIGH_HZ
+    5. the natural log of the band powers
+    6. optionally, a DCT of the log band powers to give the MFCCs
+
+    The mel bands are computed at compile time.
+
+    The feature frames are put in a ring of FEATURE_RING_FRAMES frames, for a
+    keyword spotter to take out, possibly from another task.  If the ring is
+    full, the new frame is dropped (and counted).
+
+    The features are floats, or, with FEATURE_FIXED_POINT set to 1, 16 bit
+    fixed point numbers with FEATURE_FIXED_SCALE steps per unit.
+
+    @code
+    Beamformer beamformer;
+    FeatureExtractor features;
+    int16_t voice[MICROPHONE_SAMPLES_PER_FRAME];
+    beamformer.process(frame, voice);
+    features.push(voice, MICROPHONE_SAMPLES_PER_FRAME);
+
+    FeatureFrame feature;
+    while (features.pop(feature))
+        ... feature.values[0..feature.count-1] ...
+    @endcode
+*/
+#pragma once
+#include <inttypes.h>
+#include <stddef.h>
+#include <atomic>
+#include "spine.h"
+#include "fft.h"
+
+namespace Spine {
+
+#if FEATURE_FIXED_POINT
+/// A feature, in fixed point with FEATURE_FIXED_SCALE steps per unit
+typedef int16_t Feature;
+#else
+/// A feature
+typedef float Feature;
+#endif
+
+/// The settings of the feature extractor
+struct FeatureConfig
+{
+    /// The number of samples between feature frames.  A hop longer than the
+    /// frame length skips the samples between the frames.
+    uint16_t hop;
+
+    /// The pre-emphasis coefficient, 0 for none
+    float preEmphasis;
+
+    /// The number of MFCCs, 0 for the log-mel band powers
+    uint8_t numCoefficients;
+};
+
+/// The default settings: 160 samples (about 10ms) between frames, and
+/// 13 MFCCs
+extern const FeatureConfig defaultFeatureConfig;
+
+
+/// The features of a frame of audio
+struct FeatureFrame
+{
+    /// The number of samples pushed before the end of the frame
+    uint32_t sampleNumber;
+
+    /// The number of features
+    uint8_t count;
+
+    /// The log-mel band powers, or the MFCCs
+    Feature values[FEATURE_MEL_BANDS];
+};
+
+
+/** Computes the log-mel or MFCC features of a stream of audio
+*/
+class FeatureExtractor
+{
+public:
+    /** Create the feature extractor
+        @param config the settings
+    */
+    FeatureExtractor(const FeatureConfig& config = defaultFeatureConfig);
+
+    /** Add samples
+        @param samples the samples
+        @param count the number of samples
+
+        A feature frame is computed each time another hop samples have been
+        added (once the first frame length has been added).
+    */
+    void push(const int16_t* samples, size_t count);
+
+    /** Take the oldest feature frame out of the ring
+        @param frame the feature frame
+        @return true if there was one, false if the ring is empty
+    */
+    bool pop(FeatureFrame& frame);
+
+    /// The number of feature frames computed, and dropped as the ring was full
+    uint32_t numFrames, numDropped;
+
+private:
+    /// Compute the features of the samples, and put them in the ring
+    void compute();
+
+    /// The settings
+    FeatureConfig config;
+
+    /// The transform
+    RealFft<FEATURE_FFT_SIZE> fft;
+
+    /// The Hann window
+    float window[FEATURE_FRAME_LENGTH];
+
+    /// The DCT, for the MFCCs
+    float dct[FEATURE_MEL_BANDS][FEATURE_MEL_BANDS];
+
+    /// The last frame length of samples, after the pre-emphasis
+    float samples[FEATURE_FRAME_LENGTH];
+
+    /// The number of samples held
+    size_t numSamples;
+
+    /// The number of samples yet to skip, when the hop is longer than the
+    /// frame length
+    size_t numSkip;
+
+    /// The previous sample, for the pre-emphasis
+    float previous;
+
+    /// The number of samples pushed
+    uint32_t sampleNumber;
+
+    /// The windowed frame padded with zeros, its spectrum, and the log power
+    /// in each mel band, kept here rather than on the caller's stack
+    float frame[FEATURE_FFT_SIZE];
+    float spectrum[FEATURE_FFT_SIZE+2];
+    float logPower[FEATURE_MEL_BANDS];
+
+    /// The feature frames
+    FeatureFrame ring[FEATURE_RING_FRAMES];
+
+    /// The number of frames put in, and taken out of, the ring
+    std::atomic<uint32_t> numWritten, numRead;
+};
+
+}
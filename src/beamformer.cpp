@@ -0,0 +1,190 @@
+/* Delay and sum beamformer for the microphones
+   Copyright 2024 Randall Maas
+*//**@file
+    @brief Delay and sum beamformer for the microphones.
+
+    This file contains the steering (the delays and fractional delay filter
+    taps for a direction), the delay and sum kernel, and the direction
+    estimate.
+*/
+#include <string.h>
+#include <math.h>
+#include <Arduino.h>
+#include "beamformer.h"
+
+namespace Spine {
+
+/// The default geometry of the microphones
+const BeamformerConfig defaultBeamformerConfig =
+{
+    // the corners of a 3cm square: front left, front right, back left, back right
+    { 0.015f,  0.015f, -0.015f, -0.015f},
+    { 0.015f, -0.015f,  0.015f, -0.015f},
+    // meters/second, in air at 20C
+    343.0f
+};
+
+/// The fixed point scale of the filter taps
+#define TAP_SCALE (16384)
+
+/// The shift to take the fixed point scale off the sum
+#define TAP_SHIFT (14)
+
+/// Pi, as a float
+static constexpr float pi = 3.14159265f;
+
+
+/** Create the beamformer, steered straight ahead
+    @param config the geometry of the microphones
+*/
+Beamformer::Beamformer(const BeamformerConfig& config)
+    : azimuth(0), numFrames(0), config(config)
+{
+    memset(samples, 0, sizeof(samples));
+    steer(0);
+}
+
+
+/** Compute the delays for a direction
+    @param azimuth the direction (in radians)
+    @param steering the delays
+*/
+void Beamformer::steering(float azimuth, Steering& steering) const
+{
+    // the time the sound reaches each microphone, relative to the centre
+    float arrival[MICROPHONE_COUNT];
+    float latest = -INFINITY;
+    float ux = cosf(azimuth), uy = sinf(azimuth);
+    for (size_t mic = 0; mic < MICROPHONE_COUNT; mic++)
+    {
+        arrival[mic] = -(config.micX[mic]*ux + config.micY[mic]*uy) / config.speedOfSound;
+        if (arrival[mic] > latest)
+            latest = arrival[mic];
+    }
+
+    for (size_t mic = 0; mic < MICROPHONE_COUNT; mic++)
+    {
+        // delay each microphone to line up with the latest; the extra sample
+        // keeps the fractional part in the middle of the filter
+        float delay = 1.0f + (latest - arrival[mic]) * MICROPHONE_SAMPLE_RATE;
+        if (delay > historySize - 2)
+            delay = historySize - 2;
+        int whole = (int) delay - 1;
+        float fraction = delay - whole;
+        steering.delay[mic] = (uint8_t) whole;
+
+        // the Lagrange interpolation taps for a delay of fraction (1 to 2)
+        for (int tap = 0; tap < (int) numTaps; tap++)
+        {
+            float h = 1.0f;
+            for (int other = 0; other < (int) numTaps; other++)
+                if (other != tap)
+                    h *= (fraction - other) / (tap - other);
+            steering.taps[mic][tap] = (int16_t) lroundf(h * TAP_SCALE / MICROPHONE_COUNT);
+        }
+    }
+}
+
+
+/** Steer the beamformer
+    @param azimuth the direction of the sound (in radians), 0 ahead, and
+           positive to the left
+*/
+void Beamformer::steer(float azimuth)
+{
+    this->azimuth = azimuth;
+    steering(azimuth, current);
+}
+
+
+/** Split the microphones of a frame, after their past samples
+    @param frame the data frame
+*/
+void Beamformer::split(const B2HDataFrame& frame)
+{
+    for (size_t idx = 0; idx < MICROPHONE_SAMPLES_PER_FRAME; idx++)
+        for (size_t mic = 0; mic < MICROPHONE_COUNT; mic++)
+            samples[mic][historySize + idx] = frame.mic_samples[idx*MICROPHONE_COUNT + mic];
+}
+
+
+/** Delay and add the microphones
+    @param steering the delays
+    @param out the sum
+*/
+void Beamformer::sum(const Steering& steering, int32_t* out) const
+{
+    memset(out, 0, MICROPHONE_SAMPLES_PER_FRAME*sizeof(*out));
+
+    // a multiply-add over the frame for each microphone and tap
+    for (size_t mic = 0; mic < MICROPHONE_COUNT; mic++)
+        for (size_t tap = 0; tap < numTaps; tap++)
+        {
+            const int16_t* in = samples[mic] + historySize - steering.delay[mic] - tap;
+            int32_t weight = steering.taps[mic][tap];
+            for (size_t idx = 0; idx < MICROPHONE_SAMPLES_PER_FRAME; idx++)
+                out[idx] += weight * in[idx];
+        }
+}
+
+
+/** Estimate the direction of the sound in a frame
+    @param frame the data frame from the body board
+    @return the direction (in radians) with the most power, of
+            BEAMFORMER_DIRECTIONS directions around the robot
+
+    This doesn't steer the beamformer, or consume the frame.
+*/
+float Beamformer::estimate(const B2HDataFrame& frame)
+{
+    split(frame);
+    float best = 0;
+    int64_t bestPower = -1;
+    for (int direction = 0; direction < BEAMFORMER_DIRECTIONS; direction++)
+    {
+        float angle = 2*pi * direction / BEAMFORMER_DIRECTIONS;
+        if (angle > pi)
+            angle -= 2*pi;
+        Steering trial;
+        steering(angle, trial);
+        int32_t out[MICROPHONE_SAMPLES_PER_FRAME];
+        sum(trial, out);
+
+        int64_t power = 0;
+        for (size_t idx = 0; idx < MICROPHONE_SAMPLES_PER_FRAME; idx++)
+        {
+            int64_t value = out[idx] >> TAP_SHIFT;
+            power += value * value;
+        }
+        if (power > bestPower)
+        {
+            bestPower = power;
+            best = angle;
+        }
+    }
+    return best;
+}
+
+
+/** Combine the microphones of a frame into one channel
+    @param frame the data frame from the body board
+    @param out the samples of the channel (MICROPHONE_SAMPLES_PER_FRAME)
+*/
+void Beamformer::process(const B2HDataFrame& frame, int16_t* out)
+{
+    split(frame);
+    int32_t total[MICROPHONE_SAMPLES_PER_FRAME];
+    sum(current, total);
+    for (size_t idx = 0; idx < MICROPHONE_SAMPLES_PER_FRAME; idx++)
+    {
+        int32_t value = (total[idx] + TAP_SCALE/2) >> TAP_SHIFT;
+        out[idx] = (int16_t)(value > INT16_MAX ? INT16_MAX : value < INT16_MIN ? INT16_MIN : value);
+    }
+
+    // keep the end of the frame for the delays into the next
+    for (size_t mic = 0; mic < MICROPHONE_COUNT; mic++)
+        memmove(samples[mic], samples[mic] + MICROPHONE_SAMPLES_PER_FRAME, historySize*sizeof(samples[mic][0]));
+    numFrames++;
+}
+
+}
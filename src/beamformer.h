@@ -0,0 +1,135 @@
+/* Delay and sum beamformer for the microphones
+   Copyright 2024 Randall Maas
+*//**@file
+    @brief Delay and sum beamformer for the microphones.
+
+    The beamformer combines the 4 microphones into one channel that favours
+    the sound from one direction.  The sound from that direction reaches each
+    microphone at a slightly different time; the beamformer delays each
+    microphone so the sound lines up, and adds them.  The sound from that
+    direction adds up, while the noise and the sound from other directions
+    partly cancel.
+
+    The delays are a fraction of a sample (the microphones are a few
+    centimetres apart, and a sample is 64us, about 2cm of travel), so each
+    microphone is delayed with a 4 tap Lagrange fractional delay filter.  The
+    filter taps are in fixed point, and the filtering is done a microphone
+    and tap at a time over the whole frame, so that it is a run of
+    multiply-adds over contiguous samples that the compiler can vectorize.
+
+    The direction is given by the caller (e.g. toward the face the head is
+    tracking), or estimated from a frame as the direction with the most power
+    out of the beamformer.
+
+    The output is one channel of 80 samples at 15625 Hz per data frame,
+    delayed by 1 sample plus the largest of the steering delays.
+
+    The samples are taken to be interleaved in the frame
+    (mic_samples[sample*MICROPHONE_COUNT + microphone]).
+*/
+#pragma once
+#include <inttypes.h>
+#include "spine.h"
+
+namespace Spine {
+
+/// The geometry of the microphones
+struct BeamformerConfig
+{
+    /// The position of each microphone (in meters): x forward, y to the left
+    float micX[MICROPHONE_COUNT], micY[MICROPHONE_COUNT];
+
+    /// The speed of sound (in meters/second)
+    float speedOfSound;
+};
+
+/// The default geometry of the microphones.  It assumes a 3cm square; if the
+/// microphones are laid out otherwise, the beam points away from the
+/// direction it is steered to.
+extern const BeamformerConfig defaultBeamformerConfig;
+
+
+/** Combine the microphones into one channel, steered toward a direction
+*/
+class Beamformer
+{
+public:
+    /// The number of taps of the fractional delay filters
+    static constexpr size_t numTaps = 4;
+
+    /// The number of past samples kept of each microphone; this limits the
+    /// delay to historySize-numTaps samples
+    static constexpr size_t historySize = 16;
+
+    /** Create the beamformer, steered straight ahead
+        @param config the geometry of the microphones
+    */
+    Beamformer(const BeamformerConfig& config = defaultBeamformerConfig);
+
+    /** Steer the beamformer
+        @param azimuth the direction of the sound (in radians), 0 ahead, and
+               positive to the left
+    */
+    void steer(float azimuth);
+
+    /** Estimate the direction of the sound in a frame
+        @param frame the data frame from the body board
+        @return the direction (in radians) with the most power, of
+                BEAMFORMER_DIRECTIONS directions around the robot
+
+        This doesn't steer the beamformer, or consume the frame.
+    */
+    float estimate(const B2HDataFrame& frame);
+
+    /** Combine the microphones of a frame into one channel
+        @param frame the data frame from the body board
+        @param out the samples of the channel (MICROPHONE_SAMPLES_PER_FRAME)
+    */
+    void process(const B2HDataFrame& frame, int16_t* out);
+
+    /// The direction the beamformer is steered toward (in radians)
+    float azimuth;
+
+    /// The number of frames processed
+    uint32_t numFrames;
+
+private:
+    /// The delay of each microphone, as a whole number of samples and the
+    /// taps of the fractional delay filter
+    struct Steering
+    {
+        /// The whole samples of delay of each microphone (before the taps)
+        uint8_t delay[MICROPHONE_COUNT];
+
+        /// The taps of each microphone (Q14, including the 1/MICROPHONE_COUNT)
+        int16_t taps[MICROPHONE_COUNT][numTaps];
+    };
+
+    /** Compute the delays for a direction
+        @param azimuth the direction (in radians)
+        @param steering the delays
+    */
+    void steering(float azimuth, Steering& steering) const;
+
+    /** Split the microphones of a frame, after their past samples
+        @param frame the data frame
+    */
+    void split(const B2HDataFrame& frame);
+
+    /** Delay and add the microphones
+        @param steering the delays
+        @param out the sum
+    */
+    void sum(const Steering& steering, int32_t* out) const;
+
+    /// The geometry of the microphones
+    BeamformerConfig config;
+
+    /// The current steering
+    Steering current;
+
+    /// The past samples of each microphone, then the samples of the frame
+    int16_t samples[MICROPHONE_COUNT][historySize + MICROPHONE_SAMPLES_PER_FRAME];
+};
+
+}
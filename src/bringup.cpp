@@ -0,0 +1,163 @@
+/* Fast link bring-up with the body board
+   Copyright 2024 Randall Maas
+*//**@file
+    @brief Fast link bring-up with the body board.
+
+    This file contains the implementation of the link bring-up: the rolling
+    sync match, the banner match, and the body board state.
+*/
+#include <Arduino.h>
+#include "bringup.h"
+
+namespace Spine {
+
+/// The sync bytes, 0xAA 'B' '2' 'H', as they appear in the window
+#define B2H_SYNC_WINDOW   (0xAA423248UL)
+
+/// The start of the reset preamble, 0xFF 0x16 0x92 0x16, as it appears in a window
+#define PREAMBLE_WINDOW   (0xFF169216UL)
+
+/// The banner that follows the preamble
+static const char banner[] = "\nbooted\n";
+
+
+LinkBringup::LinkBringup()
+    : state(LinkState::unknown), numResets(0), timeToFirstFrame_us(0), numSkipped(0),
+      window(0), preamble(0), bannerMatched(0), waitingForFrame(false), reset_us(0)
+{
+}
+
+
+/** Mark the start of a bring up
+    @param now_us the time (in microseconds)
+*/
+void LinkBringup::reset(uint32_t now_us)
+{
+    state = LinkState::booting;
+    waitingForFrame = true;
+    reset_us = now_us;
+}
+
+
+/** Check a byte that isn't part of a frame for the reset preamble and banner
+    @param byte the byte
+    @param now_us the time (in microseconds) that the byte arrived
+    @return true if the byte completed the preamble or the banner
+*/
+bool LinkBringup::observe(uint8_t byte, uint32_t now_us)
+{
+    // The first thing heard starts the clock, in case the reset was missed
+    if (state == LinkState::unknown && !waitingForFrame)
+    {
+        waitingForFrame = true;
+        reset_us = now_us;
+    }
+
+    // The preamble is the earliest sign of a reset
+    preamble = (preamble << 8) | byte;
+    if (preamble == PREAMBLE_WINDOW)
+    {
+        numResets++;
+        reset(now_us);
+        return true;
+    }
+
+    // Match the banner.  The 'o' repeats, but a restart must begin with the
+    // newline, and the only newline in a partial match is its first
+    // character; so a mismatch can only restart the match on a newline.
+    if (byte == (uint8_t) banner[bannerMatched])
+        bannerMatched++;
+    else
+        bannerMatched = byte == (uint8_t) banner[0] ? 1 : 0;
+    if (bannerMatched < sizeof(banner)-1)
+        return false;
+
+    // The banner without the preamble (the preamble was garbled) is a reset too
+    bannerMatched = 0;
+    if (state != LinkState::booting)
+    {
+        numResets++;
+        reset(now_us);
+    }
+    return true;
+}
+
+
+/** Update the state with a good frame from the body board
+    @param message_type the type of the message
+    @param payload the payload of the message
+    @param now_us the time (in microseconds) that the frame arrived
+*/
+void LinkBringup::observe(MessageType message_type, const uint8_t* payload, uint32_t now_us)
+{
+    switch (message_type)
+    {
+        default:
+            break;
+
+        case MessageType::bootFrame:
+            state = LinkState::bootloader;
+            break;
+
+        case MessageType::ack:
+            // The boot-loader NAKs the version request
+            if (((const Ack*) payload)->value <= 0 && state != LinkState::application)
+                state = LinkState::bootloader;
+            break;
+
+        case MessageType::dataFrame:
+        case MessageType::version:
+            state = LinkState::application;
+            break;
+    }
+
+    // Report the time to the first frame
+    if (waitingForFrame)
+    {
+        waitingForFrame = false;
+        timeToFirstFrame_us = now_us - reset_us;
+    }
+}
+
+
+/** Receive a message frame from the body board
+    @param in the stream to receive the message from
+    @param payload_size the size of the payload
+    @return the message type, -1 if there is no good frame (yet)
+
+    The frame is received into B2H::recv_buffer.
+*/
+MessageType LinkBringup::receive(Stream& in, size_t& payload_size)
+{
+    payload_size = 0;
+    for (;;)
+    {
+        // Take the next byte, if there is one
+        auto byte = in.read();
+        if (byte < 0)
+            return (MessageType)-1;
+        window = (window << 8) | (uint8_t) byte;
+        if (window == B2H_SYNC_WINDOW)
+            break;
+
+        // Not (yet) a frame; check for the reset
+        observe((uint8_t) byte, micros());
+        numSkipped++;
+    }
+
+    // The first three sync bytes were counted as skipped
+    numSkipped = numSkipped > 3 ? numSkipped - 3 : 0;
+
+    // Put the sync in place, and receive the rest of the frame
+    window = 0;
+    B2H::recv_buffer[0] = 0xAA;
+    B2H::recv_buffer[1] = 'B';
+    B2H::recv_buffer[2] = '2';
+    B2H::recv_buffer[3] = 'H';
+    auto message_type = B2H::ReceiveFrame(in, payload_size);
+    if ((int) message_type != -1)
+        observe(message_type, B2H::recv_buffer+payload_ofs, micros());
+    return message_type;
+}
+
+}
@@ -0,0 +1,117 @@
+/* Fast link bring-up with the body board
+   Copyright 2024 Randall Maas
+*//**@file
+    @brief Fast link bring-up with the body board.
+
+    When the body board resets, it sends a power on preamble and a banner
+    (see DataCharacter):
+
+    @code
+    0xFF 0x16 0x92 0x16 0x1F 0x16 0xCF 0x16 0xFF 0x16 0xFF 0x16 0xFF 0x16 0xFF 0x16 “\nbooted\n”
+    @endcode
+
+    Then it runs either the boot-loader, which sends boot-loader frames (and
+    NAKs the version request), or the application, which streams data frames.
+
+    The link bring-up receives the frames from the body board the same way as
+    B2H::ReceiveMessage, with two differences that get the link going sooner:
+
+    - The sync bytes are matched with a rolling window that is kept between
+      calls.  A sync sequence split across two calls (because the rest of it
+      had not arrived yet), or one starting on the byte that broke a false
+      match, is not lost.
+    - The bytes that aren't part of a frame are checked for the preamble and
+      banner, to tell when the body board has reset.
+
+    It tracks the state of the body board, and reports the time from the
+    reset to the first good frame.
+*/
+#pragma once
+#include <inttypes.h>
+#include "spine.h"
+
+namespace Spine {
+
+/// The state of the body board, as seen from the link
+enum class LinkState
+{
+    /// Nothing has been heard yet
+    unknown = 0,
+
+    /// The reset preamble or banner was seen; waiting for the first frame
+    booting,
+
+    /// The boot-loader is running: it sent boot-loader frames, or NAK'd the
+    /// version request
+    bootloader,
+
+    /// The application is running: it is sending data frames, or answered
+    /// the version request
+    application
+};
+
+
+/** Bring up the link with the body board.
+*/
+class LinkBringup
+{
+public:
+    LinkBringup();
+
+    /** Receive a message frame from the body board
+        @param in the stream to receive the message from
+        @param payload_size the size of the payload
+        @return the message type, -1 if there is no good frame (yet)
+
+        The frame is received into B2H::recv_buffer.
+    */
+    MessageType receive(Stream& in, size_t& payload_size);
+
+    /** Check a byte that isn't part of a frame for the reset preamble and banner
+        @param byte the byte
+        @param now_us the time (in microseconds) that the byte arrived
+        @return true if the byte completed the preamble or the banner
+    */
+    bool observe(uint8_t byte, uint32_t now_us);
+
+    /** Update the state with a good frame from the body board
+        @param message_type the type of the message
+        @param payload the payload of the message
+        @param now_us the time (in microseconds) that the frame arrived
+    */
+    void observe(MessageType message_type, const uint8_t* payload, uint32_t now_us);
+
+    /// The state of the body board
+    LinkState state;
+
+    /// The number of times the body board was seen to reset
+    uint32_t numResets;
+
+    /// The time from the last reset (or the first byte heard) to the first
+    /// good frame (in microseconds)
+    uint32_t timeToFirstFrame_us;
+
+    /// The number of bytes skipped looking for the sync
+    uint32_t numSkipped;
+
+private:
+    /// Mark the start of a bring up
+    void reset(uint32_t now_us);
+
+    /// The last four bytes received, for matching the sync
+    uint32_t window;
+
+    /// The last four bytes outside of a frame, for matching the preamble
+    uint32_t preamble;
+
+    /// The number of characters of the banner matched so far
+    uint8_t bannerMatched;
+
+    /// Waiting for the first frame since the reset
+    bool waitingForFrame;
+
+    /// The time of the reset
+    uint32_t reset_us;
+};
+
+}
@@ -0,0 +1,365 @@
+/* C interface to the spine framing, for host tools
+   Copyright 2024 Randall Maas
+*//**@file
+    @brief C interface to the spine framing, for host tools.
+
+    This file contains the implementation of the links: the buffer, reading
+    from the file descriptor, and finding the frames in place.
+*/
+#include <Arduino.h>
+#include <esp32/rom/crc.h>
+#include "capi.h"
+#if !defined(ARDUINO)
+#include <stdlib.h>
+#include <string.h>
+#if defined(__linux__)
+#include <errno.h>
+#include <poll.h>
+#include <time.h>
+#include <unistd.h>
+#endif
+#include "spine.h"
+#include "filter.h"
+#include "crc.h"
+#define crc32 crc32_le
+
+using namespace Spine;
+
+/// A compiled filter expression
+struct spine_filter
+{
+    Filter filter;
+};
+
+/// A link to one board
+struct spine_link
+{
+    /// The file descriptor to read from, -1 if the bytes are fed in
+    int fd;
+
+    /// The direction of the frames on the link
+    int direction;
+
+    /// The bytes received
+    uint8_t* buffer;
+
+    /// Where to resume looking for a frame
+    size_t scan;
+
+    /// The end of the bytes received
+    size_t tail;
+
+    /// The number of frames borrowed and not yet released
+    uint32_t numBorrowed;
+
+    /// The end of the file has been reached
+    bool eof;
+
+    /// The time of the last bytes received
+    uint64_t last_ns;
+
+    /// The function to call from spine_dispatch()
+    spine_callback callback;
+
+    /// Passed to the callback
+    void* context;
+
+    /// The counters
+    spine_stats stats;
+};
+
+
+/** Open a link
+    @param fd the file descriptor, -1 if the bytes are fed in
+    @param direction the direction of the frames on the link
+    @return the link, or null on error
+*/
+static spine_link* openLink(int fd, int direction)
+{
+    if (direction != SPINE_B2H && direction != SPINE_H2B)
+        return nullptr;
+    auto link = (spine_link*) calloc(1, sizeof(spine_link));
+    if (!link)
+        return nullptr;
+    link->buffer = (uint8_t*) malloc(SPINE_LINK_BUFFER_SIZE);
+    if (!link->buffer)
+    {
+        free(link);
+        return nullptr;
+    }
+    link->fd = fd;
+    link->direction = direction;
+    return link;
+}
+
+
+/** Make room at the end of the buffer
+    @param link the link
+    @return the number of bytes free at the end of the buffer
+
+    The bytes before the scan are done with.  They can be moved out of the way
+    only if no frames are borrowed, as that would move the payloads.
+*/
+static size_t room(spine_link* link)
+{
+    if (!link->numBorrowed && link->scan)
+    {
+        memmove(link->buffer, link->buffer+link->scan, link->tail-link->scan);
+        link->tail -= link->scan;
+        link->scan = 0;
+    }
+    return SPINE_LINK_BUFFER_SIZE - link->tail;
+}
+
+
+/** Read the bytes that are ready from the file descriptor
+    @param link the link
+    @return the number of bytes read, or -1 on error
+*/
+static long fill(spine_link* link)
+{
+#if defined(__linux__)
+    auto space = room(link);
+    if (!space || link->eof)
+        return 0;
+
+    // don't wait for bytes
+    struct pollfd pfd = {link->fd, POLLIN, 0};
+    if (::poll(&pfd, 1, 0) <= 0)
+        return 0;
+    auto num = read(link->fd, link->buffer+link->tail, space);
+    if (num < 0)
+        return errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR ? 0 : -1;
+    if (!num)
+    {
+        link->eof = true;
+        return 0;
+    }
+
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    link->last_ns = (uint64_t) ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+    link->tail += num;
+    link->stats.numBytes += num;
+    return num;
+#else
+    return -1;
+#endif
+}
+
+
+/** Find the next frame in the buffer
+    @param link the link
+    @param frame the frame found
+    @return 1 if there is a frame, 0 if there isn't one yet, -1 on error or
+            the end of the file
+*/
+static int next(spine_link* link, spine_frame* frame)
+{
+    if (link->fd >= 0 && fill(link) < 0)
+        return -1;
+
+    // find the frame in place
+    MessageType message_type;
+    size_t payload_size;
+    auto start = link->buffer + link->scan;
+    auto size  = link->tail - link->scan;
+    auto found = link->direction == SPINE_B2H
+               ? B2H::FindMessage(start, size, message_type, payload_size)
+               : H2B::FindMessage(start, size, message_type, payload_size);
+    link->stats.numSkipped += found - start;
+    link->scan = found - link->buffer;
+    if ((int) message_type == -1)
+        return link->eof ? -1 : 0;
+
+    frame->type = (uint16_t) message_type;
+    frame->size = (uint16_t) payload_size;
+    frame->payload = found + payload_ofs;
+    frame->timestamp_ns = link->last_ns;
+    // both directions' data frames start with the sequence number; the
+    // payload can be anywhere in the buffer, so it is copied out (assumes a
+    // little endian host)
+    frame->sequenceNumber = 0;
+    if (message_type == MessageType::dataFrame)
+        memcpy(&frame->sequenceNumber, frame->payload, sizeof(frame->sequenceNumber));
+
+    link->scan += payload_ofs + payload_size + 4;
+    link->stats.numFrames++;
+    return 1;
+}
+
+
+extern "C" {
+
+uint32_t spine_abi_version(void)
+{
+    return SPINE_ABI_VERSION;
+}
+
+
+spine_link* spine_open_fd(int fd, int direction)
+{
+    if (fd < 0)
+        return nullptr;
+    return openLink(fd, direction);
+}
+
+
+spine_link* spine_open_buffer(int direction)
+{
+    return openLink(-1, direction);
+}
+
+
+void spine_close(spine_link* link)
+{
+    if (!link)
+        return;
+    free(link->buffer);
+    free(link);
+}
+
+
+long spine_feed(spine_link* link, const uint8_t* bytes, size_t size, uint64_t timestamp_ns)
+{
+    if (!link || link->fd >= 0 || (!bytes && size))
+        return -1;
+
+    // take what fits
+    auto num = room(link);
+    if (num > size)
+        num = size;
+    memcpy(link->buffer+link->tail, bytes, num);
+    link->tail += num;
+    link->last_ns = timestamp_ns;
+    link->stats.numBytes += num;
+    return (long) num;
+}
+
+
+int spine_poll(spine_link* link, spine_frame* frame)
+{
+    if (!link || !frame)
+        return -1;
+    auto ret = next(link, frame);
+    if (ret > 0)
+        link->numBorrowed++;
+    return ret;
+}
+
+
+void spine_release(spine_link* link, const spine_frame* frame)
+{
+    (void) frame;
+    if (link && link->numBorrowed)
+        link->numBorrowed--;
+}
+
+
+void spine_set_callback(spine_link* link, spine_callback callback, void* context)
+{
+    if (!link)
+        return;
+    link->callback = callback;
+    link->context = context;
+}
+
+
+int spine_dispatch(spine_link* link)
+{
+    if (!link)
+        return -1;
+
+    int count = 0;
+    spine_frame frame;
+    for (;;)
+    {
+        auto ret = next(link, &frame);
+        if (ret < 0)
+            return count ? count : -1;
+        if (!ret)
+            return count;
+        if (link->callback)
+            link->callback(&frame, link->context);
+        count++;
+    }
+}
+
+
+size_t spine_encode(int direction, uint16_t type, const void* payload, size_t size, uint8_t* out, size_t out_size)
+{
+    // check the type and size against each other
+    int expected_size;
+    const char* tag;
+    if (direction == SPINE_B2H)
+    {
+        expected_size = B2H::size((MessageType) type);
+        tag = "B2H";
+    }
+    else if (direction == SPINE_H2B)
+    {
+        expected_size = H2B::size((MessageType) type);
+        tag = "H2B";
+    }
+    else
+        return 0;
+    if (expected_size < 0 || (size_t) expected_size != size || (size && !payload))
+        return 0;
+    if (!out || out_size < payload_ofs + size + 4)
+        return 0;
+
+    out[0] = 0xAA;
+    out[1] = tag[0];
+    out[2] = tag[1];
+    out[3] = tag[2];
+    // the caller's buffer needn't be aligned, so the fields are copied in
+    // (assumes a little endian host)
+    uint16_t size16 = (uint16_t) size;
+    memcpy(out+4, &type, 2);
+    memcpy(out+payload_size_ofs, &size16, 2);
+    if (size)
+        memcpy(out+payload_ofs, payload, size);
+    uint32_t crc = crc32(CRC32_INITIAL, out+payload_ofs, size);
+    memcpy(out+payload_ofs+size, &crc, 4);
+    return payload_ofs + size + 4;
+}
+
+
+void spine_get_stats(const spine_link* link, spine_stats* stats)
+{
+    if (link && stats)
+        *stats = link->stats;
+}
+
+
+spine_filter* spine_filter_compile(const char* expression, int direction, size_t* error_pos)
+{
+    if (!expression || (direction != SPINE_B2H && direction != SPINE_H2B))
+        return nullptr;
+    auto filter = new spine_filter();
+    if (!filter->filter.compile(expression, direction == SPINE_B2H))
+    {
+        if (error_pos)
+            *error_pos = filter->filter.errorPos;
+        delete filter;
+        return nullptr;
+    }
+    return filter;
+}
+
+
+int spine_filter_match(const spine_filter* filter, const spine_frame* frame)
+{
+    if (!filter || !frame)
+        return -1;
+    return filter->filter.match((MessageType) frame->type, frame->payload, frame->size);
+}
+
+
+void spine_filter_free(spine_filter* filter)
+{
+    delete filter;
+}
+
+}
+#endif
@@ -0,0 +1,221 @@
+/* C interface to the spine framing, for host tools
+   Copyright 2024 Randall Maas
+*//**@file
+    @brief C interface to the spine framing, for host tools.
+
+    Tools that are not written in C++ (or not built with the Arduino
+    tool-chain) can use the spine framing through this C interface, built as
+    a shared library on Linux:
+
+    @code
+    g++ -std=c++17 -O2 -shared -fPIC -Ihost -Isrc src/spine.cpp src/schema.cpp src/filter.cpp src/capi.cpp -o libspine.so
+    @endcode
+
+    The host directory has the little of the Arduino and ESP32 headers that
+    the framing needs.
+
+    A link receives the bytes from one board, either read from a file
+    descriptor (a serial port, a pipe, or a capture file) or fed in by the
+    caller.  The bytes are kept in the link's buffer, and the frames are found
+    in place: the payload of a frame is a pointer into that buffer, borrowed
+    until the frame is released.  No frame is copied.
+
+    @code
+    spine_link* link = spine_open_fd(fd, SPINE_B2H);
+    spine_frame frame;
+    while (spine_poll(link, &frame) >= 0)
+    {
+        ... use frame.payload ...
+        spine_release(link, &frame);
+    }
+    spine_close(link);
+    @endcode
+
+    The buffer space of the frames is reclaimed once all of the borrowed
+    frames are released.  While frames are held, the buffer can fill; then no
+    more bytes are taken in until they are released.
+
+    The frames are checked the same way as FindMessage(): the sync bytes, the
+    message type against the payload size, and the CRC following the payload.
+
+    @note this is not built for the Arduino; it is for the host
+*/
+#pragma once
+#include <inttypes.h>
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/// The version of the interface; a change in the major version (the upper
+/// 16 bits) is not compatible with the previous version.
+#define SPINE_ABI_VERSION (0x00010000UL)
+
+/// The direction of the frames on a link
+enum spine_direction
+{
+    /// From the body board to the head board
+    SPINE_B2H = 0,
+
+    /// From the head board to the body board
+    SPINE_H2B = 1
+};
+
+/// A link to one board
+typedef struct spine_link spine_link;
+
+/// A frame received on a link
+typedef struct spine_frame
+{
+    /// The message type (see Spine::MessageType)
+    uint16_t type;
+
+    /// The size of the payload (in bytes)
+    uint16_t size;
+
+    /// The sequence number, for data frames; otherwise 0
+    uint32_t sequenceNumber;
+
+    /// The time that the bytes completing the frame were received (in
+    /// nanoseconds, the monotonic clock for a file descriptor, otherwise the
+    /// time passed to spine_feed())
+    uint64_t timestamp_ns;
+
+    /// The payload, borrowed from the link's buffer until released
+    const uint8_t* payload;
+} spine_frame;
+
+/** Called with each frame by spine_dispatch()
+    @param frame the frame; the payload is only valid during the call
+    @param context the context passed to spine_set_callback()
+*/
+typedef void (*spine_callback)(const spine_frame* frame, void* context);
+
+
+/** The version of the interface in the library
+    @return SPINE_ABI_VERSION as the library was built
+*/
+uint32_t spine_abi_version(void);
+
+/** Open a link that reads from a file descriptor
+    @param fd the file descriptor (it is not closed by the link)
+    @param direction the direction of the frames on the link
+    @return the link, or null on error
+*/
+spine_link* spine_open_fd(int fd, int direction);
+
+/** Open a link that the caller feeds bytes into
+    @param direction the direction of the frames on the link
+    @return the link, or null on error
+*/
+spine_link* spine_open_buffer(int direction);
+
+/** Close a link and free its buffer
+    @param link the link
+
+    Any borrowed payloads are no longer valid.
+*/
+void spine_close(spine_link* link);
+
+/** Feed bytes into a link
+    @param link the link
+    @param bytes the bytes received
+    @param size the number of bytes
+    @param timestamp_ns the time the bytes were received (in nanoseconds)
+    @return the number of bytes taken; fewer than size if the buffer is full
+            of frames that have not been released.  -1 on error
+*/
+long spine_feed(spine_link* link, const uint8_t* bytes, size_t size, uint64_t timestamp_ns);
+
+/** Get the next frame from a link
+    @param link the link
+    @param frame the frame received
+    @return 1 if there is a frame, 0 if there isn't one yet, -1 on error or
+            the end of the file
+
+    A link to a file descriptor reads whatever bytes are ready, without
+    waiting.  The frame must be released with spine_release().
+*/
+int spine_poll(spine_link* link, spine_frame* frame);
+
+/** Release a frame, returning its space to the link
+    @param link the link
+    @param frame the frame from spine_poll()
+*/
+void spine_release(spine_link* link, const spine_frame* frame);
+
+/** Set the function to call with each frame from spine_dispatch()
+    @param link the link
+    @param callback the function to call, or null
+    @param context passed to the callback
+*/
+void spine_set_callback(spine_link* link, spine_callback callback, void* context);
+
+/** Get the frames that are ready, and pass each to the callback
+    @param link the link
+    @return the number of frames, or -1 on error or the end of the file
+
+    Each frame is released when the callback returns.
+*/
+int spine_dispatch(spine_link* link);
+
+/** Encode a frame
+    @param direction the direction of the frame
+    @param type the message type
+    @param payload the payload
+    @param size the size of the payload; this must be the size of the type
+    @param out where to put the frame
+    @param out_size the size of the out buffer
+    @return the size of the frame, or 0 if the type, size or buffer are wrong
+*/
+size_t spine_encode(int direction, uint16_t type, const void* payload, size_t size, uint8_t* out, size_t out_size);
+
+/** The counters of a link
+*/
+typedef struct spine_stats
+{
+    /// The number of bytes received
+    uint64_t numBytes;
+
+    /// The number of good frames
+    uint64_t numFrames;
+
+    /// The number of bytes skipped that weren't part of a good frame
+    uint64_t numSkipped;
+} spine_stats;
+
+/** Get the counters of a link
+    @param link the link
+    @param stats the counters
+*/
+void spine_get_stats(const spine_link* link, spine_stats* stats);
+
+
+/// A compiled filter expression
+typedef struct spine_filter spine_filter;
+
+/** Compile a filter expression, to select frames (see filter.h)
+    @param expression the expression, e.g. "cliffSense[2] < 200 && onCharger == 0"
+    @param direction the direction of the frames to filter (this picks the fields)
+    @param error_pos where the error is in the expression, if it can't be
+           compiled; may be null
+    @return the filter, or null if the expression has an error
+*/
+spine_filter* spine_filter_compile(const char* expression, int direction, size_t* error_pos);
+
+/** Check a frame against a filter
+    @param filter the filter
+    @param frame the frame
+    @return 1 if the frame matches, 0 if it doesn't, -1 on error
+*/
+int spine_filter_match(const spine_filter* filter, const spine_frame* frame);
+
+/** Free a filter
+    @param filter the filter
+*/
+void spine_filter_free(spine_filter* filter);
+
+#ifdef __cplusplus
+}
+#endif
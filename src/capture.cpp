@@ -0,0 +1,247 @@
+/* Capture files, with an index of each block to skip the blocks when searching
+   Copyright 2024 Randall Maas
+*//**@file
+    @brief Capture files, with an index of each block to skip the blocks when searching.
+
+    This file contains the summary of the blocks, the writer and the reader.
+*/
+#include <Arduino.h>
+#include <string.h>
+#include "capture.h"
+
+namespace Spine {
+
+/// The size of a frame in a block, with its header and padding
+#define RECORD_SIZE(payload_size) (sizeof(CaptureRecord) + (((payload_size) + 3) & ~(size_t) 3))
+
+
+/** Add a frame to the summary of a block
+    @param index the summary of the block
+    @param b2h true for a frame from the body board, false from the head board
+    @param message_type the type of the message
+    @param payload the payload
+    @param payload_size the size of the payload
+*/
+void AddToIndex(CaptureIndex& index, bool b2h, MessageType message_type, const uint8_t* payload, size_t payload_size)
+{
+    index.numFrames++;
+    bool first = b2h && !(index.types[0] & TypeBit(MessageType::dataFrame));
+    index.types[b2h ? 0 : 1] |= TypeBit(message_type);
+
+    // only the data frames from the body board are summarized
+    if (!b2h || message_type != MessageType::dataFrame || payload_size < sizeof(B2HDataFrame))
+        return;
+    for (size_t idx = 0; idx < numB2HDataFrameFields; idx++)
+    {
+        auto& field = b2hDataFrameFields[idx];
+        if (field.count != 1)
+            continue;
+        int64_t value = ReadField(field, payload);
+        if (field.type == FieldType::u32)
+            value = (uint32_t) value;
+
+        if (field.width)
+        {
+            if (value)
+                index.flagsSet   |= 1ULL << idx;
+            else
+                index.flagsClear |= 1ULL << idx;
+        }
+        else if (first)
+            index.min[idx] = index.max[idx] = value;
+        else if (value < index.min[idx])
+            index.min[idx] = value;
+        else if (value > index.max[idx])
+            index.max[idx] = value;
+    }
+}
+
+
+CaptureWriter::CaptureWriter()
+: file(nullptr)
+{
+    memset(&header, 0, sizeof(header));
+}
+
+
+CaptureWriter::~CaptureWriter()
+{
+    close();
+}
+
+
+/** Create a capture file
+    @param path the path of the file
+    @return true on success, false on error
+*/
+bool CaptureWriter::open(const char* path)
+{
+    close();
+    memset(&header, 0, sizeof(header));
+    file = fopen(path, "wb");
+    return file != nullptr;
+}
+
+
+/** Write a frame
+    @param b2h true for a frame from the body board, false from the head board
+    @param message_type the type of the message
+    @param payload the payload
+    @param payload_size the size of the payload
+    @param timestamp_ns the time the frame was received (in nanoseconds)
+    @return true on success, false on error
+*/
+bool CaptureWriter::write(bool b2h, MessageType message_type, const uint8_t* payload, size_t payload_size, uint64_t timestamp_ns)
+{
+    auto size = RECORD_SIZE(payload_size);
+    if (!file || size > sizeof(block))
+        return false;
+
+    // start a new block if the frame doesn't fit
+    if (header.size + size > sizeof(block) && !flush())
+        return false;
+
+    CaptureRecord record = {timestamp_ns, (uint16_t) message_type, (uint16_t) payload_size, (uint8_t) b2h, {0, 0, 0}};
+    memcpy(block + header.size, &record, sizeof(record));
+    memcpy(block + header.size + sizeof(record), payload, payload_size);
+    memset(block + header.size + sizeof(record) + payload_size, 0, size - sizeof(record) - payload_size);
+    header.size += (uint32_t) size;
+
+    if (!header.index.numFrames)
+        header.firstTime_ns = timestamp_ns;
+    header.lastTime_ns = timestamp_ns;
+    AddToIndex(header.index, b2h, message_type, payload, payload_size);
+    return true;
+}
+
+
+/** Write the block
+    @return true on success, false on error
+*/
+bool CaptureWriter::flush()
+{
+    if (!header.size)
+        return true;
+    header.magic = captureBlockMagic;
+    bool ok = fwrite(&header, sizeof(header), 1, file) == 1
+           && fwrite(block, header.size, 1, file) == 1;
+    memset(&header, 0, sizeof(header));
+    return ok;
+}
+
+
+/** Write the last block and close the file
+    @return true on success, false on error
+*/
+bool CaptureWriter::close()
+{
+    if (!file)
+        return true;
+    bool ok = flush();
+    ok = !fclose(file) && ok;
+    file = nullptr;
+    return ok;
+}
+
+
+CaptureReader::CaptureReader()
+: numBlocks(0)
+, numSkipped(0)
+, file(nullptr)
+, offset(0)
+{
+    memset(&header, 0, sizeof(header));
+}
+
+
+CaptureReader::~CaptureReader()
+{
+    close();
+}
+
+
+/** Open a capture file
+    @param path the path of the file
+    @return true on success, false on error
+*/
+bool CaptureReader::open(const char* path)
+{
+    close();
+    file = fopen(path, "rb");
+    return file != nullptr;
+}
+
+
+/// Close the file
+void CaptureReader::close()
+{
+    if (file)
+        fclose(file);
+    file        = nullptr;
+    header.size = 0;
+    offset      = 0;
+    numBlocks   = 0;
+    numSkipped  = 0;
+}
+
+
+/** Get the next frame
+    @param frame the frame
+    @param filter selects the frames, or null for every frame
+    @return true if there is a frame, false at the end of the file or on
+            an error
+*/
+bool CaptureReader::next(CaptureFrame& frame, const Filter* filter)
+{
+    for (;;)
+    {
+        // the frames in this block
+        while (offset + sizeof(CaptureRecord) <= header.size)
+        {
+            CaptureRecord record;
+            memcpy(&record, block + offset, sizeof(record));
+            auto payload = block + offset + sizeof(record);
+            offset += RECORD_SIZE(record.size);
+            if (offset > header.size)
+                return false;
+            if (filter && filter->active()
+                && (record.b2h != filter->b2h() || !filter->match((MessageType) record.type, payload, record.size)))
+                continue;
+
+            frame.timestamp_ns = record.timestamp_ns;
+            frame.type         = (MessageType) record.type;
+            frame.b2h          = record.b2h != 0;
+            frame.size         = record.size;
+            frame.payload      = payload;
+            return true;
+        }
+
+        // the next block
+        offset = header.size = 0;
+        if (!file || fread(&header, sizeof(header), 1, file) != 1)
+            return false;
+        if (header.magic != captureBlockMagic || header.size > sizeof(block))
+        {
+            header.size = 0;
+            return false;
+        }
+        numBlocks++;
+
+        // skip the block if no frame in it can match
+        if (filter && !filter->mayMatch(header.index))
+        {
+            numSkipped++;
+            if (fseek(file, header.size, SEEK_CUR))
+                return false;
+            header.size = 0;
+            continue;
+        }
+        if (fread(block, header.size, 1, file) != 1)
+        {
+            header.size = 0;
+            return false;
+        }
+    }
+}
+
+}
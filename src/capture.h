@@ -0,0 +1,240 @@
+/* Capture files, with an index of each block to skip the blocks when searching
+   Copyright 2024 Randall Maas
+*//**@file
+    @brief Capture files, with an index of each block to skip the blocks when searching.
+
+    A capture file holds the frames received from both boards, in the order
+    received.  The frames are written in blocks of up to CAPTURE_BLOCK_SIZE
+    bytes.  Each block starts with a header that summarizes the frames in it:
+
+    - a bitmap of the message types, in each direction
+    - the lowest and highest value of each scalar field of the data frames
+      from the body board (e.g. i2cFault, battery_volt, sequenceNumber)
+    - a bitmap of the flags (the one bit fields, e.g. shutdown) that were set
+      in some data frame, and one of those that were clear in some frame
+
+    To find the frames matching a filter expression (see filter.h), the
+    reader checks the expression against each block's summary first, and
+    skips the blocks where no frame can match without reading them.  A
+    search for rare events, such as "i2cFault != 0" or "shutdown", reads only
+    the blocks holding them:
+
+    @code
+    CaptureReader reader;
+    Filter filter;
+    filter.compile("i2cFault != 0");
+    reader.open("day.cap");
+    CaptureFrame frame;
+    while (reader.next(frame, &filter))
+        ... use frame.payload ...
+    @endcode
+
+    The arrays (e.g. cliffSense[2]) are not summarized; an expression that
+    depends on them only skips blocks on its other terms.
+
+    The file is written in the host's byte order (little endian).
+*/
+#pragma once
+#include <inttypes.h>
+#include <stdio.h>
+#include "pack.h"
+#include "spine.h"
+#include "schema.h"
+#include "filter.h"
+
+namespace Spine {
+
+/// The number of fields of the body board's data frame
+constexpr size_t numB2HDataFrameFields = sizeof(b2hDataFrameFields)/sizeof(b2hDataFrameFields[0]);
+static_assert(numB2HDataFrameFields <= 64, "The flag bitmaps have a bit for each field");
+static_assert(sizeof(messageTypes)/sizeof(messageTypes[0]) <= 32, "The type bitmaps have a bit for each message type");
+
+/** The bit of a message type in the type bitmaps
+    @param message_type the type of the message
+    @return the bit, or 0 if the type isn't known
+*/
+constexpr uint32_t TypeBit(MessageType message_type)
+{
+    for (size_t idx = 0; idx < sizeof(messageTypes)/sizeof(messageTypes[0]); idx++)
+        if (messageTypes[idx] == message_type)
+            return 1UL << idx;
+    return 0;
+}
+
+/// The "SPCB" at the start of each block
+constexpr uint32_t captureBlockMagic = 0x42435053UL;
+
+/** The summary of the frames in a block of a capture.
+    The fields are indexed as in b2hDataFrameFields.
+*/
+PACK(struct CaptureIndex
+{
+    /// The number of frames in the block
+    uint32_t numFrames;
+
+    /// The message types in the block, a bit for each in messageTypes; the
+    /// frames from the body board, then the head board
+    uint32_t types[2];
+
+    /// The flags (one bit fields) of the data frames from the body board
+    /// that were set in some frame, and that were clear in some frame
+    uint64_t flagsSet, flagsClear;
+
+    /// The lowest and highest value of each scalar field, in the data frames
+    /// from the body board; only valid if the block has one
+    int64_t min[numB2HDataFrameFields], max[numB2HDataFrameFields];
+});
+
+/// The header of a block of a capture
+PACK(struct CaptureBlockHeader
+{
+    /// captureBlockMagic
+    uint32_t magic;
+
+    /// The number of bytes of frames following the header
+    uint32_t size;
+
+    /// The time of the first and last frames (in nanoseconds)
+    uint64_t firstTime_ns, lastTime_ns;
+
+    /// The summary of the frames in the block
+    CaptureIndex index;
+});
+
+/// The header of a frame in a block; the payload follows, padded to a
+/// multiple of 4 bytes
+PACK(struct CaptureRecord
+{
+    /// The time the frame was received (in nanoseconds)
+    uint64_t timestamp_ns;
+
+    /// The message type
+    uint16_t type;
+
+    /// The size of the payload
+    uint16_t size;
+
+    /// 1 for a frame from the body board, 0 from the head board
+    uint8_t b2h;
+
+    uint8_t reserved[3];
+});
+
+/// A frame read from a capture
+struct CaptureFrame
+{
+    /// The time the frame was received (in nanoseconds)
+    uint64_t timestamp_ns;
+
+    /// The message type
+    MessageType type;
+
+    /// True for a frame from the body board, false from the head board
+    bool b2h;
+
+    /// The size of the payload
+    size_t size;
+
+    /// The payload, valid until the next frame is read
+    const uint8_t* payload;
+};
+
+
+/** Add a frame to the summary of a block
+    @param index the summary of the block
+    @param b2h true for a frame from the body board, false from the head board
+    @param message_type the type of the message
+    @param payload the payload
+    @param payload_size the size of the payload
+*/
+void AddToIndex(CaptureIndex& index, bool b2h, MessageType message_type, const uint8_t* payload, size_t payload_size);
+
+
+/** Writes the frames to a capture file
+*/
+class CaptureWriter
+{
+public:
+    CaptureWriter();
+    ~CaptureWriter();
+
+    /** Create a capture file
+        @param path the path of the file
+        @return true on success, false on error
+    */
+    bool open(const char* path);
+
+    /** Write a frame
+        @param b2h true for a frame from the body board, false from the head board
+        @param message_type the type of the message
+        @param payload the payload
+        @param payload_size the size of the payload
+        @param timestamp_ns the time the frame was received (in nanoseconds)
+        @return true on success, false on error
+    */
+    bool write(bool b2h, MessageType message_type, const uint8_t* payload, size_t payload_size, uint64_t timestamp_ns);
+
+    /** Write the last block and close the file
+        @return true on success, false on error
+    */
+    bool close();
+
+private:
+    /// Write the block
+    bool flush();
+
+    /// The file, null if it isn't open
+    FILE* file;
+
+    /// The header of the block
+    CaptureBlockHeader header;
+
+    /// The frames of the block
+    uint8_t block[CAPTURE_BLOCK_SIZE];
+};
+
+
+/** Reads the frames from a capture file, skipping the blocks that can't
+    match the filter
+*/
+class CaptureReader
+{
+public:
+    CaptureReader();
+    ~CaptureReader();
+
+    /** Open a capture file
+        @param path the path of the file
+        @return true on success, false on error
+    */
+    bool open(const char* path);
+
+    /// Close the file
+    void close();
+
+    /** Get the next frame
+        @param frame the frame
+        @param filter selects the frames, or null for every frame
+        @return true if there is a frame, false at the end of the file or on
+                an error
+    */
+    bool next(CaptureFrame& frame, const Filter* filter = nullptr);
+
+    /// The number of blocks read, and skipped
+    size_t numBlocks, numSkipped;
+
+private:
+    /// The file, null if it isn't open
+    FILE* file;
+
+    /// The header of the block
+    CaptureBlockHeader header;
+
+    /// Where the next frame is in the block
+    size_t offset;
+
+    /// The frames of the block
+    uint8_t block[CAPTURE_BLOCK_SIZE];
+};
+
+}
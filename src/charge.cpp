@@ -0,0 +1,193 @@
+/* Charging dock session analysis
+   Copyright 2024 Randall Maas
+*//**@file
+    @brief Charging dock session analysis.
+
+    This file contains the implementation of the session analyser: the
+    debouncing of the docked and charging edges, the per session statistics
+    and the constant memory charge curve.
+*/
+#include <string.h>
+#include <Arduino.h>
+#include "charge.h"
+
+namespace Spine {
+
+/// The default configuration
+const ChargeConfig defaultChargeConfig =
+{
+    // 4V / 0.00136719V
+    2926,
+    // debounce frames
+    8,
+    // 2 seconds of frames
+    2000000/B2H_FRAME_PERIOD_US
+};
+
+
+/** Create the session analyser
+    @param config the configuration
+    @param callback called with each completed session, or null
+    @param context passed to the callback
+*/
+ChargeAnalyser::ChargeAnalyser(const ChargeConfig& config, SessionCallback callback, void* context)
+    : config(config), callback(callback), context(context),
+      docked(false), charging(false), dockedCount(0), chargingCount(0)
+{
+    memset(&last, 0, sizeof(last));
+    memset(&stats, 0, sizeof(stats));
+    memset(&current, 0, sizeof(current));
+}
+
+
+/** Debounce an input
+    @param state the debounced state
+    @param count the number of frames the input has disagreed with the state
+    @param input the raw input
+    @param debounceFrames the number of frames the input must hold
+    @return true if the state changed
+*/
+static bool debounce(bool& state, uint8_t& count, bool input, uint8_t debounceFrames)
+{
+    if (input == state)
+    {
+        count = 0;
+        return false;
+    }
+    if (++count < debounceFrames)
+        return false;
+    count = 0;
+    state = input;
+    return true;
+}
+
+
+/** Update with a data frame
+    @param frame the data frame from the body board
+    @return true if a session was completed
+*/
+bool ChargeAnalyser::update(const B2HDataFrame& frame)
+{
+    // Look for the docking and undocking
+    bool onContacts = frame.onCharger || frame.charger_volt > config.dockedVolt;
+    if (debounce(docked, dockedCount, onContacts, config.debounceFrames))
+    {
+        if (!docked)
+        {
+            // undocked, the session is over
+            charging = false;
+            chargingCount = 0;
+            complete(false);
+            return true;
+        }
+
+        // docked, start a new session
+        memset(&current, 0, sizeof(current));
+        current.startSequence = frame.sequenceNumber;
+        current.startBattery_volt = frame.battery_volt;
+        current.maxCharger_volt = frame.charger_volt;
+        current.curveStride = 1;
+    }
+    if (!docked)
+        return false;
+
+    // Look for charging starting and stopping
+    if (debounce(charging, chargingCount, frame.charging, config.debounceFrames) && charging)
+    {
+        if (!current.numChargeStarts)
+        {
+            current.chargeDelayFrames = current.dockedFrames;
+            current.success = current.dockedFrames <= config.successFrames;
+        }
+        if (current.numChargeStarts < 255)
+            current.numChargeStarts++;
+    }
+
+    // Sample the charge curve.  When it is full, drop every other point and
+    // sample half as often.
+    if (current.dockedFrames % current.curveStride == 0)
+    {
+        if (current.numCurvePoints == CHARGE_CURVE_POINTS)
+        {
+            for (int idx = 0; idx < CHARGE_CURVE_POINTS/2; idx++)
+                current.curve[idx] = current.curve[2*idx];
+            current.numCurvePoints = CHARGE_CURVE_POINTS/2;
+            current.curveStride *= 2;
+        }
+        if (current.dockedFrames % current.curveStride == 0)
+            current.curve[current.numCurvePoints++] = frame.battery_volt;
+    }
+
+    // Accumulate the session
+    current.dockedFrames++;
+    if (charging)
+        current.chargingFrames++;
+    current.endBattery_volt = frame.battery_volt;
+    if (frame.charger_volt > current.maxCharger_volt)
+        current.maxCharger_volt = frame.charger_volt;
+    if (frame.overheated) current.overheated = 1;
+    if (frame.voltageLow) current.voltageLow = 1;
+    return false;
+}
+
+
+/** Complete the current session
+    @param truncated true if the session did not end with an undocking
+*/
+void ChargeAnalyser::complete(bool truncated)
+{
+    current.truncated = truncated;
+    last = current;
+
+    // Accumulate the statistics
+    stats.numSessions++;
+    if (current.success)
+        stats.numSuccessful++;
+    stats.dockedFrames += current.dockedFrames;
+    stats.chargingFrames += current.chargingFrames;
+
+    if (callback)
+        callback(last, context);
+}
+
+
+/** Close out the session in progress, if any, at the end of a capture
+    @return true if a session was completed
+*/
+bool ChargeAnalyser::finish()
+{
+    if (!docked)
+        return false;
+    docked = charging = false;
+    dockedCount = chargingCount = 0;
+    complete(true);
+    return true;
+}
+
+
+/** Analyse the raw bytes from the body board
+    @param buffer the bytes, for instance, from a capture
+    @param size the number of bytes in the buffer
+    @return the number of bytes examined; the remainder is the start of
+            a frame that is not complete
+*/
+size_t ChargeAnalyser::scan(const uint8_t* buffer, size_t size)
+{
+    auto ptr = buffer;
+    auto end = buffer + size;
+    for (;;)
+    {
+        MessageType message_type;
+        size_t payload_size;
+        ptr = B2H::FindMessage(ptr, end - ptr, message_type, payload_size);
+        if ((int) message_type == -1)
+            return ptr - buffer;
+
+        // only the data frames have the battery state
+        if (message_type == MessageType::dataFrame)
+            update(*(const B2HDataFrame*)(ptr + payload_ofs));
+        ptr += payload_ofs + payload_size + 4;
+    }
+}
+
+}
@@ -0,0 +1,193 @@
+/* Charging dock session analysis
+   Copyright 2024 Randall Maas
+*//**@file
+    @brief Charging dock session analysis.
+
+    The body board reports whether the robot is on the charger, whether the
+    battery is charging, and the voltage on the charging contacts in every
+    data frame.  The session analyser watches these for the edges:
+
+    - Docking: the robot is on the charger, or the contacts have a voltage
+    - Undocking: neither
+    - Charging starting and stopping
+
+    The bits can bounce as the contacts settle, so an edge is only taken
+    after it has held for a few frames.
+
+    Each dock-to-undock session is summarized in a compact, fixed size record:
+    how long the robot was docked, how long it charged, the battery voltage at
+    the start and the end, and a coarse charge curve.  The curve is kept in
+    constant memory by halving its resolution whenever it fills.  Time is
+    measured in data frames (B2H_FRAME_PERIOD_US each), so the records can
+    be made from captures that have no timestamps.
+
+    The analyser can run in the bridge, frame by frame, or over the raw body
+    board bytes of a capture.  It has no shared state, so separate captures
+    can be analysed in parallel, one analyser each.
+*/
+#pragma once
+#include <inttypes.h>
+#include "spine.h"
+#include "pack.h"
+
+namespace Spine {
+
+/// The configuration of the session analyser
+struct ChargeConfig
+{
+    /// The charger voltage (in raw units of 0.00136719V) above which the
+    /// robot is considered to be on the contacts
+    int16_t dockedVolt;
+
+    /// The number of frames an edge must hold before it is taken
+    uint8_t debounceFrames;
+
+    /// The number of frames, after docking, within which charging must start
+    /// for the docking to count as a success
+    uint16_t successFrames;
+};
+
+/// The default configuration: about 4V on the contacts, 8 frames of
+/// debounce, and charging within about 2 seconds.
+extern const ChargeConfig defaultChargeConfig;
+
+
+/// The summary of a charging dock session
+PACK(struct ChargeSession
+{
+    /// The sequence number of the frame the robot docked on
+    uint32_t startSequence;
+
+    /// The number of frames the robot was docked
+    uint32_t dockedFrames;
+
+    /// The number of frames the battery was charging
+    uint32_t chargingFrames;
+
+    /// The number of frames from docking until charging started
+    uint32_t chargeDelayFrames;
+
+    /// The battery voltage when docked (raw units of 0.00136719V)
+    int16_t startBattery_volt;
+
+    /// The battery voltage when undocked (raw units of 0.00136719V)
+    int16_t endBattery_volt;
+
+    /// The highest charger voltage seen (raw units of 0.00136719V)
+    int16_t maxCharger_volt;
+
+    /// The number of times charging started
+    uint8_t numChargeStarts;
+
+    /// Charging started within the success window
+    uint8_t success:1,
+
+    /// The battery was overheated during the session
+            overheated:1,
+
+    /// The battery voltage was low during the session
+            voltageLow:1,
+
+    /// The session was still in progress at the end of the capture
+            truncated:1;
+
+    /// The number of frames between the points of the charge curve
+    uint32_t curveStride;
+
+    /// The number of points in the charge curve
+    uint8_t numCurvePoints;
+
+    /// The battery voltage, every curveStride frames (raw units of 0.00136719V)
+    int16_t curve[CHARGE_CURVE_POINTS];
+});
+
+
+/// The statistics over all of the sessions
+struct ChargeStats
+{
+    /// The number of sessions
+    uint32_t numSessions;
+
+    /// The number of sessions where charging started within the success window
+    uint32_t numSuccessful;
+
+    /// The total frames docked
+    uint64_t dockedFrames;
+
+    /// The total frames charging
+    uint64_t chargingFrames;
+};
+
+
+/** Extract the charging dock sessions from the data frames.
+*/
+class ChargeAnalyser
+{
+public:
+    /// Called with each completed session
+    typedef void (*SessionCallback)(const ChargeSession& session, void* context);
+
+    /** Create the session analyser
+        @param config the configuration
+        @param callback called with each completed session, or null
+        @param context passed to the callback
+    */
+    ChargeAnalyser(const ChargeConfig& config = defaultChargeConfig, SessionCallback callback = nullptr, void* context = nullptr);
+
+    /** Update with a data frame
+        @param frame the data frame from the body board
+        @return true if a session was completed
+    */
+    bool update(const B2HDataFrame& frame);
+
+    /** Analyse the raw bytes from the body board
+        @param buffer the bytes, for instance, from a capture
+        @param size the number of bytes in the buffer
+        @return the number of bytes examined; the remainder is the start of
+                a frame that is not complete
+    */
+    size_t scan(const uint8_t* buffer, size_t size);
+
+    /** Close out the session in progress, if any, at the end of a capture
+        @return true if a session was completed
+    */
+    bool finish();
+
+    /// The most recently completed session
+    ChargeSession last;
+
+    /// The statistics over the completed sessions
+    ChargeStats stats;
+
+private:
+    /** Complete the current session
+        @param truncated true if the session did not end with an undocking
+    */
+    void complete(bool truncated);
+
+    /// The configuration
+    ChargeConfig config;
+
+    /// Called with each completed session
+    SessionCallback callback;
+
+    /// Passed to the callback
+    void* context;
+
+    /// The session in progress
+    ChargeSession current;
+
+    /// The debounced docked state
+    bool docked;
+
+    /// The debounced charging state
+    bool charging;
+
+    /// The number of frames the docked input has disagreed with the state
+    uint8_t dockedCount;
+
+    /// The number of frames the charging input has disagreed with the state
+    uint8_t chargingCount;
+};
+
+}
@@ -0,0 +1,233 @@
+/* Compile-time configuration of the spine library
+   Copyright 2024 Randall Maas
+*//**@file
+    @brief Compile-time configuration of the spine library.
+
+    This file has the settings that size the buffers and histories at compile
+    time.  Each may be overridden by defining it before this file is included,
+    e.g. with -D on the compiler command line, or in the sketch's build_opt.h
+    (arduino-esp32).
+
+    The receive buffers are sized for the largest message enabled in each
+    direction (see H2B::size and B2H::size), not the largest message in the
+    protocol.  The firmware update message from the head board is 1028 bytes;
+    a bridge that never passes firmware updates can disable those messages and
+    recover about 1KB of SRAM.
+
+    Defining SPINE_RAM_REPORT as 1 has the compiler report the static RAM used
+    by each subsystem, as a warning naming the subsystem and its size in bytes:
+
+    @code
+    warning: 'void Spine::ReportRAM() [with Subsystem = Spine::B2H::ReceiveBuffer; unsigned int Bytes = 780]' is deprecated: static RAM used
+    @endcode
+*/
+#pragma once
+#include <stddef.h>
+
+/// Enable the firmware update messages: the update firmware, validate and
+/// erase messages from the head board, and the update firmware and validate
+/// messages from the body board.  The boot-loader frames and the version
+/// messages are always enabled, as they are needed to bring up the link.
+#ifndef SPINE_ENABLE_DFU
+#define SPINE_ENABLE_DFU (1)
+#endif
+
+/// The number of motor commands remembered to pair with the feedback.
+#ifndef STALL_COMMAND_HISTORY
+#define STALL_COMMAND_HISTORY (8)
+#endif
+
+/// The number of range bins in the time of flight histograms
+#ifndef TOF_BIN_COUNT
+#define TOF_BIN_COUNT (16)
+#endif
+
+/// The number of points in the charge curve of a session
+#ifndef CHARGE_CURVE_POINTS
+#define CHARGE_CURVE_POINTS (16)
+#endif
+
+/// The baud rate of the links, for the time a frame takes to arrive
+#ifndef SPINE_BAUD_RATE
+#define SPINE_BAUD_RATE (3000000)
+#endif
+
+/// The time (in milliseconds) allowed past when the rest of a frame should
+/// have arrived, before it is given up as cut short
+#ifndef SPINE_READ_SLACK_MS
+#define SPINE_READ_SLACK_MS (1)
+#endif
+
+/// The size of the buffer of a link in the C interface (on the host)
+#ifndef SPINE_LINK_BUFFER_SIZE
+#define SPINE_LINK_BUFFER_SIZE (16384)
+#endif
+
+/// The most instructions in a compiled filter expression
+#ifndef FILTER_MAX_CODE
+#define FILTER_MAX_CODE (32)
+#endif
+
+/// The size of the blocks of frames in a capture file
+#ifndef CAPTURE_BLOCK_SIZE
+#define CAPTURE_BLOCK_SIZE (65536)
+#endif
+
+/// The number of directions tried when estimating the direction of a sound
+#ifndef BEAMFORMER_DIRECTIONS
+#define BEAMFORMER_DIRECTIONS (16)
+#endif
+
+/// The number of samples in each frame of the audio features (about 25ms)
+#ifndef FEATURE_FRAME_LENGTH
+#define FEATURE_FRAME_LENGTH (400)
+#endif
+
+/// The size of the FFT of the audio features; at least FEATURE_FRAME_LENGTH
+#ifndef FEATURE_FFT_SIZE
+#define FEATURE_FFT_SIZE (512)
+#endif
+
+/// The number of mel bands of the audio features
+#ifndef FEATURE_MEL_BANDS
+#define FEATURE_MEL_BANDS (40)
+#endif
+
+/// The lowest and highest frequency of the mel bands (in Hz)
+#ifndef FEATURE_MEL_LOW_HZ
+#define FEATURE_MEL_LOW_HZ (20)
+#endif
+#ifndef FEATURE_MEL_HIGH_HZ
+#define FEATURE_MEL_HIGH_HZ (7800)
+#endif
+
+/// The number of feature frames held for the keyword spotter
+#ifndef FEATURE_RING_FRAMES
+#define FEATURE_RING_FRAMES (8)
+#endif
+
+/// Keep the audio features in fixed point, rather than as floats
+#ifndef FEATURE_FIXED_POINT
+#define FEATURE_FIXED_POINT (0)
+#endif
+
+/// The steps per unit of the fixed point audio features
+#ifndef FEATURE_FIXED_SCALE
+#define FEATURE_FIXED_SCALE (64)
+#endif
+
+/// The size of the FFT of the noise suppressor; the frames overlap by half
+#ifndef DENOISE_FFT_SIZE
+#define DENOISE_FFT_SIZE (256)
+#endif
+
+/// The noise floor is the minimum over DENOISE_MIN_WINDOWS windows of
+/// DENOISE_MIN_FRAMES frames each (about 0.8s)
+#ifndef DENOISE_MIN_FRAMES
+#define DENOISE_MIN_FRAMES (24)
+#endif
+#ifndef DENOISE_MIN_WINDOWS
+#define DENOISE_MIN_WINDOWS (4)
+#endif
+
+/// Correct the frames that fail the CRC with a single bit in error (see
+/// correction.h)
+#ifndef SPINE_CORRECT_CRC
+#define SPINE_CORRECT_CRC (0)
+#endif
+
+/// The largest payload corrected.  The table of the syndromes takes 48
+/// bytes of flash per byte of payload.
+#ifndef SPINE_CORRECT_MAX_PAYLOAD
+#define SPINE_CORRECT_MAX_PAYLOAD (768)
+#endif
+
+/// The number of keyframes in each period of a light animation
+#ifndef LIGHTS_KEYFRAMES
+#define LIGHTS_KEYFRAMES (32)
+#endif
+
+/// The most time (in milliseconds) between lights messages, in case one was
+/// lost, even if the lights haven't changed
+#ifndef LIGHTS_REFRESH_MS
+#define LIGHTS_REFRESH_MS (1000)
+#endif
+
+/// Send the frames from the head board through the latest-wins mailbox
+/// (see mailbox.h)
+#ifndef SPINE_H2B_MAILBOX
+#define SPINE_H2B_MAILBOX (1)
+#endif
+
+/// The number of frames from the head board that must each be delivered
+/// (not data frames or lights) that can wait to be sent
+#ifndef H2B_MAILBOX_QUEUE_DEPTH
+#define H2B_MAILBOX_QUEUE_DEPTH (4)
+#endif
+
+/// The number of integration steps in each frame period of the body board
+/// emulator
+#ifndef EMULATOR_SUBSTEPS
+#define EMULATOR_SUBSTEPS (8)
+#endif
+
+/// The most boxes in the body board emulator's world
+#ifndef EMULATOR_MAX_BOXES
+#define EMULATOR_MAX_BOXES (8)
+#endif
+
+/// Read the data frames from the body board a block of samples at a time, and
+/// pass the samples on to B2H::earlyAudio before the CRC is checked (see
+/// earlyaudio.h)
+#ifndef SPINE_EARLY_AUDIO
+#define SPINE_EARLY_AUDIO (0)
+#endif
+
+/// The number of samples (per microphone) in each block of the early audio,
+/// passed on before the CRC is checked.  This must divide the samples of a
+/// frame.
+#ifndef EARLY_AUDIO_BLOCK_SAMPLES
+#define EARLY_AUDIO_BLOCK_SAMPLES (8)
+#endif
+
+/// The most consumers of the early audio
+#ifndef EARLY_AUDIO_CONSUMERS
+#define EARLY_AUDIO_CONSUMERS (4)
+#endif
+
+/// The size of the buffers that pcapng files are written and read through;
+/// this is also the largest block that can be read
+#ifndef PCAPNG_BUFFER_SIZE
+#define PCAPNG_BUFFER_SIZE (1024*1024)
+#endif
+
+/// The size of the buffer that logic analyser exports are read through;
+/// this is also the longest line of a CSV export
+#ifndef UART_IMPORT_BUFFER_SIZE
+#define UART_IMPORT_BUFFER_SIZE (1024*1024)
+#endif
+
+/// The number of bytes in each direction held while importing a logic
+/// analyser export; at least the largest frame
+#ifndef UART_IMPORT_STREAM_SIZE
+#define UART_IMPORT_STREAM_SIZE (65536)
+#endif
+
+/// Report the static RAM used by each subsystem when compiling
+#ifndef SPINE_RAM_REPORT
+#define SPINE_RAM_REPORT (0)
+#endif
+
+
+namespace Spine {
+
+#if SPINE_RAM_REPORT
+/** Report the static RAM used by a subsystem, as a compiler warning
+    @tparam Subsystem the type that names the subsystem
+    @tparam Bytes the number of bytes of static RAM it uses
+*/
+template<typename Subsystem, size_t Bytes>
+[[deprecated("static RAM used")]] inline void ReportRAM() {}
+#endif
+
+}
@@ -0,0 +1,136 @@
+/* Single bit error correction of the frames that fail the CRC
+   Copyright 2024 Randall Maas
+*//**@file
+    @brief Single bit error correction of the frames that fail the CRC.
+
+    This file contains the table of the syndromes, built at compile time, and
+    the correction.
+*/
+#include <Arduino.h>
+#include "crc.h"
+#include "correction.h"
+
+namespace Spine {
+
+/// The number of payload bits that can be corrected
+static constexpr size_t correctableBits = 8*SPINE_CORRECT_MAX_PAYLOAD;
+
+/// The syndrome of each bit of the payload, sorted by syndrome
+struct SyndromeTable
+{
+    /// The syndromes, in increasing order
+    uint32_t syndrome[correctableBits];
+
+    /// The bit in error for each syndrome: 8 times the bytes from the end of
+    /// the payload, plus the bit in the byte
+    uint16_t bit[correctableBits];
+};
+
+/** Build the table of the syndromes
+    @return the table
+*/
+static constexpr SyndromeTable makeSyndromeTable()
+{
+    SyndromeTable table = {};
+
+    // the syndrome of a bit is the CRC register (started at 0) after the
+    // byte with that bit, then the zero bytes to the end of the payload
+    for (uint32_t bit = 0; bit < 8; bit++)
+    {
+        uint32_t crc = crc32Table.entry[1u << bit];
+        for (size_t bytes = 0; bytes < SPINE_CORRECT_MAX_PAYLOAD; bytes++)
+        {
+            table.syndrome[8*bytes + bit] = crc;
+            table.bit[8*bytes + bit] = (uint16_t)(8*bytes + bit);
+            crc = crc32Table.entry[crc & 0xFF] ^ (crc >> 8);
+        }
+    }
+
+    // heap sort by syndrome
+    auto swap = [&table](size_t a, size_t b)
+    {
+        uint32_t s = table.syndrome[a]; table.syndrome[a] = table.syndrome[b]; table.syndrome[b] = s;
+        uint16_t t = table.bit[a]; table.bit[a] = table.bit[b]; table.bit[b] = t;
+    };
+    auto sift = [&table, &swap](size_t root, size_t end)
+    {
+        for (size_t child = 2*root + 1; child < end; root = child, child = 2*root + 1)
+        {
+            if (child + 1 < end && table.syndrome[child] < table.syndrome[child+1])
+                child++;
+            if (table.syndrome[root] >= table.syndrome[child])
+                break;
+            swap(root, child);
+        }
+    };
+    for (size_t idx = correctableBits/2; idx-- > 0; )
+        sift(idx, correctableBits);
+    for (size_t end = correctableBits; end-- > 1; )
+    {
+        swap(0, end);
+        sift(0, end);
+    }
+    return table;
+}
+
+/// The table of the syndromes, built at compile time
+static constexpr SyndromeTable syndromes = makeSyndromeTable();
+
+/** Check that each bit has its own syndrome, and none is a bit in the CRC
+    @return true if the syndromes can be told apart
+*/
+static constexpr bool syndromesDistinct()
+{
+    for (size_t idx = 0; idx < correctableBits; idx++)
+        if (!(syndromes.syndrome[idx] & (syndromes.syndrome[idx] - 1))
+            || (idx && syndromes.syndrome[idx-1] == syndromes.syndrome[idx]))
+            return false;
+    return true;
+}
+static_assert(syndromesDistinct(), "Each bit in error must have its own syndrome");
+
+
+/** Correct a single bit in error in a frame that failed the CRC
+    @param payload the payload
+    @param size the size of the payload (in bytes)
+    @param crc the CRC following the payload
+    @param syndrome the CRC computed over the payload, exclusive or'd with
+           the CRC following the payload
+    @return true if one bit was in error, and has been corrected; false if
+            the frame can't be corrected
+
+    The CRC is corrected in place if the bit in error was in it.
+*/
+bool CorrectBitError(uint8_t* payload, size_t size, uint32_t& crc, uint32_t syndrome)
+{
+    if (!syndrome || size > SPINE_CORRECT_MAX_PAYLOAD)
+        return false;
+
+    // the bit in error is in the CRC
+    if (!(syndrome & (syndrome - 1)))
+    {
+        crc ^= syndrome;
+        return true;
+    }
+
+    // find the syndrome in the table; the same number of steps each time
+    size_t lo = 0;
+    for (size_t step = correctableBits; step > 1; )
+    {
+        size_t half = step / 2;
+        if (syndromes.syndrome[lo + half] <= syndrome)
+            lo += half;
+        step -= half;
+    }
+    if (syndromes.syndrome[lo] != syndrome)
+        return false;
+
+    // the bit in error must be in the payload
+    size_t bytes = syndromes.bit[lo] / 8;
+    if (bytes >= size)
+        return false;
+    payload[size - 1 - bytes] ^= (uint8_t)(1u << (syndromes.bit[lo] % 8));
+    return true;
+}
+
+}
@@ -0,0 +1,51 @@
+/* Single bit error correction of the frames that fail the CRC
+   Copyright 2024 Randall Maas
+*//**@file
+    @brief Single bit error correction of the frames that fail the CRC.
+
+    Most of the frames that fail the CRC on a marginal cable have just one bit
+    flipped.  The CRC-32 can find and fix that bit, rather than the frame
+    being dropped.
+
+    The CRC is linear: the CRC computed over the payload received, exclusive
+    or'd with the CRC received (the "syndrome"), depends only on the bits in
+    error, not on the payload.  The syndrome of a single bit in error depends
+    only on how far it is from the end of the payload, so one table serves
+    all of the payload sizes:
+
+    - a syndrome with just one bit set is a bit in error in the CRC itself
+    - otherwise, the syndrome is looked up in a table of the syndrome of each
+      bit of the payload, sorted by syndrome.  The table is built at compile
+      time (it is in flash on the ESP32), and is searched in a fixed number of
+      steps.
+
+    The CRC-32 has a Hamming distance of 4 at these payload sizes, so a
+    single bit in error is always found, and two bits in error are never
+    mistaken for one.  It can't correct two bits in error: two different
+    pairs of bits can have the same syndrome.
+
+    The correction is enabled with SPINE_CORRECT_CRC in config.h, for the
+    payloads of up to SPINE_CORRECT_MAX_PAYLOAD bytes.  The receivers count
+    the frames corrected in numCorrected.
+*/
+#pragma once
+#include <inttypes.h>
+#include <stddef.h>
+#include "spine.h"
+
+namespace Spine {
+
+/** Correct a single bit in error in a frame that failed the CRC
+    @param payload the payload
+    @param size the size of the payload (in bytes)
+    @param crc the CRC following the payload
+    @param syndrome the CRC computed over the payload, exclusive or'd with
+           the CRC following the payload
+    @return true if one bit was in error, and has been corrected; false if
+            the frame can't be corrected
+
+    The CRC is corrected in place if the bit in error was in it.
+*/
+bool CorrectBitError(uint8_t* payload, size_t size, uint32_t& crc, uint32_t syndrome);
+
+}
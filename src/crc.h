@@ -0,0 +1,132 @@
+/* Compile-time CRC-32
+   Copyright 2024 Randall Maas
+*//**@file
+    @brief Compile-time CRC-32.
+
+    The frames are checked with a CRC-32 of the payload.  At run time this is
+    computed by the ESP32 ROM's crc32_le().  This file has an equivalent that
+    can be evaluated by the compiler, so that the CRC of a constant payload --
+    and the whole frame around it -- can be built at compile time.
+
+    The ROM's crc32_le() is the usual reflected CRC-32 (polynomial 0xEDB88320)
+    with the register inverted on the way in and on the way out.  The frames
+    pass ~0 as the initial value, so the register starts at 0.
+
+    @note this needs C++17 (the arduino-esp32 3.x tool-chain)
+*/
+#pragma once
+#include <inttypes.h>
+#include <stddef.h>
+
+namespace Spine {
+
+/// The reflected CRC-32 polynomial
+#define CRC32_POLYNOMIAL (0xEDB88320UL)
+
+/// The initial value the frames pass to the CRC
+#define CRC32_INITIAL (0xFFFFFFFFUL)
+
+/// The byte-wise lookup table for the CRC-32
+struct Crc32Table
+{
+    /// The CRC of each byte value
+    uint32_t entry[256];
+};
+
+/** Build the byte-wise lookup table for the CRC-32
+    @return the table
+*/
+constexpr Crc32Table makeCrc32Table()
+{
+    Crc32Table table = {};
+    for (uint32_t idx = 0; idx < 256; idx++)
+    {
+        uint32_t crc = idx;
+        for (int bit = 0; bit < 8; bit++)
+            crc = (crc >> 1) ^ ((crc & 1) ? CRC32_POLYNOMIAL : 0);
+        table.entry[idx] = crc;
+    }
+    return table;
+}
+
+/// The byte-wise lookup table for the CRC-32, built at compile time
+inline constexpr Crc32Table crc32Table = makeCrc32Table();
+
+
+/** Compute the CRC-32 of some bytes, the same as the ROM's crc32_le()
+    @param crc the initial value (or the CRC of the preceding bytes)
+    @param data the bytes
+    @param size the number of bytes
+    @return the CRC
+
+    This can be evaluated at compile time.
+*/
+template<typename T>
+constexpr uint32_t Crc32(uint32_t crc, const T* data, size_t size)
+{
+    crc = ~crc;
+    for (size_t idx = 0; idx < size; idx++)
+        crc = crc32Table.entry[(crc ^ (uint8_t) data[idx]) & 0xFF] ^ (crc >> 8);
+    return ~crc;
+}
+
+// check against the standard check value
+static_assert(Crc32(0, "123456789", 9) == 0xCBF43926UL, "The CRC-32 doesn't match the standard check value");
+
+
+/// The slice-by-8 lookup tables for the CRC-32: the first is the byte-wise
+/// table, and each of the others takes the CRC on by another byte of zeros
+struct Crc32SliceTable
+{
+    /// The CRC of each byte value, followed by 0 to 7 bytes of zeros
+    uint32_t entry[8][256];
+};
+
+/** Build the slice-by-8 lookup tables for the CRC-32
+    @return the tables
+*/
+constexpr Crc32SliceTable makeCrc32SliceTable()
+{
+    Crc32SliceTable table = {};
+    for (uint32_t idx = 0; idx < 256; idx++)
+        table.entry[0][idx] = crc32Table.entry[idx];
+    for (int slice = 1; slice < 8; slice++)
+        for (uint32_t idx = 0; idx < 256; idx++)
+        {
+            auto crc = table.entry[slice-1][idx];
+            table.entry[slice][idx] = crc32Table.entry[crc & 0xFF] ^ (crc >> 8);
+        }
+    return table;
+}
+
+/// The slice-by-8 lookup tables for the CRC-32, built at compile time
+inline constexpr Crc32SliceTable crc32SliceTable = makeCrc32SliceTable();
+
+
+/** Compute the CRC-32 of some bytes, 8 bytes at a time
+    @param crc the initial value (or the CRC of the preceding bytes)
+    @param data the bytes
+    @param size the number of bytes
+    @return the CRC, the same as Crc32()
+
+    This is for the host tools that check a lot of frames (e.g. scanning
+    captures); it is several times faster than the byte-wise Crc32(), at the
+    cost of 8K of tables.  The bytes needn't be aligned.
+*/
+inline uint32_t Crc32Sliced(uint32_t crc, const uint8_t* data, size_t size)
+{
+    auto& t = crc32SliceTable.entry;
+    crc = ~crc;
+    for (; size >= 8; data += 8, size -= 8)
+    {
+        uint32_t lo = crc ^ (data[0] | (uint32_t) data[1] << 8 | (uint32_t) data[2] << 16 | (uint32_t) data[3] << 24);
+        uint32_t hi = data[4] | (uint32_t) data[5] << 8 | (uint32_t) data[6] << 16 | (uint32_t) data[7] << 24;
+        crc = t[7][lo & 0xFF] ^ t[6][(lo >> 8) & 0xFF] ^ t[5][(lo >> 16) & 0xFF] ^ t[4][lo >> 24]
+            ^ t[3][hi & 0xFF] ^ t[2][(hi >> 8) & 0xFF] ^ t[1][(hi >> 16) & 0xFF] ^ t[0][hi >> 24];
+    }
+    for (; size; data++, size--)
+        crc = t[0][(crc ^ *data) & 0xFF] ^ (crc >> 8);
+    return ~crc;
+}
+
+}
@@ -0,0 +1,148 @@
+/* Spectral noise suppression for the microphone audio
+   Copyright 2024 Randall Maas
+*//**@file
+    @brief Spectral noise suppression for the microphone audio.
+
+    This file contains the overlap-add framing, the noise floor tracking and
+    the gains.
+*/
+#include <string.h>
+#include <math.h>
+#include <Arduino.h>
+#include "denoise.h"
+
+namespace Spine {
+
+/// The default settings
+const NoiseSuppressorConfig defaultNoiseSuppressorConfig =
+{
+    // power smoothing: a time constant of about 5 frames (40ms)
+    0.8f,
+    // prior smoothing: the usual weight of the decision-directed estimate
+    0.98f,
+    // bias: the minimum of the smoothed power is about half the mean
+    2.0f,
+    // least gain: -20dB, to limit the musical noise
+    0.1f
+};
+
+/// The smallest noise power, so that the SNR is finite
+#define MIN_NOISE (1e-3f)
+
+
+/** Create the noise suppressor
+    @param config the settings
+*/
+NoiseSuppressor::NoiseSuppressor(const NoiseSuppressorConfig& config)
+    : numFrames(0), config(config), position(0), windowFrames(0), pastWindow(0)
+{
+    // the periodic Hann window sums to 1 at half overlap; the analysis and
+    // synthesis each take its square root
+    for (size_t idx = 0; idx < DENOISE_FFT_SIZE; idx++)
+        window[idx] = (float) sqrt(0.5 - 0.5*cos(2*3.14159265358979323846*idx / DENOISE_FFT_SIZE));
+
+    memset(input, 0, sizeof(input));
+    memset(overlap, 0, sizeof(overlap));
+    memset(output, 0, sizeof(output));
+    memset(power, 0, sizeof(power));
+    memset(clean, 0, sizeof(clean));
+    for (size_t bin = 0; bin < numBins; bin++)
+    {
+        windowMin[bin] = INFINITY;
+        for (size_t past = 0; past < DENOISE_MIN_WINDOWS; past++)
+            pastMin[past][bin] = INFINITY;
+    }
+}
+
+
+/** Take the noise out of samples
+    @param in the samples
+    @param out the samples with the noise taken out, latency samples
+           later; this may be the same as in
+    @param count the number of samples
+*/
+void NoiseSuppressor::process(const int16_t* in, int16_t* out, size_t count)
+{
+    for (size_t idx = 0; idx < count; idx++)
+    {
+        input[hop + position] = in[idx];
+        out[idx] = output[position];
+        if (++position < hop)
+            continue;
+        frame();
+        memmove(input, input + hop, hop*sizeof(input[0]));
+        position = 0;
+    }
+}
+
+
+/// Take the noise out of the frame in the input, and add it to the overlap
+void NoiseSuppressor::frame()
+{
+    float samples[DENOISE_FFT_SIZE];
+    for (size_t idx = 0; idx < DENOISE_FFT_SIZE; idx++)
+        samples[idx] = input[idx] * window[idx];
+
+    float spectrum[DENOISE_FFT_SIZE+2];
+    fft.forward(samples, spectrum);
+    suppress(spectrum);
+    fft.inverse(spectrum, samples);
+
+    for (size_t idx = 0; idx < DENOISE_FFT_SIZE; idx++)
+        overlap[idx] += samples[idx] * window[idx];
+
+    // the first hop has all of its frames now
+    for (size_t idx = 0; idx < hop; idx++)
+    {
+        long value = lroundf(overlap[idx]);
+        output[idx] = (int16_t)(value > INT16_MAX ? INT16_MAX : value < INT16_MIN ? INT16_MIN : value);
+    }
+    memmove(overlap, overlap + hop, hop*sizeof(overlap[0]));
+    memset(overlap + hop, 0, hop*sizeof(overlap[0]));
+    numFrames++;
+}
+
+
+/// Update the noise floor, and scale the spectrum by the gains
+void NoiseSuppressor::suppress(float* spectrum)
+{
+    float frame[numBins], noise[numBins];
+    for (size_t bin = 0; bin < numBins; bin++)
+        frame[bin] = spectrum[2*bin]*spectrum[2*bin] + spectrum[2*bin+1]*spectrum[2*bin+1];
+
+    // the noise floor: the minimum of the smoothed power
+    const float a = numFrames ? config.powerSmoothing : 0;
+    for (size_t bin = 0; bin < numBins; bin++)
+    {
+        power[bin] = a*power[bin] + (1-a)*frame[bin];
+        windowMin[bin] = power[bin] < windowMin[bin] ? power[bin] : windowMin[bin];
+        noise[bin] = windowMin[bin];
+    }
+    for (size_t past = 0; past < DENOISE_MIN_WINDOWS; past++)
+        for (size_t bin = 0; bin < numBins; bin++)
+            noise[bin] = pastMin[past][bin] < noise[bin] ? pastMin[past][bin] : noise[bin];
+    if (++windowFrames >= DENOISE_MIN_FRAMES)
+    {
+        memcpy(pastMin[pastWindow], windowMin, sizeof(windowMin));
+        pastWindow = (pastWindow + 1) % DENOISE_MIN_WINDOWS;
+        for (size_t bin = 0; bin < numBins; bin++)
+            windowMin[bin] = INFINITY;
+        windowFrames = 0;
+    }
+
+    // the Wiener gains, from the decision directed SNR
+    const float b = config.priorSmoothing;
+    for (size_t bin = 0; bin < numBins; bin++)
+    {
+        float level = config.bias*noise[bin] + MIN_NOISE;
+        float excess = frame[bin]/level - 1;
+        float snr = b*clean[bin]/level + (1-b)*(excess > 0 ? excess : 0);
+        float gain = snr / (1 + snr);
+        gain = gain > config.minGain ? gain : config.minGain;
+        clean[bin] = gain*gain*frame[bin];
+        spectrum[2*bin]   *= gain;
+        spectrum[2*bin+1] *= gain;
+    }
+}
+
+}
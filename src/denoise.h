@@ -0,0 +1,146 @@
+/* Spectral noise suppression for the microphone audio
+   Copyright 2024 Randall Maas
+*//**@file
+    @brief Spectral noise suppression for the microphone audio.
+
+    The noise suppressor takes out the steady noise (the motors and fan) from
+    one channel of audio (a microphone, or the output of the beamformer).  It
+    is an optional stage, between the beamformer and the consumers of the
+    audio:
+
+    @code
+    Beamformer beamformer;
+    NoiseSuppressor denoise;
+    int16_t voice[MICROPHONE_SAMPLES_PER_FRAME];
+    beamformer.process(frame, voice);
+    denoise.process(voice, voice, MICROPHONE_SAMPLES_PER_FRAME);
+    @endcode
+
+    The audio is cut into frames of DENOISE_FFT_SIZE samples that overlap by
+    half, each with a square root Hann window, and transformed to the
+    spectrum.  For each bin of the spectrum:
+
+    1. The noise floor is tracked as the minimum of the smoothed power over
+       the last DENOISE_MIN_WINDOWS windows of DENOISE_MIN_FRAMES frames
+       ("minimum statistics").  Speech comes and goes, so the minimum is the
+       noise between the words.  The minimum is less than the mean of the
+       noise, so it is scaled up by a bias.
+    2. The bin is scaled by a Wiener gain, SNR/(1+SNR).  The SNR is estimated
+       from the frame, smoothed with the clean power of the previous frame
+       (the "decision directed" estimate), which keeps the gain from
+       flickering on the noise (the "musical noise").  The gain has a floor,
+       so the noise is turned down, not gated.
+
+    The frames are transformed back, windowed again, and overlap added.  The
+    square root Hann windows of the analysis and synthesis multiply to a Hann
+    window, which sums to 1 at half overlap, so with a gain of 1 the output is
+    the input, delayed.
+
+    The output is delayed by latency samples (DENOISE_FFT_SIZE, about 16ms
+    at the default size).
+
+    The kernels are runs over the contiguous bins, which the compiler can
+    vectorize.
+*/
+#pragma once
+#include <inttypes.h>
+#include <stddef.h>
+#include "spine.h"
+#include "fft.h"
+
+namespace Spine {
+
+/// The settings of the noise suppressor
+struct NoiseSuppressorConfig
+{
+    /// The smoothing of the power for the noise floor tracking, 0 to 1
+    float powerSmoothing;
+
+    /// The weight of the previous frame in the SNR estimate, 0 to 1
+    float priorSmoothing;
+
+    /// The ratio of the mean of the noise to the minimum of its smoothed power
+    float bias;
+
+    /// The least gain, 0 to 1
+    float minGain;
+};
+
+/// The default settings, the usual ones for speech in steady noise.  The
+/// motors' noise starts and stops, so it leaks through until the noise
+/// floor catches up.
+extern const NoiseSuppressorConfig defaultNoiseSuppressorConfig;
+
+
+/** Takes the steady noise out of a stream of audio
+*/
+class NoiseSuppressor
+{
+public:
+    /// The number of samples between frames
+    static constexpr size_t hop = DENOISE_FFT_SIZE/2;
+
+    /// The number of bins of the spectrum
+    static constexpr size_t numBins = DENOISE_FFT_SIZE/2 + 1;
+
+    /// The number of samples the output is delayed from the input
+    static constexpr size_t latency = DENOISE_FFT_SIZE;
+
+    /** Create the noise suppressor
+        @param config the settings
+    */
+    NoiseSuppressor(const NoiseSuppressorConfig& config = defaultNoiseSuppressorConfig);
+
+    /** Take the noise out of samples
+        @param in the samples
+        @param out the samples with the noise taken out, latency samples
+               later; this may be the same as in
+        @param count the number of samples
+    */
+    void process(const int16_t* in, int16_t* out, size_t count);
+
+    /// The number of frames processed
+    uint32_t numFrames;
+
+private:
+    /// Take the noise out of the frame in the input, and add it to the overlap
+    void frame();
+
+    /// Update the noise floor, and scale the spectrum by the gains
+    void suppress(float* spectrum);
+
+    /// The settings
+    NoiseSuppressorConfig config;
+
+    /// The transform
+    RealFft<DENOISE_FFT_SIZE> fft;
+
+    /// The square root Hann window
+    float window[DENOISE_FFT_SIZE];
+
+    /// The last frame of samples in
+    float input[DENOISE_FFT_SIZE];
+
+    /// The overlap added samples out, not yet finished
+    float overlap[DENOISE_FFT_SIZE];
+
+    /// The finished samples out
+    int16_t output[hop];
+
+    /// The number of samples in (and out) since the last frame
+    size_t position;
+
+    /// The smoothed power of each bin
+    float power[numBins];
+
+    /// The minimum power of each bin, in this window and the past windows
+    float windowMin[numBins], pastMin[DENOISE_MIN_WINDOWS][numBins];
+
+    /// The number of frames in this window, and the next past window to replace
+    size_t windowFrames, pastWindow;
+
+    /// The clean power of each bin in the previous frame
+    float clean[numBins];
+};
+
+}
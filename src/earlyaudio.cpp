@@ -0,0 +1,214 @@
+/* Early delivery of the microphone audio, before the CRC is checked
+   Copyright 2024 Randall Maas
+*//**@file
+    @brief Early delivery of the microphone audio, before the CRC is checked.
+
+    This file contains the following of the frames as the bytes arrive, the
+    running CRC, and the delivery, commit and roll back of the samples.
+*/
+#include <stddef.h>
+#include <string.h>
+#include <Arduino.h>
+#include <esp32/rom/crc.h>
+#include "earlyaudio.h"
+#include "crc.h"
+// the same CRC as the framing
+#define crc32 crc32_le
+
+namespace Spine {
+
+static_assert(MICROPHONE_SAMPLES_PER_FRAME % EARLY_AUDIO_BLOCK_SAMPLES == 0, "The blocks must divide the samples of a frame");
+
+/// The sync bytes of the frames from the body board
+static const uint8_t b2hSync[4] = {0xAA, 'B', '2', 'H'};
+
+/// Where the samples start in the payload of a data frame
+static constexpr size_t samplesOfs = offsetof(B2HDataFrame, mic_samples);
+static_assert(samplesOfs + MICROPHONE_SAMPLES_PER_FRAME*MICROPHONE_COUNT*sizeof(int16_t) == sizeof(B2HDataFrame), "The samples end the payload");
+
+/// The bytes of each sample (all of the microphones)
+static constexpr size_t sampleSize = MICROPHONE_COUNT * sizeof(int16_t);
+
+
+EarlyAudioReceiver::EarlyAudioReceiver()
+    : numCommitted(0), numRolledBack(0), numConsumers(0), offset(0), payloadSize(0), isDataFrame(false)
+    , crc(0), crcInFrame(0), numDelivered(0), numFrames(0), start_us(0)
+{
+    memset(header, 0, sizeof(header));
+    memset(samples, 0, sizeof(samples));
+}
+
+
+/** Add a consumer of the audio
+    @param consumer the consumer
+    @return true on success, false if there are EARLY_AUDIO_CONSUMERS
+            already
+*/
+bool EarlyAudioReceiver::subscribe(const AudioConsumer& consumer)
+{
+    if (numConsumers >= EARLY_AUDIO_CONSUMERS)
+        return false;
+    consumers[numConsumers++] = consumer;
+    return true;
+}
+
+
+/** Take the bytes from the body board as they arrive
+    @param bytes the bytes
+    @param size the number of bytes
+    @param now_us the time (in microseconds) that the bytes arrived
+*/
+void EarlyAudioReceiver::receive(const uint8_t* bytes, size_t size, uint32_t now_us)
+{
+    while (size)
+    {
+        // the sync bytes
+        if (offset < sizeof(b2hSync))
+        {
+            auto byte = *bytes++;
+            size--;
+            if (byte == b2hSync[offset])
+                header[offset++] = byte;
+            else
+                offset = byte == b2hSync[0] ? 1 : 0;
+            if (offset == 1)
+                start_us = now_us;
+            continue;
+        }
+
+        // the message type and size
+        if (offset < payload_ofs)
+        {
+            header[offset++] = *bytes++;
+            size--;
+            if (offset < payload_ofs)
+                continue;
+
+            // assumes alignment, little endian host
+            auto message_type = (MessageType) *(uint16_t*)(header+4);
+            payloadSize = *(uint16_t*)(header+payload_size_ofs);
+            auto expected_size = B2H::size(message_type);
+            if (expected_size < 0 || (size_t) expected_size != payloadSize)
+            {
+                offset = 0;
+                continue;
+            }
+            isDataFrame = message_type == MessageType::dataFrame;
+            crc = CRC32_INITIAL;
+            crcInFrame = 0;
+            numDelivered = 0;
+            continue;
+        }
+
+        // the payload; only the samples of the data frames are kept
+        auto end = payload_ofs + payloadSize;
+        if (offset < end)
+        {
+            auto num = size < end - offset ? size : end - offset;
+            if (isDataFrame)
+            {
+                crc = crc32(crc, (uint8_t*) bytes, (uint32_t) num);
+                size_t pos = offset - payload_ofs, skip = pos < samplesOfs ? samplesOfs - pos : 0;
+                if (skip < num)
+                    memcpy((uint8_t*) samples + (pos + skip - samplesOfs), bytes + skip, num - skip);
+            }
+            offset += num;
+            bytes  += num;
+            size   -= num;
+            if (isDataFrame)
+                deliverBlocks();
+            continue;
+        }
+
+        // the CRC, little endian
+        crcInFrame |= (uint32_t) *bytes++ << (8*(offset - end));
+        size--;
+        if (++offset < end + 4)
+            continue;
+        if (isDataFrame)
+            finish(crc == crcInFrame);
+        offset = 0;
+    }
+}
+
+
+/** Roll back a data frame that is taking too long to arrive
+    @param now_us the time (in microseconds)
+    @return true if a frame was rolled back
+
+    The frame is given the time it takes to send at SPINE_BAUD_RATE, and
+    SPINE_READ_SLACK_MS, as a read of the frame would be.
+*/
+bool EarlyAudioReceiver::expire(uint32_t now_us)
+{
+    if (!offset)
+        return false;
+
+    // 10 bits a byte on the wire
+    auto frameSize = payload_ofs + (offset < payload_ofs ? 0 : payloadSize) + 4;
+    auto deadline_us = ((uint64_t) frameSize * 10 * 1000000 + SPINE_BAUD_RATE - 1) / SPINE_BAUD_RATE + SPINE_READ_SLACK_MS * 1000;
+    if (now_us - start_us <= deadline_us)
+        return false;
+
+    bool rolledBack = offset >= payload_ofs && isDataFrame;
+    if (rolledBack)
+        finish(false);
+    offset = 0;
+    return rolledBack;
+}
+
+
+/** Finish the frame being received, with the result of a CRC checked by the
+    caller
+    @param good true if the CRC passed
+*/
+void EarlyAudioReceiver::settle(bool good)
+{
+    if (offset >= payload_ofs && isDataFrame)
+        finish(good);
+    offset = 0;
+}
+
+
+/** Pass on the blocks of samples that have arrived to the speculative
+    consumers
+*/
+void EarlyAudioReceiver::deliverBlocks()
+{
+    auto received = offset - payload_ofs;
+    size_t available = received > samplesOfs ? (received - samplesOfs) / sampleSize : 0;
+    for (; numDelivered + EARLY_AUDIO_BLOCK_SAMPLES <= available; numDelivered += EARLY_AUDIO_BLOCK_SAMPLES)
+        for (size_t idx = 0; idx < numConsumers; idx++)
+        {
+            auto& consumer = consumers[idx];
+            if (consumer.speculative)
+                consumer.samples(consumer.context, numFrames, numDelivered, samples + numDelivered*MICROPHONE_COUNT, EARLY_AUDIO_BLOCK_SAMPLES, true);
+        }
+}
+
+
+/** Finish a data frame: commit or roll back its samples
+    @param good true if the CRC passed
+*/
+void EarlyAudioReceiver::finish(bool good)
+{
+    for (size_t idx = 0; idx < numConsumers; idx++)
+    {
+        auto& consumer = consumers[idx];
+        if (consumer.speculative)
+        {
+            // the blocks that did arrive have been passed on
+            if (numDelivered && consumer.verdict)
+                consumer.verdict(consumer.context, numFrames, good);
+        }
+        else if (good)
+            consumer.samples(consumer.context, numFrames, 0, samples, MICROPHONE_SAMPLES_PER_FRAME, false);
+    }
+    if (good)
+        numCommitted++;
+    else
+        numRolledBack++;
+    numFrames++;
+}
+
+}
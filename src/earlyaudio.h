@@ -0,0 +1,181 @@
+/* Early delivery of the microphone audio, before the CRC is checked
+   Copyright 2024 Randall Maas
+*//**@file
+    @brief Early delivery of the microphone audio, before the CRC is checked.
+
+    The microphone samples are the last 640 bytes of the body board's data
+    frame.  Receiving the whole frame and checking its CRC before using any
+    of the samples holds the first of them back for the time it takes the
+    rest of the frame to arrive.
+
+    The early audio receiver takes the bytes from the body board as they
+    arrive (e.g. each time the UART hands over its FIFO), and follows the
+    frames in them.  The samples of a data frame are passed on in blocks of
+    EARLY_AUDIO_BLOCK_SAMPLES (interleaved, as in the frame), as soon as the
+    bytes of each block are in.  These blocks are speculative: the CRC hasn't
+    been checked yet.  When the CRC arrives, the consumer is told whether to
+    commit the samples, or roll them back (the CRC failed, or the rest of the
+    frame didn't arrive in time).
+
+    A consumer that can't roll back takes the samples the usual way: all of
+    them at once, once the CRC has passed.  Each consumer picks when it
+    subscribes:
+
+    @code
+    EarlyAudioReceiver audio;
+    audio.subscribe({onSamples, onVerdict, &detector, true});
+    // as bytes arrive from the body board
+    audio.receive(bytes, numBytes, micros());
+    audio.expire(micros());
+    @endcode
+
+    The bytes are only looked at; they still need to be forwarded as usual.
+    The frames other than the data frames are skipped.
+
+    With SPINE_EARLY_AUDIO, the bridge does this itself: B2H::ReceiveFrame
+    (and so ReceiveMessage and the link bring-up) reads a data frame a block
+    of samples at a time, passes the header and each block to B2H::earlyAudio,
+    and settles the frame with the result of its own CRC check:
+
+    @code
+    B2H::earlyAudio.subscribe({onSamples, onVerdict, &detector, true});
+    @endcode
+*/
+#pragma once
+#include <inttypes.h>
+#include <stddef.h>
+#include "spine.h"
+
+namespace Spine {
+
+/// A consumer of the microphone audio
+struct AudioConsumer
+{
+    /** Called with a block of samples
+        @param context the consumer's context
+        @param frame the number of the frame the samples are from, counted
+               by the receiver
+        @param first the index of the first sample in the frame
+        @param samples the samples, interleaved (MICROPHONE_COUNT per sample)
+        @param count the number of samples (per microphone)
+        @param speculative true if the CRC of the frame hasn't been checked
+    */
+    void (*samples)(void* context, uint32_t frame, size_t first, const int16_t* samples, size_t count, bool speculative);
+
+    /** Called when the CRC of a frame whose samples were speculative has
+        been checked, or the frame was abandoned.  Not called for a consumer
+        that isn't speculative, or if none of the frame's samples had been
+        passed on.
+        @param context the consumer's context
+        @param frame the number of the frame
+        @param good true to commit the samples, false to roll them back
+    */
+    void (*verdict)(void* context, uint32_t frame, bool good);
+
+    /// The consumer's context
+    void* context;
+
+    /// Take the samples as they arrive, before the CRC is checked
+    bool speculative;
+};
+
+
+/** Follow the frames from the body board as the bytes arrive, and pass on
+    the microphone samples early.
+*/
+class EarlyAudioReceiver
+{
+public:
+    EarlyAudioReceiver();
+
+    /** Add a consumer of the audio
+        @param consumer the consumer
+        @return true on success, false if there are EARLY_AUDIO_CONSUMERS
+                already
+    */
+    bool subscribe(const AudioConsumer& consumer);
+
+    /** Take the bytes from the body board as they arrive
+        @param bytes the bytes
+        @param size the number of bytes
+        @param now_us the time (in microseconds) that the bytes arrived
+    */
+    void receive(const uint8_t* bytes, size_t size, uint32_t now_us);
+
+    /** Roll back a data frame that is taking too long to arrive
+        @param now_us the time (in microseconds)
+        @return true if a frame was rolled back
+
+        The frame is given the time it takes to send at SPINE_BAUD_RATE, and
+        SPINE_READ_SLACK_MS, as a read of the frame would be.
+    */
+    bool expire(uint32_t now_us);
+
+    /** Finish the frame being received, with the result of a CRC checked by
+        the caller
+        @param good true if the CRC passed
+
+        This is for a caller that reads the frames itself: it passes on the
+        header and the payload, but not the CRC.  A frame that was cut short
+        is settled as bad.
+    */
+    void settle(bool good);
+
+    /// The number of data frames whose samples were committed, and rolled back
+    uint32_t numCommitted, numRolledBack;
+
+private:
+    /** Pass on the blocks of samples that have arrived to the speculative
+        consumers
+    */
+    void deliverBlocks();
+
+    /** Finish a data frame: commit or roll back its samples
+        @param good true if the CRC passed
+    */
+    void finish(bool good);
+
+    /// The consumers
+    AudioConsumer consumers[EARLY_AUDIO_CONSUMERS];
+    size_t numConsumers;
+
+    /// The frame being received: the header, and the samples of a data frame
+    /// (copied out of the packed payload, so that they are aligned)
+    uint8_t header[payload_ofs];
+    int16_t samples[MICROPHONE_SAMPLES_PER_FRAME*MICROPHONE_COUNT];
+
+    /// The bytes of the frame received so far; 0 while looking for the sync
+    size_t offset;
+
+    /// The size of the payload of the frame
+    size_t payloadSize;
+
+    /// The frame is a data frame
+    bool isDataFrame;
+
+    /// The CRC of the payload received so far, and the CRC in the frame
+    uint32_t crc, crcInFrame;
+
+    /// The number of samples (per microphone) passed on speculatively
+    size_t numDelivered;
+
+    /// The number of data frames finished; the number of the frame being
+    /// received
+    uint32_t numFrames;
+
+    /// When the frame started to arrive (in microseconds)
+    uint32_t start_us;
+};
+
+
+namespace B2H {
+
+#if SPINE_EARLY_AUDIO
+/// Passes the samples of the data frames received by ReceiveFrame and
+/// ReceiveMessage on as they arrive
+extern EarlyAudioReceiver earlyAudio;
+#endif
+
+}
+
+}
@@ -0,0 +1,338 @@
+/* Closed-loop emulation of the body board
+   Copyright 2024 Randall Maas
+*//**@file
+    @brief Closed-loop emulation of the body board.
+
+    This file contains the motor dynamics, the motion of the robot about the
+    world, the sensor models, and the building of the data frames.
+*/
+#include <math.h>
+#include <string.h>
+#include <Arduino.h>
+#include <esp32/rom/crc.h>
+#include "frames.h"
+#include "emulator.h"
+// the same CRC as the framing
+#define crc32 crc32_le
+
+namespace Spine {
+
+/// The default robot
+const BodyConfig defaultBodyConfig =
+{
+    {
+        // the wheels: about 40 ticks a frame at full duty (see defaultStallConfig)
+        {7800.0f, 0.05f, 3277, 0, 0},
+        {7800.0f, 0.05f, 3277, 0, 0},
+        // the lift and head: about 8 ticks a frame, between the stops of
+        // defaultLiftConfig and defaultHeadConfig
+        {1560.0f, 0.03f, 3277, -200, 1050},
+        {1560.0f, 0.03f, 3277, -380,  785},
+    },
+    // ticks per mm: about 195 mm/s at full duty
+    40.0f,
+    // wheel base, radius
+    48.0f, 35.0f,
+    // cliff sensors at the corners
+    {{30.0f, 15.0f}, {30.0f, -15.0f}, {-30.0f, 15.0f}, {-30.0f, -15.0f}},
+    // cliff readings over the table, and past the edge
+    1000, 40,
+    // time of flight sensor on the front, ranges up to 2m
+    30.0f, 2000,
+    // a white target at 100mm (see defaultTofConfig)
+    2000, 100,
+    // about 3.9V
+    2853
+};
+
+/// The default world: a table of 600 by 400mm, with a box near one end
+const World defaultWorld =
+{
+    600.0f, 400.0f,
+    {{450.0f, 150.0f, 500.0f, 250.0f, 1.0f}},
+    1
+};
+
+/// The time of flight status when there is no target in range
+static constexpr uint8_t tofNoTarget = 2;
+
+/// The SPADs enabled for the time of flight ranging (8.8 fixed point)
+static constexpr uint16_t tofSpads = 16 << 8;
+
+
+/** The distance from a point to a box
+    @param box the box
+    @param x the point (in mm)
+    @param y the point (in mm)
+    @return the distance (in mm), 0 if the point is in the box
+*/
+static float distance(const Box& box, float x, float y)
+{
+    float dx = x < box.minX ? box.minX - x : x > box.maxX ? x - box.maxX : 0;
+    float dy = y < box.minY ? box.minY - y : y > box.maxY ? y - box.maxY : 0;
+    return sqrtf(dx*dx + dy*dy);
+}
+
+
+/** Create the emulator, with the robot in the middle of the table
+    @param config the robot and its sensors
+    @param world the world to drive about
+*/
+BodyEmulator::BodyEmulator(const BodyConfig& config, const World& world)
+    : frame(B2H::ConstantFrame<MessageType::dataFrame>()), now_us(0), numFrames(0), numCommands(0)
+    , config(config), world(world), numPending(0)
+{
+    place({world.width_mm/2, world.depth_mm/2, 0});
+}
+
+
+/** Place the robot, at rest
+    @param pose where to put the robot
+*/
+void BodyEmulator::place(const Pose& pose)
+{
+    this->pose = pose;
+    blocked = false;
+    memset(motors, 0, sizeof(motors));
+    memset(power, 0, sizeof(power));
+    for (auto& motor : motors)
+        motor.changed_us = now_us;
+}
+
+
+/** Apply a motor command from the head board
+    @param frame the data frame from the head board
+*/
+void BodyEmulator::command(const H2BDataFrame& frame)
+{
+    memcpy(power, frame.motorPower, sizeof(power));
+    numCommands++;
+}
+
+
+/** Receive bytes from the head board, and apply the data frames in them
+    @param bytes the bytes received
+    @param size the number of bytes
+    @return the number of data frames applied
+*/
+size_t BodyEmulator::receive(const uint8_t* bytes, size_t size)
+{
+    size_t count = 0;
+    while (size)
+    {
+        // keep the newest bytes if there are more than there is room for
+        if (numPending == sizeof(pending))
+        {
+            memmove(pending, pending + H2B::recv_buffer_size, sizeof(pending) - H2B::recv_buffer_size);
+            numPending -= H2B::recv_buffer_size;
+        }
+        auto num = size < sizeof(pending) - numPending ? size : sizeof(pending) - numPending;
+        memcpy(pending + numPending, bytes, num);
+        numPending += num;
+        bytes += num;
+        size  -= num;
+
+        // apply the data frames
+        const uint8_t* ptr = pending;
+        const uint8_t* end = pending + numPending;
+        for (;;)
+        {
+            MessageType message_type;
+            size_t payload_size;
+            ptr = H2B::FindMessage(ptr, end - ptr, message_type, payload_size);
+            if ((int) message_type == -1)
+                break;
+            if (message_type == MessageType::dataFrame)
+            {
+                H2BDataFrame data;
+                memcpy(&data, ptr + payload_ofs, sizeof(data));
+                command(data);
+                count++;
+            }
+            ptr += payload_ofs + payload_size + 4;
+        }
+        numPending = end - ptr;
+        memmove(pending, ptr, numPending);
+    }
+    return count;
+}
+
+
+/** Advance the motors and the robot
+    @param dt the time step (in seconds)
+*/
+void BodyEmulator::integrate(float dt)
+{
+    double moved[MOTOR_COUNT];
+    for (int idx = 0; idx < MOTOR_COUNT; idx++)
+    {
+        auto& model = config.motor[idx];
+        auto& motor = motors[idx];
+
+        // the speed approaches that of the duty cycle; below the dead band
+        // the motor coasts to a stop
+        int16_t duty = power[idx] >= model.deadband || power[idx] <= -model.deadband ? power[idx] : 0;
+        float target = duty * model.maxSpeed / 32767.0f;
+        motor.speed += (target - motor.speed) * (dt < model.timeConstant_s ? dt / model.timeConstant_s : 1.0f);
+
+        auto position = motor.position + motor.speed * dt;
+        if (model.minPosition != model.maxPosition && (position < model.minPosition || position > model.maxPosition))
+        {
+            // at the hard stop
+            position = position < model.minPosition ? model.minPosition : model.maxPosition;
+            motor.speed = 0;
+        }
+        moved[idx] = position - motor.position;
+        motor.position = position;
+    }
+
+    // the wheels move the robot: the mid-point of the arc
+    float left  = (float)(moved[(int) Motor::frontLeft ] / config.ticksPerMm);
+    float right = (float)(moved[(int) Motor::frontRight] / config.ticksPerMm);
+    float turn  = (right - left) / config.wheelBase_mm;
+    float forward = (left + right) / 2;
+    float heading = pose.heading + turn / 2;
+    float x = pose.x_mm + forward * cosf(heading);
+    float y = pose.y_mm + forward * sinf(heading);
+
+    // a move further into a box is blocked, and the wheels stall
+    blocked = false;
+    for (size_t idx = 0; idx < world.numBoxes; idx++)
+    {
+        auto& box = world.boxes[idx];
+        float after = distance(box, x, y);
+        if (after < config.radius_mm && after < distance(box, pose.x_mm, pose.y_mm))
+            blocked = true;
+    }
+    if (blocked)
+    {
+        for (auto idx : {Motor::frontLeft, Motor::frontRight})
+        {
+            motors[(int) idx].position -= moved[(int) idx];
+            motors[(int) idx].speed = 0;
+        }
+        return;
+    }
+    pose = {x, y, remainderf(pose.heading + turn, 2*3.14159265358979323846f)};
+}
+
+
+/** Read a cliff sensor
+    @param sensor the sensor
+    @return the reading
+*/
+uint16_t BodyEmulator::cliff(int sensor) const
+{
+    float c = cosf(pose.heading), s = sinf(pose.heading);
+    float forward = config.cliffPosition_mm[sensor][0], left = config.cliffPosition_mm[sensor][1];
+    float x = pose.x_mm + forward*c - left*s;
+    float y = pose.y_mm + forward*s + left*c;
+    bool onTable = x >= 0 && x <= world.width_mm && y >= 0 && y <= world.depth_mm;
+    return onTable ? config.cliffFloor : config.cliffDrop;
+}
+
+
+/** Range the time of flight sensor
+    @param data the data frame to fill in
+*/
+void BodyEmulator::range(B2HDataFrame& data) const
+{
+    // cast a ray ahead of the sensor at each box: where it enters the slabs
+    float dx = cosf(pose.heading), dy = sinf(pose.heading);
+    float x = pose.x_mm + config.tofOffset_mm*dx, y = pose.y_mm + config.tofOffset_mm*dy;
+    float nearest = config.tofMaxRange_mm, reflectivity = 0;
+    for (size_t idx = 0; idx < world.numBoxes; idx++)
+    {
+        auto& box = world.boxes[idx];
+        float enter = 0, leave = nearest;
+        const float origin[2] = {x, y}, direction[2] = {dx, dy};
+        const float lo[2] = {box.minX, box.minY}, hi[2] = {box.maxX, box.maxY};
+        for (int axis = 0; axis < 2 && enter <= leave; axis++)
+        {
+            if (direction[axis] == 0)
+            {
+                if (origin[axis] < lo[axis] || origin[axis] > hi[axis])
+                    leave = -1;
+                continue;
+            }
+            float t0 = (lo[axis] - origin[axis]) / direction[axis];
+            float t1 = (hi[axis] - origin[axis]) / direction[axis];
+            if (t0 > t1)
+            {
+                float t = t0;
+                t0 = t1;
+                t1 = t;
+            }
+            enter = t0 > enter ? t0 : enter;
+            leave = t1 < leave ? t1 : leave;
+        }
+        if (enter <= leave && enter < nearest)
+        {
+            nearest = enter;
+            reflectivity = box.reflectivity;
+        }
+    }
+
+    data.prox_SPADCount    = tofSpads;
+    data.prox_sampleCount  = 32;
+    data.prox_ambient      = 10;
+    if (reflectivity <= 0)
+    {
+        data.prox_status   = tofNoTarget;
+        return;
+    }
+
+    // the signal falls off with the square of the range (see TofReconstruction)
+    float range = nearest > 1 ? nearest : 1;
+    float ratio = config.tofRefRange_mm / range;
+    float perSpad = config.tofRefSignalPerSpad_kcps * reflectivity * ratio * ratio;
+    float rate = perSpad * tofSpads / 2000;
+    data.prox_status          = 0;
+    data.prox_sigma_mm        = 5;
+    data.prox_range_mm        = (uint16_t) lroundf(nearest);
+    data.prox_signalRate_mcps = rate < 0xFFFF ? (uint16_t) lroundf(rate) : 0xFFFF;
+}
+
+
+/// Advance the simulation by one frame period, and build the frame to send
+/// to the head board
+void BodyEmulator::step()
+{
+    const float dt = B2H_FRAME_PERIOD_US * 1.0e-6f / EMULATOR_SUBSTEPS;
+    for (int idx = 0; idx < EMULATOR_SUBSTEPS; idx++)
+        integrate(dt);
+    now_us += B2H_FRAME_PERIOD_US;
+
+    B2HDataFrame data;
+    memset(&data, 0, sizeof(data));
+    data.sequenceNumber = numFrames++;
+    data.sensorsOn = 1;
+    for (int idx = 0; idx < MOTOR_COUNT; idx++)
+    {
+        auto& motor = motors[idx];
+        auto position = (int32_t) lround(motor.position);
+        if (position != motor.reported)
+            motor.changed_us = now_us;
+        auto& state = data.motor[idx];
+        state.position = position;
+        state.delta    = position - motor.reported;
+        auto since = now_us - motor.changed_us;
+        state.time     = since < UINT32_MAX ? (uint32_t) since : UINT32_MAX;
+        motor.reported = position;
+    }
+    data.liftEncoderChanged = data.motor[(int) Motor::backLeft ].delta != 0;
+    data.headEncoderChanged = data.motor[(int) Motor::backRight].delta != 0;
+    for (int sensor = 0; sensor < 4; sensor++)
+        data.cliffSense[sensor] = cliff(sensor);
+    range(data);
+    data.battery_volt = config.battery_volt;
+
+    // the payload and its CRC
+    auto payload = frame.data() + payload_ofs;
+    memcpy(payload, &data, sizeof(data));
+    uint32_t crc = crc32(CRC32_INITIAL, payload, sizeof(data));
+    for (int idx = 0; idx < 4; idx++)
+        payload[sizeof(data) + idx] = (uint8_t)(crc >> (8*idx));
+}
+
+}
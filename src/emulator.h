@@ -0,0 +1,243 @@
+/* Closed-loop emulation of the body board
+   Copyright 2024 Randall Maas
+*//**@file
+    @brief Closed-loop emulation of the body board.
+
+    The emulator stands in for the body board, so that the head board's
+    control loops and the bridge can be run, and timed, on a host.  It takes
+    the data frames from the head board (the motor commands), simulates the
+    motors, and sends data frames back at the body board's cadence (one each
+    B2H_FRAME_PERIOD_US, about 195 frames/s):
+
+    - Each motor (the wheels, lift and head) is a first order system: the
+      speed approaches the commanded duty cycle times the motor's free
+      running speed, with the motor's time constant.  A duty below the
+      dead band doesn't overcome the friction, and the motor coasts to a
+      stop.  The lift and head stop at their hard stops.
+    - The wheels move the robot (a circle) about a 2D world: a table top,
+      with boxes on it.  A robot driving into a box stops; its wheels stall.
+    - The encoders report the position, the change since the last frame,
+      and the time since the encoder last changed.
+    - The cliff sensors read the floor, or the drop past the edge of the
+      table.  The time of flight sensor ranges the nearest box ahead.
+
+    The emulator has no clock of its own: each step() advances the
+    simulation by one frame period, so it runs as fast as it is stepped.
+    The simulation is integrated in EMULATOR_SUBSTEPS steps per frame.
+
+    @code
+    BodyEmulator body;
+    for (;;)
+    {
+        body.receive(bytesFromTheHead, numBytes);
+        body.step();
+        SendFrame(toTheHead, body.frame);
+    }
+    @endcode
+
+    The sensors are plausible, not calibrated: the readings are rough, and
+    the microphone samples are silence.
+*/
+#pragma once
+#include <inttypes.h>
+#include <stddef.h>
+#include <array>
+#include "spine.h"
+#include "stall.h"
+
+namespace Spine {
+
+/// The dynamics of a motor
+struct MotorModel
+{
+    /// The speed at full duty, with no load (in encoder ticks/second)
+    float maxSpeed;
+
+    /// The mechanical time constant (in seconds)
+    float timeConstant_s;
+
+    /// The smallest duty cycle (magnitude) that moves the motor
+    int16_t deadband;
+
+    /// The encoder positions of the hard stops; the wheels have none (equal)
+    int32_t minPosition, maxPosition;
+};
+
+/// The robot and its sensors
+struct BodyConfig
+{
+    /// The dynamics of each motor: left wheel, right wheel, lift, head
+    MotorModel motor[MOTOR_COUNT];
+
+    /// The encoder ticks per mm that a wheel travels
+    float ticksPerMm;
+
+    /// The distance between the treads (in mm)
+    float wheelBase_mm;
+
+    /// The radius of the robot's footprint (in mm), for the collisions
+    float radius_mm;
+
+    /// The position of each cliff sensor (in mm), forward and left of the
+    /// center of the robot: front left, front right, back left, back right
+    float cliffPosition_mm[4][2];
+
+    /// The cliff sensor reading over the table, and past the edge of it
+    uint16_t cliffFloor, cliffDrop;
+
+    /// The distance of the time of flight sensor forward of the center (in mm)
+    float tofOffset_mm;
+
+    /// The longest range of the time of flight sensor (in mm)
+    uint16_t tofMaxRange_mm;
+
+    /// The signal per SPAD (in kilo-counts per second per SPAD) from a white
+    /// target at the reference range (in mm) (see TofConfig)
+    uint16_t tofRefSignalPerSpad_kcps, tofRefRange_mm;
+
+    /// The reported battery voltage (in the units of the data frame)
+    int16_t battery_volt;
+};
+
+/// The default robot.  It agrees with defaultStallConfig, defaultHeadConfig,
+/// defaultLiftConfig and defaultTofConfig, so its frames aren't flagged by
+/// the modules that use them.
+extern const BodyConfig defaultBodyConfig;
+
+
+/// A box on the table, aligned with the axes (in mm)
+struct Box
+{
+    float minX, minY, maxX, maxY;
+
+    /// The reflectivity, relative to a white target
+    float reflectivity;
+};
+
+/// The world the robot drives about: a table top, with boxes on it
+struct World
+{
+    /// The size of the table (in mm), from (0,0)
+    float width_mm, depth_mm;
+
+    /// The boxes on the table
+    Box boxes[EMULATOR_MAX_BOXES];
+    uint8_t numBoxes;
+};
+
+/// The default world: a table of 600 by 400mm, with a box near one end
+extern const World defaultWorld;
+
+
+/// Where the robot is on the table
+struct Pose
+{
+    /// The position of the center of the robot (in mm)
+    float x_mm, y_mm;
+
+    /// The direction the robot faces (in radians, anti-clockwise from +x)
+    float heading;
+};
+
+
+/** Emulate the body board.
+*/
+class BodyEmulator
+{
+public:
+    /// The size of the frames sent to the head board
+    static constexpr size_t frameSize = payload_ofs + sizeof(B2HDataFrame) + 4;
+
+    /** Create the emulator, with the robot in the middle of the table
+        @param config the robot and its sensors
+        @param world the world to drive about
+    */
+    BodyEmulator(const BodyConfig& config = defaultBodyConfig, const World& world = defaultWorld);
+
+    /** Place the robot, at rest
+        @param pose where to put the robot
+    */
+    void place(const Pose& pose);
+
+    /** Apply a motor command from the head board
+        @param frame the data frame from the head board
+    */
+    void command(const H2BDataFrame& frame);
+
+    /** Receive bytes from the head board, and apply the data frames in them
+        @param bytes the bytes received
+        @param size the number of bytes
+        @return the number of data frames applied
+    */
+    size_t receive(const uint8_t* bytes, size_t size);
+
+    /// Advance the simulation by one frame period, and build the frame
+    /// to send to the head board
+    void step();
+
+    /// The frame to send to the head board (the header, payload and CRC)
+    std::array<uint8_t, frameSize> frame;
+
+    /// The simulated time (in microseconds)
+    uint64_t now_us;
+
+    /// Where the robot is
+    Pose pose;
+
+    /// The robot is pushing against a box
+    bool blocked;
+
+    /// The number of frames built, and the number of commands applied
+    uint32_t numFrames, numCommands;
+
+private:
+    /// The state of a motor
+    struct Actuator
+    {
+        /// The encoder position (in ticks, with the fraction)
+        double position;
+
+        /// The speed (in ticks/second)
+        float speed;
+
+        /// The encoder position reported in the last frame
+        int32_t reported;
+
+        /// When the encoder last changed (in microseconds)
+        uint64_t changed_us;
+    };
+
+    /** Advance the motors and the robot
+        @param dt the time step (in seconds)
+    */
+    void integrate(float dt);
+
+    /** Read a cliff sensor
+        @param sensor the sensor
+        @return the reading
+    */
+    uint16_t cliff(int sensor) const;
+
+    /** Range the time of flight sensor
+        @param data the data frame to fill in
+    */
+    void range(B2HDataFrame& data) const;
+
+    /// The robot and its sensors
+    BodyConfig config;
+
+    /// The world
+    World world;
+
+    /// The state of each motor
+    Actuator motors[MOTOR_COUNT];
+
+    /// The commanded duty cycle of each motor
+    int16_t power[MOTOR_COUNT];
+
+    /// The bytes from the head board not yet framed
+    uint8_t pending[2*H2B::recv_buffer_size];
+    size_t numPending;
+};
+
+}
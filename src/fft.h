@@ -0,0 +1,167 @@
+/* Real fast Fourier transform, for the audio processing
+   Copyright 2024 Randall Maas
+*//**@file
+    @brief Real fast Fourier transform, for the audio processing.
+
+    The transform of N real samples is done as a complex transform of N/2
+    points (the even samples as the real part, the odd samples as the
+    imaginary part), then split into the spectrum of the real signal.  This
+    takes about half the work of a complex transform of N points.
+
+    The spectrum is the N/2+1 bins from 0 Hz to the Nyquist frequency, each
+    a (real, imaginary) pair:
+
+    @code
+    RealFft<512> fft;
+    float spectrum[512+2];
+    fft.forward(samples, spectrum);
+    float power = spectrum[2*k]*spectrum[2*k] + spectrum[2*k+1]*spectrum[2*k+1];
+    @endcode
+
+    The inverse takes the spectrum back to the N samples:
+
+    @code
+    fft.inverse(spectrum, samples);
+    @endcode
+
+    The twiddle factors and the bit reversal order are computed once, when
+    the transform is created.
+*/
+#pragma once
+#include <inttypes.h>
+#include <stddef.h>
+#include <math.h>
+
+namespace Spine {
+
+/** The transform of N real samples
+    @tparam N the number of samples; a power of 2, at least 4
+*/
+template<size_t N>
+class RealFft
+{
+public:
+    static_assert(N >= 4 && !(N & (N-1)), "The size of the transform must be a power of 2");
+
+    /// The number of bins in the spectrum
+    static constexpr size_t numBins = N/2 + 1;
+
+    RealFft()
+    {
+        for (size_t idx = 0; idx < N/2; idx++)
+        {
+            double angle = -2*3.14159265358979323846*idx / N;
+            cosTable[idx] = (float) cos(angle);
+            sinTable[idx] = (float) sin(angle);
+        }
+
+        // the bit reversed order of the N/2 points
+        size_t bits = 0;
+        while ((1u << bits) < N/2)
+            bits++;
+        for (size_t idx = 0; idx < N/2; idx++)
+        {
+            size_t reversed = 0;
+            for (size_t bit = 0; bit < bits; bit++)
+                if (idx & (1u << bit))
+                    reversed |= 1u << (bits-1-bit);
+            reverse[idx] = (uint16_t) reversed;
+        }
+    }
+
+    /** Transform the samples to their spectrum
+        @param in the N samples
+        @param spectrum the numBins bins, as (real, imaginary) pairs
+    */
+    void forward(const float* in, float* spectrum) const
+    {
+        // pack the real samples as N/2 complex points, in bit reversed order
+        float re[N/2], im[N/2];
+        for (size_t idx = 0; idx < N/2; idx++)
+        {
+            re[reverse[idx]] = in[2*idx];
+            im[reverse[idx]] = in[2*idx+1];
+        }
+        transform(re, im);
+
+        // split into the spectrum of the real samples
+        spectrum[0] = re[0] + im[0];
+        spectrum[1] = 0;
+        spectrum[N] = re[0] - im[0];
+        spectrum[N+1] = 0;
+        for (size_t k = 1; k < N/2; k++)
+        {
+            // the even and odd sample parts of bin k
+            float evenRe = 0.5f*(re[k] + re[N/2-k]), evenIm = 0.5f*(im[k] - im[N/2-k]);
+            float oddRe  = 0.5f*(im[k] + im[N/2-k]), oddIm  = 0.5f*(re[N/2-k] - re[k]);
+            float c = cosTable[k], s = sinTable[k];
+            spectrum[2*k]   = evenRe + c*oddRe - s*oddIm;
+            spectrum[2*k+1] = evenIm + c*oddIm + s*oddRe;
+        }
+    }
+
+    /** Transform the spectrum back to the samples
+        @param spectrum the numBins bins, as (real, imaginary) pairs
+        @param out the N samples
+    */
+    void inverse(const float* spectrum, float* out) const
+    {
+        // merge the spectrum into the N/2 point spectrum of the even samples
+        // (real part) and odd samples (imaginary part).  The inverse
+        // transform is the conjugate of the transform of the conjugate.
+        float re[N/2], im[N/2];
+        for (size_t k = 0; k < N/2; k++)
+        {
+            float xRe = spectrum[2*k], xIm = spectrum[2*k+1];
+            float yRe = spectrum[N-2*k], yIm = -spectrum[N-2*k+1];
+            float evenRe = 0.5f*(xRe + yRe), evenIm = 0.5f*(xIm + yIm);
+            float dRe = 0.5f*(xRe - yRe), dIm = 0.5f*(xIm - yIm);
+            float c = cosTable[k], s = sinTable[k];
+            float oddRe = dRe*c + dIm*s, oddIm = dIm*c - dRe*s;
+            re[reverse[k]] = evenRe - oddIm;
+            im[reverse[k]] = -(evenIm + oddRe);
+        }
+        transform(re, im);
+
+        const float scale = 2.0f / N;
+        for (size_t idx = 0; idx < N/2; idx++)
+        {
+            out[2*idx]   = re[idx] * scale;
+            out[2*idx+1] = -im[idx] * scale;
+        }
+    }
+
+private:
+    /** The complex transform of N/2 points, in place
+        @param re the real parts, in bit reversed order
+        @param im the imaginary parts, in bit reversed order
+    */
+    void transform(float* re, float* im) const
+    {
+        for (size_t size = 2; size <= N/2; size *= 2)
+        {
+            // the twiddle factors of this size are every N/size'th of the table
+            size_t stride = N / size;
+            for (size_t start = 0; start < N/2; start += size)
+                for (size_t idx = 0; idx < size/2; idx++)
+                {
+                    float c = cosTable[idx*stride], s = sinTable[idx*stride];
+                    size_t a = start + idx, b = a + size/2;
+                    float tr = re[b]*c - im[b]*s;
+                    float ti = re[b]*s + im[b]*c;
+                    re[b] = re[a] - tr;
+                    im[b] = im[a] - ti;
+                    re[a] += tr;
+                    im[a] += ti;
+                }
+        }
+    }
+
+    /// The twiddle factors, e^(-2 pi i k/N)
+    float cosTable[N/2], sinTable[N/2];
+
+    /// The bit reversed order of the N/2 points
+    uint16_t reverse[N/2];
+};
+
+}
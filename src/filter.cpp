@@ -0,0 +1,640 @@
+/* Filter expressions, to select frames
+   Copyright 2024 Randall Maas
+*//**@file
+    @brief Filter expressions, to select frames.
+
+    This file contains the compiler, a recursive descent parser that emits the
+    program as it goes, and the evaluators: over a frame, and over the
+    summary of a block of a capture.
+*/
+#include <Arduino.h>
+#include <stdlib.h>
+#include <string.h>
+#include "filter.h"
+#include "capture.h"
+
+namespace Spine {
+
+/// The size of an array
+#define COUNT_OF(array) (sizeof(array)/sizeof(array[0]))
+
+
+/** Apply an operation to its operands
+    @param op the operation
+    @param a the first operand (the only one of a unary operation)
+    @param b the second operand
+    @return the result; the comparisons and logical operations give 0 or 1
+*/
+static inline int64_t apply(FilterOp op, int64_t a, int64_t b)
+{
+    switch (op)
+    {
+        case FilterOp::neg : return -a;
+        case FilterOp::lnot: return !a;
+        case FilterOp::bnot: return ~a;
+        case FilterOp::add : return a + b;
+        case FilterOp::sub : return a - b;
+        case FilterOp::band: return a & b;
+        case FilterOp::bor : return a | b;
+        case FilterOp::eq  : return a == b;
+        case FilterOp::ne  : return a != b;
+        case FilterOp::lt  : return a < b;
+        case FilterOp::le  : return a <= b;
+        case FilterOp::gt  : return a > b;
+        case FilterOp::ge  : return a >= b;
+        // both sides have been evaluated; combine their truth values
+        case FilterOp::land: return (a != 0) & (b != 0);
+        case FilterOp::lor : return (a != 0) | (b != 0);
+        default: return 0;
+    }
+}
+
+
+/** Read a field of the payload
+    @param instruction the field instruction
+    @param payload the payload
+    @return the value of the field
+
+    Unlike ReadField(), the unsigned 32-bit fields are read as unsigned.
+*/
+static inline int64_t load(const FilterInstruction& instruction, const uint8_t* payload)
+{
+    // assumes alignment, little endian host
+    auto ptr = payload + instruction.offset;
+    int64_t value;
+    switch (instruction.type)
+    {
+        default:
+        case FieldType::u8 : value = *ptr; break;
+        case FieldType::i8 : value = *(const int8_t*) ptr; break;
+        case FieldType::u16: value = *(const uint16_t*) ptr; break;
+        case FieldType::i16: value = *(const int16_t*) ptr; break;
+        case FieldType::u32: value = *(const uint32_t*) ptr; break;
+        case FieldType::i32: value = *(const int32_t*) ptr; break;
+    }
+    if (instruction.width)
+        value = (int64_t)(((uint64_t) value >> instruction.bit) & ((1ULL << instruction.width) - 1));
+    return value;
+}
+
+
+Filter::Filter()
+: error(nullptr)
+, errorPos(0)
+, numCode(0)
+, payloadSize(0)
+, forB2H(true)
+, fields(nullptr)
+, numFields(0)
+, start(nullptr)
+, ptr(nullptr)
+{
+}
+
+
+/** Compile a filter expression
+    @param expression the expression
+    @param b2h true to filter the frames from the body board, false for
+           the head board (this picks the fields)
+    @return true if the expression was compiled, false on an error (see
+            error and errorPos)
+*/
+bool Filter::compile(const char* expression, bool b2h)
+{
+    numCode     = 0;
+    payloadSize = 0;
+    error       = nullptr;
+    errorPos    = 0;
+    forB2H      = b2h;
+    fields      = b2h ? b2hDataFrameFields : h2bDataFrameFields;
+    numFields   = b2h ? COUNT_OF(b2hDataFrameFields) : COUNT_OF(h2bDataFrameFields);
+    start       = ptr = expression;
+
+    // an empty expression matches every frame
+    while (*ptr == ' ' || *ptr == '\t')
+        ptr++;
+    if (!*ptr)
+        return true;
+
+    if (!parseOr())
+        return false;
+    while (*ptr == ' ' || *ptr == '\t')
+        ptr++;
+    if (*ptr)
+        return fail("expected an operator");
+    return true;
+}
+
+
+/** Record an error
+    @param message the error
+    @return false
+*/
+bool Filter::fail(const char* message)
+{
+    error       = message;
+    errorPos    = ptr - start;
+    numCode     = 0;
+    payloadSize = 0;
+    return false;
+}
+
+
+/** Skip the spaces, and check for the token
+    @param token the token
+    @return true if the token is next (and is consumed), false if not
+*/
+bool Filter::accept(const char* token)
+{
+    while (*ptr == ' ' || *ptr == '\t')
+        ptr++;
+    auto length = strlen(token);
+    if (strncmp(ptr, token, length))
+        return false;
+    // not the start of a longer operator: & of &&, | of ||, ! of !=
+    if (length == 1 && ((token[0] == '&' || token[0] == '|') && ptr[1] == token[0]))
+        return false;
+    if (length == 1 && token[0] == '!' && ptr[1] == '=')
+        return false;
+    ptr += length;
+    return true;
+}
+
+
+/** Append an instruction, folding the constants
+    @param op the operation
+    @param value the constant (for FilterOp::constant)
+    @param field the field (for FilterOp::field)
+    @param index the index into the field's array
+    @return true on success, false if the program is too long
+*/
+bool Filter::emit(FilterOp op, int64_t value, const FieldInfo* field, size_t index)
+{
+    // fold a unary operation on a constant
+    bool unary = op == FilterOp::neg || op == FilterOp::lnot || op == FilterOp::bnot;
+    if (unary && numCode >= 1 && code[numCode-1].op == FilterOp::constant)
+    {
+        code[numCode-1].value = apply(op, code[numCode-1].value, 0);
+        return true;
+    }
+
+    // fold a binary operation on two constants
+    bool binary = op >= FilterOp::add;
+    if (binary && numCode >= 2 && code[numCode-1].op == FilterOp::constant && code[numCode-2].op == FilterOp::constant)
+    {
+        code[numCode-2].value = apply(op, code[numCode-2].value, code[numCode-1].value);
+        numCode--;
+        return true;
+    }
+
+    if (numCode >= FILTER_MAX_CODE)
+        return fail("the expression is too long");
+
+    auto& instruction = code[numCode++];
+    instruction = {op, FieldType::u8, 0, 0, 0, 0, value};
+    if (field)
+    {
+        instruction.field  = (uint8_t)(field - fields);
+        instruction.type   = field->type;
+        instruction.width  = field->width;
+        instruction.bit    = field->bit;
+        instruction.offset = (uint16_t)(field->offset + index * field->stride);
+
+        // the payload must reach the end of the field
+        auto end = instruction.offset + fieldSize(field->type);
+        if (end > payloadSize)
+            payloadSize = (uint16_t) end;
+    }
+    return true;
+}
+
+
+/// Parse the || operations
+bool Filter::parseOr()
+{
+    if (!parseAnd())
+        return false;
+    while (accept("||"))
+        if (!parseAnd() || !emit(FilterOp::lor))
+            return false;
+    return true;
+}
+
+
+/// Parse the && operations
+bool Filter::parseAnd()
+{
+    if (!parseCompare())
+        return false;
+    while (accept("&&"))
+        if (!parseCompare() || !emit(FilterOp::land))
+            return false;
+    return true;
+}
+
+
+/// Parse a comparison
+bool Filter::parseCompare()
+{
+    if (!parseBitOr())
+        return false;
+
+    // the longer operators are checked first
+    static const struct { const char* token; FilterOp op; } compares[] =
+    {
+        {"==", FilterOp::eq}, {"!=", FilterOp::ne}, {"<=", FilterOp::le},
+        {">=", FilterOp::ge}, {"<" , FilterOp::lt}, {">" , FilterOp::gt},
+    };
+    for (auto& compare : compares)
+        if (accept(compare.token))
+            return parseBitOr() && emit(compare.op);
+    return true;
+}
+
+
+/// Parse the | operations
+bool Filter::parseBitOr()
+{
+    if (!parseBitAnd())
+        return false;
+    while (accept("|"))
+        if (!parseBitAnd() || !emit(FilterOp::bor))
+            return false;
+    return true;
+}
+
+
+/// Parse the & operations
+bool Filter::parseBitAnd()
+{
+    if (!parseSum())
+        return false;
+    while (accept("&"))
+        if (!parseSum() || !emit(FilterOp::band))
+            return false;
+    return true;
+}
+
+
+/// Parse the + and - operations
+bool Filter::parseSum()
+{
+    if (!parseUnary())
+        return false;
+    for (;;)
+    {
+        FilterOp op;
+        if (accept("+"))
+            op = FilterOp::add;
+        else if (accept("-"))
+            op = FilterOp::sub;
+        else
+            return true;
+        if (!parseUnary() || !emit(op))
+            return false;
+    }
+}
+
+
+/// Parse the unary operations
+bool Filter::parseUnary()
+{
+    if (accept("!"))
+        return parseUnary() && emit(FilterOp::lnot);
+    if (accept("-"))
+        return parseUnary() && emit(FilterOp::neg);
+    if (accept("~"))
+        return parseUnary() && emit(FilterOp::bnot);
+    return parsePrimary();
+}
+
+
+/// Parse a number, a field, the message type, or a parenthesized expression
+bool Filter::parsePrimary()
+{
+    if (accept("("))
+    {
+        if (!parseOr())
+            return false;
+        if (!accept(")"))
+            return fail("expected )");
+        return true;
+    }
+
+    // a number
+    if (*ptr >= '0' && *ptr <= '9')
+    {
+        char* end;
+        bool hex = ptr[0] == '0' && (ptr[1] == 'x' || ptr[1] == 'X');
+        int64_t value = hex ? strtoll(ptr+2, &end, 16) : strtoll(ptr, &end, 10);
+        if (hex && end == ptr+2)
+            return fail("expected a hexadecimal number");
+        ptr = end;
+        return emit(FilterOp::constant, value);
+    }
+
+    // a name
+    auto name = ptr;
+    while ((*ptr >= 'a' && *ptr <= 'z') || (*ptr >= 'A' && *ptr <= 'Z') || *ptr == '_' || *ptr == '.'
+           || (ptr > name && *ptr >= '0' && *ptr <= '9'))
+        ptr++;
+    size_t length = ptr - name;
+    if (!length)
+        return fail("expected a number or a field");
+
+    // the message type
+    if (length == 4 && !strncmp(name, "type", 4))
+        return emit(FilterOp::type);
+
+    // a field of the data frame
+    auto field = FindField(fields, numFields, name, length);
+    if (field)
+    {
+        size_t index = 0;
+        if (accept("["))
+        {
+            while (*ptr == ' ' || *ptr == '\t')
+                ptr++;
+            char* end;
+            index = strtoul(ptr, &end, 10);
+            if (end == ptr)
+                return fail("expected an index");
+            if (index >= field->count)
+                return fail("the index is past the end of the field");
+            ptr = end;
+            if (!accept("]"))
+                return fail("expected ]");
+        }
+        return emit(FilterOp::field, 0, field, index);
+    }
+
+    // the name of a message type
+    for (auto message_type : messageTypes)
+    {
+        auto messageName = MessageName(message_type);
+        if (messageName && !strncmp(messageName, name, length) && !messageName[length])
+            return emit(FilterOp::constant, (int64_t) message_type);
+    }
+
+    ptr = name;
+    return fail("unknown field");
+}
+
+
+/** Check a frame against the filter
+    @param message_type the type of the message
+    @param payload the payload
+    @param payload_size the size of the payload
+    @return true if the frame matches; an empty filter matches every frame
+*/
+bool Filter::match(MessageType message_type, const uint8_t* payload, size_t payload_size) const
+{
+    if (!numCode)
+        return true;
+
+    // only the data frames have the fields; in the other frames the fields
+    // are absent, as is any value computed from one
+    bool missing = payloadSize && (message_type != MessageType::dataFrame || payload_size < payloadSize);
+
+    int64_t stack[FILTER_MAX_CODE];
+    bool absent[FILTER_MAX_CODE];
+    size_t top = 0;
+    for (size_t idx = 0; idx < numCode; idx++)
+    {
+        auto& instruction = code[idx];
+        switch (instruction.op)
+        {
+            case FilterOp::constant:
+                absent[top] = false;
+                stack[top++] = instruction.value;
+                break;
+            case FilterOp::field:
+                absent[top] = missing;
+                stack[top++] = missing ? 0 : load(instruction, payload);
+                break;
+            case FilterOp::type:
+                absent[top] = false;
+                stack[top++] = (int64_t) message_type;
+                break;
+            case FilterOp::neg:
+            case FilterOp::lnot:
+            case FilterOp::bnot:
+                stack[top-1] = apply(instruction.op, stack[top-1], 0);
+                break;
+            case FilterOp::land:
+            case FilterOp::lor:
+                // an absent term is false
+                top--;
+                stack[top-1] = apply(instruction.op, absent[top-1] ? 0 : stack[top-1], absent[top] ? 0 : stack[top]);
+                absent[top-1] = false;
+                break;
+            default:
+                top--;
+                stack[top-1] = apply(instruction.op, stack[top-1], stack[top]);
+                absent[top-1] |= absent[top];
+                break;
+        }
+    }
+    return stack[0] != 0 && !absent[0];
+}
+
+
+
+/// The range of values that part of an expression may have, over the frames
+/// of a block
+struct Range
+{
+    /// The range of the value, where it is present
+    int64_t lo, hi;
+
+    /// True if this is the message type
+    bool type;
+
+    /// True if the value may be present, and if it may be absent (computed
+    /// from a field in a frame that doesn't have the fields)
+    bool present, absent;
+};
+
+/// A value that may be anything
+static constexpr Range anything = {INT64_MIN, INT64_MAX, false, true, false};
+
+/// A value that is always absent
+static constexpr Range nothing = {0, 0, false, false, true};
+
+/** The range of a truth value
+    @param canBeFalse true if it may be false
+    @param canBeTrue true if it may be true
+    @return the range
+*/
+static inline Range truth(bool canBeFalse, bool canBeTrue)
+{
+    return {canBeFalse ? 0 : 1, canBeTrue ? 1 : 0, false, true, false};
+}
+
+/// True if the value may be true (present, and not 0)
+static inline bool canBeTrue(const Range& range) { return range.present && (range.lo != 0 || range.hi != 0); }
+
+/// True if the value may be false (absent, or 0)
+static inline bool canBeFalse(const Range& range) { return range.absent || (range.lo <= 0 && range.hi >= 0); }
+
+/// True if the value is known
+static inline bool isConstant(const Range& range) { return range.lo == range.hi && !range.type && !range.absent; }
+
+/// True if the value has no bound
+static inline bool unbounded(const Range& range) { return range.lo == INT64_MIN || range.hi == INT64_MAX; }
+
+
+/** Compare the message type against a constant
+    @param op FilterOp::eq or FilterOp::ne
+    @param constant the message type compared against
+    @param types the message types in the block (see CaptureIndex)
+    @return the range of the comparison
+*/
+static Range compareType(FilterOp op, int64_t constant, uint32_t types)
+{
+    auto bit = TypeBit((MessageType) constant);
+    bool present = (types & bit) != 0;
+    bool only = types == bit;
+    return op == FilterOp::eq ? truth(!only, present) : truth(present, !only);
+}
+
+
+/** Apply an operation to the ranges of its present operands
+    @param op the operation, other than && and ||
+    @param a the range of the first operand (the only one of a unary operation)
+    @param b the range of the second operand
+    @param unary true if the operation is unary
+    @param types the message types in the block (see CaptureIndex)
+    @return the range of the result, where it is present
+*/
+static Range range(FilterOp op, Range a, Range b, bool unary, uint32_t types)
+{
+    // only the present values matter here
+    a.absent = b.absent = false;
+    if (isConstant(a) && (unary || isConstant(b)))
+    {
+        auto value = apply(op, a.lo, b.lo);
+        return {value, value, false, true, false};
+    }
+
+    switch (op)
+    {
+        case FilterOp::neg:
+            return unbounded(a) ? anything : Range{-a.hi, -a.lo, false, true, false};
+        case FilterOp::lnot:
+            return truth(canBeTrue(a), canBeFalse(a));
+        case FilterOp::add:
+            return unbounded(a) || unbounded(b) ? anything : Range{a.lo + b.lo, a.hi + b.hi, false, true, false};
+        case FilterOp::sub:
+            return unbounded(a) || unbounded(b) ? anything : Range{a.lo - b.hi, a.hi - b.lo, false, true, false};
+        case FilterOp::band:
+            // the bits of two positive values can't be more than either
+            if (a.lo >= 0 && b.lo >= 0)
+                return {0, a.hi < b.hi ? a.hi : b.hi, false, true, false};
+            return anything;
+        case FilterOp::eq:
+        case FilterOp::ne:
+            if (a.type && isConstant(b))
+                return compareType(op, b.lo, types);
+            if (b.type && isConstant(a))
+                return compareType(op, a.lo, types);
+            {
+                bool disjoint = a.hi < b.lo || b.hi < a.lo;
+                return op == FilterOp::eq ? truth(true, !disjoint) : truth(!disjoint, true);
+            }
+        case FilterOp::lt  : return truth(a.hi >= b.lo, a.lo <  b.hi);
+        case FilterOp::le  : return truth(a.hi >  b.lo, a.lo <= b.hi);
+        case FilterOp::gt  : return truth(a.lo <= b.hi, a.hi >  b.lo);
+        case FilterOp::ge  : return truth(a.lo <  b.hi, a.hi >= b.lo);
+        default:
+            return anything;
+    }
+}
+
+
+/** Apply an operation to the ranges of its operands
+    @param op the operation
+    @param a the range of the first operand (the only one of a unary operation)
+    @param b the range of the second operand
+    @param types the message types in the block (see CaptureIndex)
+    @return the range of the result
+*/
+static Range bound(FilterOp op, const Range& a, const Range& b, uint32_t types)
+{
+    // an absent term is false to && and ||
+    if (op == FilterOp::land)
+        return truth(canBeFalse(a) || canBeFalse(b), canBeTrue(a) && canBeTrue(b));
+    if (op == FilterOp::lor)
+        return truth(canBeFalse(a) && canBeFalse(b), canBeTrue(a) || canBeTrue(b));
+
+    // otherwise the result is absent if an operand is
+    bool unary = op == FilterOp::neg || op == FilterOp::lnot || op == FilterOp::bnot;
+    if (!a.present || (!unary && !b.present))
+        return nothing;
+    auto result = range(op, a, b, unary, types);
+    result.absent = a.absent || (!unary && b.absent);
+    return result;
+}
+
+
+/** Check if a frame in a block of a capture might match the filter
+    @param index the summary of the block
+    @return false if no frame in the block can match, true if one might
+*/
+bool Filter::mayMatch(const CaptureIndex& index) const
+{
+    // an empty filter matches every frame, from either board
+    if (!numCode)
+        return true;
+    auto types = index.types[forB2H ? 0 : 1];
+    if (!types)
+        return false;
+
+    // only the data frames have the fields; in the other frames the fields
+    // are absent
+    auto dataFrame = TypeBit(MessageType::dataFrame);
+    bool present = (types & dataFrame) != 0, absent = (types & ~dataFrame) != 0;
+
+    Range stack[FILTER_MAX_CODE];
+    size_t top = 0;
+    for (size_t idx = 0; idx < numCode; idx++)
+    {
+        auto& instruction = code[idx];
+        switch (instruction.op)
+        {
+            case FilterOp::constant:
+                stack[top++] = {instruction.value, instruction.value, false, true, false};
+                break;
+            case FilterOp::type:
+                stack[top++] = {INT64_MIN, INT64_MAX, true, true, false};
+                break;
+            case FilterOp::field:
+            {
+                // only the scalar fields from the body board are summarized
+                auto& field = b2hDataFrameFields[instruction.field];
+                if (!present)
+                    stack[top] = nothing;
+                else if (!forB2H || field.count != 1)
+                    stack[top] = anything;
+                else if (field.width)
+                    stack[top] = truth((index.flagsClear >> instruction.field) & 1, (index.flagsSet >> instruction.field) & 1);
+                else
+                    stack[top] = {index.min[instruction.field], index.max[instruction.field], false, true, false};
+                stack[top++].absent = absent;
+                break;
+            }
+            case FilterOp::neg:
+            case FilterOp::lnot:
+            case FilterOp::bnot:
+                stack[top-1] = bound(instruction.op, stack[top-1], stack[top-1], types);
+                break;
+            default:
+                top--;
+                stack[top-1] = bound(instruction.op, stack[top-1], stack[top], types);
+                break;
+        }
+    }
+    return canBeTrue(stack[0]);
+}
+
+}
@@ -0,0 +1,185 @@
+/* Filter expressions, to select frames
+   Copyright 2024 Randall Maas
+*//**@file
+    @brief Filter expressions, to select frames.
+
+    A filter selects frames with an expression over the fields of the payload,
+    such as:
+
+    @code
+    cliffSense[2] < 200 && onCharger == 0
+    type == ack || (type == dataFrame && i2cFault != 0)
+    @endcode
+
+    The fields are named as in the field tables (see schema.h): a field, an
+    element of an array ("cliffSense[2]"; the first if there is no index), or
+    a member of an array of structs ("motor.delta[3]").  The message type is
+    "type", and the message names (dataFrame, ack, ...) are its values.  The
+    numbers are decimal or hexadecimal (0x...).
+
+    The operators, from the lowest precedence:
+
+    - ||
+    - &&
+    - == != < <= > >=
+    - |
+    - &
+    - + -
+    - ! - ~ (unary)
+
+    The expression is compiled once into a short program for a stack
+    machine.  The fields are resolved to their offset, type and bit when it is
+    compiled, and any part of the expression that doesn't depend on the frame
+    is folded into a constant.
+
+    Only the data frames have the fields.  In the other frames a field is
+    absent, as is any value computed from it; an absent value is false to &&
+    and ||, and to the filter as a whole.  So the second example above
+    matches the acks, and the data frames with an I2C fault.
+
+    Evaluating the program doesn't branch on the values: && and || evaluate
+    both sides and combine the truth values, so the time per frame depends
+    only on the length of the program.
+
+    The program can also be checked against the summary of a block of a
+    capture (see capture.h), with the range of each value in place of the
+    value, to tell if any frame in the block might match.
+*/
+#pragma once
+#include <inttypes.h>
+#include <stddef.h>
+#include "spine.h"
+#include "schema.h"
+
+namespace Spine {
+
+struct CaptureIndex;
+
+/// The operations of a filter program
+enum class FilterOp : uint8_t
+{
+    /// Push a constant
+    constant,
+    /// Push a field of the payload
+    field,
+    /// Push the message type
+    type,
+    /// The unary operations, on the top of the stack
+    neg, lnot, bnot,
+    /// The binary operations, on the top two of the stack
+    add, sub, band, bor, eq, ne, lt, le, gt, ge, land, lor
+};
+
+/// An instruction of a filter program
+struct FilterInstruction
+{
+    /// The operation
+    FilterOp op;
+
+    /// The type of the field
+    FieldType type;
+
+    /// The number of bits of a bit field, 0 if it isn't one
+    uint8_t width;
+
+    /// The lowest bit of a bit field
+    uint8_t bit;
+
+    /// The index of the field in the field table
+    uint8_t field;
+
+    /// The offset of the field in the payload
+    uint16_t offset;
+
+    /// The constant
+    int64_t value;
+};
+
+
+/** A compiled filter expression
+*/
+class Filter
+{
+public:
+    Filter();
+
+    /** Compile a filter expression
+        @param expression the expression
+        @param b2h true to filter the frames from the body board, false for
+               the head board (this picks the fields)
+        @return true if the expression was compiled, false on an error (see
+                error and errorPos)
+    */
+    bool compile(const char* expression, bool b2h = true);
+
+    /** Check a frame against the filter
+        @param message_type the type of the message
+        @param payload the payload
+        @param payload_size the size of the payload
+        @return true if the frame matches; an empty filter matches every frame
+    */
+    bool match(MessageType message_type, const uint8_t* payload, size_t payload_size) const;
+
+    /** Check if a frame in a block of a capture might match the filter
+        @param index the summary of the block
+        @return false if no frame in the block can match, true if one might
+    */
+    bool mayMatch(const CaptureIndex& index) const;
+
+    /// True if the filter is for the frames from the body board
+    bool b2h() const { return forB2H; }
+
+    /// True if the filter has an expression
+    bool active() const { return numCode > 0; }
+
+    /// The number of instructions in the program
+    size_t size() const { return numCode; }
+
+    /// The error in the expression, null if there is none
+    const char* error;
+
+    /// The position of the error in the expression
+    size_t errorPos;
+
+private:
+    /// Append an instruction, folding the constants
+    bool emit(FilterOp op, int64_t value = 0, const FieldInfo* field = nullptr, size_t index = 0);
+
+    /// Parse the expression, at each level of precedence
+    bool parseOr();
+    bool parseAnd();
+    bool parseCompare();
+    bool parseBitOr();
+    bool parseBitAnd();
+    bool parseSum();
+    bool parseUnary();
+    bool parsePrimary();
+
+    /// Skip the spaces, and check for the token
+    bool accept(const char* token);
+
+    /// Record an error
+    bool fail(const char* message);
+
+    /// The program
+    FilterInstruction code[FILTER_MAX_CODE];
+
+    /// The number of instructions in the program
+    uint8_t numCode;
+
+    /// The payload needed by the fields (0 if no field is used)
+    uint16_t payloadSize;
+
+    /// True if the filter is for the frames from the body board
+    bool forB2H;
+
+    /// The fields that may be named
+    const FieldInfo* fields;
+    size_t numFields;
+
+    /// The start of the expression, and where it is being parsed
+    const char* start;
+    const char* ptr;
+};
+
+}
@@ -0,0 +1,141 @@
+/* Compile-time construction of constant message frames
+   Copyright 2024 Randall Maas
+*//**@file
+    @brief Compile-time construction of constant message frames.
+
+    Several messages from the head board have no payload (shutdown, mode,
+    version, validate, erase), and others may have a payload that never
+    changes.  The whole wire image of these frames is a constant: the sync
+    bytes, the message type and size, the payload, and the CRC.  Rather than
+    populate the header and compute the CRC each time, the frames are built
+    by the compiler as constant arrays (which are kept in flash), and sending
+    one is a single write:
+
+    @code
+    SendFrame(Serial1, H2B::shutdownFrame);
+    @endcode
+
+    The frame is payload_ofs + payload size + 4 bytes -- the same bytes that
+    SendMessage() sends -- with the CRC following the payload.  The sizes are
+    checked against the size tables used at run time.
+
+    @note this needs C++17 (the arduino-esp32 3.x tool-chain)
+*/
+#pragma once
+#include <inttypes.h>
+#include <stddef.h>
+#include <array>
+#include "spine.h"
+#include "crc.h"
+
+namespace Spine {
+
+/** Build the wire image of a frame at compile time
+    @tparam PayloadSize the size of the payload
+    @param tag the three characters following the sync byte
+    @param message_type the type of the message
+    @param payload the payload, or null if it is all zeros
+    @return the frame
+*/
+template<size_t PayloadSize>
+constexpr std::array<uint8_t, payload_ofs+PayloadSize+4> buildFrame(const char* tag, MessageType message_type, const uint8_t* payload)
+{
+    std::array<uint8_t, payload_ofs+PayloadSize+4> frame = {};
+    frame[0] = 0xAA;
+    frame[1] = (uint8_t) tag[0];
+    frame[2] = (uint8_t) tag[1];
+    frame[3] = (uint8_t) tag[2];
+
+    // The message type and size, little endian
+    frame[4] = (uint8_t)  (uint16_t) message_type;
+    frame[5] = (uint8_t)(((uint16_t) message_type) >> 8);
+    frame[payload_size_ofs  ] = (uint8_t)  PayloadSize;
+    frame[payload_size_ofs+1] = (uint8_t) (PayloadSize >> 8);
+
+    // The payload
+    for (size_t idx = 0; payload && idx < PayloadSize; idx++)
+        frame[payload_ofs+idx] = payload[idx];
+
+    // The CRC of the payload, little endian
+    auto crc = Crc32(CRC32_INITIAL, frame.data()+payload_ofs, PayloadSize);
+    for (int idx = 0; idx < 4; idx++)
+        frame[payload_ofs+PayloadSize+idx] = (uint8_t)(crc >> (8*idx));
+    return frame;
+}
+
+
+/** Send a constant frame
+    @param out the stream to send the frame to
+    @param frame the frame
+*/
+template<typename S, size_t N>
+void SendFrame(S& out, const std::array<uint8_t, N>& frame)
+{
+    out.write(frame.data(), N);
+}
+
+
+namespace H2B {
+
+/** Build the frame of a message to the body board at compile time
+    @tparam message_type the type of the message
+    @param payload the payload, or null if it is empty (or all zeros)
+    @return the frame
+*/
+template<MessageType message_type>
+constexpr auto ConstantFrame(const uint8_t* payload = nullptr)
+{
+    static_assert(size(message_type) >= 0, "The message type is not sent to the body board");
+    return buildFrame<(size_t) size(message_type)>("H2B", message_type, payload);
+}
+
+/// The frame to disconnect the battery, to shutoff the system
+inline constexpr auto shutdownFrame = ConstantFrame<MessageType::shutdown>();
+
+/// The frame to change the mode
+inline constexpr auto modeFrame = ConstantFrame<MessageType::mode>();
+
+/// The frame to request the application version
+inline constexpr auto versionFrame = ConstantFrame<MessageType::version>();
+
+#if SPINE_ENABLE_DFU
+/// The frame to validate the flash
+inline constexpr auto validateFrame = ConstantFrame<MessageType::validate>();
+
+/// The frame to erase the program memory
+inline constexpr auto eraseFrame = ConstantFrame<MessageType::erase>();
+#endif
+
+// Check the frames against the sizes used at run time
+static_assert(shutdownFrame.size() == payload_ofs + size(MessageType::shutdown) + 4, "The shutdown frame is the wrong size");
+static_assert(modeFrame    .size() == payload_ofs + size(MessageType::mode    ) + 4, "The mode frame is the wrong size");
+static_assert(versionFrame .size() == payload_ofs + size(MessageType::version ) + 4, "The version frame is the wrong size");
+#if SPINE_ENABLE_DFU
+static_assert(validateFrame.size() == payload_ofs + size(MessageType::validate) + 4, "The validate frame is the wrong size");
+static_assert(eraseFrame   .size() == payload_ofs + size(MessageType::erase   ) + 4, "The erase frame is the wrong size");
+#endif
+static_assert(shutdownFrame[0] == 0xAA && shutdownFrame[1] == 'H' && shutdownFrame[2] == '2' && shutdownFrame[3] == 'B', "The sync bytes are wrong");
+static_assert(shutdownFrame[4] == 0x73 && shutdownFrame[5] == 0x64, "The message type is wrong");
+static_assert(shutdownFrame[payload_size_ofs] == 0 && shutdownFrame[payload_size_ofs+1] == 0, "The payload size is wrong");
+// the CRC of an empty payload is the register inverted
+static_assert(shutdownFrame[payload_ofs] == 0xFF && shutdownFrame[payload_ofs+3] == 0xFF, "The CRC is wrong");
+}
+
+
+namespace B2H {
+
+/** Build the frame of a message to the head board at compile time
+    @tparam message_type the type of the message
+    @param payload the payload, or null if it is empty (or all zeros)
+    @return the frame
+*/
+template<MessageType message_type>
+constexpr auto ConstantFrame(const uint8_t* payload = nullptr)
+{
+    static_assert(size(message_type) >= 0, "The message type is not sent to the head board");
+    return buildFrame<(size_t) size(message_type)>("B2H", message_type, payload);
+}
+
+}
+
+}
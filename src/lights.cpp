@@ -0,0 +1,183 @@
+/* Animation of the backpack lights
+   Copyright 2024 Randall Maas
+*//**@file
+    @brief Animation of the backpack lights.
+
+    This file contains the keyframe tables (built at compile time), the
+    rendering of the animations, and the update of the lights frame.
+*/
+#include <string.h>
+#include <Arduino.h>
+#include "crc.h"
+#include "frames.h"
+#include "lights.h"
+
+namespace Spine {
+
+/** The cosine, at compile time
+    @param x the angle (in radians), 0 to 2 pi
+    @return the cosine
+*/
+static constexpr double constCos(double x)
+{
+    // the series about 0, on -pi to pi
+    if (x > 3.14159265358979323846)
+        x -= 2*3.14159265358979323846;
+    double result = 1, term = 1;
+    for (int idx = 2; idx < 30; idx += 2)
+    {
+        term *= -x*x / ((idx-1) * idx);
+        result += term;
+    }
+    return result;
+}
+
+/// The brightness (0 to 255) of each keyframe of the animations
+struct LightTables
+{
+    /// The weight of the second color of a fade
+    uint8_t fade[LIGHTS_KEYFRAMES];
+
+    /// The brightness of a pulse
+    uint8_t pulse[LIGHTS_KEYFRAMES];
+
+    /// The brightness of each LED of a spinner
+    uint8_t spinner[LIGHTS_KEYFRAMES][LightsAnimator::numLEDs];
+};
+
+/** Build the keyframe tables
+    @return the tables
+*/
+static constexpr LightTables makeLightTables()
+{
+    LightTables tables = {};
+    for (size_t key = 0; key < LIGHTS_KEYFRAMES; key++)
+    {
+        // squared, so that the fade looks even to the eye
+        double t = (double) key / (LIGHTS_KEYFRAMES-1);
+        tables.fade[key] = (uint8_t)(255*t*t + 0.5);
+
+        // a raised cosine, off at the start of each period
+        tables.pulse[key] = (uint8_t)(255*(0.5 - 0.5*constCos(2*3.14159265358979323846*key / LIGHTS_KEYFRAMES)) + 0.5);
+
+        // the head goes around the LEDs once a period; the tail fades over 2 LEDs
+        double head = (double) key * LightsAnimator::numLEDs / LIGHTS_KEYFRAMES;
+        for (size_t led = 0; led < LightsAnimator::numLEDs; led++)
+        {
+            double behind = head - led;
+            if (behind < 0)
+                behind += LightsAnimator::numLEDs;
+            tables.spinner[key][led] = behind < 2 ? (uint8_t)(255*(1 - behind/2) + 0.5) : 0;
+        }
+    }
+    return tables;
+}
+
+/// The keyframe tables, built at compile time
+static constexpr LightTables lightTables = makeLightTables();
+static_assert(lightTables.fade[LIGHTS_KEYFRAMES-1] == 255 && lightTables.pulse[LIGHTS_KEYFRAMES/2] == 255, "The keyframes should reach full brightness");
+
+
+/// Create the animator, with the lights off
+LightsAnimator::LightsAnimator()
+    : frame(H2B::ConstantFrame<MessageType::lights>()), numTicks(0), numFrames(0)
+    , animation{LightPattern::off, {}, {}, 1000}, start_ms(0), sent_ms(0)
+{
+    uint8_t off[sizeof(Lights)] = {};
+    crc = Crc32(CRC32_INITIAL, off, sizeof(off));
+}
+
+
+/** Start an animation
+    @param animation the animation
+    @param now_ms the time (in milliseconds)
+*/
+void LightsAnimator::start(const LightAnimation& animation, uint32_t now_ms)
+{
+    this->animation = animation;
+    if (!this->animation.period_ms)
+        this->animation.period_ms = 1;
+    start_ms = now_ms;
+}
+
+
+/** Render the colors of the animation
+    @param now_ms the time (in milliseconds)
+    @param lights the colors
+*/
+void LightsAnimator::render(uint32_t now_ms, Lights& lights) const
+{
+    memset(&lights, 0, sizeof(lights));
+    uint32_t elapsed = now_ms - start_ms;
+    size_t key = (size_t)((uint64_t) (elapsed % animation.period_ms) * LIGHTS_KEYFRAMES / animation.period_ms);
+
+    for (size_t led = 0; led < numLEDs; led++)
+    {
+        uint8_t* color = lights.ledColors + 4*led;
+        for (size_t channel = 0; channel < 3; channel++)
+        {
+            unsigned value = 0;
+            switch (animation.pattern)
+            {
+                case LightPattern::off:
+                    break;
+                case LightPattern::solid:
+                    value = animation.color[channel];
+                    break;
+                case LightPattern::fade:
+                {
+                    // holds the second color once the fade is done
+                    unsigned weight = elapsed >= animation.period_ms ? 255 : lightTables.fade[key];
+                    value = (animation.color[channel]*(255 - weight) + animation.color2[channel]*weight + 127) / 255;
+                    break;
+                }
+                case LightPattern::pulse:
+                    value = (animation.color[channel]*lightTables.pulse[key] + 127) / 255;
+                    break;
+                case LightPattern::spinner:
+                    value = (animation.color[channel]*lightTables.spinner[key][led] + 127) / 255;
+                    break;
+            }
+            color[channel] = (uint8_t) value;
+        }
+    }
+}
+
+
+/** Render the animation, and update the frame if the colors changed
+    @param now_ms the time (in milliseconds)
+    @return true if the frame should be sent: the colors changed, or it is
+            time to refresh them
+*/
+bool LightsAnimator::tick(uint32_t now_ms)
+{
+    numTicks++;
+    Lights lights;
+    render(now_ms, lights);
+
+    // the first byte that changed
+    uint8_t* payload = frame.data() + payload_ofs;
+    size_t first = 0;
+    while (first < sizeof(lights) && payload[first] == lights.ledColors[first])
+        first++;
+
+    if (first < sizeof(lights))
+    {
+        // the CRC of the change, from a zero register, exclusive or'd in
+        uint32_t change = 0;
+        for (size_t idx = first; idx < sizeof(lights); idx++)
+            change = crc32Table.entry[(change ^ payload[idx] ^ lights.ledColors[idx]) & 0xFF] ^ (change >> 8);
+        crc ^= change;
+        memcpy(payload + first, lights.ledColors + first, sizeof(lights) - first);
+        for (int idx = 0; idx < 4; idx++)
+            payload[sizeof(lights) + idx] = (uint8_t)(crc >> (8*idx));
+    }
+    else if (numFrames && now_ms - sent_ms < LIGHTS_REFRESH_MS)
+        return false;
+
+    sent_ms = now_ms;
+    numFrames++;
+    return true;
+}
+
+}
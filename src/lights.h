@@ -0,0 +1,137 @@
+/* Animation of the backpack lights
+   Copyright 2024 Randall Maas
+*//**@file
+    @brief Animation of the backpack lights.
+
+    An app that animates the backpack lights by sending a lights message each
+    tick spends the link, and the time to build and CRC the frame, on
+    messages that mostly don't change anything.  The animator renders the
+    animation each tick, but only builds a lights frame when the colors
+    change:
+
+    @code
+    LightsAnimator lights;
+    lights.start({LightPattern::pulse, {0, 0, 255}, {}, 2000}, millis());
+    ...
+    // each tick
+    if (lights.tick(millis()))
+        SendFrame(Serial1, lights.frame);
+    @endcode
+
+    The animations step through LIGHTS_KEYFRAMES keyframes each period, from
+    tables built at compile time:
+
+    - solid: one color
+    - fade: from one color to the other, over the period, then holds
+    - pulse: brightens and dims one color, each period
+    - spinner: one color chases around the 4 LEDs, with a fading tail, each
+      period
+
+    So the colors change at most LIGHTS_KEYFRAMES times a period, however
+    often the tick is called.  The frame is sent again every
+    LIGHTS_REFRESH_MS even if the colors haven't changed, in case one was
+    lost.
+
+    The CRC is updated from the bytes that changed, rather than computed over
+    the payload again: the CRC is linear, so the new CRC is the old one
+    exclusive or'd with the CRC (from a zero register) of the change, and
+    the change starts at the first byte that differs.
+*/
+#pragma once
+#include <inttypes.h>
+#include <stddef.h>
+#include <array>
+#include "spine.h"
+
+namespace Spine {
+
+/// The kinds of light animations
+enum class LightPattern : uint8_t
+{
+    /// The lights are off
+    off,
+
+    /// One color
+    solid,
+
+    /// From one color to the other, over the period
+    fade,
+
+    /// Brightens and dims one color, each period
+    pulse,
+
+    /// One color chases around the LEDs, each period
+    spinner
+};
+
+/// A light animation
+struct LightAnimation
+{
+    /// The kind of animation
+    LightPattern pattern;
+
+    /// The color (red, green, blue)
+    uint8_t color[3];
+
+    /// The color faded to (red, green, blue)
+    uint8_t color2[3];
+
+    /// The period of the animation (in milliseconds)
+    uint16_t period_ms;
+};
+
+
+/** Renders a light animation, and builds the lights frames when it changes
+*/
+class LightsAnimator
+{
+public:
+    /// The number of LEDs
+    static constexpr size_t numLEDs = 4;
+
+    /// The size of the lights frame
+    static constexpr size_t frameSize = payload_ofs + sizeof(Lights) + 4;
+
+    /// Create the animator, with the lights off
+    LightsAnimator();
+
+    /** Start an animation
+        @param animation the animation
+        @param now_ms the time (in milliseconds)
+    */
+    void start(const LightAnimation& animation, uint32_t now_ms);
+
+    /** Render the colors of the animation
+        @param now_ms the time (in milliseconds)
+        @param lights the colors
+    */
+    void render(uint32_t now_ms, Lights& lights) const;
+
+    /** Render the animation, and update the frame if the colors changed
+        @param now_ms the time (in milliseconds)
+        @return true if the frame should be sent: the colors changed, or it is
+                time to refresh them
+    */
+    bool tick(uint32_t now_ms);
+
+    /// The lights frame, to send when tick() returns true
+    std::array<uint8_t, frameSize> frame;
+
+    /// The number of ticks, and of frames to send
+    uint32_t numTicks, numFrames;
+
+private:
+    /// The animation
+    LightAnimation animation;
+
+    /// When the animation started (in milliseconds)
+    uint32_t start_ms;
+
+    /// When the frame was last sent (in milliseconds)
+    uint32_t sent_ms;
+
+    /// The CRC of the payload in the frame
+    uint32_t crc;
+};
+
+}
@@ -8,11 +8,97 @@
 #include <Arduino.h>
 #include <esp32/rom/crc.h>
 #include "spine.h"
+#include "crc.h"
+#include "schema.h"
+#include "stall.h"
+#include "angle.h"
+#include "tof.h"
+#include "charge.h"
+#include "predictor.h"
+#include "bringup.h"
+#include "filter.h"
+#include "mailbox.h"
 // not sure if it should be crc32_be or crc32_le
 #define crc32 crc32_le
 
 using namespace Spine;
 
+/// Watches the motor commands and encoder feedback for stalled motors
+StallDetector stallDetector;
+
+/// Tracks the angle of the lift and head
+AngleTracker angleTracker;
+
+/// Reconstructs the time of flight counts and reflectivity
+TofReconstruction tofReconstruction;
+
+/// Extracts the charging dock sessions
+ChargeAnalyser chargeAnalyser;
+
+/// Predicts when the next data frame from the body board will arrive
+FramePredictor framePredictor;
+
+/// Locks on to the frames from the body board, and watches for it resetting
+LinkBringup linkBringup;
+
+/// Selects the frames from each board that are copied to the tap
+Filter b2hTapFilter, h2bTapFilter;
+
+/// Where the selected frames are printed, null if there is no tap
+static Stream* b2hTap, * h2bTap;
+
+#if SPINE_H2B_MAILBOX
+/// The frames from the head board waiting to go to the body board
+H2BMailbox h2bMailbox;
+#endif
+
+
+/** Tap the frames from the body board
+    @param tap the stream to print the selected frames on, or null for none
+    @param expression the filter expression that selects the frames (see
+           filter.h); empty for every frame
+    @return true on success, false if the expression has an error (see
+            b2hTapFilter.error); the tap is then off
+*/
+bool TapB2H(Stream* tap, const char* expression)
+{
+    b2hTap = b2hTapFilter.compile(expression, true) ? tap : nullptr;
+    return !b2hTapFilter.error;
+}
+
+
+/** Tap the frames from the head board
+    @param tap the stream to print the selected frames on, or null for none
+    @param expression the filter expression that selects the frames (see
+           filter.h); empty for every frame
+    @return true on success, false if the expression has an error (see
+            h2bTapFilter.error); the tap is then off
+*/
+bool TapH2B(Stream* tap, const char* expression)
+{
+    h2bTap = h2bTapFilter.compile(expression, false) ? tap : nullptr;
+    return !h2bTapFilter.error;
+}
+
+
+/** Print a received frame on the tap, if the filter selects it
+    @param tap the stream to print on, or null for none
+    @param filter selects the frames
+    @param b2h true for a frame from the body board, false for the head board
+    @param msg_type the type of the message
+    @param payload the payload
+    @param payload_size the size of the payload
+*/
+static void tapFrame(Stream* tap, const Filter& filter, bool b2h, MessageType msg_type, const uint8_t* payload, size_t payload_size)
+{
+    if (!tap || !filter.match(msg_type, payload, payload_size))
+        return;
+    static char text[600];
+    auto length = FormatMessage(text, sizeof(text)-1, b2h, msg_type, payload, payload_size);
+    text[length++] = '\n';
+    tap->write((const uint8_t*) text, length);
+}
+
 
 /** Process ack message from the body board to the head board
  
@@ -56,40 +142,97 @@ bool process(DataCharacter& value)
 */
 bool process(B2HDataFrame& frame)
 {
+    // check the encoders against the commanded motor drive
+    auto now = micros();
+    stallDetector.feedback(frame, now);
+
+    // update the lift and head angles, if they moved
+    angleTracker.update(frame, now);
+
+    // accumulate the time of flight histograms
+    tofReconstruction.update(frame);
+
+    // look for docking, undocking and charging
+    chargeAnalyser.update(frame);
+
     // return true if the message was modified (thus needs a new CRC), false if not.
     return false;
 }
 
+/// Passes the messages from the body board to their processing
+struct Body2HeadHandler
+{
+    bool operator()(Ack& value)           { return process(value); }
+    bool operator()(DataCharacter& value) { return process(value); }
+    bool operator()(B2HDataFrame& frame)  { return process(frame); }
+
+    /// The other messages aren't processed
+    template<typename T> bool operator()(T&) { return false; }
+};
+
+
 /** Process a received message.
     @param msg_type the type of the message
     @return true if the message was modified (thus needs a new CRC), false if not.
 
     This dispatch function is used to call the appropriate processing function
-    for each message type. It uses a switch statement to determine the
-    appropriate action for each message type.
+    for each message type.  The payload is passed as its struct, as given in
+    the message schema (see SPINE_MESSAGES).
 
-    You can implement your own processing for each message type.
+    You can implement your own processing for each message type, by adding it
+    to Body2HeadHandler.
 */
 bool processBody2Head(MessageType msg_type)
 {
-    // make decision on what the message type
-    switch (msg_type)
-    {
-        default                         : break;
-        case MessageType::ack           : return process(((Ack*)(B2H::recv_buffer+payload_ofs))[0]);
-        case MessageType::dataCharacter : return process(((DataCharacter*)(B2H::recv_buffer+payload_ofs))[0]);
-        case MessageType::dataFrame     : return process(((B2HDataFrame*)(B2H::recv_buffer+payload_ofs))[0]);
-        case MessageType::bootFrame     : break;
-        case MessageType::updateFirmware: break;
-        case MessageType::version       : break;
-        case MessageType::validate      : break;
-    }
+    return DispatchB2H(msg_type, B2H::recv_buffer+payload_ofs, Body2HeadHandler());
+}
+
+
+/** Process data frame message from the head board to the body board
+    @param frame the data frame message
+    @return true if the message was modified (thus needs a new CRC), false if not.
+ 
+    1. process message fields
+    2. update message fields, if needed
+    3. return true if the message was modified (thus needs a new CRC), false if not.
+*/
+bool process(H2BDataFrame& frame)
+{
+    // remember the commanded motor drive
+    stallDetector.command(frame, micros());
 
-    // Not modified
+    // return true if the message was modified (thus needs a new CRC), false if not.
     return false;
 }
 
 
+/// Passes the messages from the head board to their processing
+struct Head2BodyHandler
+{
+    bool operator()(H2BDataFrame& frame) { return process(frame); }
+
+    /// The other messages aren't processed
+    template<typename T> bool operator()(T&) { return false; }
+};
+
+
+/** Process a received message from the head board.
+    @param msg_type the type of the message
+    @return true if the message was modified (thus needs a new CRC), false if not.
+
+    This dispatch function is used to call the appropriate processing function
+    for each message type.  The payload is passed as its struct, as given in
+    the message schema (see SPINE_MESSAGES).
+
+    You can implement your own processing for each message type, by adding it
+    to Head2BodyHandler.
+*/
+bool processHead2Body(MessageType msg_type)
+{
+    return DispatchH2B(msg_type, H2B::recv_buffer+payload_ofs, Head2BodyHandler());
+}
+
+
 /** Rewrite a message from the body board and send it to the head board.
     @param in the stream to receive the message from
     @param out the stream to send the message to
@@ -99,18 +242,115 @@ void ReceiveAndRewriteB2HMessage(Stream& in, Stream& out)
 {
     // wait for a message
     size_t payload_size = 0;
-    auto msg_type = B2H::ReceiveMessage(in, payload_size);
+    auto msg_type = linkBringup.receive(in, payload_size);
+
+    // nothing to forward if the frame was bad
+    if ((int) msg_type == -1)
+        return;
+
+    // learn the cadence of the data frames
+    if (msg_type == MessageType::dataFrame)
+        framePredictor.observe(((B2HDataFrame*)(B2H::recv_buffer+payload_ofs))->sequenceNumber, micros());
+
+    // copy it to the tap, as received
+    tapFrame(b2hTap, b2hTapFilter, true, msg_type, B2H::recv_buffer+payload_ofs, payload_size);
 
     // process the message
     processBody2Head(msg_type);
 
     // calculate new crc
-    auto crc = crc32(~0U, B2H::recv_buffer+payload_ofs, payload_size);
-    *(uint32_t*)(B2H::recv_buffer+payload_ofs+ payload_size+4) = crc;
+    auto crc = crc32(CRC32_INITIAL, B2H::recv_buffer+payload_ofs, payload_size);
+    *(uint32_t*)(B2H::recv_buffer+payload_ofs+payload_size) = crc;
 
     // send to head board
     out.write(B2H::recv_buffer, payload_size+payload_ofs+4);
 }
 
 
+/** Rewrite a message from the head board and send it to the body board.
+    @param in the stream to receive the message from
+    @param out the stream to send the message to
+
+    With SPINE_H2B_MAILBOX, the message goes through the mailbox (see
+    mailbox.h): it is sent when the stream has room, and a newer data frame
+    or lights message replaces one that is still waiting.  Call this each
+    time around the loop, so the waiting messages are sent.
+ */
+void ReceiveAndRewriteH2BMessage(Stream& in, Stream& out)
+{
+#if SPINE_H2B_MAILBOX
+    // send the frames that are waiting, as there is room
+    h2bMailbox.send(out, micros());
+#endif
 
+    // wait for a message
+    size_t payload_size = 0;
+    auto msg_type = H2B::ReceiveMessage(in, payload_size);
+
+    // nothing to forward if the frame was bad
+    if ((int) msg_type == -1)
+        return;
+
+    // copy it to the tap, as received
+    tapFrame(h2bTap, h2bTapFilter, false, msg_type, H2B::recv_buffer+payload_ofs, payload_size);
+
+    // process the message
+    processHead2Body(msg_type);
+
+    // calculate new crc
+    auto crc = crc32(CRC32_INITIAL, H2B::recv_buffer+payload_ofs, payload_size);
+    *(uint32_t*)(H2B::recv_buffer+payload_ofs+payload_size) = crc;
+
+    // send to body board
+#if SPINE_H2B_MAILBOX
+    // a newer data frame or lights replaces the one waiting
+    h2bMailbox.put(H2B::recv_buffer, payload_size+payload_ofs+4, micros());
+    h2bMailbox.send(out, micros());
+#else
+    out.write(H2B::recv_buffer, payload_size+payload_ofs+4);
+#endif
+}
+
+
+/** Sleep until just before the next data frame from the body board is due.
+    @param body the stream from the body board
+    @param head the stream from the head board
+
+    The sleep is cut short if bytes arrive from either board.
+ */
+void SleepUntilNextFrame(Stream& body, Stream& head)
+{
+    // sleep in slices of a millisecond, so that early bytes cut it short
+    for (;;)
+    {
+        auto sleep_us = framePredictor.sleepTime(micros());
+        if (sleep_us < 1000)
+            return;
+        if (body.available() || head.available())
+        {
+            framePredictor.numEarlyWakes++;
+            return;
+        }
+        auto start_us = micros();
+        SleepFor(1000);
+        framePredictor.slept_us += micros() - start_us;
+    }
+}
+
+
+#if SPINE_RAM_REPORT
+/// Report the static RAM used by the subsystems
+[[maybe_unused]] static void reportRAM()
+{
+    ReportRAM<StallDetector    , sizeof(stallDetector    )>();
+    ReportRAM<AngleTracker     , sizeof(angleTracker     )>();
+    ReportRAM<TofReconstruction, sizeof(tofReconstruction)>();
+    ReportRAM<ChargeAnalyser   , sizeof(chargeAnalyser   )>();
+    ReportRAM<FramePredictor   , sizeof(framePredictor   )>();
+    ReportRAM<LinkBringup      , sizeof(linkBringup      )>();
+    ReportRAM<Filter           , sizeof(b2hTapFilter)+sizeof(h2bTapFilter)>();
+#if SPINE_H2B_MAILBOX
+    ReportRAM<H2BMailbox       , sizeof(h2bMailbox       )>();
+#endif
+}
+#endif
@@ -36,9 +36,69 @@ bool process(DataCharacter& value);
 bool process(B2HDataFrame& frame);
 
 
+/** Process data frame message from the head board to the body board
+    @param frame the data frame message
+    @return true if the message was modified (thus needs a new CRC), false if not.
+ 
+    1. process message fields
+    2. update message fields, if needed
+    3. return true if the message was modified (thus needs a new CRC), false if not.
+*/
+bool process(H2BDataFrame& frame);
+
+
+/** Tap the frames from the body board
+    @param tap the stream to print the selected frames on, or null for none
+    @param expression the filter expression that selects the frames (see
+           filter.h); empty for every frame
+    @return true on success, false if the expression has an error; the tap
+            is then off
+
+    The selected frames are printed as received, before they are rewritten,
+    one line per frame.  For example, to print the data frames with a cliff
+    sensor seeing the floor edge while off the charger:
+
+    @code
+    TapB2H(&Serial, "cliffSense[2] < 200 && onCharger == 0");
+    @endcode
+*/
+bool TapB2H(Stream* tap, const char* expression);
+
+
+/** Tap the frames from the head board
+    @param tap the stream to print the selected frames on, or null for none
+    @param expression the filter expression that selects the frames (see
+           filter.h); empty for every frame
+    @return true on success, false if the expression has an error; the tap
+            is then off
+*/
+bool TapH2B(Stream* tap, const char* expression);
+
+
 /** Rewrite a message from the body board and send it to the head board.
     @param in the stream to receive the message from
     @param out the stream to send the message to
 
  */
 void ReceiveAndRewriteB2HMessage(Stream& in, Stream& out);
+
+
+/** Rewrite a message from the head board and send it to the body board.
+    @param in the stream to receive the message from
+    @param out the stream to send the message to
+
+    With SPINE_H2B_MAILBOX, the message goes through the mailbox (see
+    mailbox.h): it is sent when the stream has room, and a newer data frame
+    or lights message replaces one that is still waiting.  Call this each
+    time around the loop, so the waiting messages are sent.
+ */
+void ReceiveAndRewriteH2BMessage(Stream& in, Stream& out);
+
+
+/** Sleep until just before the next data frame from the body board is due.
+    @param body the stream from the body board
+    @param head the stream from the head board
+
+    The sleep is cut short if bytes arrive from either board.
+ */
+void SleepUntilNextFrame(Stream& body, Stream& head);
@@ -0,0 +1,124 @@
+/* Latest-wins mailbox for the frames from the head board
+   Copyright 2024 Randall Maas
+*//**@file
+    @brief Latest-wins mailbox for the frames from the head board.
+
+    This file contains the slots, the queue, and the staleness measurement.
+*/
+#include <string.h>
+#include <Arduino.h>
+#include "mailbox.h"
+
+namespace Spine {
+
+static_assert(H2BMailbox::maxFrameSize <= UINT16_MAX, "The frame sizes must fit in the entries");
+static_assert(sizeof(Lights) <= sizeof(H2BDataFrame), "The slots are sized for the data frame");
+
+
+H2BMailbox::H2BMailbox()
+    : numSent(0), numReplaced(0), numDropped(0), totalAge_us(0), maxAge_us(0)
+    , numQueued(0), numDequeued(0), txBufferSize(0)
+{
+    memset(slotEntries, 0, sizeof(slotEntries));
+    memset(queueEntries, 0, sizeof(queueEntries));
+}
+
+
+/** Put a frame in the mailbox
+    @param frame the frame (the header, payload and CRC)
+    @param size the size of the frame
+    @param now_us the time (in microseconds)
+    @return true if the frame was put in the mailbox, false if it was
+            dropped because the queue is full, or the frame is bad
+*/
+bool H2BMailbox::put(const uint8_t* frame, size_t size, uint32_t now_us)
+{
+    if (size < payload_ofs + 4 || size > maxFrameSize)
+    {
+        numDropped++;
+        return false;
+    }
+
+    // the newest data frame or lights frame replaces the one in the slot
+    // assumes alignment, little endian host
+    auto message_type = (MessageType) *(const uint16_t*)(frame+4);
+    int slot = message_type == MessageType::dataFrame ? dataFrameSlot
+             : message_type == MessageType::lights    ? lightsSlot
+             : -1;
+    if (slot >= 0 && size <= slotSize)
+    {
+        auto& entry = slotEntries[slot];
+        if (entry.size)
+            numReplaced++;
+        memcpy(slots[slot], frame, size);
+        entry = {(uint16_t) size, now_us};
+        return true;
+    }
+
+    // the other frames must each be delivered
+    if (numQueued - numDequeued >= H2B_MAILBOX_QUEUE_DEPTH)
+    {
+        numDropped++;
+        return false;
+    }
+    auto idx = numQueued++ % H2B_MAILBOX_QUEUE_DEPTH;
+    memcpy(queue[idx], frame, size);
+    queueEntries[idx] = {(uint16_t) size, now_us};
+    return true;
+}
+
+
+/// Where the frame returned by peek() is: a slot, or the queue (-1)
+int H2BMailbox::next() const
+{
+    if (numQueued != numDequeued)
+        return -1;
+    int oldest = numSlots;
+    for (int slot = 0; slot < numSlots; slot++)
+        if (slotEntries[slot].size && (oldest == numSlots || (int32_t)(slotEntries[slot].put_us - slotEntries[oldest].put_us) < 0))
+            oldest = slot;
+    return oldest;
+}
+
+
+/** The next frame to send
+    @param size the size of the frame
+    @return the frame, or null if there are none
+*/
+const uint8_t* H2BMailbox::peek(size_t& size) const
+{
+    auto where = next();
+    if (where < 0)
+    {
+        auto idx = numDequeued % H2B_MAILBOX_QUEUE_DEPTH;
+        size = queueEntries[idx].size;
+        return queue[idx];
+    }
+    if (where == numSlots)
+    {
+        size = 0;
+        return nullptr;
+    }
+    size = slotEntries[where].size;
+    return slots[where];
+}
+
+
+/** Take the frame returned by peek() out of the mailbox, as it has been sent
+    @param now_us the time (in microseconds)
+*/
+void H2BMailbox::pop(uint32_t now_us)
+{
+    auto where = next();
+    if (where == numSlots)
+        return;
+    auto& entry = where < 0 ? queueEntries[numDequeued++ % H2B_MAILBOX_QUEUE_DEPTH] : slotEntries[where];
+    uint32_t age = now_us - entry.put_us;
+    totalAge_us += age;
+    if (age > maxAge_us)
+        maxAge_us = age;
+    entry.size = 0;
+    numSent++;
+}
+
+}
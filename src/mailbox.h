@@ -0,0 +1,148 @@
+/* Latest-wins mailbox for the frames from the head board
+   Copyright 2024 Randall Maas
+*//**@file
+    @brief Latest-wins mailbox for the frames from the head board.
+
+    If the head board sends its data frames (the motor commands) and lights
+    faster than the link to the body board can take them, a queue would hold
+    them all, and the body board would get each command later and later.
+    Only the newest of these matters: each one replaces the last.
+
+    The mailbox holds the frames waiting to go to the body board:
+
+    - the data frames and lights frames each have a slot.  A newer frame
+      replaces one in the slot that hasn't been sent yet.
+    - the other frames (the firmware update, shutdown, mode, ...) must each
+      be delivered, in order; they go in a queue of H2B_MAILBOX_QUEUE_DEPTH
+      frames.  A frame that doesn't fit is dropped, and counted.
+
+    The frames are sent when the stream has room for them, so the sender
+    never blocks on a full transmit buffer.  The queued frames go first, then
+    the slots, oldest first.
+
+    A frame larger than the transmit buffer never has room: a firmware update
+    frame is 1040 bytes, and the buffer may be just the 128 byte FIFO (e.g.
+    if the buffer size was set after begin()).  Such a frame is written once
+    the buffer has emptied, and that write blocks until the last of the frame
+    is in the buffer.  The size of the transmit buffer is taken to be the
+    most room the stream has reported.
+
+    The mailbox measures the staleness of the frames: the time from a frame
+    being put in the mailbox until it is sent.
+
+    @code
+    // on each frame from the head board
+    h2bMailbox.put(H2B::recv_buffer, payload_ofs + payload_size + 4, micros());
+    // each time around the loop
+    h2bMailbox.send(Serial1, micros());
+    @endcode
+*/
+#pragma once
+#include <inttypes.h>
+#include <stddef.h>
+#include "spine.h"
+
+namespace Spine {
+
+/** Holds the frames waiting to go to the body board, with the newest data
+    frame and lights frame replacing the older ones
+*/
+class H2BMailbox
+{
+public:
+    /// The largest frame
+    static constexpr size_t maxFrameSize = H2B::recv_buffer_size;
+
+    H2BMailbox();
+
+    /** Put a frame in the mailbox
+        @param frame the frame (the header, payload and CRC)
+        @param size the size of the frame
+        @param now_us the time (in microseconds)
+        @return true if the frame was put in the mailbox, false if it was
+                dropped because the queue is full, or the frame is bad
+    */
+    bool put(const uint8_t* frame, size_t size, uint32_t now_us);
+
+    /** The next frame to send
+        @param size the size of the frame
+        @return the frame, or null if there are none
+    */
+    const uint8_t* peek(size_t& size) const;
+
+    /** Take the frame returned by peek() out of the mailbox, as it has been sent
+        @param now_us the time (in microseconds)
+    */
+    void pop(uint32_t now_us);
+
+    /** Send the frames, as many as the stream has room for
+        @param out the stream to send the frames to
+        @param now_us the time (in microseconds)
+        @return the number of frames sent
+    */
+    template<typename S>
+    size_t send(S& out, uint32_t now_us)
+    {
+        size_t count = 0, size;
+        for (const uint8_t* frame; (frame = peek(size)); count++)
+        {
+            // wait for room for the whole frame, unless the transmit buffer
+            // is empty (as seen before), as a larger frame would never fit
+            size_t room = (size_t) out.availableForWrite();
+            bool empty = txBufferSize && room >= txBufferSize;
+            if (room > txBufferSize)
+                txBufferSize = room;
+            if (room < size && !empty)
+                break;
+            out.write(frame, size);
+            pop(now_us);
+        }
+        return count;
+    }
+
+    /// The number of frames sent, replaced by a newer frame, and dropped as
+    /// the queue was full
+    uint32_t numSent, numReplaced, numDropped;
+
+    /// The total, and most, time (in microseconds) from a frame being put
+    /// in the mailbox until it was sent
+    uint64_t totalAge_us;
+    uint32_t maxAge_us;
+
+private:
+    /// A frame waiting to be sent
+    struct Entry
+    {
+        /// The size of the frame, 0 if there is none
+        uint16_t size;
+
+        /// When the frame was put in the mailbox (in microseconds)
+        uint32_t put_us;
+    };
+
+    /// The slots of the data frame and lights frame
+    enum { dataFrameSlot, lightsSlot, numSlots };
+
+    /// The size of the largest frame in a slot
+    static constexpr size_t slotSize = payload_ofs + sizeof(H2BDataFrame) + 4;
+
+    /// Where the frame returned by peek() is: a slot, or the queue (-1)
+    int next() const;
+
+    /// The frames in the slots
+    uint8_t slots[numSlots][slotSize];
+    Entry slotEntries[numSlots];
+
+    /// The queue of the frames that must each be delivered
+    uint8_t queue[H2B_MAILBOX_QUEUE_DEPTH][maxFrameSize];
+    Entry queueEntries[H2B_MAILBOX_QUEUE_DEPTH];
+
+    /// The number of frames put in, and taken out of, the queue
+    uint32_t numQueued, numDequeued;
+
+    /// The most room the stream has reported, taken as the size of its
+    /// transmit buffer; 0 until it has been seen
+    size_t txBufferSize;
+};
+
+}
@@ -0,0 +1,355 @@
+/* Lossless coding of the microphone samples
+   Copyright 2024 Randall Maas
+*//**@file
+    @brief Lossless coding of the microphone samples.
+
+    This file contains the bit packing, the predictors, and the Rice coding
+    of the residuals.
+*/
+#include <Arduino.h>
+#include <string.h>
+#include "miccodec.h"
+
+namespace Spine {
+
+/// The largest fixed predictor order
+#define MAX_ORDER (3)
+
+/// The largest Rice parameter
+#define MAX_RICE (31)
+
+/// The unary upper bits at which a residual is escaped, and coded in 32 bits
+#define RICE_ESCAPE (24)
+
+
+/// Packs bits into bytes, the most significant bit first
+struct BitWriter
+{
+    uint8_t* out;
+    size_t   size;
+    size_t   pos;
+    uint64_t bits;
+    unsigned numBits;
+    bool     overflow;
+
+    BitWriter(uint8_t* out, size_t size) : out(out), size(size), pos(0), bits(0), numBits(0), overflow(false) {}
+
+    /// Append the lower count bits of value (up to 32)
+    void put(uint32_t value, unsigned count)
+    {
+        bits = (bits << count) | (value & (uint32_t)((1ULL << count) - 1));
+        numBits += count;
+        while (numBits >= 8)
+        {
+            numBits -= 8;
+            if (pos < size)
+                out[pos++] = (uint8_t)(bits >> numBits);
+            else
+                overflow = true;
+        }
+    }
+
+    /// Pad the last byte with zeros
+    size_t finish()
+    {
+        if (numBits)
+            put(0, 8 - numBits);
+        return overflow ? 0 : pos;
+    }
+};
+
+
+/// Unpacks the bits from bytes, the most significant bit first
+struct BitReader
+{
+    const uint8_t* in;
+    size_t   size;
+    size_t   pos;
+    uint64_t bits;
+    unsigned numBits;
+    bool     overrun;
+
+    BitReader(const uint8_t* in, size_t size) : in(in), size(size), pos(0), bits(0), numBits(0), overrun(false) {}
+
+    /// Take the next count bits (up to 32)
+    uint32_t get(unsigned count)
+    {
+        while (numBits < count)
+        {
+            bits = (bits << 8) | (pos < size ? in[pos] : 0);
+            overrun |= pos >= size;
+            pos++;
+            numBits += 8;
+        }
+        numBits -= count;
+        return (uint32_t)((bits >> numBits) & ((1ULL << count) - 1));
+    }
+};
+
+
+/** The residual of a fixed polynomial predictor
+    @param signal the samples
+    @param idx the index of the sample
+    @param order the order of the predictor; lowered for the first samples
+    @return the residual
+*/
+static inline int32_t residual(const int32_t* signal, size_t idx, unsigned order)
+{
+    if (order > idx)
+        order = (unsigned) idx;
+    auto s = signal + idx;
+    switch (order)
+    {
+        default:
+        case 0: return s[0];
+        case 1: return s[0] - s[-1];
+        case 2: return s[0] - 2*s[-1] + s[-2];
+        case 3: return s[0] - 3*s[-1] + 3*s[-2] - s[-3];
+    }
+}
+
+
+/** Undo the fixed polynomial predictor
+    @param signal the samples decoded so far
+    @param idx the index of the sample
+    @param order the order of the predictor
+    @param value the residual
+    @return the sample
+*/
+static inline int32_t restore(const int32_t* signal, size_t idx, unsigned order, int32_t value)
+{
+    if (order > idx)
+        order = (unsigned) idx;
+    auto s = signal + idx;
+    switch (order)
+    {
+        default:
+        case 0: return value;
+        case 1: return value + s[-1];
+        case 2: return value + 2*s[-1] - s[-2];
+        case 3: return value + 3*s[-1] - 3*s[-2] + s[-3];
+    }
+}
+
+
+/// Map a signed residual to unsigned: 0, -1, 1, -2, ... to 0, 1, 2, 3, ...
+static inline uint32_t zigzag(int32_t value)
+{
+    return ((uint32_t) value << 1) ^ (uint32_t)(value >> 31);
+}
+
+/// Undo zigzag()
+static inline int32_t unzigzag(uint32_t value)
+{
+    return (int32_t)(value >> 1) ^ -(int32_t)(value & 1);
+}
+
+
+/** The number of bits to Rice code the residuals
+    @param values the zigzagged residuals
+    @param k the Rice parameter
+    @return the number of bits
+*/
+static uint32_t riceBits(const uint32_t* values, uint32_t k)
+{
+    uint32_t total = 0;
+    for (size_t idx = 0; idx < MICROPHONE_SAMPLES_PER_FRAME; idx++)
+    {
+        auto q = values[idx] >> k;
+        total += q < RICE_ESCAPE ? q + 1 + k : RICE_ESCAPE + 32;
+    }
+    return total;
+}
+
+
+MicEncoder::MicEncoder()
+: numBlocks(0)
+, numSampleBytes(0)
+, numCodedBytes(0)
+{
+}
+
+
+/** Code the microphone samples of a data frame
+    @param frame the data frame from the body board
+    @param out where to put the block
+    @param out_size the size of the out buffer; micBlockMaxSize is
+           always enough
+    @return the size of the block, or 0 if the out buffer is too small
+*/
+size_t MicEncoder::encode(const B2HDataFrame& frame, uint8_t* out, size_t out_size)
+{
+    static_assert(MAX_RICE < 32 && MAX_ORDER < 4, "The coding of a microphone is packed in a byte");
+
+    // split the microphones
+    int32_t signals[MICROPHONE_COUNT][MICROPHONE_SAMPLES_PER_FRAME];
+    for (size_t idx = 0; idx < MICROPHONE_SAMPLES_PER_FRAME; idx++)
+        for (size_t mic = 0; mic < MICROPHONE_COUNT; mic++)
+            signals[mic][idx] = frame.mic_samples[idx*MICROPHONE_COUNT + mic];
+
+    BitWriter writer(out, out_size);
+    writer.put(frame.sequenceNumber, 32);
+
+    // pick the coding of each microphone, and write it
+    uint32_t values[MICROPHONE_COUNT][MICROPHONE_SAMPLES_PER_FRAME];
+    uint32_t ks[MICROPHONE_COUNT];
+    for (size_t mic = 0; mic < MICROPHONE_COUNT; mic++)
+    {
+        int32_t difference[MICROPHONE_SAMPLES_PER_FRAME];
+        for (size_t idx = 0; idx < MICROPHONE_SAMPLES_PER_FRAME; idx++)
+            difference[idx] = signals[mic][idx] - signals[0][idx];
+
+        // the coding and order with the smallest residuals
+        unsigned bestMode = 0, bestOrder = 0;
+        uint64_t bestSum = UINT64_MAX;
+        for (unsigned mode = 0; mode < (mic ? 2u : 1u); mode++)
+        {
+            auto signal = mode ? difference : signals[mic];
+            for (unsigned order = 0; order <= MAX_ORDER; order++)
+            {
+                uint64_t sum = 0;
+                for (size_t idx = 0; idx < MICROPHONE_SAMPLES_PER_FRAME; idx++)
+                {
+                    auto value = residual(signal, idx, order);
+                    sum += value < 0 ? -(int64_t) value : value;
+                }
+                if (sum < bestSum)
+                {
+                    bestSum   = sum;
+                    bestMode  = mode;
+                    bestOrder = order;
+                }
+            }
+        }
+        auto signal = bestMode ? difference : signals[mic];
+        for (size_t idx = 0; idx < MICROPHONE_SAMPLES_PER_FRAME; idx++)
+            values[mic][idx] = zigzag(residual(signal, idx, bestOrder));
+
+        // the Rice parameter: try those near the log2 of the mean residual
+        auto mean = 2*bestSum / MICROPHONE_SAMPLES_PER_FRAME;
+        uint32_t estimate = 0;
+        while (estimate < MAX_RICE && (mean >> (estimate+1)))
+            estimate++;
+        uint32_t bestK = estimate, bestBits = riceBits(values[mic], estimate);
+        for (uint32_t k = estimate ? estimate-1 : 0; k <= estimate+1 && k <= MAX_RICE; k++)
+        {
+            auto bits = riceBits(values[mic], k);
+            if (bits < bestBits)
+            {
+                bestBits = bits;
+                bestK    = k;
+            }
+        }
+        ks[mic] = bestK;
+        writer.put(bestMode << 7 | bestOrder << 5 | bestK, 8);
+    }
+
+    // the residuals
+    for (size_t mic = 0; mic < MICROPHONE_COUNT; mic++)
+    {
+        auto k = ks[mic];
+        for (size_t idx = 0; idx < MICROPHONE_SAMPLES_PER_FRAME; idx++)
+        {
+            auto value = values[mic][idx];
+            auto q = value >> k;
+            if (q < RICE_ESCAPE)
+            {
+                // q ones, a zero, then the lower k bits
+                writer.put(((1UL << q) - 1) << 1, q + 1);
+                writer.put(value, k);
+            }
+            else
+            {
+                writer.put((1UL << RICE_ESCAPE) - 1, RICE_ESCAPE);
+                writer.put(value, 32);
+            }
+        }
+    }
+
+    auto size = writer.finish();
+    if (size)
+    {
+        numBlocks++;
+        numSampleBytes += sizeof(frame.mic_samples);
+        numCodedBytes  += size;
+    }
+    return size;
+}
+
+
+MicDecoder::MicDecoder()
+: numBlocks(0)
+, numGaps(0)
+, numMissing(0)
+, nextSequenceNumber(0)
+{
+}
+
+
+/** Decode a block
+    @param in the block
+    @param in_size the number of bytes available
+    @param sequenceNumber the sequence number of the frame
+    @param samples the samples of the frame (micBlockSamples of them,
+           interleaved as in the frame)
+    @return the size of the block, or 0 if it is bad (or truncated)
+
+    The frames missing between this block and the previous one are
+    added to numMissing.
+*/
+size_t MicDecoder::decode(const uint8_t* in, size_t in_size, uint32_t& sequenceNumber, int16_t* samples)
+{
+    BitReader reader(in, in_size);
+    sequenceNumber = reader.get(32);
+    unsigned modes[MICROPHONE_COUNT], orders[MICROPHONE_COUNT], ks[MICROPHONE_COUNT];
+    for (size_t mic = 0; mic < MICROPHONE_COUNT; mic++)
+    {
+        auto coding = reader.get(8);
+        modes [mic] = coding >> 7;
+        orders[mic] = (coding >> 5) & 3;
+        ks    [mic] = coding & 31;
+        if (!mic && modes[mic])
+            return 0;
+    }
+
+    int32_t signals[MICROPHONE_COUNT][MICROPHONE_SAMPLES_PER_FRAME];
+    for (size_t mic = 0; mic < MICROPHONE_COUNT; mic++)
+    {
+        auto k = ks[mic];
+        auto signal = signals[mic];
+        for (size_t idx = 0; idx < MICROPHONE_SAMPLES_PER_FRAME; idx++)
+        {
+            uint32_t q = 0;
+            while (q < RICE_ESCAPE && reader.get(1))
+                q++;
+            auto value = q < RICE_ESCAPE ? (q << k) | reader.get(k) : reader.get(32);
+            signal[idx] = restore(signal, idx, orders[mic], unzigzag(value));
+        }
+        if (reader.overrun)
+            return 0;
+
+        // the difference from the first microphone
+        if (modes[mic])
+            for (size_t idx = 0; idx < MICROPHONE_SAMPLES_PER_FRAME; idx++)
+                signal[idx] += signals[0][idx];
+    }
+
+    for (size_t idx = 0; idx < MICROPHONE_SAMPLES_PER_FRAME; idx++)
+        for (size_t mic = 0; mic < MICROPHONE_COUNT; mic++)
+            samples[idx*MICROPHONE_COUNT + mic] = (int16_t) signals[mic][idx];
+
+    // note the frames missing before this one
+    if (numBlocks && sequenceNumber != nextSequenceNumber)
+    {
+        numGaps++;
+        // a jump back is the body board restarting, not missing frames
+        auto missing = sequenceNumber - nextSequenceNumber;
+        if (missing < 0x80000000UL)
+            numMissing += missing;
+    }
+    nextSequenceNumber = sequenceNumber + 1;
+    numBlocks++;
+    return reader.pos;
+}
+
+}
@@ -0,0 +1,105 @@
+/* Lossless coding of the microphone samples
+   Copyright 2024 Randall Maas
+*//**@file
+    @brief Lossless coding of the microphone samples.
+
+    The microphone samples of each data frame from the body board (80 samples
+    from each of the 4 microphones) are coded into a block, independent of
+    the other blocks, that decodes to exactly the same samples.  A capture of
+    the microphones is a run of these blocks.
+
+    Each block holds the frame's sequence number, so that the decoder can
+    tell where frames are missing (see MicDecoder).  Then, for each
+    microphone:
+
+    - Whether the samples are coded as they are, or as the difference from
+      the first microphone.  The microphones hear much the same sound, so
+      the difference is often smaller.
+    - The order (0 to 3) of the fixed polynomial predictor.  Each sample is
+      predicted from the ones before it (e.g. order 2 predicts
+      2*x[n-1] - x[n-2]), and only the error (the residual) is coded.  The
+      first samples of the block use lower orders, as they have fewer
+      samples before them.
+    - The Rice parameter k for the residuals: each residual is coded as its
+      upper bits in unary, and its lower k bits as is.  Small residuals take
+      few bits.  A residual too large for that is escaped, and coded in full.
+
+    The encoder picks the coding, and the order, that give the smallest
+    residuals for each microphone.
+
+    The samples are taken to be interleaved in the frame
+    (mic_samples[sample*MICROPHONE_COUNT + microphone]).  If they aren't,
+    the coding is still lossless, but it doesn't compress as well.
+*/
+#pragma once
+#include <inttypes.h>
+#include <stddef.h>
+#include "spine.h"
+
+namespace Spine {
+
+/// The number of microphone samples in a block
+constexpr size_t micBlockSamples = MICROPHONE_SAMPLES_PER_FRAME*MICROPHONE_COUNT;
+
+/// The largest size of a block (in bytes): the sequence number, the
+/// coding of each microphone, and each residual escaped
+constexpr size_t micBlockMaxSize = 4 + MICROPHONE_COUNT + (micBlockSamples * (24 + 32) + 7) / 8;
+
+
+/** Codes the microphone samples of the data frames
+*/
+class MicEncoder
+{
+public:
+    MicEncoder();
+
+    /** Code the microphone samples of a data frame
+        @param frame the data frame from the body board
+        @param out where to put the block
+        @param out_size the size of the out buffer; micBlockMaxSize is
+               always enough
+        @return the size of the block, or 0 if the out buffer is too small
+    */
+    size_t encode(const B2HDataFrame& frame, uint8_t* out, size_t out_size);
+
+    /// The number of blocks coded
+    size_t numBlocks;
+
+    /// The number of bytes of samples, and of the blocks
+    uint64_t numSampleBytes, numCodedBytes;
+};
+
+
+/** Decodes the blocks of microphone samples, noting the missing frames
+*/
+class MicDecoder
+{
+public:
+    MicDecoder();
+
+    /** Decode a block
+        @param in the block
+        @param in_size the number of bytes available
+        @param sequenceNumber the sequence number of the frame
+        @param samples the samples of the frame (micBlockSamples of them,
+               interleaved as in the frame)
+        @return the size of the block, or 0 if it is bad (or truncated)
+
+        The frames missing between this block and the previous one are
+        added to numMissing.
+    */
+    size_t decode(const uint8_t* in, size_t in_size, uint32_t& sequenceNumber, int16_t* samples);
+
+    /// The number of blocks decoded
+    size_t numBlocks;
+
+    /// The number of gaps in the sequence numbers, and the number of frames
+    /// missing in them
+    size_t numGaps, numMissing;
+
+private:
+    /// The sequence number of the next frame
+    uint32_t nextSequenceNumber;
+};
+
+}
@@ -0,0 +1,417 @@
+/* pcapng files of the frames, for the standard packet tools
+   Copyright 2024 Randall Maas
+*//**@file
+    @brief pcapng files of the frames, for the standard packet tools.
+
+    This file contains the layout of the blocks, the writer and the reader.
+*/
+#include <Arduino.h>
+#include <string.h>
+#include "pcapng.h"
+
+namespace Spine {
+
+/// The block types
+enum : uint32_t
+{
+    /// Section Header Block
+    pcapngSectionHeader = 0x0A0D0D0AUL,
+
+    /// Interface Description Block
+    pcapngInterface = 1,
+
+    /// Enhanced Packet Block
+    pcapngEnhancedPacket = 6
+};
+
+/// The byte order magic of the section header, in the host's order
+constexpr uint32_t pcapngByteOrder = 0x1A2B3C4DUL;
+
+/// The option codes
+enum : uint16_t
+{
+    optEndOfOpt  = 0,
+    shbUserAppl  = 4,
+    ifName       = 2,
+    ifTsresol    = 9,
+    ifFcslen     = 13,
+    epbFlags     = 2
+};
+
+/// The fixed part of an Enhanced Packet Block: the type, length, interface,
+/// time stamp (high and low), and the captured and original lengths
+constexpr size_t epbHeaderSize = 28;
+
+/// The epb_flags option, the end of the options, and the trailing length
+constexpr size_t epbTrailerSize = 16;
+
+/// The size of a value padded to 32 bits
+#define PAD4(size) (((size) + 3) & ~(size_t) 3)
+
+/// Store a 16 bit value, in the host's byte order
+static inline void put16(uint8_t* ptr, uint16_t value) { memcpy(ptr, &value, 2); }
+
+/// Store a 32 bit value, in the host's byte order
+static inline void put32(uint8_t* ptr, uint32_t value) { memcpy(ptr, &value, 4); }
+
+/// Load a 16 bit value, in the host's byte order
+static inline uint16_t get16(const uint8_t* ptr) { uint16_t value; memcpy(&value, ptr, 2); return value; }
+
+/// Load a 32 bit value, in the host's byte order
+static inline uint32_t get32(const uint8_t* ptr) { uint32_t value; memcpy(&value, ptr, 4); return value; }
+
+
+/** Store an option
+    @param ptr where to put the option
+    @param code the option code
+    @param value the value
+    @param length the length of the value
+    @return the number of bytes stored, with the padding
+*/
+static size_t putOption(uint8_t* ptr, uint16_t code, const void* value, uint16_t length)
+{
+    put16(ptr, code);
+    put16(ptr+2, length);
+    memset(ptr+4, 0, PAD4(length));
+    memcpy(ptr+4, value, length);
+    return 4 + PAD4(length);
+}
+
+
+/** Convert a time stamp to nanoseconds
+    @param timestamp the time stamp
+    @param tsresol the resolution of the time stamps (if_tsresol)
+    @return the time (in nanoseconds)
+*/
+static uint64_t toNanoseconds(uint64_t timestamp, uint8_t tsresol)
+{
+    // a negative power of 2
+    if (tsresol & 0x80)
+        return (uint64_t)((long double) timestamp * 1e9L / (long double)(1ULL << (tsresol & 0x3F)));
+
+    // a negative power of 10
+    uint64_t scale = 1;
+    for (int idx = tsresol; idx < 9; idx++)
+        scale *= 10;
+    if (tsresol <= 9)
+        return timestamp * scale;
+    for (int idx = 9; idx < tsresol && timestamp; idx++)
+        timestamp /= 10;
+    return timestamp;
+}
+
+
+PcapngWriter::PcapngWriter()
+: numFrames(0)
+, file(nullptr)
+, used(0)
+{
+}
+
+
+PcapngWriter::~PcapngWriter()
+{
+    close();
+}
+
+
+/** Create a pcapng file, with its section header and interface
+    @param path the path of the file
+    @return true on success, false on error
+*/
+bool PcapngWriter::open(const char* path)
+{
+    close();
+    numFrames = 0;
+    file = fopen(path, "wb");
+    if (!file)
+        return false;
+    // the blocks are buffered here
+    setvbuf(file, nullptr, _IONBF, 0);
+
+    // the section header
+    auto ptr = buffer;
+    put32(ptr, pcapngSectionHeader);
+    put32(ptr+8, pcapngByteOrder);
+    put16(ptr+12, 1);
+    put16(ptr+14, 0);
+    memset(ptr+16, 0xFF, 8);
+    size_t size = 24;
+    size += putOption(ptr+size, shbUserAppl, "Vector.spine", 12);
+    size += putOption(ptr+size, optEndOfOpt, nullptr, 0);
+    put32(ptr+4, (uint32_t)(size + 4));
+    put32(ptr+size, (uint32_t)(size + 4));
+    ptr += size + 4;
+
+    // the interface, with nanosecond time stamps and no CRC in the packets
+    const uint8_t nanoseconds = 9, noCrc = 0;
+    put32(ptr, pcapngInterface);
+    put16(ptr+8, pcapngLinkType);
+    put16(ptr+10, 0);
+    put32(ptr+12, 0);
+    size = 16;
+    size += putOption(ptr+size, ifName, "spine", 5);
+    size += putOption(ptr+size, ifTsresol, &nanoseconds, 1);
+    size += putOption(ptr+size, ifFcslen, &noCrc, 1);
+    size += putOption(ptr+size, optEndOfOpt, nullptr, 0);
+    put32(ptr+4, (uint32_t)(size + 4));
+    put32(ptr+size, (uint32_t)(size + 4));
+    ptr += size + 4;
+
+    used = ptr - buffer;
+    return true;
+}
+
+
+/** Write a frame
+    @param b2h true for a frame from the body board, false from the head board
+    @param message_type the type of the message
+    @param payload the payload
+    @param payload_size the size of the payload
+    @param timestamp_ns the time the frame was received (in nanoseconds)
+    @param crcError true if the CRC of the frame failed
+    @return true on success, false on error
+*/
+bool PcapngWriter::write(bool b2h, MessageType message_type, const uint8_t* payload, size_t payload_size, uint64_t timestamp_ns, bool crcError)
+{
+    auto length = payload_ofs + payload_size;
+    auto size = epbHeaderSize + PAD4(length) + epbTrailerSize;
+    if (!file || payload_size > UINT16_MAX || size > sizeof(buffer))
+        return false;
+    if (used + size > sizeof(buffer) && !flush())
+        return false;
+
+    auto ptr = buffer + used;
+    put32(ptr     , pcapngEnhancedPacket);
+    put32(ptr +  4, (uint32_t) size);
+    put32(ptr +  8, 0);
+    put32(ptr + 12, (uint32_t)(timestamp_ns >> 32));
+    put32(ptr + 16, (uint32_t) timestamp_ns);
+    put32(ptr + 20, (uint32_t) length);
+    put32(ptr + 24, (uint32_t) length);
+
+    // the frame, as on the wire, without the CRC
+    auto packet = ptr + epbHeaderSize;
+    packet[0] = 0xAA;
+    memcpy(packet+1, b2h ? "B2H" : "H2B", 3);
+    put16(packet+4, (uint16_t) message_type);
+    put16(packet+payload_size_ofs, (uint16_t) payload_size);
+    memcpy(packet+payload_ofs, payload, payload_size);
+    memset(packet+length, 0, PAD4(length) - length);
+
+    // the direction and CRC status
+    auto options = packet + PAD4(length);
+    put16(options    , epbFlags);
+    put16(options + 2, 4);
+    put32(options + 4, (b2h ? (uint32_t) pcapngInbound : (uint32_t) pcapngOutbound) | (crcError ? (uint32_t) pcapngCrcError : 0u));
+    put32(options + 8, optEndOfOpt);
+    put32(options + 12, (uint32_t) size);
+
+    used += size;
+    numFrames++;
+    return true;
+}
+
+
+/** Write out what is buffered
+    @return true on success, false on error
+*/
+bool PcapngWriter::flush()
+{
+    bool ok = !used || fwrite(buffer, used, 1, file) == 1;
+    used = 0;
+    return ok;
+}
+
+
+/** Write what is buffered, and close the file
+    @return true on success, false on error
+*/
+bool PcapngWriter::close()
+{
+    if (!file)
+        return true;
+    bool ok = flush();
+    ok = !fclose(file) && ok;
+    file = nullptr;
+    return ok;
+}
+
+
+PcapngReader::PcapngReader()
+: numBlocks(0)
+, numSkipped(0)
+, file(nullptr)
+, start(0)
+, end(0)
+, numInterfaces(0)
+{
+}
+
+
+PcapngReader::~PcapngReader()
+{
+    close();
+}
+
+
+/** Open a pcapng file
+    @param path the path of the file
+    @return true on success, false on error
+*/
+bool PcapngReader::open(const char* path)
+{
+    close();
+    file = fopen(path, "rb");
+    if (!file)
+        return false;
+    // the blocks are read in large pieces here
+    setvbuf(file, nullptr, _IONBF, 0);
+    return true;
+}
+
+
+/// Close the file
+void PcapngReader::close()
+{
+    if (file)
+        fclose(file);
+    file          = nullptr;
+    start = end   = 0;
+    numInterfaces = 0;
+    numBlocks     = 0;
+    numSkipped    = 0;
+}
+
+
+/** Read more of the file into the buffer
+    @param size the number of bytes needed from where the next block starts
+    @return true if they are there, false at the end of the file
+*/
+bool PcapngReader::fill(size_t size)
+{
+    if (end - start >= size)
+        return true;
+    if (!file || size > sizeof(buffer))
+        return false;
+    memmove(buffer, buffer + start, end - start);
+    end  -= start;
+    start = 0;
+    while (end < size)
+    {
+        auto num = fread(buffer + end, 1, sizeof(buffer) - end, file);
+        if (!num)
+            return false;
+        end += num;
+    }
+    return true;
+}
+
+
+/** Read an interface description
+    @param block the block
+    @param size the size of the block
+*/
+void PcapngReader::addInterface(const uint8_t* block, size_t size)
+{
+    // microseconds, unless the options say otherwise
+    Interface interface = {size >= 20 && get16(block+8) == pcapngLinkType, 6};
+    for (size_t ofs = 16; ofs + 4 <= size - 4; )
+    {
+        auto code = get16(block+ofs), length = get16(block+ofs+2);
+        if (code == optEndOfOpt || ofs + 4 + length > size - 4)
+            break;
+        if (code == ifTsresol && length >= 1)
+            interface.tsresol = block[ofs+4];
+        ofs += 4 + PAD4(length);
+    }
+    if (numInterfaces < maxInterfaces)
+        interfaces[numInterfaces] = interface;
+    numInterfaces++;
+}
+
+
+/** Get the next frame
+    @param frame the frame; the payload is valid until the next frame is
+           read
+    @return true if there is a frame, false at the end of the file or on
+            an error
+*/
+bool PcapngReader::next(PcapngFrame& frame)
+{
+    for (;;)
+    {
+        if (!fill(8))
+            return false;
+        size_t size = get32(buffer + start + 4);
+        if (size < 12 || size % 4 || !fill(size))
+            return false;
+        auto block = buffer + start;
+        start += size;
+        numBlocks++;
+
+        switch (get32(block))
+        {
+            case pcapngSectionHeader:
+                // a new section has its own interfaces
+                if (size < 28 || get32(block+8) != pcapngByteOrder)
+                    return false;
+                numInterfaces = 0;
+                continue;
+
+            case pcapngInterface:
+                addInterface(block, size);
+                continue;
+
+            case pcapngEnhancedPacket:
+                break;
+
+            default:
+                numSkipped++;
+                continue;
+        }
+
+        // the packet must be a whole spine frame, on a spine interface
+        auto idx = get32(block+8);
+        size_t length = size >= epbHeaderSize + 4 ? get32(block+20) : 0;
+        auto packet = block + epbHeaderSize;
+        if (idx >= numInterfaces || idx >= maxInterfaces || !interfaces[idx].spine
+            || length < payload_ofs || epbHeaderSize + PAD4(length) + 4 > size
+            || packet[0] != 0xAA || get16(packet+payload_size_ofs) != length - payload_ofs)
+        {
+            numSkipped++;
+            continue;
+        }
+        bool b2h = !memcmp(packet+1, "B2H", 3);
+        if (!b2h && memcmp(packet+1, "H2B", 3))
+        {
+            numSkipped++;
+            continue;
+        }
+
+        // the direction and CRC status
+        uint32_t flags = 0;
+        for (size_t ofs = epbHeaderSize + PAD4(length); ofs + 4 <= size - 4; )
+        {
+            auto code = get16(block+ofs), optLength = get16(block+ofs+2);
+            if (code == optEndOfOpt || ofs + 4 + optLength > size - 4)
+                break;
+            if (code == epbFlags && optLength == 4)
+                flags = get32(block+ofs+4);
+            ofs += 4 + PAD4(optLength);
+        }
+        if (flags & pcapngDirection)
+            b2h = (flags & pcapngDirection) == pcapngInbound;
+
+        uint64_t timestamp = (uint64_t) get32(block+12) << 32 | get32(block+16);
+        frame.timestamp_ns = toNanoseconds(timestamp, interfaces[idx].tsresol);
+        frame.type         = (MessageType) get16(packet+4);
+        frame.b2h          = b2h;
+        frame.size         = length - payload_ofs;
+        frame.payload      = packet + payload_ofs;
+        frame.crcError     = (flags & pcapngCrcError) != 0;
+        return true;
+    }
+}
+
+}
@@ -0,0 +1,191 @@
+/* pcapng files of the frames, for the standard packet tools
+   Copyright 2024 Randall Maas
+*//**@file
+    @brief pcapng files of the frames, for the standard packet tools.
+
+    The frames can be written to (and read back from) pcapng files, so that
+    the packet tools (filtering, timelines, statistics) can be used on them.
+    Each frame is a packet, in an Enhanced Packet Block:
+
+    - The packet is the frame as it was on the wire -- the sync bytes, the
+      message type and size, and the payload -- without the CRC, as an
+      Ethernet capture leaves out the FCS (if_fcslen is 0).
+    - The link type is LINKTYPE_USER0 (147); a dissector can tell the
+      direction, and the message type, from the header.
+    - The time stamps are in nanoseconds (if_tsresol is 9).
+    - The direction is in the epb_flags: inbound for the frames from the
+      body board, outbound for the frames from the head board (as seen by
+      the head board).
+    - A frame whose CRC failed has bit 24 of the epb_flags (a CRC error) set.
+
+    The files are written and read through buffers of PCAPNG_BUFFER_SIZE,
+    and the packets are read in place:
+
+    @code
+    PcapngReader reader;
+    reader.open("day.pcapng");
+    PcapngFrame frame;
+    while (reader.next(frame))
+        ... use frame.payload ...
+    @endcode
+
+    The reader takes the files of other tools: it skips the blocks, and the
+    interfaces, that aren't spine frames, and takes the time stamps in the
+    resolution of each interface.  Only files in the host's byte order
+    (little endian) are read.
+*/
+#pragma once
+#include <inttypes.h>
+#include <stdio.h>
+#include "spine.h"
+#include "capture.h"
+
+namespace Spine {
+
+/// The link type of the spine frames: LINKTYPE_USER0
+constexpr uint16_t pcapngLinkType = 147;
+
+/// The epb_flags bits
+enum : uint32_t
+{
+    /// The direction: the frames from the body board
+    pcapngInbound  = 1,
+
+    /// The direction: the frames from the head board
+    pcapngOutbound = 2,
+
+    /// The mask of the direction
+    pcapngDirection = 3,
+
+    /// The CRC of the frame failed
+    pcapngCrcError = 1UL << 24
+};
+
+/// A frame read from a pcapng file
+struct PcapngFrame : CaptureFrame
+{
+    /// The CRC of the frame failed
+    bool crcError;
+};
+
+
+/** Writes the frames to a pcapng file
+*/
+class PcapngWriter
+{
+public:
+    PcapngWriter();
+    ~PcapngWriter();
+
+    /** Create a pcapng file, with its section header and interface
+        @param path the path of the file
+        @return true on success, false on error
+    */
+    bool open(const char* path);
+
+    /** Write a frame
+        @param b2h true for a frame from the body board, false from the head board
+        @param message_type the type of the message
+        @param payload the payload
+        @param payload_size the size of the payload
+        @param timestamp_ns the time the frame was received (in nanoseconds)
+        @param crcError true if the CRC of the frame failed
+        @return true on success, false on error
+    */
+    bool write(bool b2h, MessageType message_type, const uint8_t* payload, size_t payload_size, uint64_t timestamp_ns, bool crcError = false);
+
+    /** Write what is buffered, and close the file
+        @return true on success, false on error
+    */
+    bool close();
+
+    /// The number of frames written
+    size_t numFrames;
+
+private:
+    /** Write out what is buffered
+        @return true on success, false on error
+    */
+    bool flush();
+
+    /// The file, null if it isn't open
+    FILE* file;
+
+    /// The number of bytes in the buffer
+    size_t used;
+
+    /// The blocks waiting to be written
+    uint8_t buffer[PCAPNG_BUFFER_SIZE];
+};
+
+
+/** Reads the frames from a pcapng file
+*/
+class PcapngReader
+{
+public:
+    PcapngReader();
+    ~PcapngReader();
+
+    /** Open a pcapng file
+        @param path the path of the file
+        @return true on success, false on error
+    */
+    bool open(const char* path);
+
+    /// Close the file
+    void close();
+
+    /** Get the next frame
+        @param frame the frame; the payload is valid until the next frame is
+               read
+        @return true if there is a frame, false at the end of the file or on
+                an error
+    */
+    bool next(PcapngFrame& frame);
+
+    /// The number of blocks read, and the blocks and packets skipped (not
+    /// spine frames)
+    size_t numBlocks, numSkipped;
+
+private:
+    /** Read more of the file into the buffer
+        @param size the number of bytes needed from where the next block starts
+        @return true if they are there, false at the end of the file
+    */
+    bool fill(size_t size);
+
+    /** Read an interface description
+        @param block the block
+        @param size the size of the block
+    */
+    void addInterface(const uint8_t* block, size_t size);
+
+    /// The file, null if it isn't open
+    FILE* file;
+
+    /// Where the next block starts, and the end of the bytes, in the buffer
+    size_t start, end;
+
+    /// The most interfaces in a section; packets on the others are skipped
+    static constexpr size_t maxInterfaces = 8;
+
+    /// An interface of the section
+    struct Interface
+    {
+        /// The interface has spine frames
+        bool spine;
+
+        /// The resolution of the time stamps (if_tsresol)
+        uint8_t tsresol;
+    };
+
+    /// The interfaces of the section
+    Interface interfaces[maxInterfaces];
+    size_t numInterfaces;
+
+    /// The bytes read
+    uint8_t buffer[PCAPNG_BUFFER_SIZE];
+};
+
+}
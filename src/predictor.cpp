@@ -0,0 +1,113 @@
+/* Frame arrival prediction, to sleep between frames
+   Copyright 2024 Randall Maas
+*//**@file
+    @brief Frame arrival prediction, to sleep between frames.
+
+    This file contains the implementation of the predictor: the filtered
+    estimates of the period and jitter, and the platform sleep.
+*/
+#include <Arduino.h>
+#include "predictor.h"
+#if defined(ARDUINO_ARCH_ESP32)
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#elif defined(__linux__)
+#include <time.h>
+#endif
+
+namespace Spine {
+
+/// The most frames that may be lost between two arrivals before the
+/// predictor starts over
+#define MAX_FRAME_GAP (64)
+
+
+FramePredictor::FramePredictor()
+    : minGuard_us(500), numFrames(0), slept_us(0), numEarlyWakes(0), maxLate_us(0),
+      period_q4(B2H_FRAME_PERIOD_US << 4), jitter_q4(0), lastSequence(0), lastArrival_us(0)
+{
+}
+
+
+/** Learn from the arrival of a data frame
+    @param sequenceNumber the sequence number of the frame
+    @param arrival_us the time (in microseconds) that the frame arrived
+*/
+void FramePredictor::observe(uint32_t sequenceNumber, uint32_t arrival_us)
+{
+    auto gap = sequenceNumber - lastSequence;
+    auto elapsed = arrival_us - lastArrival_us;
+    bool first = !numFrames;
+    lastSequence = sequenceNumber;
+    lastArrival_us = arrival_us;
+    numFrames++;
+
+    // The body board restarted, or there was a long outage; start over
+    if (first || gap == 0 || gap > MAX_FRAME_GAP)
+        return;
+
+    // How far off the prediction was
+    auto predicted = period_us() * gap;
+    if (elapsed > predicted && elapsed - predicted > maxLate_us)
+        maxLate_us = elapsed - predicted;
+    uint32_t error = elapsed > predicted ? elapsed - predicted : predicted - elapsed;
+
+    // A stall that long isn't the cadence; don't learn from it
+    if (elapsed > 4*predicted)
+        return;
+
+    // Filter the period and jitter, with a time constant of 8 frames
+    int32_t sample_q4 = (int32_t)((elapsed << 4) / gap);
+    period_q4 += (sample_q4 - (int32_t) period_q4) / 8;
+    jitter_q4 += ((int32_t)(error << 4) - (int32_t) jitter_q4) / 8;
+}
+
+
+/** The time to sleep before the next frame is due
+    @param now_us the current time (in microseconds)
+    @return the time to sleep (in microseconds), 0 if it is time to look
+*/
+uint32_t FramePredictor::sleepTime(uint32_t now_us) const
+{
+    // Until the period is learned, don't sleep
+    if (numFrames < 2)
+        return 0;
+
+    // Wake up ahead of the frame by a few times the jitter
+    auto guard = 4 * jitter_us();
+    if (guard < minGuard_us)
+        guard = minGuard_us;
+    auto wake_us = nextExpected() - guard;
+    int32_t remaining = (int32_t)(wake_us - now_us);
+    return remaining > 0 ? (uint32_t) remaining : 0;
+}
+
+
+/** Sleep, letting other tasks (or the processor) run
+    @param us the time to sleep (in microseconds)
+
+    On the ESP32 this delays the task; on Linux it sleeps the thread.  The
+    time actually slept can differ: the caller should measure it.
+*/
+void SleepFor(uint32_t us)
+{
+#if defined(ARDUINO_ARCH_ESP32)
+    // The scheduler's resolution is a tick; round down, so as to not
+    // oversleep.  A time shorter than a tick is waited out instead, as
+    // vTaskDelay(0) would only yield.
+    auto ticks = (TickType_t)((uint64_t) us * configTICK_RATE_HZ / 1000000);
+    if (ticks)
+        vTaskDelay(ticks);
+    else
+        delayMicroseconds(us);
+#elif defined(__linux__)
+    struct timespec ts;
+    ts.tv_sec  = us / 1000000;
+    ts.tv_nsec = (us % 1000000) * 1000;
+    clock_nanosleep(CLOCK_MONOTONIC, 0, &ts, nullptr);
+#else
+    (void) us;
+#endif
+}
+
+}
@@ -0,0 +1,98 @@
+/* Frame arrival prediction, to sleep between frames
+   Copyright 2024 Randall Maas
+*//**@file
+    @brief Frame arrival prediction, to sleep between frames.
+
+    The body board sends its data frames at a steady cadence (about every
+    B2H_FRAME_PERIOD_US).  Rather than polling the serial port the whole time,
+    the receive task can sleep until just before the next frame is due.
+
+    The predictor learns the period from the arrival times and the sequence
+    numbers of the frames -- the sequence numbers show how many frames were
+    lost between two arrivals, so a lost frame doesn't look like a long
+    period.  It also tracks the jitter of the arrivals, and wakes early by
+    a guard time of a few times the jitter.
+
+    If bytes arrive while sleeping, the sleep is cut short (the sleep is in
+    short slices, checking for data between each).
+*/
+#pragma once
+#include <inttypes.h>
+#include "spine.h"
+
+namespace Spine {
+
+/** Predict the arrival of the next data frame.
+*/
+class FramePredictor
+{
+public:
+    FramePredictor();
+
+    /** Learn from the arrival of a data frame
+        @param sequenceNumber the sequence number of the frame
+        @param arrival_us the time (in microseconds) that the frame arrived
+    */
+    void observe(uint32_t sequenceNumber, uint32_t arrival_us);
+
+    /** The time that the next frame is expected
+        @return the time (in microseconds)
+    */
+    uint32_t nextExpected() const { return lastArrival_us + period_us(); }
+
+    /** The time to sleep before the next frame is due
+        @param now_us the current time (in microseconds)
+        @return the time to sleep (in microseconds), 0 if it is time to look
+    */
+    uint32_t sleepTime(uint32_t now_us) const;
+
+    /** The learned period
+        @return the period between frames (in microseconds)
+    */
+    uint32_t period_us() const { return period_q4 >> 4; }
+
+    /** The learned jitter
+        @return the mean deviation of the arrivals from their prediction (in microseconds)
+    */
+    uint32_t jitter_us() const { return jitter_q4 >> 4; }
+
+    /// The least time to wake ahead of the expected arrival (in microseconds)
+    uint32_t minGuard_us;
+
+    /// The number of frames observed
+    uint32_t numFrames;
+
+    /// The total time slept (in microseconds)
+    uint64_t slept_us;
+
+    /// The number of sleeps cut short by early data
+    uint32_t numEarlyWakes;
+
+    /// The most that a frame has arrived after its predicted time (in
+    /// microseconds); sleeping must not make this worse
+    uint32_t maxLate_us;
+
+private:
+    /// The learned period, in 1/16ths of a microsecond
+    uint32_t period_q4;
+
+    /// The learned jitter, in 1/16ths of a microsecond
+    uint32_t jitter_q4;
+
+    /// The sequence number of the last frame
+    uint32_t lastSequence;
+
+    /// The time the last frame arrived
+    uint32_t lastArrival_us;
+};
+
+
+/** Sleep, letting other tasks (or the processor) run
+    @param us the time to sleep (in microseconds)
+
+    On the ESP32 this delays the task; on Linux it sleeps the thread.  The
+    time actually slept can differ: the caller should measure it.
+*/
+void SleepFor(uint32_t us);
+
+}
@@ -0,0 +1,147 @@
+/* What is generated from the message schema
+   Copyright 2024 Randall Maas
+*//**@file
+    @brief What is generated from the message schema.
+
+    This file contains the lookup of the field tables, and the printers.
+*/
+#include <Arduino.h>
+#include <stdio.h>
+#include <string.h>
+#include "schema.h"
+
+namespace Spine {
+
+/// The size of an array
+#define COUNT_OF(array) (sizeof(array)/sizeof(array[0]))
+
+/// The most fields of an array that are printed
+#define MAX_PRINTED_FIELDS (8)
+
+
+/** The fields of the payload of a message
+    @param b2h true for the messages from the body board, false for the head board
+    @param message_type the type of the message
+    @param numFields the number of fields
+    @return the fields, or null if the payload has no field table
+*/
+const FieldInfo* Fields(bool b2h, MessageType message_type, size_t& numFields)
+{
+    numFields = 0;
+    if (message_type == MessageType::dataFrame)
+    {
+        numFields = b2h ? COUNT_OF(b2hDataFrameFields) : COUNT_OF(h2bDataFrameFields);
+        return b2h ? b2hDataFrameFields : h2bDataFrameFields;
+    }
+    if (message_type == MessageType::ack && b2h)
+    {
+        numFields = COUNT_OF(ackFields);
+        return ackFields;
+    }
+    if (message_type == MessageType::lights && !b2h)
+    {
+        numFields = COUNT_OF(lightsFields);
+        return lightsFields;
+    }
+    return nullptr;
+}
+
+
+/** Find a field by name
+    @param fields the fields
+    @param numFields the number of fields
+    @param name the name of the field
+    @param length the length of the name
+    @return the field, or null if there is no field with that name
+*/
+const FieldInfo* FindField(const FieldInfo* fields, size_t numFields, const char* name, size_t length)
+{
+    for (size_t idx = 0; idx < numFields; idx++)
+        if (!strncmp(fields[idx].name, name, length) && !fields[idx].name[length])
+            return fields + idx;
+    return nullptr;
+}
+
+
+/// Append printf formatted text to text (of size bytes), advancing length
+#define appendf(format, ...) do{ auto num = snprintf(text+length, length < size ? size-length : 0, format, __VA_ARGS__); if (num > 0) length += num; }while(0)
+
+
+/** Print the fields of a payload, as name=value pairs
+    @param text where to put the text
+    @param size the size of the text buffer
+    @param fields the fields
+    @param numFields the number of fields
+    @param payload the payload
+    @return the length of the text
+
+    The arrays of more than 8 fields are printed as their count.
+*/
+size_t FormatFields(char* text, size_t size, const FieldInfo* fields, size_t numFields, const uint8_t* payload)
+{
+    size_t length = 0;
+    if (size)
+        text[0] = 0;
+    for (size_t idx = 0; idx < numFields; idx++)
+    {
+        auto& field = fields[idx];
+        appendf("%s%s=", idx ? " " : "", field.name);
+        if (field.count == 1)
+            appendf("%ld", (long) ReadField(field, payload));
+        else if (field.count > MAX_PRINTED_FIELDS)
+            appendf("[%u]", (unsigned) field.count);
+        else
+        {
+            for (uint16_t item = 0; item < field.count; item++)
+                appendf("%c%ld", item ? ',' : '[', (long) ReadField(field, payload, item));
+            appendf("%s", "]");
+        }
+    }
+    return length < size ? length : (size ? size-1 : 0);
+}
+
+
+/** Print a message
+    @param text where to put the text
+    @param size the size of the text buffer
+    @param b2h true for the messages from the body board, false for the head board
+    @param message_type the type of the message
+    @param payload the payload
+    @param payload_size the size of the payload
+    @return the length of the text
+*/
+size_t FormatMessage(char* text, size_t size, bool b2h, MessageType message_type, const uint8_t* payload, size_t payload_size)
+{
+    size_t length = 0;
+    if (size)
+        text[0] = 0;
+    auto name = MessageName(message_type);
+    if (name)
+        appendf("%s %s:", b2h ? "B2H" : "H2B", name);
+    else
+        appendf("%s %04X:", b2h ? "B2H" : "H2B", (unsigned) message_type);
+
+    // the text of a data character message
+    if (message_type == MessageType::dataCharacter)
+    {
+        auto& value = *(const DataCharacter*) payload;
+        appendf(" \"%.*s\"", (int) strnlen(value.text, sizeof(value.text)), value.text);
+    }
+    // the fields, if they are known
+    else
+    {
+        size_t numFields;
+        auto fields = Fields(b2h, message_type, numFields);
+        if (fields && length+1 < size)
+        {
+            text[length++] = ' ';
+            length += FormatFields(text+length, size-length, fields, numFields, payload);
+        }
+        else if (!fields)
+            appendf(" %u bytes", (unsigned) payload_size);
+    }
+    return length < size ? length : (size ? size-1 : 0);
+}
+
+#undef appendf
+}
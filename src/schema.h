@@ -0,0 +1,383 @@
+/* What is generated from the message schema
+   Copyright 2024 Randall Maas
+*//**@file
+    @brief What is generated from the message schema.
+
+    The messages are described once: the kinds of messages, with their sizes
+    and payload structs in each direction, in SPINE_MESSAGES (spine.h); and
+    the fields of the data frames in the tables below.  From these come:
+
+    - the size tables, H2B::size() and B2H::size(), and the checks of the
+      payload structs against them (spine.h)
+    - the names of the messages, for printing
+    - the dispatch of a payload, as its struct, to a handler
+    - the offset, type, and count of each field of the data frames, checked
+      against the struct layout at compile time.  The rewrite, filter and
+      capture code use these rather than knowing the structs.
+    - printers of the messages and their fields
+
+    Adding a message, or naming another field, is a change to the schema
+    alone.
+*/
+#pragma once
+#include <inttypes.h>
+#include <stddef.h>
+#include <type_traits>
+#include "spine.h"
+
+namespace Spine {
+
+/** The name of a kind of message
+    @param message_type the type of the message
+    @return the name, or null if it isn't known
+*/
+constexpr const char* MessageName(MessageType message_type)
+{
+    switch (message_type)
+    {
+        default: return nullptr;
+#define SPINE_NAME(type, h2b_size, h2b_payload, b2h_size, b2h_payload) case MessageType::type: return #type;
+        SPINE_MESSAGES(SPINE_NAME)
+#undef SPINE_NAME
+    }
+}
+
+
+/** Pass the payload of a message from the head board to a handler, as its struct
+    @param message_type the type of the message
+    @param payload the payload
+    @param handler called with the payload struct (or the first byte, if the
+           payload has no struct); it returns true if it modified the payload
+    @return what the handler returned, or false if the type isn't sent by the
+            head board
+*/
+template<typename Handler>
+bool DispatchH2B(MessageType message_type, uint8_t* payload, Handler&& handler)
+{
+    switch (message_type)
+    {
+        default: return false;
+#define SPINE_DISPATCH(type, h2b_size, h2b_payload, b2h_size, b2h_payload) \
+        case MessageType::type: return h2b_size >= 0 && handler(*(h2b_payload*) payload);
+        SPINE_MESSAGES(SPINE_DISPATCH)
+#undef SPINE_DISPATCH
+    }
+}
+
+
+/** Pass the payload of a message from the body board to a handler, as its struct
+    @param message_type the type of the message
+    @param payload the payload
+    @param handler called with the payload struct (or the first byte, if the
+           payload has no struct); it returns true if it modified the payload
+    @return what the handler returned, or false if the type isn't sent by the
+            body board
+*/
+template<typename Handler>
+bool DispatchB2H(MessageType message_type, uint8_t* payload, Handler&& handler)
+{
+    switch (message_type)
+    {
+        default: return false;
+#define SPINE_DISPATCH(type, h2b_size, h2b_payload, b2h_size, b2h_payload) \
+        case MessageType::type: return b2h_size >= 0 && handler(*(b2h_payload*) payload);
+        SPINE_MESSAGES(SPINE_DISPATCH)
+#undef SPINE_DISPATCH
+    }
+}
+
+
+/** The fields of the data frame from the body board.
+
+    - FIELD(name): a field, or an array of them
+    - MEMBER(array, member): a member of each struct in an array of structs
+    - BITS(name, offset, bit): a one bit flag, in the word at that offset
+
+    Every byte is listed (other than the reserved bits), in order, so that
+    the layout can be checked against the struct.
+*/
+#define B2H_DATA_FRAME_FIELDS(FIELD, MEMBER, BITS) \
+    FIELD (sequenceNumber) \
+    BITS  (sensorsOn             , offsetof(B2HDataFrame, temperstureStatus)-1, 0) \
+    BITS  (encodersOff           , offsetof(B2HDataFrame, temperstureStatus)-1, 1) \
+    BITS  (headEncoderChanged    , offsetof(B2HDataFrame, temperstureStatus)-1, 2) \
+    BITS  (liftEncoderChanged    , offsetof(B2HDataFrame, temperstureStatus)-1, 3) \
+    FIELD (temperstureStatus) \
+    FIELD (i2cFault) \
+    FIELD (i2cFault_index) \
+    MEMBER(motor, position) \
+    MEMBER(motor, delta) \
+    MEMBER(motor, time) \
+    FIELD (cliffSense) \
+    FIELD (battery_volt) \
+    FIELD (charger_volt) \
+    FIELD (temperature) \
+    BITS  (onCharger             , offsetof(B2HDataFrame, unknown)-2, 0) \
+    BITS  (charging              , offsetof(B2HDataFrame, unknown)-2, 1) \
+    BITS  (disconnect            , offsetof(B2HDataFrame, unknown)-2, 2) \
+    BITS  (overheated            , offsetof(B2HDataFrame, unknown)-2, 3) \
+    BITS  (voltageLow            , offsetof(B2HDataFrame, unknown)-2, 5) \
+    BITS  (shutdown              , offsetof(B2HDataFrame, unknown)-2, 6) \
+    FIELD (unknown) \
+    FIELD (prox_status) \
+    FIELD (prox_sigma_mm) \
+    FIELD (prox_range_mm) \
+    FIELD (prox_signalRate_mcps) \
+    FIELD (prox_ambient) \
+    FIELD (prox_SPADCount) \
+    FIELD (prox_sampleCount) \
+    FIELD (prox_calibrationResult) \
+    FIELD (touchLevel) \
+    FIELD (micError) \
+    FIELD (touchLevel2) \
+    FIELD (reserved_) \
+    FIELD (mic_samples)
+
+/// The fields of the data frame from the head board; see B2H_DATA_FRAME_FIELDS
+#define H2B_DATA_FRAME_FIELDS(FIELD, MEMBER, BITS) \
+    FIELD (sequenceNumber) \
+    FIELD (powerFlags) \
+    FIELD (reserved1) \
+    FIELD (motorPower) \
+    FIELD (ledColors) \
+    FIELD (reserved_)
+
+/// The fields of the acknowledge from the body board; see B2H_DATA_FRAME_FIELDS
+#define ACK_FIELDS(FIELD, MEMBER, BITS) \
+    FIELD (value)
+
+/// The fields of the lights message from the head board; see B2H_DATA_FRAME_FIELDS
+#define LIGHTS_FIELDS(FIELD, MEMBER, BITS) \
+    FIELD (ledColors)
+
+
+/// The type of a field
+enum class FieldType : uint8_t
+{
+    u8, i8, u16, i16, u32, i32
+};
+
+/** The field type of a C++ type
+    @tparam T the type
+    @return the field type
+*/
+template<typename T>
+constexpr FieldType fieldType()
+{
+    static_assert(std::is_integral<T>::value && sizeof(T) <= 4, "The fields are integers of up to 32 bits");
+    return sizeof(T) == 1 ? (std::is_signed<T>::value ? FieldType::i8  : FieldType::u8 )
+         : sizeof(T) == 2 ? (std::is_signed<T>::value ? FieldType::i16 : FieldType::u16)
+         :                  (std::is_signed<T>::value ? FieldType::i32 : FieldType::u32);
+}
+
+/** The size of a field type
+    @param type the field type
+    @return the size (in bytes)
+*/
+constexpr size_t fieldSize(FieldType type)
+{
+    return type == FieldType::u8  || type == FieldType::i8  ? 1
+         : type == FieldType::u16 || type == FieldType::i16 ? 2 : 4;
+}
+
+/// Where a field is in a payload, and how to read it
+struct FieldInfo
+{
+    /// The name of the field, e.g. "cliffSense" or "motor.position"
+    const char* name;
+
+    /// The offset of the (first) field in the payload
+    uint16_t offset;
+
+    /// The type of the field, or of the word holding the bit
+    FieldType type;
+
+    /// The number of fields in the array, 1 if it isn't an array
+    uint16_t count;
+
+    /// The distance between the fields in the array (in bytes)
+    uint16_t stride;
+
+    /// The number of bits, 0 if the field isn't a bit field
+    uint8_t width;
+
+    /// The position of the lowest bit of a bit field
+    uint8_t bit;
+};
+
+/// Describe a field, or an array of them
+#define SPINE_FIELD_INFO(S, name) \
+    {#name, (uint16_t) offsetof(S, name), fieldType<std::remove_all_extents_t<decltype(S::name)>>(), \
+     (uint16_t)(sizeof(S::name) / sizeof(std::remove_all_extents_t<decltype(S::name)>)), \
+     (uint16_t) sizeof(std::remove_all_extents_t<decltype(S::name)>), 0, 0},
+
+/// Describe a member of each struct in an array of structs
+#define SPINE_MEMBER_INFO(S, array, member) \
+    {#array "." #member, (uint16_t)(offsetof(S, array) + offsetof(std::remove_extent_t<decltype(S::array)>, member)), \
+     fieldType<decltype(std::remove_extent_t<decltype(S::array)>::member)>(), \
+     (uint16_t)(sizeof(S::array) / sizeof(S::array[0])), (uint16_t) sizeof(S::array[0]), 0, 0},
+
+/// Describe a one bit flag
+#define SPINE_BITS_INFO(S, name, offset, bit) \
+    {#name, (uint16_t)(offset), fieldType<decltype(S::name)>(), 1, 0, 1, bit},
+
+#define SPINE_B2H_FIELD(name)            SPINE_FIELD_INFO (B2HDataFrame, name)
+#define SPINE_B2H_MEMBER(array, member)  SPINE_MEMBER_INFO(B2HDataFrame, array, member)
+#define SPINE_B2H_BITS(name, offset, bit) SPINE_BITS_INFO (B2HDataFrame, name, offset, bit)
+/// The fields of the data frame from the body board
+inline constexpr FieldInfo b2hDataFrameFields[] =
+{
+    B2H_DATA_FRAME_FIELDS(SPINE_B2H_FIELD, SPINE_B2H_MEMBER, SPINE_B2H_BITS)
+};
+#undef SPINE_B2H_FIELD
+#undef SPINE_B2H_MEMBER
+#undef SPINE_B2H_BITS
+
+#define SPINE_H2B_FIELD(name)            SPINE_FIELD_INFO (H2BDataFrame, name)
+/// The fields of the data frame from the head board
+inline constexpr FieldInfo h2bDataFrameFields[] =
+{
+    H2B_DATA_FRAME_FIELDS(SPINE_H2B_FIELD, , )
+};
+#undef SPINE_H2B_FIELD
+
+#define SPINE_ACK_FIELD(name)            SPINE_FIELD_INFO (Ack, name)
+/// The fields of the acknowledge from the body board
+inline constexpr FieldInfo ackFields[] =
+{
+    ACK_FIELDS(SPINE_ACK_FIELD, , )
+};
+#undef SPINE_ACK_FIELD
+
+#define SPINE_LIGHTS_FIELD(name)         SPINE_FIELD_INFO (Lights, name)
+/// The fields of the lights message from the head board
+inline constexpr FieldInfo lightsFields[] =
+{
+    LIGHTS_FIELDS(SPINE_LIGHTS_FIELD, , )
+};
+#undef SPINE_LIGHTS_FIELD
+
+
+/** Check that the fields are in order, and cover every byte of the struct
+    @param fields the fields
+    @param numFields the number of fields
+    @param size the size of the struct
+    @return true if the fields match the layout of the struct
+*/
+constexpr bool checkLayout(const FieldInfo* fields, size_t numFields, size_t size)
+{
+    // the end of the fields so far
+    size_t end = 0;
+    // the start of an array of structs, and the end of its members so far
+    size_t arrayStart = 0, elementEnd = 0, stride = 0;
+    for (size_t idx = 0; idx < numFields; idx++)
+    {
+        auto& field = fields[idx];
+        auto width = fieldSize(field.type);
+
+        // the bits of one word follow each other
+        if (field.width && idx && fields[idx-1].width && fields[idx-1].offset == field.offset)
+            continue;
+
+        // a member of an array of structs
+        if (field.stride > width)
+        {
+            // the next member of the same array
+            if (elementEnd && field.offset == elementEnd && field.stride == stride)
+            {
+                elementEnd += width;
+                continue;
+            }
+            if (field.offset != end)
+                return false;
+            arrayStart = field.offset;
+            elementEnd = field.offset + width;
+            stride = field.stride;
+            end = field.offset + field.count * field.stride;
+            continue;
+        }
+
+        // the members must cover the struct
+        if (elementEnd && elementEnd != arrayStart + stride)
+            return false;
+        elementEnd = 0;
+        if (field.offset != end)
+            return false;
+        end = field.offset + (field.count-1) * field.stride + width;
+    }
+    return (!elementEnd || elementEnd == arrayStart + stride) && end == size;
+}
+
+static_assert(checkLayout(b2hDataFrameFields, sizeof(b2hDataFrameFields)/sizeof(b2hDataFrameFields[0]), sizeof(B2HDataFrame)), "The B2HDataFrame fields don't match the struct");
+static_assert(checkLayout(h2bDataFrameFields, sizeof(h2bDataFrameFields)/sizeof(h2bDataFrameFields[0]), sizeof(H2BDataFrame)), "The H2BDataFrame fields don't match the struct");
+static_assert(checkLayout(ackFields, sizeof(ackFields)/sizeof(ackFields[0]), sizeof(Ack)), "The Ack fields don't match the struct");
+static_assert(checkLayout(lightsFields, sizeof(lightsFields)/sizeof(lightsFields[0]), sizeof(Lights)), "The Lights fields don't match the struct");
+
+
+/** The fields of the payload of a message
+    @param b2h true for the messages from the body board, false for the head board
+    @param message_type the type of the message
+    @param numFields the number of fields
+    @return the fields, or null if the payload has no field table
+*/
+const FieldInfo* Fields(bool b2h, MessageType message_type, size_t& numFields);
+
+/** Find a field by name
+    @param fields the fields
+    @param numFields the number of fields
+    @param name the name of the field
+    @param length the length of the name
+    @return the field, or null if there is no field with that name
+*/
+const FieldInfo* FindField(const FieldInfo* fields, size_t numFields, const char* name, size_t length);
+
+/** Read a field from a payload
+    @param field the field
+    @param payload the payload
+    @param index the index of the field in the array
+    @return the value of the field
+*/
+inline int32_t ReadField(const FieldInfo& field, const uint8_t* payload, size_t index = 0)
+{
+    // assumes alignment, little endian host
+    auto ptr = payload + field.offset + index * field.stride;
+    int32_t value;
+    switch (field.type)
+    {
+        default:
+        case FieldType::u8 : value = *ptr; break;
+        case FieldType::i8 : value = *(const int8_t*) ptr; break;
+        case FieldType::u16: value = *(const uint16_t*) ptr; break;
+        case FieldType::i16: value = *(const int16_t*) ptr; break;
+        case FieldType::u32: value = (int32_t) *(const uint32_t*) ptr; break;
+        case FieldType::i32: value = *(const int32_t*) ptr; break;
+    }
+    if (field.width)
+        value = (int32_t)(((uint32_t) value >> field.bit) & ((1UL << field.width) - 1));
+    return value;
+}
+
+/** Print the fields of a payload, as name=value pairs
+    @param text where to put the text
+    @param size the size of the text buffer
+    @param fields the fields
+    @param numFields the number of fields
+    @param payload the payload
+    @return the length of the text
+
+    The arrays of more than 8 fields are printed as their count.
+*/
+size_t FormatFields(char* text, size_t size, const FieldInfo* fields, size_t numFields, const uint8_t* payload);
+
+/** Print a message
+    @param text where to put the text
+    @param size the size of the text buffer
+    @param b2h true for the messages from the body board, false for the head board
+    @param message_type the type of the message
+    @param payload the payload
+    @param payload_size the size of the payload
+    @return the length of the text
+*/
+size_t FormatMessage(char* text, size_t size, bool b2h, MessageType message_type, const uint8_t* payload, size_t payload_size);
+
+}
@@ -0,0 +1,74 @@
+/* Sequence lock for publishing state between tasks
+   Copyright 2024 Randall Maas
+*//**@file
+    @brief Sequence lock for publishing state between tasks.
+
+    A sequence lock lets one writer publish a small struct to any number of
+    readers without blocking the writer.  The writer bumps the sequence number
+    to odd, copies in the new value, and bumps it back to even.  A reader
+    copies the value out, and retries if the sequence number was odd or
+    changed while it was copying.
+
+    This is meant for the receive task to publish state (for instance, the
+    head and lift angles) to other tasks without a mutex on the frame path.
+*/
+#pragma once
+#include <inttypes.h>
+#include <atomic>
+
+namespace Spine {
+
+/** Publish a value from one writer to many readers.
+    @tparam T the type of the value; it must be trivially copyable
+*/
+template<typename T>
+class Seqlock
+{
+public:
+    Seqlock() : sequence(0), value() {}
+
+    /** Publish a new value
+        @param newValue the value to publish
+
+        Only one task may write.
+    */
+    void write(const T& newValue)
+    {
+        auto seq = sequence.load(std::memory_order_relaxed);
+        sequence.store(seq+1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        value = newValue;
+        sequence.store(seq+2, std::memory_order_release);
+    }
+
+    /** Get a consistent copy of the value
+        @return the value
+    */
+    T read() const
+    {
+        for (;;)
+        {
+            auto before = sequence.load(std::memory_order_acquire);
+            T copy = value;
+            std::atomic_thread_fence(std::memory_order_acquire);
+            auto after = sequence.load(std::memory_order_relaxed);
+            // retry if the writer was in the middle of an update
+            if (before == after && !(before & 1))
+                return copy;
+        }
+    }
+
+    /** The number of values published
+        @return the count; a reader can compare this to see if there is a newer value
+    */
+    uint32_t version() const { return sequence.load(std::memory_order_acquire) / 2; }
+
+private:
+    /// The sequence number; odd while an update is in progress
+    std::atomic<uint32_t> sequence;
+
+    /// The published value
+    T value;
+};
+
+}
@@ -15,11 +15,20 @@
 #include <Arduino.h>
 #include <esp32/rom/crc.h>
 #include "spine.h"
+#include "crc.h"
+#if SPINE_CORRECT_CRC
+#include "correction.h"
+#endif
+#if SPINE_EARLY_AUDIO
+#include "earlyaudio.h"
+#endif
 // not sure if it should be crc32_be or crc32_le
 #define crc32 crc32_le
 
 namespace Spine {
 
+class EarlyAudioReceiver;
+
 
 // some helpful constants.. 
 enum
@@ -34,13 +43,240 @@ enum
 
 /// wait for a byte
 /// @param c the byte to wait for
-#define waitFor(c) do{if ((recv_buffer[offset] = in.read()) != (c)) return (MessageType)-1;offset++;}while(0)
+#define waitFor(c) do{if ((recv_buffer[offset] = in.read()) != (c)) {recv_error = FrameError::sync; return (MessageType)-1;}offset++;}while(0)
+
+
+/** Find the next valid message frame in a memory buffer
+    @param buffer the bytes to search
+    @param size the number of bytes in the buffer
+    @param tag the three characters following the sync byte
+    @param size_of the sizes of the messages for this direction
+    @param message_type the type of the message found, -1 if none
+    @param payload_size the size of the payload found
+    @return a pointer to the start of the frame.  If there is no complete
+            frame, this is where to resume the search when more bytes arrive.
+
+    This is the counterpart to ReceiveMessage for bytes that are already in
+    memory, such as a capture.  The same checks are applied: the sync
+    bytes, the message type and size, and the CRC that follows the payload.
+    The frame is not copied.
+*/
+static const uint8_t* findMessage(const uint8_t* buffer, size_t size, const char* tag, int (*size_of)(MessageType), MessageType& message_type, size_t& payload_size)
+{
+    auto end = buffer + size;
+    message_type = (MessageType)-1;
+    payload_size = 0;
+
+    for (auto ptr = buffer; ptr < end; ptr++)
+    {
+        // skip to the next sync byte
+        ptr = (const uint8_t*) memchr(ptr, sync, end - ptr);
+        if (!ptr)
+            return end;
+
+        // need the whole header to check it
+        if (end - ptr < payload_ofs)
+            return ptr;
+        if (ptr[1] != tag[0] || ptr[2] != tag[1] || ptr[3] != tag[2])
+            continue;
+
+        // check the message type against the payload size
+        // assumes alignment, little endian host
+        auto type = (MessageType) *(uint16_t*)(ptr+message_type_ofs);
+        size_t length = *(uint16_t*)(ptr+payload_size_ofs);
+        auto expected_size = size_of(type);
+        if (expected_size < 0 || (size_t) expected_size != length)
+            continue;
+
+        // need the whole frame to check the crc
+        if ((size_t)(end - ptr) < payload_ofs + length + 4)
+            return ptr;
+        auto crc = crc32(CRC32_INITIAL, (uint8_t*) ptr+payload_ofs, length);
+        if (crc != *(uint32_t*)(ptr+payload_ofs+length))
+            continue;
+
+        message_type = type;
+        payload_size = length;
+        return ptr;
+    }
+    return end;
+}
+
+
+
+/** Read bytes, waiting no longer than they should take to arrive
+    @param in the stream to read from
+    @param buffer where to put the bytes
+    @param size the number of bytes
+    @return true if all of the bytes were read, false if they didn't arrive in
+            time
+
+    The stream's timeout is set from the time the bytes take at the baud rate
+    (10 bits a byte), rounded up to the millisecond, plus SPINE_READ_SLACK_MS.
+    A frame that is cut short is given up after a few milliseconds, rather
+    than after a fixed timeout set for the stream (100ms in the example).
+*/
+static bool readBytesWithin(Stream& in, uint8_t* buffer, size_t size)
+{
+    in.setTimeout((size*10*1000 + SPINE_BAUD_RATE-1) / SPINE_BAUD_RATE + SPINE_READ_SLACK_MS);
+    return in.readBytes(buffer, size) == size;
+}
+
+
+#if SPINE_EARLY_AUDIO
+/** Read the payload and CRC of a data frame from the body board, a block of
+    samples at a time, passing the header and each block on to the early audio
+    @param in the stream to read from
+    @param recv_buffer the buffer the header has been received into
+    @param payload_size the size of the payload
+    @param audio the early audio
+    @return true if all of the bytes were read, false if they didn't arrive in
+            time
+
+    The CRC isn't passed on; the caller settles the frame once it has been
+    checked.
+*/
+static bool readEarlyAudio(Stream& in, uint8_t* recv_buffer, size_t payload_size, EarlyAudioReceiver& audio)
+{
+    constexpr size_t samplesOfs = offsetof(B2HDataFrame, mic_samples);
+    constexpr size_t blockSize  = EARLY_AUDIO_BLOCK_SAMPLES * MICROPHONE_COUNT * sizeof(int16_t);
+    audio.receive(recv_buffer, payload_ofs, micros());
+
+    // the fields before the samples, then the samples a block at a time
+    auto payload = recv_buffer + payload_ofs;
+    for (size_t pos = 0; pos < payload_size; )
+    {
+        auto num = pos < samplesOfs ? samplesOfs - pos : std::min(blockSize, payload_size - pos);
+        if (!readBytesWithin(in, payload + pos, num))
+            return false;
+        audio.receive(payload + pos, num, micros());
+        pos += num;
+    }
+    return readBytesWithin(in, payload + payload_size, 4);
+}
+#endif
+
+
+/** Receive the rest of a message frame, once the sync bytes have been received
+    @param in the stream to receive the message from
+    @param recv_buffer the buffer to receive into
+    @param size_of the sizes of the messages for this direction
+    @param payload_size the size of the payload
+    @param error why the frame was rejected
+    @param corrected the count of frames with a bit in error corrected
+    @param audio the early audio to pass the samples of the data frames on
+           to, or null
+    @return the message type, -1 if the frame is bad
+
+    This reads the message type and size, checks them against each other,
+    then reads the payload and checks the CRC.  Each read is given the time
+    its bytes take to arrive; if they don't, the frame is given up.  If SPINE_CORRECT_CRC is
+    enabled, a frame that fails the CRC with a single bit in error is
+    corrected in place.  If SPINE_EARLY_AUDIO is enabled, a data frame is read
+    a block of samples at a time, and the samples passed on as they arrive;
+    they are committed if the CRC passes as received, and rolled back
+    otherwise (including a frame that is then corrected, as the samples passed
+    on had the error).
+*/
+static MessageType receiveFrame(Stream& in, uint8_t* recv_buffer, int (*size_of)(MessageType), size_t& payload_size, FrameError& error, uint32_t& corrected, EarlyAudioReceiver* audio)
+{
+    // receive the payload type and size
+    if (!readBytesWithin(in, recv_buffer+message_type_ofs, 4))
+    {
+        payload_size = 0;
+        error = FrameError::truncated;
+        return (MessageType)-1;
+    }
+
+    // Check the payload type and size
+    // The message type is 16 bits. The message type implies both the size of the
+    // payload, and the contents.  If the message type is not recognized, or the
+    // implied size does not match the passed payload size, the packet is
+    // considered in error.
+    auto message_type = (MessageType) *(uint16_t*)(recv_buffer+message_type_ofs);
+    // The payload size is a 16 bit number.  The maximum payload size is 1280 bytes. 
+    payload_size = *(uint16_t*)(recv_buffer+payload_size_ofs);
+
+    // lookup the expected size of the message
+    auto expected_size = size_of(message_type);
+    // and check if the passed size is correct for the message type
+    if (expected_size < 0 || (size_t) expected_size != payload_size)
+    {
+        // the message is bad: didnt pass type and size checks
+        // go back to the start to look for a new message
+        payload_size = 0;
+        error = FrameError::typeSize;
+        return (MessageType)-1;
+    }
+
+    // read those bytes, including the crc
+    bool complete;
+#if SPINE_EARLY_AUDIO
+    if (audio && message_type == MessageType::dataFrame)
+        complete = readEarlyAudio(in, recv_buffer, payload_size, *audio);
+    else
+#endif
+        complete = readBytesWithin(in, recv_buffer+payload_ofs, payload_size+4);
+    if (!complete)
+    {
+        // the frame was cut short; go back to the start to look for a new
+        // message
+#if SPINE_EARLY_AUDIO
+        if (audio)
+            audio->settle(false);
+#else
+        (void) audio;
+#endif
+        payload_size = 0;
+        error = FrameError::truncated;
+        return (MessageType)-1;
+    }
+
+    // check crc of buffer
+    auto crc = crc32(CRC32_INITIAL, recv_buffer+payload_ofs, payload_size);
+    // assumes alignment, little endian host
+    auto crc_in_buffer = *(uint32_t*)(recv_buffer+payload_ofs+payload_size);
+
+#if SPINE_EARLY_AUDIO
+    // commit or roll back the samples passed on early
+    if (audio)
+        audio->settle(crc == crc_in_buffer);
+#endif
+
+#if SPINE_CORRECT_CRC
+    // fix a single bit in error, from the syndrome
+    if (crc != crc_in_buffer && CorrectBitError(recv_buffer+payload_ofs, payload_size, crc_in_buffer, crc ^ crc_in_buffer))
+    {
+        // assumes alignment, little endian host
+        *(uint32_t*)(recv_buffer+payload_ofs+payload_size) = crc_in_buffer;
+        crc = crc_in_buffer;
+        corrected++;
+    }
+#else
+    (void) corrected;
+#endif
+
+    // if crc is bad, go back to the start
+    if (crc != crc_in_buffer)
+    {
+        // the message is bad: didnt pass the crc check
+        // go back to the start to look for a new message
+        payload_size = 0;
+        error = FrameError::crc;
+        return (MessageType)-1;
+    }
+
+    // return the message type
+    error = FrameError::none;
+    return message_type;
+}
 
 
 namespace H2B {
 
 /** The buffer to receive messages into
-    @note the buffer is 1028 bytes + 4 bytes for the payload size + 4 bytes for the crc
+    @note the buffer is sized for the largest payload enabled (see config.h):
+    the header, the payload, and 4 bytes for the crc
 
     The header is:
     @code
@@ -56,30 +292,13 @@ namespace H2B {
     - The payload size is a 16 bit number.  The maximum payload size is 1280 bytes. 
     - The CRC is 32 bits.  It is computed on the payload only.
 */
-uint8_t recv_buffer[1028+payload_ofs+4];
+uint8_t recv_buffer[recv_buffer_size];
 
-/** The sizes of the messages when sent from the head board to the body board.
-    @param command the command to get the size of
-    @return the size of the message
-*/
-int size(MessageType command)
-{
-    // lookup the size of the message
-    switch (command)
-    {
-        // message type size
-        default: return -1;
-        case MessageType::dataCharacter : return 32;
-        case MessageType::dataFrame     : return 64;
-        case MessageType::shutdown      : return 0;  
-        case MessageType::updateFirmware: return 1028;
-        case MessageType::mode          : return 0;
-        case MessageType::version       : return 0;
-        case MessageType::lights        : return 16;
-        case MessageType::validate      : return 0;
-        case MessageType::erase         : return 0;
-    }
-}
+/// Why the last frame received was rejected
+FrameError recv_error;
+
+/// The number of frames received with a bit in error that was corrected
+uint32_t numCorrected;
 
 
 
@@ -127,16 +346,30 @@ size_t DataCharacterMsg(const char* text, int numBytes)
 
     // Add the CRC
     auto payload_size = size(MessageType::dataCharacter);
-    auto crc = crc32(~0UL, recv_buffer+payload_ofs, payload_size);
+    auto crc = crc32(CRC32_INITIAL, recv_buffer+payload_ofs, payload_size);
 
     // put the value into the buffer
     // assumes alignment, little endian host
-    *(uint32_t*)(recv_buffer+payload_ofs+ payload_size+4) = crc;
+    *(uint32_t*)(recv_buffer+payload_ofs+payload_size) = crc;
 
     return payload_size;
 }
 
 
+/** Receive the rest of a message frame from the head board, once the sync bytes
+    have been received
+    @param in the stream to receive the message from
+    @param payload_size the size of the payload
+    @return the message type, -1 if the frame is bad
+
+    The sync bytes are expected to be in place at the start of recv_buffer.
+*/
+MessageType ReceiveFrame(Stream& in, size_t& payload_size)
+{
+    return receiveFrame(in, recv_buffer, H2B::size, payload_size, recv_error, numCorrected, nullptr);
+}
+
+
 /** Receive a message frame from the head board
     @param in the stream to receive the message from
     @param payload_size the size of the payload
@@ -180,52 +413,26 @@ MessageType ReceiveMessage(Stream& in, size_t& payload_size)
     waitFor('2');
     waitFor('B');
 
-    // receive the payload type and size
-    in.readBytes(recv_buffer+message_type_ofs, 4);
-
-    // Check the payload type and size
-    // The message type is 16 bits. The message type implies both the size of the
-    // payload, and the contents.  If the message type is not recognized, or the
-    // implied size does not match the passed payload size, the packet is
-    // considered in error.
-    auto message_type = (MessageType) *(uint16_t*)(recv_buffer+message_type_ofs);
-    // The payload size is a 16 bit number.  The maximum payload size is 1280 bytes. 
-    payload_size = *(uint16_t*)(recv_buffer+payload_size_ofs);
-
-    // lookup the expected size of the message
-    auto expected_size = size(message_type);
-    // and check if the passed size is correct for the message type
-    if (expected_size < 0 || expected_size != payload_size)
-    {
-        // the message is bad: didnt pass type and size checks
-        // go back to the start to look for a new message
-        payload_size = 0;
-        return (MessageType)-1;
-    }
+    // receive the rest of the frame
+    return ReceiveFrame(in, payload_size);
+}
 
-    // read those bytes, including the crc
-    in.readBytes(recv_buffer+payload_ofs, payload_size+4);
 
-    // check crc of buffer
-    auto crc = crc32(~0UL, recv_buffer+payload_ofs, payload_size);
-    // assumes alignment, little endian host
-    auto crc_in_buffer = *(uint32_t*)(recv_buffer+payload_ofs+ payload_size+4);
 
-    // if crc is bad, go back to the start
-    if (crc != crc_in_buffer)
-    {
-        // the message is bad: didnt pass type and size checks
-        // go back to the start to look for a new message
-        payload_size = 0;
-        return (MessageType)-1;
-    }
-
-    // return the message type
-    return message_type;
+/** Find the next valid message frame from the head board in a memory buffer
+    @param buffer the bytes to search
+    @param size the number of bytes in the buffer
+    @param message_type the type of the message found, -1 if none
+    @param payload_size the size of the payload found
+    @return a pointer to the start of the frame.  If there is no complete
+            frame, this is where to resume the search when more bytes arrive.
+*/
+const uint8_t* FindMessage(const uint8_t* buffer, size_t size, MessageType& message_type, size_t& payload_size)
+{
+    return findMessage(buffer, size, "H2B", H2B::size, message_type, payload_size);
 }
 
 
-
 /** Send a message to the head board.
     @param out the stream to send the message to
     @param payload_size the size of the payload
@@ -242,7 +449,8 @@ void SendMessage(Stream& out, size_t payload_size)
 namespace B2H {
 
 /** The buffer to receive messages into
-    @note the buffer is 1028 bytes + 4 bytes for the payload size + 4 bytes for the crc
+    @note the buffer is sized for the largest payload enabled (see config.h):
+    the header, the payload, and 4 bytes for the crc
 
     The header is:
     @code
@@ -258,29 +466,19 @@ namespace B2H {
     - The payload size is a 16 bit number.  The maximum payload size is 1280 bytes. 
     - The CRC is 32 bits.  It is computed on the payload only.
 */
-uint8_t recv_buffer[1028+payload_ofs+4];
+uint8_t recv_buffer[recv_buffer_size];
 
+/// Why the last frame received was rejected
+FrameError recv_error;
+
+/// The number of frames received with a bit in error that was corrected
+uint32_t numCorrected;
+
+#if SPINE_EARLY_AUDIO
+/// Passes the samples of the data frames on as they arrive
+EarlyAudioReceiver earlyAudio;
+#endif
 
-/** The sizes of the messages when sent from the body board to the head board.
-    @param command the command to get the size of
-    @return the size of the message
-*/
-int size(MessageType command)
-{
-    // lookup the size of the message
-    switch (command)
-    {
-        // message type size
-        default: return -1;
-        case MessageType::dataCharacter : return 32;
-        case MessageType::updateFirmware: return 32;
-        case MessageType::dataFrame     : return 768;
-        case MessageType::bootFrame     : return 0;
-        case MessageType::ack           : return 4;
-        case MessageType::version       : return 40;
-        case MessageType::validate      : return 0;
-    }
-}
 
 
 /** Populate the header of a message
@@ -325,14 +523,32 @@ size_t DataCharacterMsg(const char* text, int numBytes)
 
     // Add the CRC
     auto payload_size = size(MessageType::dataCharacter);
-    auto crc = crc32(~0UL, recv_buffer+payload_ofs, payload_size);
+    auto crc = crc32(CRC32_INITIAL, recv_buffer+payload_ofs, payload_size);
     // assumes alignment, little endian host
-    *(uint32_t*)(recv_buffer+payload_ofs+ payload_size+4) = crc;
+    *(uint32_t*)(recv_buffer+payload_ofs+payload_size) = crc;
 
     return payload_size;
 }
 
 
+/** Receive the rest of a message frame from the body board, once the sync bytes
+    have been received
+    @param in the stream to receive the message from
+    @param payload_size the size of the payload
+    @return the message type, -1 if the frame is bad
+
+    The sync bytes are expected to be in place at the start of recv_buffer.
+*/
+MessageType ReceiveFrame(Stream& in, size_t& payload_size)
+{
+#if SPINE_EARLY_AUDIO
+    return receiveFrame(in, recv_buffer, B2H::size, payload_size, recv_error, numCorrected, &earlyAudio);
+#else
+    return receiveFrame(in, recv_buffer, B2H::size, payload_size, recv_error, numCorrected, nullptr);
+#endif
+}
+
+
 /** Receive a message frame from the body board
     @param in the stream to receive the message from
     @param payload_size the size of the payload
@@ -376,47 +592,22 @@ MessageType ReceiveMessage(Stream& in, size_t& payload_size)
     waitFor('2');
     waitFor('H');
 
-    // receive the payload type and size
-    in.readBytes(recv_buffer+message_type_ofs, 4);
-
-    // Check the payload type and size
-    // The message type is 16 bits. The message type implies both the size of the
-    // payload, and the contents.  If the message type is not recognized, or the
-    // implied size does not match the passed payload size, the packet is
-    // considered in error.
-    auto message_type = (MessageType) *(uint16_t*)(recv_buffer+message_type_ofs);
-    // The payload size is a 16 bit number.  The maximum payload size is 1280 bytes. 
-    payload_size = *(uint16_t*)(recv_buffer+payload_size_ofs);
-
-    // lookup the expected size of the message
-    auto expected_size = size(message_type);
-    // and check if the passed size is correct for the message type
-    if (expected_size < 0 || expected_size != payload_size)
-    {
-        // the message is bad: didnt pass type and size checks
-        // go back to the start to look for a new message
-        payload_size = 0;
-        return (MessageType)-1;
-    }
-
-    // read those bytes, including the crc
-    in.readBytes(recv_buffer+payload_ofs, payload_size+4);
+    // receive the rest of the frame
+    return ReceiveFrame(in, payload_size);
+}
 
-    // check crc of buffer
-    auto crc = crc32(~0UL, recv_buffer+payload_ofs, payload_size);
-    auto crc_in_buffer = *(uint32_t*)(recv_buffer+payload_ofs+ payload_size+4);
 
-    // if crc is bad, go back to the start
-    if (crc != crc_in_buffer)
-    {
-        // the message is bad: didnt pass type and size checks
-        // go back to the start to look for a new message
-        payload_size = 0;
-        return (MessageType)-1;
-    }
-
-    // return the message type
-    return message_type;
+/** Find the next valid message frame from the body board in a memory buffer
+    @param buffer the bytes to search
+    @param size the number of bytes in the buffer
+    @param message_type the type of the message found, -1 if none
+    @param payload_size the size of the payload found
+    @return a pointer to the start of the frame.  If there is no complete
+            frame, this is where to resume the search when more bytes arrive.
+*/
+const uint8_t* FindMessage(const uint8_t* buffer, size_t size, MessageType& message_type, size_t& payload_size)
+{
+    return findMessage(buffer, size, "B2H", B2H::size, message_type, payload_size);
 }
 
 
@@ -432,4 +623,16 @@ void SendMessage(Stream& out, size_t payload_size)
 
 }
 
+
+#if SPINE_RAM_REPORT
+namespace H2B { struct ReceiveBuffer; }
+namespace B2H { struct ReceiveBuffer; }
+
+/// Report the static RAM used by the receive buffers
+[[maybe_unused]] static void reportRAM()
+{
+    ReportRAM<H2B::ReceiveBuffer, sizeof(H2B::recv_buffer)>();
+    ReportRAM<B2H::ReceiveBuffer, sizeof(B2H::recv_buffer)>();
+}
+#endif
 }
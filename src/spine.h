@@ -35,14 +35,22 @@
     -	The values from  each of the 4 cliff proximity sensors
     -	Which peripherals are enabled and disabled (powered down)
 */
+#pragma once
 #include <inttypes.h>
+#include <type_traits>
 #include "pack.h"
+#include "config.h"
 class Stream;
 
 /// The number of microphones.
 #define MICROPHONE_COUNT (4)
 /// The number of samples per frame for each microphone.
 #define MICROPHONE_SAMPLES_PER_FRAME (80)
+/// The sample rate of each microphone (in samples/second).
+#define MICROPHONE_SAMPLE_RATE (15625)
+/// The period of the data frames from the body board (in microseconds).  The
+/// frames carry the microphone samples, so they keep pace with the sample rate.
+#define B2H_FRAME_PERIOD_US (MICROPHONE_SAMPLES_PER_FRAME*1000000L/MICROPHONE_SAMPLE_RATE)
 
 
 /** The Spine namespace encapsulates the definitions and structures used for 
@@ -147,6 +155,78 @@ enum class MessageType
     VS = 0x7376
 };
 
+/// Why a frame was rejected
+enum class FrameError
+{
+    /// The frame is good
+    none = 0,
+
+    /// The sync bytes didn't match
+    sync,
+
+    /// The message type isn't sent in this direction, or the payload size
+    /// doesn't match it
+    typeSize,
+
+    /// The CRC doesn't match the payload
+    crc,
+
+    /// The rest of the frame didn't arrive in time
+    truncated
+};
+
+/// The size of a firmware update message, or -1 if they are disabled
+#define SPINE_IF_DFU(size) (SPINE_ENABLE_DFU ? (size) : -1)
+
+/** The schema of the messages.
+
+    This is the one place that lists, for each kind of message, the size of
+    its payload and its struct in each direction:
+
+    @code
+    X(type, size from the head board, payload struct, size from the body board, payload struct)
+    @endcode
+
+    A size of -1 means that the message isn't sent in that direction; a
+    payload of uint8_t means that the payload has no struct.  The size tables,
+    the list of message types, and the checks of the structs below are made
+    from it, as are the names and the dispatch in schema.h.
+*/
+#define SPINE_MESSAGES(X) \
+    X(dataCharacter , 32                , DataCharacter, 32              , DataCharacter) \
+    X(dataFrame     , 64                , H2BDataFrame , 768             , B2HDataFrame ) \
+    X(shutdown      , 0                 , uint8_t      , -1              , uint8_t      ) \
+    X(updateFirmware, SPINE_IF_DFU(1028), uint8_t      , SPINE_IF_DFU(32), uint8_t      ) \
+    X(mode          , 0                 , uint8_t      , -1              , uint8_t      ) \
+    X(version       , 0                 , uint8_t      , 40              , uint8_t      ) \
+    X(lights        , 16                , Lights       , -1              , uint8_t      ) \
+    X(validate      , SPINE_IF_DFU(0)   , uint8_t      , SPINE_IF_DFU(0) , uint8_t      ) \
+    X(erase         , SPINE_IF_DFU(0)   , uint8_t      , -1              , uint8_t      ) \
+    X(bootFrame     , -1                , uint8_t      , 0               , uint8_t      ) \
+    X(ack           , -1                , uint8_t      , 4               , Ack          ) \
+    X(VS            , -1                , uint8_t      , -1              , uint8_t      )
+
+/// All of the kinds of messages, for sizing the buffers at compile time
+constexpr MessageType messageTypes[] =
+{
+#define SPINE_MESSAGE_TYPE(type, h2b_size, h2b_payload, b2h_size, b2h_payload) MessageType::type,
+    SPINE_MESSAGES(SPINE_MESSAGE_TYPE)
+#undef SPINE_MESSAGE_TYPE
+};
+
+/** The largest payload of the enabled messages in one direction
+    @param size_of the sizes of the messages in that direction
+    @return the size of the largest payload
+*/
+constexpr size_t maxPayloadSize(int (*size_of)(MessageType))
+{
+    size_t largest = 0;
+    for (auto message_type : messageTypes)
+        if (size_of(message_type) > (int) largest)
+            largest = (size_t) size_of(message_type);
+    return largest;
+}
+
 /// Ack message from the body board to the head board.
 PACK(struct Ack
 {
@@ -421,6 +501,63 @@ PACK(struct B2HDataFrame
 // check the size of the struct
 static_assert(sizeof(B2HDataFrame) == 768, "The size of the B2HDataFrame struct is expected to be 768 bytes");
 
+
+/** The data frame from the head board to the body board.
+
+    This structure represents the data frame that is sent from the head board
+    to the body board.  It carries the commanded motor drive, the LED colors
+    and the power controls.  The layout is not fully known; the fields below
+    are the ones that have been identified.
+*/
+PACK(struct H2BDataFrame
+{
+    /// The sequence number of the message.  Likely a counter to detect lost messages.
+    uint32_t sequenceNumber;
+
+    /// Power control flags -- which peripherals (cliff, time of flight,
+    /// encoders) should be powered.
+    uint8_t powerFlags;
+
+    /// Unknown/unused?
+    uint8_t reserved1[3];
+
+    /// The commanded motor power (duty cycle) for each of the motors.
+    /// Full scale is +/-32767; the sign gives the direction.
+    int16_t motorPower[4];
+
+    /// The LED colors.
+    uint8_t ledColors[16];
+
+    /// Unknown/unused?
+    uint8_t reserved_[32];
+});
+
+// check the size of the struct
+static_assert(sizeof(H2BDataFrame) == 64, "The size of the H2BDataFrame struct is expected to be 64 bytes");
+
+
+/** The lights message from the head board to the body board.
+
+    This sets the colors of the 4 LEDs on the backpack.  Each LED has 4 bytes:
+    red, green, blue, and a byte that isn't known (0).  The body board keeps
+    the colors until the next lights message.
+*/
+PACK(struct Lights
+{
+    /// The LED colors.
+    uint8_t ledColors[16];
+});
+
+// check the size of the struct
+static_assert(sizeof(Lights) == 16, "The size of the Lights struct is expected to be 16 bytes");
+
+// check the payload structs against the sizes in the schema
+#define SPINE_CHECK_PAYLOAD(type, h2b_size, h2b_payload, b2h_size, b2h_payload) \
+    static_assert(h2b_size < 0 || std::is_same<h2b_payload, uint8_t>::value || sizeof(h2b_payload) == h2b_size, "The " #h2b_payload " struct doesn't match the size of " #type " from the head board"); \
+    static_assert(b2h_size < 0 || std::is_same<b2h_payload, uint8_t>::value || sizeof(b2h_payload) == b2h_size, "The " #b2h_payload " struct doesn't match the size of " #type " from the body board");
+SPINE_MESSAGES(SPINE_CHECK_PAYLOAD)
+#undef SPINE_CHECK_PAYLOAD
+
 /** The H2B namespace encapsulates the definitions and structures used for 
     communication from the head board to the body board in Vector.
 
@@ -432,8 +569,32 @@ static_assert(sizeof(B2HDataFrame) == 768, "The size of the B2HDataFrame struct
 */
 namespace H2B {
 
+/** The sizes of the messages when sent from the head board to the body board.
+    @param command the command to get the size of
+    @return the size of the message
+*/
+constexpr int size(MessageType command)
+{
+    // lookup the size of the message
+    switch (command)
+    {
+        // message type size
+        default: return -1;
+#define SPINE_SIZE(type, h2b_size, h2b_payload, b2h_size, b2h_payload) case MessageType::type: return h2b_size;
+        SPINE_MESSAGES(SPINE_SIZE)
+#undef SPINE_SIZE
+    }
+}
+
+/// The size of the largest payload enabled
+constexpr size_t max_payload_size = maxPayloadSize(size);
+
+/// The size of the receive buffer
+constexpr size_t recv_buffer_size = payload_ofs + max_payload_size + 4;
+
 /** The buffer to receive messages into
-    @note the buffer is 1028 bytes + 4 bytes for the payload size + 4 bytes for the crc
+    @note the buffer is sized for the largest payload enabled (see config.h):
+    the header, the payload, and 4 bytes for the crc
 
     The header is:
     @code
@@ -449,13 +610,32 @@ namespace H2B {
     - The payload size is a 16 bit number.  The maximum payload size is 1280 bytes. 
     - The CRC is 32 bits.  It is computed on the payload only.
 */
-extern uint8_t recv_buffer[1028+payload_ofs+4];
+extern uint8_t recv_buffer[recv_buffer_size];
+
+/// Why the last frame received was rejected
+extern FrameError recv_error;
+
+/// The number of frames received with a bit in error that was corrected
+/// (see SPINE_CORRECT_CRC)
+extern uint32_t numCorrected;
+
+
+/** Receive the rest of a message frame from the head board, once the sync bytes
+    have been received
+    @param in the stream to receive the message from
+    @param payload_size the size of the payload
+    @return the message type, -1 if the frame is bad (see recv_error)
 
+    This is for callers that find the sync bytes themselves.  The sync bytes
+    are expected to be in place at the start of recv_buffer.  The rest of the
+    frame is checked in the same way as ReceiveMessage.
+*/
+MessageType ReceiveFrame(Stream& in, size_t& payload_size);
 
 /** Receive a message frame from the head board
     @param in the stream to receive the message from
     @param payload_size the size of the payload
-    @return the message type
+    @return the message type, -1 if the frame is bad (see recv_error)
 
     This function receives a message from the head board over a serial
     connection.  It implements a framing layer that ensures the integrity
@@ -486,6 +666,21 @@ extern uint8_t recv_buffer[1028+payload_ofs+4];
  */
 MessageType ReceiveMessage(Stream& in, size_t& payload_size);
 
+/** Find the next valid message frame from the head board in a memory buffer
+    @param buffer the bytes to search
+    @param size the number of bytes in the buffer
+    @param message_type the type of the message found, -1 if none
+    @param payload_size the size of the payload found
+    @return a pointer to the start of the frame.  If there is no complete
+            frame, this is where to resume the search when more bytes arrive.
+
+    This is the counterpart to ReceiveMessage for bytes that are already in
+    memory, such as a capture.  The frame is checked the same way, but is
+    not copied; it is payload_ofs + payload_size + 4 bytes long, with the
+    CRC following the payload.
+*/
+const uint8_t* FindMessage(const uint8_t* buffer, size_t size, MessageType& message_type, size_t& payload_size);
+
 /** Send a message to the head board.
     @param out the stream to send the message to
     @param payload_size the size of the payload
@@ -506,8 +701,32 @@ void SendMessage(Stream& out, size_t payload_size);
 */
 namespace B2H {
 
+/** The sizes of the messages when sent from the body board to the head board.
+    @param command the command to get the size of
+    @return the size of the message
+*/
+constexpr int size(MessageType command)
+{
+    // lookup the size of the message
+    switch (command)
+    {
+        // message type size
+        default: return -1;
+#define SPINE_SIZE(type, h2b_size, h2b_payload, b2h_size, b2h_payload) case MessageType::type: return b2h_size;
+        SPINE_MESSAGES(SPINE_SIZE)
+#undef SPINE_SIZE
+    }
+}
+
+/// The size of the largest payload enabled
+constexpr size_t max_payload_size = maxPayloadSize(size);
+
+/// The size of the receive buffer
+constexpr size_t recv_buffer_size = payload_ofs + max_payload_size + 4;
+
 /** The buffer to receive messages into
-    @note the buffer is 1028 bytes + 4 bytes for the payload size + 4 bytes for the crc
+    @note the buffer is sized for the largest payload enabled (see config.h):
+    the header, the payload, and 4 bytes for the crc
 
     The header is:
     @code
@@ -523,7 +742,14 @@ namespace B2H {
     - The payload size is a 16 bit number.  The maximum payload size is 1280 bytes. 
     - The CRC is 32 bits.  It is computed on the payload only.
 */
-extern uint8_t recv_buffer[1028+payload_ofs+4];
+extern uint8_t recv_buffer[recv_buffer_size];
+
+/// Why the last frame received was rejected
+extern FrameError recv_error;
+
+/// The number of frames received with a bit in error that was corrected
+/// (see SPINE_CORRECT_CRC)
+extern uint32_t numCorrected;
 
 
 /** Send a data character message to the head board.
@@ -534,10 +760,22 @@ extern uint8_t recv_buffer[1028+payload_ofs+4];
 size_t DataCharacterMsg(const char* text, int numBytes);
 
 
+/** Receive the rest of a message frame from the body board, once the sync bytes
+    have been received
+    @param in the stream to receive the message from
+    @param payload_size the size of the payload
+    @return the message type, -1 if the frame is bad (see recv_error)
+
+    This is for callers that find the sync bytes themselves.  The sync bytes
+    are expected to be in place at the start of recv_buffer.  The rest of the
+    frame is checked in the same way as ReceiveMessage.
+*/
+MessageType ReceiveFrame(Stream& in, size_t& payload_size);
+
 /** Receive a message frame from the body board
     @param in the stream to receive the message from
     @param payload_size the size of the payload
-    @return the message type
+    @return the message type, -1 if the frame is bad (see recv_error)
 
     This function receives a message from the body board over a serial
     connection.  It implements a framing layer that ensures the integrity
@@ -568,6 +806,21 @@ size_t DataCharacterMsg(const char* text, int numBytes);
  */
 MessageType ReceiveMessage(Stream& in, size_t& payload_size);
 
+/** Find the next valid message frame from the body board in a memory buffer
+    @param buffer the bytes to search
+    @param size the number of bytes in the buffer
+    @param message_type the type of the message found, -1 if none
+    @param payload_size the size of the payload found
+    @return a pointer to the start of the frame.  If there is no complete
+            frame, this is where to resume the search when more bytes arrive.
+
+    This is the counterpart to ReceiveMessage for bytes that are already in
+    memory, such as a capture.  The frame is checked the same way, but is
+    not copied; it is payload_ofs + payload_size + 4 bytes long, with the
+    CRC following the payload.
+*/
+const uint8_t* FindMessage(const uint8_t* buffer, size_t size, MessageType& message_type, size_t& payload_size);
+
 /** Send a message to the head board.
     @param out the stream to send the message to
     @param payload_size the size of the payload
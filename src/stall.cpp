@@ -0,0 +1,134 @@
+/* Motor stall detection from the encoder feedback and commanded duty
+   Copyright 2024 Randall Maas
+*//**@file
+    @brief Motor stall detection from the encoder feedback and commanded duty.
+
+    This file contains the implementation of the stall detector: pairing the
+    commands with the feedback, and estimating the expected versus actual
+    motion of each motor.
+*/
+#include <algorithm>
+#include <string.h>
+#include <Arduino.h>
+#include "stall.h"
+
+namespace Spine {
+
+/// The default tuning
+const StallConfig defaultStallConfig =
+{
+    // full scale ticks per frame: left wheel, right wheel, lift, head.
+    // Estimated; the lift and head are geared down further than the wheels
+    {40, 40, 8, 8},
+    // minimum power: 10% duty, the least that is taken to overcome friction
+    3277,
+    // stalled below 1/4 of the expected speed, leaving room for the load
+    // and a sagging battery
+    64,
+    // 8 frames (about 40ms), so one late or dropped frame isn't a stall
+    8,
+    // two frames of latency: the command's frame, and the next sample
+    10000
+};
+
+
+/** Create the stall detector
+    @param config the tuning to use
+*/
+StallDetector::StallDetector(const StallConfig& config)
+    : numStalls(0), numJams(0), config(config), numCommands(0)
+{
+    memset(commands, 0, sizeof(commands));
+    memset(state, 0, sizeof(state));
+}
+
+
+/** Record a motor command from the head board
+    @param frame the data frame from the head board
+    @param arrival_us the time (in microseconds) that the frame arrived
+*/
+void StallDetector::command(const H2BDataFrame& frame, uint32_t arrival_us)
+{
+    // Overwrite the oldest command
+    auto& cmd = commands[numCommands % STALL_COMMAND_HISTORY];
+    numCommands++;
+    cmd.arrival_us = arrival_us;
+    for (int idx = 0; idx < MOTOR_COUNT; idx++)
+        cmd.power[idx] = frame.motorPower[idx];
+}
+
+
+/** Find the command in effect when the feedback was sampled
+    @param arrival_us the time that the feedback arrived
+    @return the command, or null if there is none
+*/
+const StallDetector::Command* StallDetector::commandAt(uint32_t arrival_us) const
+{
+    // The command had to have arrived before the response delay
+    auto sampled_us = arrival_us - config.responseDelay_us;
+
+    // Walk back from the newest command
+    auto count = numCommands < STALL_COMMAND_HISTORY ? numCommands : STALL_COMMAND_HISTORY;
+    for (uint32_t idx = 1; idx <= count; idx++)
+    {
+        auto& cmd = commands[(numCommands - idx) % STALL_COMMAND_HISTORY];
+        // signed difference, to handle the timer wrapping around
+        if ((int32_t)(sampled_us - cmd.arrival_us) >= 0)
+            return &cmd;
+    }
+
+    // All of the remembered commands are too new
+    return nullptr;
+}
+
+
+/** Check the encoder feedback from the body board
+    @param frame the data frame from the body board
+    @param arrival_us the time (in microseconds) that the frame arrived
+    @return true if the fault state of any motor changed, false if not.
+*/
+bool StallDetector::feedback(const B2HDataFrame& frame, uint32_t arrival_us)
+{
+    bool changed = false;
+    auto cmd = commandAt(arrival_us);
+
+    for (int idx = 0; idx < MOTOR_COUNT; idx++)
+    {
+        auto& motor = state[idx];
+        int32_t power = cmd ? cmd->power[idx] : 0;
+        // in 1/256ths of a tick, rounded
+        int64_t scaled = (int64_t) power * config.fullScaleTicks[idx] * 256;
+        motor.expected = (int32_t)((scaled + (scaled < 0 ? -16383 : 16383)) / 32767);
+        motor.actual   = frame.motor[idx].delta;
+
+        // The encoders are turned off to save power; there is nothing to
+        // compare against.  Likewise, an idle motor can't stall.
+        bool driven = !frame.encodersOff && (power >= config.minPower || power <= -config.minPower);
+        auto expected = motor.expected < 0 ? -motor.expected : motor.expected;
+        auto actual   = motor.actual   < 0 ? -motor.actual   : motor.actual;
+        bool opposed  = driven && ((motor.expected < 0) != (motor.actual < 0)) && motor.actual != 0;
+        bool slow     = driven && !opposed && (int64_t) actual * 256 * 256 < (int64_t) expected * config.stallRatio;
+
+        // Count the consecutive frames of each condition
+        motor.stallFrames = slow    ? (uint8_t) std::min(motor.stallFrames + 1, 255) : 0;
+        motor.jamFrames   = opposed ? (uint8_t) std::min(motor.jamFrames   + 1, 255) : 0;
+
+        // Update the fault
+        auto fault = MotorFault::none;
+        if (motor.jamFrames >= config.faultFrames)
+            fault = MotorFault::jammed;
+        else if (motor.stallFrames >= config.faultFrames)
+            fault = MotorFault::stalled;
+
+        if (fault == motor.fault)
+            continue;
+        if (fault == MotorFault::stalled) numStalls++;
+        if (fault == MotorFault::jammed)  numJams++;
+        motor.fault = fault;
+        changed = true;
+    }
+
+    return changed;
+}
+
+}
@@ -0,0 +1,180 @@
+/* Motor stall detection from the encoder feedback and commanded duty
+   Copyright 2024 Randall Maas
+*//**@file
+    @brief Motor stall detection from the encoder feedback and commanded duty.
+
+    The body board does not report the motor currents, so a stalled wheel,
+    lift or head has to be inferred.  The head board commands a duty cycle for
+    each motor in the H2B data frame; the body board reports how far each
+    encoder moved in the B2H data frame.  If a motor is driven, but the
+    encoder does not move (nearly) as far as expected, the motor is stalled.
+    If the encoder moves against the commanded direction, the motor is being
+    back driven -- it is jammed.
+
+    The two streams arrive on different serial ports, so the commands are
+    paired with the feedback by their arrival time: a feedback frame is
+    compared against the newest command that arrived at least the response
+    delay before it.
+*/
+#pragma once
+#include <inttypes.h>
+#include "spine.h"
+
+namespace Spine {
+
+/// The number of motors reported in the data frames
+#define MOTOR_COUNT (4)
+
+
+/// The fault detected on a motor.
+enum class MotorFault
+{
+    /// The motor is moving as expected (or is not driven)
+    none = 0,
+
+    /// The motor is driven, but the encoder is not moving
+    stalled = 1,
+
+    /// The encoder is moving against the commanded direction
+    jammed = 2
+};
+
+
+/** The tuning for the stall detector.
+
+    The expected speed is linear in the duty cycle:
+    @code
+    expected ticks/frame = motorPower * fullScaleTicks / 32767
+    @endcode
+    It is kept in 1/256ths of a tick, so that the lift and head (a few ticks
+    a frame at full duty) still have an expected speed at minPower.
+*/
+struct StallConfig
+{
+    /// The encoder ticks per data frame expected at full duty, for each motor.
+    int32_t fullScaleTicks[MOTOR_COUNT];
+
+    /// The smallest duty cycle (magnitude) that is expected to move the motor.
+    /// Below this the motor is treated as idle.
+    int16_t minPower;
+
+    /// The fraction of the expected speed (in 1/256ths) below which the motor
+    /// is considered stalled.
+    uint16_t stallRatio;
+
+    /// The number of consecutive frames the condition must hold before the
+    /// fault is flagged.
+    uint8_t faultFrames;
+
+    /// The time from the command arriving, to the encoder responding (in
+    /// microseconds)
+    uint32_t responseDelay_us;
+};
+
+/// The default tuning.  The full scale speeds are worked out from the
+/// gearing rather than measured, so a motor that is geared differently is
+/// flagged too early or not at all.
+extern const StallConfig defaultStallConfig;
+
+
+/** Detect stalled and jammed motors.
+
+    Feed it each H2B data frame (the command) and each B2H data frame (the
+    feedback) as they arrive.  The work per frame is a handful of integer
+    operations for each motor, so it can run at the frame rate in the bridge.
+*/
+class StallDetector
+{
+public:
+    /** Create the stall detector
+        @param config the tuning to use
+    */
+    StallDetector(const StallConfig& config = defaultStallConfig);
+
+    /** Record a motor command from the head board
+        @param frame the data frame from the head board
+        @param arrival_us the time (in microseconds) that the frame arrived
+    */
+    void command(const H2BDataFrame& frame, uint32_t arrival_us);
+
+    /** Check the encoder feedback from the body board
+        @param frame the data frame from the body board
+        @param arrival_us the time (in microseconds) that the frame arrived
+        @return true if the fault state of any motor changed, false if not.
+    */
+    bool feedback(const B2HDataFrame& frame, uint32_t arrival_us);
+
+    /** The current fault state of a motor
+        @param motor the motor
+        @return the fault
+    */
+    MotorFault fault(Motor motor) const { return state[(int)motor].fault; }
+
+    /** The encoder ticks expected for the motor in the last feedback frame
+        @param motor the motor
+        @return the expected ticks (signed)
+    */
+    int32_t expected(Motor motor) const
+    {
+        auto expected = state[(int)motor].expected;
+        return (expected + (expected < 0 ? -128 : 128)) / 256;
+    }
+
+    /** The encoder ticks reported for the motor in the last feedback frame
+        @param motor the motor
+        @return the reported ticks (signed)
+    */
+    int32_t actual(Motor motor) const { return state[(int)motor].actual; }
+
+    /// The number of times a stall has been flagged
+    uint32_t numStalls;
+
+    /// The number of times a jam has been flagged
+    uint32_t numJams;
+
+private:
+    /// A command, as it arrived
+    struct Command
+    {
+        /// The time the command arrived
+        uint32_t arrival_us;
+        /// The commanded duty cycle of each motor
+        int16_t power[MOTOR_COUNT];
+    };
+
+    /// The per motor state
+    struct State
+    {
+        /// The expected encoder ticks for the last frame, in 1/256ths of a
+        /// tick
+        int32_t expected;
+        /// The reported encoder ticks for the last frame
+        int32_t actual;
+        /// The number of consecutive frames the stall condition has held
+        uint8_t stallFrames;
+        /// The number of consecutive frames the jam condition has held
+        uint8_t jamFrames;
+        /// The current fault
+        MotorFault fault;
+    };
+
+    /** Find the command in effect when the feedback was sampled
+        @param arrival_us the time that the feedback arrived
+        @return the command, or null if there is none
+    */
+    const Command* commandAt(uint32_t arrival_us) const;
+
+    /// The tuning
+    StallConfig config;
+
+    /// The recent commands, oldest first once full
+    Command commands[STALL_COMMAND_HISTORY];
+
+    /// The number of commands received (the next slot is numCommands % history)
+    uint32_t numCommands;
+
+    /// The per motor state
+    State state[MOTOR_COUNT];
+};
+
+}
@@ -0,0 +1,112 @@
+/* Time of flight histogram and reflectivity reconstruction
+   Copyright 2024 Randall Maas
+*//**@file
+    @brief Time of flight histogram and reflectivity reconstruction.
+
+    This file contains the implementation of the reconstruction: the
+    fixed point conversion of the rates to counts and reflectivity, and the
+    accumulation into range bins.
+*/
+#include <string.h>
+#include <Arduino.h>
+#include "tof.h"
+
+namespace Spine {
+
+/// The default configuration
+const TofConfig defaultTofConfig =
+{
+    // 1us per sample, inferred from the sensor family
+    1000,
+    // 16 bins of 128mm cover the 2m range of the sensor
+    128,
+    // an estimate of a white target at 100mm
+    2000, 100
+};
+
+
+/** Create the reconstruction
+    @param config the configuration
+*/
+TofReconstruction::TofReconstruction(const TofConfig& config)
+    : config(config)
+{
+    // a bin must have some width
+    if (!this->config.binWidth_mm)
+        this->config.binWidth_mm = 1;
+    reset();
+}
+
+
+/// Clear the histograms
+void TofReconstruction::reset()
+{
+    memset(&histogram, 0, sizeof(histogram));
+    published.write(histogram);
+}
+
+
+/** Reconstruct a reading, without accumulating it
+    @param frame the data frame from the body board
+    @param config the configuration
+    @return the reconstructed reading
+*/
+TofReading TofReconstruction::reconstruct(const B2HDataFrame& frame, const TofConfig& config)
+{
+    TofReading reading;
+    reading.sequenceNumber = frame.sequenceNumber;
+    reading.range_mm = frame.prox_range_mm;
+
+    // The low 4 bits are the range status; 0 is a good ranging
+    reading.valid = (frame.prox_status & 0x0F) == 0 && frame.prox_SPADCount != 0;
+
+    // counts = rate (Mcps, 9.7 fixed point) * integration time (us)
+    //        = rate * 2^-7 counts/us * integration (ns) / 1000
+    uint64_t integration_ns = (uint64_t) frame.prox_sampleCount * config.samplePeriod_ns;
+    reading.signalCounts  = (uint32_t)(((uint64_t) frame.prox_signalRate_mcps * integration_ns) / (1000 << 7));
+    reading.ambientCounts = (uint32_t)(((uint64_t) frame.prox_ambient         * integration_ns) / (1000 << 7));
+
+    // The SPAD count is 8.8 fixed point; the rate is 9.7, so the kcps per SPAD
+    // is rate * 1000 * 2^-7 / (spads * 2^-8)
+    reading.signalPerSpad_kcps = 0;
+    reading.reflectivity = 0;
+    if (!reading.valid)
+        return reading;
+    uint32_t perSpad = ((uint32_t) frame.prox_signalRate_mcps * 2000) / frame.prox_SPADCount;
+    reading.signalPerSpad_kcps = perSpad > 0xFFFF ? 0xFFFF : (uint16_t) perSpad;
+
+    // reflectivity = perSpad * range^2 / (ref perSpad * ref range^2), in 1/256ths
+    uint64_t num = (uint64_t) reading.signalPerSpad_kcps * frame.prox_range_mm * frame.prox_range_mm * 256;
+    uint64_t den = (uint64_t) config.refSignalPerSpad_kcps * config.refRange_mm * config.refRange_mm;
+    uint64_t reflectivity = den ? num / den : 0;
+    reading.reflectivity = reflectivity > 0xFFFFFFFF ? 0xFFFFFFFF : (uint32_t) reflectivity;
+    return reading;
+}
+
+
+/** Reconstruct a reading and add it to the histograms
+    @param frame the data frame from the body board
+    @return the reconstructed reading
+*/
+TofReading TofReconstruction::update(const B2HDataFrame& frame)
+{
+    auto reading = reconstruct(frame, config);
+    histogram.numReadings++;
+
+    // Accumulate the valid readings by their range
+    if (reading.valid)
+    {
+        unsigned idx = reading.range_mm / config.binWidth_mm;
+        auto& bin = histogram.bin[idx < TOF_BIN_COUNT ? idx : TOF_BIN_COUNT-1];
+        bin.count++;
+        bin.signalCounts  += reading.signalCounts;
+        bin.ambientCounts += reading.ambientCounts;
+        bin.reflectivity  += reading.reflectivity;
+    }
+
+    // Publish the histograms
+    published.write(histogram);
+    return reading;
+}
+
+}
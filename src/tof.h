@@ -0,0 +1,155 @@
+/* Time of flight histogram and reflectivity reconstruction
+   Copyright 2024 Randall Maas
+*//**@file
+    @brief Time of flight histogram and reflectivity reconstruction.
+
+    The body board forwards the time of flight sensor's summary of each
+    ranging: the signal and ambient rates, the number of SPADs enabled and
+    the number of samples.  From these the photon counts and the reflectivity
+    of the target can be reconstructed:
+
+    - The counts are the rate times the integration time.  The rates are in
+      mega-counts per second, 9.7 fixed point; the integration time is the
+      sample count times the sample period.
+    - The signal per SPAD falls off with the square of the range, so the
+      reflectivity is the signal per SPAD times the range squared, relative
+      to that of a reference target.
+
+    The readings are accumulated into running histograms by range bin.  All
+    of the arithmetic is in integers, so it is cheap on the body board's
+    microcontroller class hardware.
+
+    Note: the meaning of the fixed point formats is inferred from the sensor
+    family; the status is assumed to be 0 for a valid ranging.  The
+    calibration result isn't used, as its format isn't known; the reference
+    target in the configuration stands in for it.
+*/
+#pragma once
+#include <inttypes.h>
+#include "spine.h"
+#include "seqlock.h"
+
+namespace Spine {
+
+/// The configuration for the reconstruction
+struct TofConfig
+{
+    /// The period of each sample (in nanoseconds)
+    uint32_t samplePeriod_ns;
+
+    /// The width of each range bin (in mm); 0 is taken as 1
+    uint16_t binWidth_mm;
+
+    /// The signal per SPAD of the reference target (in kilo-counts per
+    /// second per SPAD) at the reference range
+    uint16_t refSignalPerSpad_kcps;
+
+    /// The range of the reference target (in mm)
+    uint16_t refRange_mm;
+};
+
+/// The default configuration.  The reference target hasn't been measured, so
+/// the reflectivity compares readings with each other, not with a real
+/// white target.
+extern const TofConfig defaultTofConfig;
+
+
+/// The reconstruction of one time of flight reading
+struct TofReading
+{
+    /// The sequence number of the data frame
+    uint32_t sequenceNumber;
+
+    /// The reported range (in mm)
+    uint16_t range_mm;
+
+    /// The signal per SPAD (in kilo-counts per second per SPAD)
+    uint16_t signalPerSpad_kcps;
+
+    /// The signal photons counted during the ranging
+    uint32_t signalCounts;
+
+    /// The ambient photons counted during the ranging
+    uint32_t ambientCounts;
+
+    /// The reflectivity of the target, relative to the reference target in
+    /// 1/256ths (256 is the same as the reference)
+    uint32_t reflectivity;
+
+    /// The reading is valid
+    uint8_t valid;
+};
+
+
+/// The accumulated readings of one range bin
+struct TofBin
+{
+    /// The number of valid readings in the bin
+    uint32_t count;
+
+    /// The sum of the signal counts
+    uint64_t signalCounts;
+
+    /// The sum of the ambient counts
+    uint64_t ambientCounts;
+
+    /// The sum of the reflectivity
+    uint64_t reflectivity;
+};
+
+
+/// The running histograms, by range bin
+struct TofHistogram
+{
+    /// The number of readings, including those not valid
+    uint32_t numReadings;
+
+    /// The readings by range bin.  The last bin holds everything beyond.
+    TofBin bin[TOF_BIN_COUNT];
+};
+
+
+/** Reconstruct the time of flight counts and reflectivity, and accumulate
+    them into histograms.
+*/
+class TofReconstruction
+{
+public:
+    /** Create the reconstruction
+        @param config the configuration
+    */
+    TofReconstruction(const TofConfig& config = defaultTofConfig);
+
+    /** Reconstruct a reading and add it to the histograms
+        @param frame the data frame from the body board
+        @return the reconstructed reading
+    */
+    TofReading update(const B2HDataFrame& frame);
+
+    /** Take a consistent copy of the histograms
+        @return the histograms
+    */
+    TofHistogram snapshot() const { return published.read(); }
+
+    /// Clear the histograms
+    void reset();
+
+    /** Reconstruct a reading, without accumulating it
+        @param frame the data frame from the body board
+        @param config the configuration
+        @return the reconstructed reading
+    */
+    static TofReading reconstruct(const B2HDataFrame& frame, const TofConfig& config);
+
+private:
+    /// The configuration
+    TofConfig config;
+
+    /// The histograms being accumulated
+    TofHistogram histogram;
+
+    /// The histograms, for other tasks to read
+    Seqlock<TofHistogram> published;
+};
+
+}
@@ -0,0 +1,497 @@
+/* Import of the bytes recorded by a logic analyser into capture files
+   Copyright 2024 Randall Maas
+*//**@file
+    @brief Import of the bytes recorded by a logic analyser into capture files.
+
+    This file contains the parsing of the numbers and rows, the streams of
+    bytes in each direction, and finding the frames in them.
+*/
+#include <Arduino.h>
+#include <string.h>
+#include "uartimport.h"
+
+namespace Spine {
+
+/// The powers of ten that fit in 64 bits
+static const uint64_t powersOfTen[20] =
+{
+    1ULL, 10ULL, 100ULL, 1000ULL, 10000ULL, 100000ULL, 1000000ULL, 10000000ULL,
+    100000000ULL, 1000000000ULL, 10000000000ULL, 100000000000ULL,
+    1000000000000ULL, 10000000000000ULL, 100000000000000ULL,
+    1000000000000000ULL, 10000000000000000ULL, 100000000000000000ULL,
+    1000000000000000000ULL, 10000000000000000000ULL
+};
+
+
+/** Parse eight decimal digits at once
+    @param ptr the characters; there must be at least eight
+    @param value the value of the digits
+    @return true if the eight characters are all digits
+
+    The characters are checked, and converted, as one 64 bit word: each
+    multiply combines the neighbouring digits, pairs, then quads.  This
+    assumes a little endian host.
+*/
+static inline bool eightDigits(const char* ptr, uint64_t& value)
+{
+    uint64_t word;
+    memcpy(&word, ptr, 8);
+    // each byte is 0x30..0x39: the high nibble is 3, and adding 6 doesn't
+    // carry into it
+    if (((word & 0xF0F0F0F0F0F0F0F0ULL) | (((word + 0x0606060606060606ULL) & 0xF0F0F0F0F0F0F0F0ULL) >> 4)) != 0x3333333333333333ULL)
+        return false;
+    word = (word & 0x0F0F0F0F0F0F0F0FULL) * 2561 >> 8;
+    word = (word & 0x00FF00FF00FF00FFULL) * 6553601 >> 16;
+    value = (word & 0x0000FFFF0000FFFFULL) * 42949672960001ULL >> 32;
+    return true;
+}
+
+
+/** Parse a run of decimal digits
+    @param ptr the digits; this is moved past them
+    @param end the end of the field
+    @param mantissa the digits are added to this, while it is under 18 digits
+    @param kept incremented by the number of digits added to the mantissa
+    @return the number of digits
+*/
+static size_t parseDigits(const char*& ptr, const char* end, uint64_t& mantissa, size_t& kept)
+{
+    auto begin = ptr;
+    uint64_t eight;
+    while (end - ptr >= 8 && mantissa < 10000000000ULL && eightDigits(ptr, eight))
+    {
+        mantissa = mantissa * 100000000ULL + eight;
+        ptr  += 8;
+        kept += 8;
+    }
+    for (; ptr < end && (unsigned)(*ptr - '0') < 10; ptr++)
+        if (mantissa < 100000000000000000ULL)
+        {
+            mantissa = mantissa * 10 + (unsigned)(*ptr - '0');
+            kept++;
+        }
+    return (size_t)(ptr - begin);
+}
+
+
+/** Parse a time in seconds, as nanoseconds
+    @param ptr the start of the field
+    @param end the end of the field
+    @param ns the time (in nanoseconds)
+    @return true on success, false if the field isn't a number, or is too large
+
+    The time is decimal (0.0000123) or exponent notation (1.23e-05).  The
+    digits past the nanoseconds are dropped.
+*/
+static bool parseTime(const char* ptr, const char* end, int64_t& ns)
+{
+    bool negative = ptr < end && *ptr == '-';
+    if (ptr < end && (*ptr == '-' || *ptr == '+'))
+        ptr++;
+
+    // the digits, as an integer mantissa and a power of ten
+    uint64_t mantissa = 0;
+    size_t kept = 0;
+    auto digits = parseDigits(ptr, end, mantissa, kept);
+    int scale = (int)(digits - kept);
+    if (ptr < end && *ptr == '.')
+    {
+        ptr++;
+        kept = 0;
+        digits += parseDigits(ptr, end, mantissa, kept);
+        scale -= (int) kept;
+    }
+    if (!digits)
+        return false;
+
+    if (ptr < end && (*ptr | 0x20) == 'e')
+    {
+        ptr++;
+        bool negativeExponent = ptr < end && *ptr == '-';
+        if (ptr < end && (*ptr == '-' || *ptr == '+'))
+            ptr++;
+        uint64_t exponent = 0;
+        size_t exponentKept = 0;
+        if (!parseDigits(ptr, end, exponent, exponentKept) || exponent > 1000)
+            return false;
+        scale += negativeExponent ? -(int) exponent : (int) exponent;
+    }
+    if (ptr != end)
+        return false;
+
+    // scale the seconds to nanoseconds
+    scale += 9;
+    uint64_t value;
+    if (scale >= 0)
+    {
+        if (scale > 18 || mantissa > (uint64_t) INT64_MAX / powersOfTen[scale])
+            return false;
+        value = mantissa * powersOfTen[scale];
+    }
+    else
+        value = scale < -19 ? 0 : mantissa / powersOfTen[-scale];
+    ns = negative ? -(int64_t) value : (int64_t) value;
+    return true;
+}
+
+
+/** Parse the value of a byte
+    @param ptr the start of the field
+    @param end the end of the field
+    @param value the value
+    @return true on success, false if the field isn't a byte
+
+    The value is hex (0xAA) or decimal (170).
+*/
+static bool parseByte(const char* ptr, const char* end, uint8_t& value)
+{
+    unsigned result = 0;
+    if (end - ptr > 2 && ptr[0] == '0' && (ptr[1] | 0x20) == 'x')
+    {
+        ptr += 2;
+        if (end - ptr > 2)
+            return false;
+        for (; ptr < end; ptr++)
+        {
+            unsigned digit = (unsigned)(*ptr - '0');
+            if (digit >= 10)
+            {
+                digit = (unsigned)((*ptr | 0x20) - 'a');
+                if (digit >= 6)
+                    return false;
+                digit += 10;
+            }
+            result = result * 16 + digit;
+        }
+    }
+    else
+    {
+        if (ptr == end || end - ptr > 3)
+            return false;
+        for (; ptr < end; ptr++)
+        {
+            unsigned digit = (unsigned)(*ptr - '0');
+            if (digit >= 10)
+                return false;
+            result = result * 10 + digit;
+        }
+        if (result > 255)
+            return false;
+    }
+    value = (uint8_t) result;
+    return true;
+}
+
+
+/** Trim the spaces and quotes around a field
+    @param begin the start of the field
+    @param end the end of the field
+*/
+static void trim(const char*& begin, const char*& end)
+{
+    while (begin < end && (*begin == ' ' || *begin == '"'))
+        begin++;
+    while (end > begin && (end[-1] == ' ' || end[-1] == '"' || end[-1] == '\r'))
+        end--;
+}
+
+
+UartImporter::UartImporter()
+    : numInputBytes(0), numRows(0), numBadRows(0), numFrames(0), numSkipped(0)
+    , writer(nullptr), first_ns(0), started(false), skipLines(0)
+{
+    numBytes[0] = numBytes[1] = 0;
+    for (auto& stream : streams)
+        stream.scan = stream.used = 0;
+}
+
+
+/** Start an import
+    @param writer the capture to write the frames to
+*/
+void UartImporter::start(CaptureWriter& writer)
+{
+    this->writer = &writer;
+    numInputBytes = 0;
+    numRows = numBadRows = 0;
+    numBytes[0] = numBytes[1] = 0;
+    numFrames = numSkipped = 0;
+    for (auto& stream : streams)
+        stream.scan = stream.used = 0;
+    first_ns = 0;
+    started = false;
+    skipLines = 0;
+}
+
+
+/** Import a CSV export
+    @param path the path of the export
+    @param writer the capture to write the frames to
+    @param format the columns of the export
+    @return true on success, false on an error reading or writing
+*/
+bool UartImporter::importCsv(const char* path, CaptureWriter& writer, const UartCsvFormat& format)
+{
+    start(writer);
+    skipLines = format.headerLines;
+    auto file = fopen(path, "rb");
+    if (!file)
+        return false;
+
+    // the lines left over are moved to the front of the buffer
+    bool ok = true;
+    size_t kept = 0;
+    for (;;)
+    {
+        auto num = fread(buffer + kept, 1, sizeof(buffer) - kept, file);
+        numInputBytes += num;
+        auto size = kept + num;
+        bool last = !num || feof(file);
+        auto used = parseCsv(size, format, last);
+        if (used < 0 || (!used && size == sizeof(buffer)))
+        {
+            // an error writing, or a line longer than the buffer
+            ok = false;
+            break;
+        }
+        if (last)
+            break;
+        kept = size - (size_t) used;
+        memmove(buffer, buffer + used, kept);
+    }
+    ok = !ferror(file) && ok;
+    fclose(file);
+    return decode(true) && ok;
+}
+
+
+/** Import a binary export
+    @param path the path of the export
+    @param writer the capture to write the frames to
+    @return true on success, false on an error reading or writing
+*/
+bool UartImporter::importBinary(const char* path, CaptureWriter& writer)
+{
+    start(writer);
+    auto file = fopen(path, "rb");
+    if (!file)
+        return false;
+
+    bool ok = true;
+    size_t kept = 0;
+    for (;;)
+    {
+        auto num = fread(buffer + kept, 1, sizeof(buffer) - kept, file);
+        numInputBytes += num;
+        auto size = kept + num;
+        size_t used = 0;
+        for (; used + sizeof(UartRecord) <= size; used += sizeof(UartRecord))
+        {
+            UartRecord record;
+            memcpy(&record, buffer + used, sizeof(record));
+            numRows++;
+            if (record.channel > 1)
+                numBadRows++;
+            else if (!add(record.channel, (int64_t) record.timestamp_ns, record.value))
+            {
+                ok = false;
+                break;
+            }
+        }
+        kept = size - used;
+        if (!ok || !num || feof(file))
+            break;
+        memmove(buffer, buffer + used, kept);
+    }
+
+    // a record cut short
+    if (kept)
+    {
+        numRows++;
+        numBadRows++;
+    }
+    ok = !ferror(file) && ok;
+    fclose(file);
+    return decode(true) && ok;
+}
+
+
+/** Parse the CSV rows in the buffer
+    @param size the number of bytes in the buffer
+    @param format the columns of the export
+    @param last true if this is the end of the export
+    @return the number of bytes used; the rest are a partial line, or
+            -1 on an error writing
+*/
+long UartImporter::parseCsv(size_t size, const UartCsvFormat& format, bool last)
+{
+    const uint8_t columns[3] = {format.timeColumn, format.channelColumn, format.valueColumn};
+    auto lastColumn = columns[0] > columns[1] ? columns[0] : columns[1];
+    if (columns[2] > lastColumn)
+        lastColumn = columns[2];
+    const size_t nameLength[2] = {strlen(format.channels[0]), strlen(format.channels[1])};
+
+    const char* ptr = buffer;
+    auto end = buffer + size;
+    while (ptr < end)
+    {
+        auto eol = (const char*) memchr(ptr, '\n', (size_t)(end - ptr));
+        if (!eol)
+        {
+            if (!last)
+                break;
+            eol = end;
+        }
+        auto line = ptr;
+        ptr = eol < end ? eol + 1 : end;
+        if (skipLines)
+        {
+            skipLines--;
+            continue;
+        }
+        if (line == eol || (eol - line == 1 && *line == '\r'))
+            continue;
+        numRows++;
+
+        // the fields of the time, channel and value
+        const char* begins[3] = {}, *ends[3] = {};
+        auto field = line;
+        for (size_t column = 0; column <= lastColumn; column++)
+        {
+            auto comma = (const char*) memchr(field, ',', (size_t)(eol - field));
+            auto fieldEnd = comma ? comma : eol;
+            for (size_t idx = 0; idx < 3; idx++)
+                if (columns[idx] == column)
+                {
+                    begins[idx] = field;
+                    ends[idx]   = fieldEnd;
+                    trim(begins[idx], ends[idx]);
+                }
+            if (!comma)
+                break;
+            field = comma + 1;
+        }
+
+        int64_t timestamp_ns;
+        uint8_t value;
+        if (!begins[0] || !begins[1] || !begins[2]
+            || !parseTime(begins[0], ends[0], timestamp_ns)
+            || !parseByte(begins[2], ends[2], value))
+        {
+            numBadRows++;
+            continue;
+        }
+
+        // the direction from the name of the channel
+        auto length = (size_t)(ends[1] - begins[1]);
+        unsigned direction = 0;
+        for (; direction < 2; direction++)
+            if (length == nameLength[direction] && !memcmp(begins[1], format.channels[direction], length))
+                break;
+        if (direction >= 2)
+        {
+            numBadRows++;
+            continue;
+        }
+        if (!add(direction, timestamp_ns, value))
+            return -1;
+    }
+    return ptr - buffer;
+}
+
+
+/** Add a byte to the stream of its direction
+    @param direction 0 for the body board, 1 for the head board
+    @param timestamp_ns the time the byte started (in nanoseconds)
+    @param value the value of the byte
+    @return true on success, false on an error writing
+*/
+bool UartImporter::add(unsigned direction, int64_t timestamp_ns, uint8_t value)
+{
+    if (!started)
+    {
+        first_ns = timestamp_ns;
+        started  = true;
+    }
+    auto& stream = streams[direction];
+    if (stream.used == UART_IMPORT_STREAM_SIZE && !decode(false))
+        return false;
+    stream.bytes[stream.used] = value;
+    stream.times[stream.used] = timestamp_ns > first_ns ? (uint64_t)(timestamp_ns - first_ns) : 0;
+    stream.used++;
+    numBytes[direction]++;
+    return true;
+}
+
+
+/** Write the frames in both streams, in the order of their time
+    @param last true if this is the end of the export; the bytes left
+           over are skipped
+    @return true on success, false on an error writing
+
+    Both streams hold the bytes up to the same row, so the frames found in
+    them now all end before any found later.
+*/
+bool UartImporter::decode(bool last)
+{
+    /// A frame found in a stream
+    struct Found
+    {
+        const uint8_t* frame;
+        MessageType type;
+        size_t payloadSize;
+        uint64_t timestamp_ns;
+    };
+
+    // find the next frame in a stream
+    auto findNext = [this](unsigned direction, Found& found)
+    {
+        auto& stream = streams[direction];
+        auto start = stream.bytes + stream.scan;
+        auto size  = stream.used - stream.scan;
+        found.frame = direction == 0
+                    ? B2H::FindMessage(start, size, found.type, found.payloadSize)
+                    : H2B::FindMessage(start, size, found.type, found.payloadSize);
+        numSkipped += found.frame - start;
+        stream.scan = found.frame - stream.bytes;
+        if ((int) found.type == -1)
+            return false;
+        auto frameSize = payload_ofs + found.payloadSize + 4;
+        found.timestamp_ns = stream.times[stream.scan + frameSize - 1];
+        stream.scan += frameSize;
+        return true;
+    };
+
+    // merge the frames of the two streams
+    Found found[2];
+    bool more[2] = {findNext(0, found[0]), findNext(1, found[1])};
+    while (more[0] || more[1])
+    {
+        unsigned direction = !more[1] || (more[0] && found[0].timestamp_ns <= found[1].timestamp_ns) ? 0 : 1;
+        auto& frame = found[direction];
+        if (!writer->write(direction == 0, frame.type, frame.frame + payload_ofs, frame.payloadSize, frame.timestamp_ns))
+            return false;
+        numFrames++;
+        more[direction] = findNext(direction, frame);
+    }
+
+    // keep the partial frames for the bytes to come
+    for (auto& stream : streams)
+    {
+        if (last)
+        {
+            numSkipped += stream.used - stream.scan;
+            stream.used = 0;
+        }
+        else
+        {
+            stream.used -= stream.scan;
+            memmove(stream.bytes, stream.bytes + stream.scan, stream.used);
+            memmove(stream.times, stream.times + stream.scan, stream.used * sizeof(stream.times[0]));
+        }
+        stream.scan = 0;
+    }
+    return true;
+}
+
+}
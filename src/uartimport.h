@@ -0,0 +1,186 @@
+/* Import of the bytes recorded by a logic analyser into capture files
+   Copyright 2024 Randall Maas
+*//**@file
+    @brief Import of the bytes recorded by a logic analyser into capture files.
+
+    The bytes on the spine can be recorded with a logic analyser, decoding
+    the two UART lines (one each way), rather than through the bridge.  The
+    analyser exports the bytes with the time each started, as a CSV table.
+    The importer rebuilds the stream of bytes in each direction from the
+    table, finds the frames in them (checking the CRC, as FindMessage does),
+    and writes the frames to a capture file (see capture.h):
+
+    @code
+    static UartImporter importer;
+    CaptureWriter writer;
+    writer.open("field.cap");
+    importer.importCsv("field.csv", writer, saleaeCsvFormat);
+    writer.close();
+    @endcode
+
+    The CSV has a row for each byte, with the time (in seconds, as decimal
+    or exponent notation, e.g. 0.0000123 or 1.23e-05), the name of the
+    channel, and the value of the byte (hex, e.g. 0xAA, or decimal).  The
+    columns are given by the format; the other columns are ignored.  The
+    fields may be quoted, but may not contain commas.
+
+    The binary form is a sequence of UartRecord, in the host's byte order
+    (little endian).
+
+    The rows must be in the order of their time, as the analyser exports
+    them.  The time stamps of the frames are in nanoseconds from the first
+    byte of the export, and are the time of the last byte of each frame.
+    The rows that don't parse are counted and skipped; the bytes that aren't
+    in a frame (the noise, or a frame with a bad CRC) are counted and
+    skipped.
+
+    The numbers are parsed by hand, without the locale or floating point:
+    the time is read as an integer number of nanoseconds, eight digits at a
+    time where it can be.
+*/
+#pragma once
+#include <inttypes.h>
+#include <stdio.h>
+#include "pack.h"
+#include "spine.h"
+#include "capture.h"
+
+namespace Spine {
+
+/// The columns of a CSV export
+struct UartCsvFormat
+{
+    /// The column (from 0) of the time of the byte (in seconds)
+    uint8_t timeColumn;
+
+    /// The column of the name of the channel
+    uint8_t channelColumn;
+
+    /// The column of the value of the byte
+    uint8_t valueColumn;
+
+    /// The number of header lines before the rows
+    uint8_t headerLines;
+
+    /// The names of the channels with the bytes from the body board, and
+    /// from the head board
+    const char* channels[2];
+};
+
+/// time,channel,value with a line of header
+constexpr UartCsvFormat defaultCsvFormat = {0, 1, 2, 1, {"B2H", "H2B"}};
+
+/// The table of a Saleae Logic 2 Async Serial analyser on each line, named
+/// "B2H" and "H2B": name,type,start_time,duration,data
+constexpr UartCsvFormat saleaeCsvFormat = {2, 0, 4, 1, {"B2H", "H2B"}};
+
+/// A byte in the binary form
+PACK(struct UartRecord
+{
+    /// The time the byte started (in nanoseconds)
+    uint64_t timestamp_ns;
+
+    /// 0 for a byte from the body board, 1 from the head board
+    uint8_t channel;
+
+    /// The value of the byte
+    uint8_t value;
+});
+
+
+/** Imports the bytes recorded by a logic analyser into a capture
+*/
+class UartImporter
+{
+public:
+    UartImporter();
+
+    /** Import a CSV export
+        @param path the path of the export
+        @param writer the capture to write the frames to
+        @param format the columns of the export
+        @return true on success, false on an error reading or writing
+    */
+    bool importCsv(const char* path, CaptureWriter& writer, const UartCsvFormat& format = defaultCsvFormat);
+
+    /** Import a binary export
+        @param path the path of the export
+        @param writer the capture to write the frames to
+        @return true on success, false on an error reading or writing
+    */
+    bool importBinary(const char* path, CaptureWriter& writer);
+
+    /// The number of bytes of the export read
+    uint64_t numInputBytes;
+
+    /// The number of rows, and the rows that didn't parse or were on
+    /// another channel
+    size_t numRows, numBadRows;
+
+    /// The number of bytes in each direction: from the body board, and from
+    /// the head board
+    size_t numBytes[2];
+
+    /// The number of frames written, and the bytes skipped that weren't in a
+    /// frame
+    size_t numFrames, numSkipped;
+
+private:
+    /** Start an import
+        @param writer the capture to write the frames to
+    */
+    void start(CaptureWriter& writer);
+
+    /** Parse the CSV rows in the buffer
+        @param size the number of bytes in the buffer
+        @param format the columns of the export
+        @param last true if this is the end of the export
+        @return the number of bytes used; the rest are a partial line, or
+                -1 on an error writing
+    */
+    long parseCsv(size_t size, const UartCsvFormat& format, bool last);
+
+    /** Add a byte to the stream of its direction
+        @param direction 0 for the body board, 1 for the head board
+        @param timestamp_ns the time the byte started (in nanoseconds)
+        @param value the value of the byte
+        @return true on success, false on an error writing
+    */
+    bool add(unsigned direction, int64_t timestamp_ns, uint8_t value);
+
+    /** Write the frames in both streams, in the order of their time
+        @param last true if this is the end of the export; the bytes left
+               over are skipped
+        @return true on success, false on an error writing
+    */
+    bool decode(bool last);
+
+    /// The bytes from one board
+    struct ByteStream
+    {
+        /// The bytes, and the time each started (in nanoseconds)
+        uint8_t  bytes[UART_IMPORT_STREAM_SIZE];
+        uint64_t times[UART_IMPORT_STREAM_SIZE];
+
+        /// Where to resume looking for a frame, and the end of the bytes
+        size_t scan, used;
+    };
+
+    /// The streams from the body board, and from the head board
+    ByteStream streams[2];
+
+    /// The capture being written
+    CaptureWriter* writer;
+
+    /// The time of the first byte (in nanoseconds), once there is one
+    int64_t first_ns;
+    bool started;
+
+    /// The number of header lines yet to skip
+    size_t skipLines;
+
+    /// The bytes read from the export
+    char buffer[UART_IMPORT_BUFFER_SIZE];
+};
+
+}
@@ -1 +1,4 @@
 #pragma once
+
+/// Mock of the microsecond timer for testing
+inline unsigned long micros() { return 0; }
@@ -0,0 +1,90 @@
+#include <vector>
+#include <cstdint>
+
+#include "../src/angle.cpp"
+
+#include <CppUnitTest.h>
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+using namespace Spine;
+
+TEST_CLASS(AngleTests)
+{
+public:
+
+    /// Test Method for frames where nothing moved:
+    /// Frames without the changed bits set are skipped, without publishing.
+    TEST_METHOD(TestUnchangedFramesSkipped)
+    {
+        AngleTracker tracker;
+        B2HDataFrame frame = {};
+
+        for (uint32_t idx = 0; idx < 10; idx++)
+        {
+            frame.sequenceNumber = idx;
+            Assert::IsFalse(tracker.update(frame, idx * 5000));
+        }
+
+        Assert::AreEqual((uint32_t) 10, tracker.numFrames);
+        Assert::AreEqual((uint32_t) 0, tracker.numUpdates);
+        Assert::AreEqual((uint32_t) 0, tracker.head.version());
+        Assert::AreEqual((uint32_t) 0, tracker.lift.version());
+    }
+
+    /// Test Method for head motion:
+    /// Only the head is updated when only its bit is set; the velocity comes
+    /// from the encoder delta, and returns to zero when the head stops.
+    TEST_METHOD(TestHeadMotion)
+    {
+        AngleTracker tracker;
+        B2HDataFrame frame = {};
+        tracker.update(frame, 0);
+
+        // move the head by 10 ticks in 5ms
+        frame.sequenceNumber = 1;
+        frame.headEncoderChanged = 1;
+        frame.motor[(int)Motor::backRight].position = 10;
+        frame.motor[(int)Motor::backRight].delta = 10;
+        Assert::IsTrue(tracker.update(frame, 5000));
+
+        auto head = tracker.head.read();
+        Assert::AreEqual((uint32_t) 1, head.sequenceNumber);
+        Assert::AreEqual(10.0f / defaultHeadConfig.ticksPerRadian, head.angle, 1e-6f);
+        Assert::AreEqual(2000.0f / defaultHeadConfig.ticksPerRadian, head.velocity, 1e-3f);
+        Assert::AreEqual((uint32_t) 0, tracker.lift.version());
+
+        // the head stops
+        frame.sequenceNumber = 2;
+        frame.headEncoderChanged = 0;
+        Assert::IsTrue(tracker.update(frame, 10000));
+        Assert::AreEqual(0.0f, tracker.head.read().velocity, 0.0f);
+
+        // and stays stopped, with no more work
+        frame.sequenceNumber = 3;
+        Assert::IsFalse(tracker.update(frame, 15000));
+        Assert::AreEqual((uint32_t) 2, tracker.head.version());
+    }
+
+    /// Test Method for the limit:
+    /// Driving the lift past its lower stop references the axis to the stop.
+    TEST_METHOD(TestLimitCalibration)
+    {
+        AngleTracker tracker;
+        B2HDataFrame frame = {};
+        frame.liftEncoderChanged = 1;
+        frame.motor[(int)Motor::backLeft].position = -5000;
+        tracker.update(frame, 0);
+
+        auto lift = tracker.lift.read();
+        Assert::AreEqual(defaultLiftConfig.minAngle, lift.angle, 1e-6f);
+        Assert::IsTrue(lift.atMinLimit);
+        Assert::IsFalse(lift.atMaxLimit);
+        Assert::IsTrue(lift.calibrated);
+
+        // moving up from the stop is relative to the new reference
+        frame.motor[(int)Motor::backLeft].position = -4900;
+        tracker.update(frame, 5000);
+        lift = tracker.lift.read();
+        Assert::AreEqual(defaultLiftConfig.minAngle + 100.0f/defaultLiftConfig.ticksPerRadian, lift.angle, 1e-4f);
+        Assert::IsFalse(lift.atMinLimit);
+    }
+};
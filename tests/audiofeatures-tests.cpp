@@ -0,0 +1,201 @@
+#include <vector>
+#include <cstdint>
+#include <chrono>
+#include <cmath>
+#include <random>
+#include <string>
+
+#include "../src/audiofeatures.cpp"
+
+#include <CppUnitTest.h>
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+using namespace Spine;
+
+TEST_CLASS(AudioFeaturesTests)
+{
+public:
+
+    /** Make the samples of a tone
+        @param count the number of samples
+        @param frequency the frequency of the tone (in Hz)
+        @return the samples
+    */
+    static std::vector<int16_t> tone(size_t count, double frequency)
+    {
+        std::vector<int16_t> samples(count);
+        for (size_t idx = 0; idx < count; idx++)
+            samples[idx] = (int16_t) lround(8000*sin(2*3.14159265358979*frequency*idx / MICROPHONE_SAMPLE_RATE));
+        return samples;
+    }
+
+    /// Test Method for the real FFT:
+    /// It matches a plain DFT of random samples.
+    TEST_METHOD(TestFft)
+    {
+        const size_t N = 64;
+        std::mt19937 random(1);
+        std::uniform_real_distribution<float> uniform(-1, 1);
+        float in[N];
+        for (auto& value : in)
+            value = uniform(random);
+
+        RealFft<N> fft;
+        float spectrum[N+2];
+        fft.forward(in, spectrum);
+        for (size_t k = 0; k <= N/2; k++)
+        {
+            double re = 0, im = 0;
+            for (size_t idx = 0; idx < N; idx++)
+            {
+                re += in[idx] * cos(2*3.14159265358979*k*idx / N);
+                im -= in[idx] * sin(2*3.14159265358979*k*idx / N);
+            }
+            Assert::IsTrue(fabs(spectrum[2*k] - re) < 1e-4);
+            Assert::IsTrue(fabs(spectrum[2*k+1] - im) < 1e-4);
+        }
+    }
+
+    /// Test Method for the log-mel band powers of a tone:
+    /// The band holding the tone has the most power.
+    TEST_METHOD(TestTone)
+    {
+        FeatureConfig config = defaultFeatureConfig;
+        config.numCoefficients = 0;
+        FeatureExtractor features(config);
+        const double frequency = 1000;
+        auto samples = tone(FEATURE_FRAME_LENGTH, frequency);
+        features.push(samples.data(), samples.size());
+
+        FeatureFrame frame;
+        Assert::IsTrue(features.pop(frame));
+        Assert::AreEqual((int) FEATURE_MEL_BANDS, (int) frame.count);
+        size_t loudest = 0;
+        for (size_t idx = 0; idx < frame.count; idx++)
+            if (frame.values[idx] > frame.values[loudest])
+                loudest = idx;
+
+        // the band whose peak is nearest the tone
+        double bin = frequency * FEATURE_FFT_SIZE / MICROPHONE_SAMPLE_RATE;
+        Assert::IsTrue(mel.bands[loudest].left < bin && bin < mel.bands[loudest].right);
+        Assert::IsFalse(features.pop(frame));
+    }
+
+    /// Test Method for the hop:
+    /// A feature frame is made after the first frame length, then every hop.
+    TEST_METHOD(TestHop)
+    {
+        FeatureExtractor features;
+        auto samples = tone(FEATURE_FRAME_LENGTH + 3*defaultFeatureConfig.hop - 1, 440);
+        // in data frame size pieces, as from the body board
+        for (size_t idx = 0; idx < samples.size(); idx += MICROPHONE_SAMPLES_PER_FRAME)
+        {
+            size_t count = samples.size() - idx;
+            features.push(samples.data() + idx, count < MICROPHONE_SAMPLES_PER_FRAME ? count : MICROPHONE_SAMPLES_PER_FRAME);
+        }
+        Assert::AreEqual(3u, features.numFrames);
+
+        FeatureFrame frame;
+        uint32_t expected = FEATURE_FRAME_LENGTH;
+        while (features.pop(frame))
+        {
+            Assert::AreEqual(expected, frame.sampleNumber);
+            Assert::AreEqual((int) defaultFeatureConfig.numCoefficients, (int) frame.count);
+            expected += defaultFeatureConfig.hop;
+        }
+        Assert::AreEqual(FEATURE_FRAME_LENGTH + 3u*defaultFeatureConfig.hop, expected);
+    }
+
+    /// Test Method for a hop longer than the frame:
+    /// The samples between the frames are skipped, so each frame is of the
+    /// samples just before it.
+    TEST_METHOD(TestLongHop)
+    {
+        FeatureConfig config = {2*FEATURE_FRAME_LENGTH, 0, 0};
+        FeatureExtractor features(config);
+        std::vector<int16_t> samples(5*FEATURE_FRAME_LENGTH);
+        std::mt19937 random(7);
+        for (auto& sample : samples)
+            sample = (int16_t)(random() % 16000) - 8000;
+        features.push(samples.data(), samples.size());
+        Assert::AreEqual(3u, features.numFrames);
+
+        FeatureFrame frame;
+        for (uint32_t idx = 0; idx < 3; idx++)
+        {
+            Assert::IsTrue(features.pop(frame));
+            uint32_t end = (2*idx + 1)*FEATURE_FRAME_LENGTH;
+            Assert::AreEqual(end, frame.sampleNumber);
+
+            // the same as a frame of just those samples
+            FeatureExtractor alone(config);
+            alone.push(samples.data() + end - FEATURE_FRAME_LENGTH, FEATURE_FRAME_LENGTH);
+            FeatureFrame expected;
+            Assert::IsTrue(alone.pop(expected));
+            for (size_t band = 0; band < FEATURE_MEL_BANDS; band++)
+                Assert::AreEqual((double) expected.values[band], (double) frame.values[band], 1e-4);
+        }
+    }
+
+    /// Test Method for the ring:
+    /// When no one takes the feature frames out, the new ones are dropped.
+    TEST_METHOD(TestRing)
+    {
+        FeatureExtractor features;
+        auto samples = tone(FEATURE_FRAME_LENGTH + (FEATURE_RING_FRAMES+4)*defaultFeatureConfig.hop, 440);
+        features.push(samples.data(), samples.size());
+        Assert::AreEqual((uint32_t) FEATURE_RING_FRAMES + 5, features.numFrames);
+        Assert::AreEqual(5u, features.numDropped);
+
+        // the oldest frames were kept
+        FeatureFrame frame;
+        Assert::IsTrue(features.pop(frame));
+        Assert::AreEqual((uint32_t) FEATURE_FRAME_LENGTH, frame.sampleNumber);
+        size_t count = 1;
+        while (features.pop(frame))
+            count++;
+        Assert::AreEqual((size_t) FEATURE_RING_FRAMES, count);
+    }
+
+    /// Test Method for the MFCCs:
+    /// The first is the scaled mean of the log-mel band powers.
+    TEST_METHOD(TestMfcc)
+    {
+        FeatureConfig config = defaultFeatureConfig;
+        config.numCoefficients = 0;
+        FeatureExtractor bands(config);
+        FeatureExtractor mfcc;
+        auto samples = tone(FEATURE_FRAME_LENGTH, 2500);
+        bands.push(samples.data(), samples.size());
+        mfcc.push(samples.data(), samples.size());
+
+        FeatureFrame logMel, coefficients;
+        Assert::IsTrue(bands.pop(logMel));
+        Assert::IsTrue(mfcc.pop(coefficients));
+        double sum = 0;
+        for (size_t idx = 0; idx < logMel.count; idx++)
+            sum += logMel.values[idx];
+        Assert::IsTrue(fabs(sum / sqrt((double) FEATURE_MEL_BANDS) - coefficients.values[0]) < 1e-2);
+    }
+
+    /// Test Method for the cost:
+    /// Log the time to compute a feature frame, against the hop.
+    TEST_METHOD(TestSpeed)
+    {
+        FeatureExtractor features;
+        auto samples = tone(FEATURE_FRAME_LENGTH + 1000*defaultFeatureConfig.hop, 440);
+        FeatureFrame frame;
+        auto start = std::chrono::steady_clock::now();
+        for (size_t idx = 0; idx < samples.size(); idx += defaultFeatureConfig.hop)
+        {
+            size_t count = samples.size() - idx;
+            features.push(samples.data() + idx, count < defaultFeatureConfig.hop ? count : defaultFeatureConfig.hop);
+            while (features.pop(frame))
+                ;
+        }
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        Assert::AreEqual(0u, features.numDropped);
+        double us = seconds * 1e6 / features.numFrames;
+        Logger::WriteMessage(("features: " + std::to_string(us) + " us/frame, of a "
+                              + std::to_string(1e6 * defaultFeatureConfig.hop / MICROPHONE_SAMPLE_RATE) + " us hop\n").c_str());
+    }
+};
@@ -0,0 +1,127 @@
+#include <vector>
+#include <cstdint>
+#include <chrono>
+#include <cmath>
+#include <random>
+#include <string>
+
+#include "../src/beamformer.cpp"
+
+#include <CppUnitTest.h>
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+using namespace Spine;
+
+TEST_CLASS(BeamformerTests)
+{
+public:
+
+    /** Make the data frames of a tone from a direction, and noise at each
+        microphone
+        @param numFrames the number of frames
+        @param azimuth the direction of the tone (in radians)
+        @param frequency the frequency of the tone (in Hz), 0 for none
+        @param noise the standard deviation of the noise
+        @return the frames
+    */
+    static std::vector<B2HDataFrame> sound(size_t numFrames, float azimuth, float frequency, double noise)
+    {
+        std::mt19937 random(1);
+        std::normal_distribution<double> normal(0, noise > 0 ? noise : 1);
+        auto& config = defaultBeamformerConfig;
+        std::vector<B2HDataFrame> frames(numFrames);
+        for (size_t frame = 0; frame < numFrames; frame++)
+        {
+            frames[frame] = {};
+            for (size_t idx = 0; idx < MICROPHONE_SAMPLES_PER_FRAME; idx++)
+                for (size_t mic = 0; mic < MICROPHONE_COUNT; mic++)
+                {
+                    double arrival = -(config.micX[mic]*cos(azimuth) + config.micY[mic]*sin(azimuth)) / config.speedOfSound;
+                    double t = (double)(frame*MICROPHONE_SAMPLES_PER_FRAME + idx) / MICROPHONE_SAMPLE_RATE - arrival;
+                    double value = 4000*sin(2*3.14159265358979*frequency*t) + (noise > 0 ? normal(random) : 0);
+                    frames[frame].mic_samples[idx*MICROPHONE_COUNT + mic] = (int16_t) lround(value);
+                }
+        }
+        return frames;
+    }
+
+    /// The power of the beamformer's output, after the first few frames
+    static double outputPower(Beamformer& beamformer, const std::vector<B2HDataFrame>& frames)
+    {
+        double power = 0;
+        size_t num = 0;
+        for (size_t frame = 0; frame < frames.size(); frame++)
+        {
+            int16_t out[MICROPHONE_SAMPLES_PER_FRAME];
+            beamformer.process(frames[frame], out);
+            if (frame < 2)
+                continue;
+            for (auto value : out)
+                power += (double) value * value;
+            num += MICROPHONE_SAMPLES_PER_FRAME;
+        }
+        return power / num;
+    }
+
+    /// Test Method for a tone from the steered direction:
+    /// It passes with about the same power as at a microphone.
+    TEST_METHOD(TestSteeredTone)
+    {
+        const float azimuth = 1.0f;
+        Beamformer beamformer;
+        beamformer.steer(azimuth);
+        double power = outputPower(beamformer, sound(50, azimuth, 2000, 0));
+        // the power of a sine of amplitude 4000
+        double ratio = power / (4000.0*4000.0/2);
+        Logger::WriteMessage(("steered tone: gain " + std::to_string(ratio) + "\n").c_str());
+        Assert::IsTrue(ratio > 0.95 && ratio < 1.05);
+    }
+
+    /// Test Method for the noise at each microphone:
+    /// The noise doesn't line up, so it is about a quarter of the power (6 dB
+    /// less) than at a microphone; a little less, as the fractional delay
+    /// filters smooth it.
+    TEST_METHOD(TestNoise)
+    {
+        Beamformer beamformer;
+        double power = outputPower(beamformer, sound(50, 0, 0, 1000));
+        double ratio = power / (1000.0*1000.0);
+        Logger::WriteMessage(("noise: gain " + std::to_string(ratio) + "\n").c_str());
+        Assert::IsTrue(ratio > 0.15 && ratio < 0.3);
+    }
+
+    /// Test Method for the direction estimate:
+    /// The direction of a tone is found, to within one of the directions tried.
+    TEST_METHOD(TestEstimate)
+    {
+        const float step = 2*pi / BEAMFORMER_DIRECTIONS;
+        for (float azimuth : {0.0f, 1.2f, -2.0f, 3.0f})
+        {
+            auto frames = sound(3, azimuth, 5000, 0);
+            Beamformer beamformer;
+            int16_t out[MICROPHONE_SAMPLES_PER_FRAME];
+            beamformer.process(frames[0], out);
+            float estimate = beamformer.estimate(frames[1]);
+            float error = fabsf(remainderf(estimate - azimuth, 2*pi));
+            Logger::WriteMessage(("estimate: " + std::to_string(azimuth) + " -> " + std::to_string(estimate) + "\n").c_str());
+            Assert::IsTrue(error <= step);
+        }
+    }
+
+    /// Test Method for the cost:
+    /// The time to process a frame is logged.
+    TEST_METHOD(TestCost)
+    {
+        auto frames = sound(100, 0.5f, 1000, 100);
+        Beamformer beamformer;
+        beamformer.steer(0.5f);
+        int16_t out[MICROPHONE_SAMPLES_PER_FRAME];
+        const size_t numFrames = 20000;
+        auto start = std::chrono::steady_clock::now();
+        for (size_t idx = 0; idx < numFrames; idx++)
+            beamformer.process(frames[idx % frames.size()], out);
+        std::chrono::duration<double> seconds = std::chrono::steady_clock::now() - start;
+        Assert::AreEqual((uint32_t) numFrames, beamformer.numFrames);
+        Logger::WriteMessage(("beamformer: " + std::to_string(seconds.count() / numFrames * 1e6) + " us/frame, of "
+                              + std::to_string(B2H_FRAME_PERIOD_US) + " us\n").c_str());
+    }
+};
@@ -0,0 +1,108 @@
+#include <vector>
+#include <cstdint>
+
+#define Stream MockStream
+#include "mockStream.h"
+
+#include "../src/bringup.cpp"
+#include "testFrames.h"
+
+#include <CppUnitTest.h>
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+using namespace Spine;
+
+TEST_CLASS(BringupTests)
+{
+public:
+
+    /// Append an ack frame from the body board
+    static void ackFrame(std::vector<uint8_t>& bytes, int32_t value)
+    {
+        TestFrames::appendFrame(bytes, true, MessageType::ack, &value, sizeof(value));
+    }
+
+    /// Test Method for the reset banner:
+    /// The preamble and banner are recognized, and counted as one reset.
+    TEST_METHOD(TestBanner)
+    {
+        LinkBringup bringup;
+        const uint8_t preamble[] = {0xFF, 0x16, 0x92, 0x16, 0x1F, 0x16, 0xCF, 0x16};
+        for (auto byte : preamble)
+            bringup.observe(byte, 100);
+        Assert::AreEqual((int) LinkState::booting, (int) bringup.state);
+
+        for (auto ch : "\nbooted\n")
+            bringup.observe((uint8_t) ch, 200);
+        Assert::AreEqual((uint32_t) 1, bringup.numResets);
+    }
+
+    /// Test Method for the banner alone:
+    /// Without the preamble, the banner still marks a reset.
+    TEST_METHOD(TestBannerWithoutPreamble)
+    {
+        LinkBringup bringup;
+        bool seen = false;
+        for (auto ch : "junk\n\nbooted\n")
+            seen |= bringup.observe((uint8_t) ch, 0);
+        Assert::IsTrue(seen);
+        Assert::AreEqual((uint32_t) 1, bringup.numResets);
+        Assert::AreEqual((int) LinkState::booting, (int) bringup.state);
+    }
+
+    /// Test Method for a broken banner:
+    /// A banner cut short, or with a repeated letter, restarts the match on
+    /// the next newline without counting a reset.
+    TEST_METHOD(TestBrokenBanner)
+    {
+        LinkBringup bringup;
+        bool seen = false;
+        const char bytes[] = "\nbooooted\n\nbo\nboot\nbooted";
+        for (size_t idx = 0; idx < sizeof(bytes)-1; idx++)
+            seen |= bringup.observe((uint8_t) bytes[idx], 0);
+        Assert::IsFalse(seen);
+        Assert::AreEqual((uint32_t) 0, bringup.numResets);
+
+        Assert::IsTrue(bringup.observe('\n', 0));
+        Assert::AreEqual((uint32_t) 1, bringup.numResets);
+    }
+
+    /// Test Method for the sync:
+    /// A false start whose breaking byte is itself a sync byte, and a sync
+    /// split across calls, are both received.
+    TEST_METHOD(TestSync)
+    {
+        MockStream mockStream;
+        LinkBringup bringup;
+        std::vector<uint8_t> bytes = {0x00, 0xAA, 'B', 0xAA};
+        std::vector<uint8_t> rest;
+        ackFrame(rest, 1);
+        // the first sync byte of the frame is in with the false start
+        bytes.insert(bytes.end(), rest.begin() + 1, rest.end());
+
+        size_t payload_size = 0;
+        mockStream.setBuffer(std::vector<uint8_t>(bytes.begin(), bytes.begin() + 5));
+        Assert::AreEqual(-1, (int) bringup.receive(mockStream, payload_size));
+
+        mockStream.setBuffer(std::vector<uint8_t>(bytes.begin() + 5, bytes.end()));
+        Assert::AreEqual((int) MessageType::ack, (int) bringup.receive(mockStream, payload_size));
+        Assert::AreEqual((size_t) 4, payload_size);
+        Assert::AreEqual((uint32_t) 3, bringup.numSkipped);
+    }
+
+    /// Test Method for the boot-loader:
+    /// A NAK puts the link in the boot-loader state, and the time to the
+    /// first frame is reported.
+    TEST_METHOD(TestBootloaderNak)
+    {
+        MockStream mockStream;
+        LinkBringup bringup;
+        std::vector<uint8_t> bytes(std::begin("\nbooted\n"), std::end("\nbooted\n") - 1);
+        ackFrame(bytes, 0);
+        mockStream.setBuffer(bytes);
+
+        size_t payload_size = 0;
+        Assert::AreEqual((int) MessageType::ack, (int) bringup.receive(mockStream, payload_size));
+        Assert::AreEqual((int) LinkState::bootloader, (int) bringup.state);
+        Assert::AreEqual((uint32_t) 0, bringup.timeToFirstFrame_us);
+    }
+};
@@ -0,0 +1,124 @@
+#include <vector>
+#include <cstdint>
+
+#define Stream MockStream
+#include "mockStream.h"
+
+#include "../src/spine.h"
+#include "../src/capi.cpp"
+#include "testFrames.h"
+
+#include <CppUnitTest.h>
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+using namespace Spine;
+
+TEST_CLASS(CapiTests)
+{
+public:
+
+    /// Build a data frame from the body board
+    static std::vector<uint8_t> dataFrame(uint32_t sequenceNumber)
+    {
+        B2HDataFrame payload = {};
+        payload.sequenceNumber = sequenceNumber;
+        return TestFrames::makeFrame(true, MessageType::dataFrame, &payload, sizeof(payload));
+    }
+
+    /// Count the frames passed to the callback
+    static void count(const spine_frame*, void* context)
+    {
+        ++*(int*) context;
+    }
+
+    /// Test Method for polling frames:
+    /// The frames fed in come out with their type, size, sequence number,
+    /// time and payload, amid bytes that aren't frames.
+    TEST_METHOD(TestPoll)
+    {
+        auto frame = dataFrame(42);
+        auto frame_size = frame.size();
+
+        auto link = spine_open_buffer(SPINE_B2H);
+        uint8_t noise[] = {0x12, 0xAA, 'B', 0x34};
+        Assert::AreEqual(4L, spine_feed(link, noise, sizeof(noise), 100));
+        Assert::AreEqual((long) frame_size, spine_feed(link, frame.data(), frame_size, 200));
+
+        spine_frame received;
+        Assert::AreEqual(1, spine_poll(link, &received));
+        Assert::AreEqual((uint16_t) MessageType::dataFrame, received.type);
+        Assert::AreEqual((uint16_t) sizeof(B2HDataFrame), received.size);
+        Assert::AreEqual((uint32_t) 42, received.sequenceNumber);
+        Assert::AreEqual((uint64_t) 200, received.timestamp_ns);
+        Assert::AreEqual((uint32_t) 42, ((const B2HDataFrame*) received.payload)->sequenceNumber);
+        Assert::AreEqual(0, spine_poll(link, &received));
+        spine_release(link, &received);
+
+        spine_stats stats;
+        spine_get_stats(link, &stats);
+        Assert::AreEqual((uint64_t) 1, stats.numFrames);
+        Assert::AreEqual((uint64_t) sizeof(noise), stats.numSkipped);
+        spine_close(link);
+    }
+
+    /// Test Method for borrowed frames:
+    /// The payload stays in place while borrowed, so the buffer fills; once
+    /// released, the space is reclaimed.
+    TEST_METHOD(TestBorrowAndRelease)
+    {
+        auto frame = dataFrame(1);
+        auto frame_size = frame.size();
+        auto link = spine_open_buffer(SPINE_B2H);
+
+        // hold the first frame, and fill the buffer behind it
+        spine_frame held;
+        spine_feed(link, frame.data(), frame_size, 0);
+        Assert::AreEqual(1, spine_poll(link, &held));
+        auto payload = held.payload;
+        long total = (long) frame_size;
+        for (long num; (num = spine_feed(link, frame.data(), frame_size, 0)) > 0; total += num)
+        {
+            spine_frame other;
+            while (spine_poll(link, &other) > 0)
+                spine_release(link, &other);
+        }
+        Assert::AreEqual((long) SPINE_LINK_BUFFER_SIZE, total);
+        Assert::IsTrue(payload == held.payload);
+
+        // releasing the held frame frees the space
+        spine_release(link, &held);
+        Assert::AreEqual((long) frame_size, spine_feed(link, frame.data(), frame_size, 0));
+        spine_close(link);
+    }
+
+    /// Test Method for dispatching frames:
+    /// Each frame ready is passed to the callback, and released.
+    TEST_METHOD(TestDispatch)
+    {
+        auto link = spine_open_buffer(SPINE_B2H);
+        for (uint32_t idx = 0; idx < 3; idx++)
+        {
+            auto frame = dataFrame(idx);
+            spine_feed(link, frame.data(), frame.size(), 0);
+        }
+
+        int num = 0;
+        spine_set_callback(link, count, &num);
+        Assert::AreEqual(3, spine_dispatch(link));
+        Assert::AreEqual(3, num);
+        Assert::AreEqual(0, spine_dispatch(link));
+        spine_close(link);
+    }
+
+    /// Test Method for encoding:
+    /// The type must be sent in that direction, with the right size.
+    TEST_METHOD(TestEncode)
+    {
+        uint8_t frame[64];
+        Ack ack = {1};
+        Assert::AreEqual((size_t) payload_ofs+4+4, spine_encode(SPINE_B2H, (uint16_t) MessageType::ack, &ack, sizeof(ack), frame, sizeof(frame)));
+        Assert::IsTrue(TestFrames::makeFrame(true, MessageType::ack, &ack, sizeof(ack)) == std::vector<uint8_t>(frame, frame+payload_ofs+4+4));
+        Assert::AreEqual((size_t) 0, spine_encode(SPINE_H2B, (uint16_t) MessageType::ack, &ack, sizeof(ack), frame, sizeof(frame)));
+        Assert::AreEqual((size_t) 0, spine_encode(SPINE_B2H, (uint16_t) MessageType::ack, &ack, 2, frame, sizeof(frame)));
+        Assert::AreEqual((size_t) 0, spine_encode(SPINE_B2H, (uint16_t) MessageType::ack, &ack, sizeof(ack), frame, 8));
+    }
+};
@@ -0,0 +1,190 @@
+#include <vector>
+#include <cstdint>
+#include <chrono>
+#include <memory>
+#include <string>
+
+#include "../src/capture.cpp"
+
+#include <CppUnitTest.h>
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+using namespace Spine;
+
+TEST_CLASS(CaptureTests)
+{
+public:
+
+    /// The capture file written by the tests
+    static constexpr const char* path = "capture-tests.cap";
+
+    /// Check an expression against the summary of a block
+    static bool mayMatch(const char* expression, const CaptureIndex& index, bool b2h = true)
+    {
+        Filter filter;
+        Assert::IsTrue(filter.compile(expression, b2h));
+        return filter.mayMatch(index);
+    }
+
+    /** Write a capture of data frames from the body board, with an ack every
+        100 frames, and an I2C fault in the frames from first to last
+        @param numFrames the number of data frames
+        @param first the first frame with the fault
+        @param last the last frame with the fault
+    */
+    static void writeCapture(size_t numFrames, size_t first, size_t last)
+    {
+        std::unique_ptr<CaptureWriter> writer(new CaptureWriter());
+        Assert::IsTrue(writer->open(path));
+        B2HDataFrame frame = {};
+        Ack ack = {1};
+        for (size_t idx = 0; idx < numFrames; idx++)
+        {
+            frame.sequenceNumber = (uint32_t) idx;
+            frame.battery_volt   = (int16_t)(3000 + idx % 500);
+            frame.i2cFault       = idx >= first && idx <= last ? 2 : 0;
+            frame.onCharger      = (idx / 1000) & 1;
+            Assert::IsTrue(writer->write(true, MessageType::dataFrame, (const uint8_t*) &frame, sizeof(frame), idx * 5000000ULL));
+            if (!(idx % 100))
+                Assert::IsTrue(writer->write(true, MessageType::ack, (const uint8_t*) &ack, sizeof(ack), idx * 5000000ULL));
+        }
+        Assert::IsTrue(writer->close());
+    }
+
+    /** Read the frames matching a filter from the capture
+        @param reader the reader
+        @param filter selects the frames
+        @param sequenceNumbers the sequence numbers of the data frames
+        @return the number of frames
+    */
+    static size_t readCapture(CaptureReader& reader, const Filter* filter, std::vector<uint32_t>* sequenceNumbers = nullptr)
+    {
+        Assert::IsTrue(reader.open(path));
+        CaptureFrame frame;
+        size_t num = 0;
+        while (reader.next(frame, filter))
+        {
+            num++;
+            if (sequenceNumbers && frame.type == MessageType::dataFrame)
+                sequenceNumbers->push_back(((const B2HDataFrame*) frame.payload)->sequenceNumber);
+        }
+        return num;
+    }
+
+    /// Test Method for the summary of a block:
+    /// The lowest and highest values, the flags and the message types are
+    /// gathered from the frames.
+    TEST_METHOD(TestIndex)
+    {
+        CaptureIndex index = {};
+        B2HDataFrame frame = {};
+        frame.battery_volt = 3700;
+        frame.sequenceNumber = 0xFFFFFFF0UL;
+        AddToIndex(index, true, MessageType::dataFrame, (const uint8_t*) &frame, sizeof(frame));
+        frame.battery_volt = 3500;
+        frame.sequenceNumber = 0xFFFFFFF1UL;
+        frame.shutdown = 1;
+        AddToIndex(index, true, MessageType::dataFrame, (const uint8_t*) &frame, sizeof(frame));
+        AddToIndex(index, false, MessageType::lights, nullptr, 0);
+
+        auto volt = FindField(b2hDataFrameFields, numB2HDataFrameFields, "battery_volt", 12) - b2hDataFrameFields;
+        auto shutdown = FindField(b2hDataFrameFields, numB2HDataFrameFields, "shutdown", 8) - b2hDataFrameFields;
+        Assert::AreEqual((uint32_t) 3, index.numFrames);
+        Assert::AreEqual((int64_t) 3500, index.min[volt]);
+        Assert::AreEqual((int64_t) 3700, index.max[volt]);
+        Assert::AreEqual((int64_t) 0xFFFFFFF1UL, index.max[0]);
+        Assert::IsTrue(((index.flagsSet >> shutdown) & 1) != 0);
+        Assert::IsTrue(((index.flagsClear >> shutdown) & 1) != 0);
+        Assert::AreEqual(TypeBit(MessageType::dataFrame), index.types[0]);
+        Assert::AreEqual(TypeBit(MessageType::lights), index.types[1]);
+    }
+
+    /// Test Method for checking a filter against the summary:
+    /// A block is only skipped when no frame in it can match.
+    TEST_METHOD(TestMayMatch)
+    {
+        CaptureIndex index = {};
+        B2HDataFrame frame = {};
+        frame.battery_volt = 3700;
+        frame.onCharger = 1;
+        AddToIndex(index, true, MessageType::dataFrame, (const uint8_t*) &frame, sizeof(frame));
+        frame.battery_volt = 3500;
+        AddToIndex(index, true, MessageType::dataFrame, (const uint8_t*) &frame, sizeof(frame));
+
+        Assert::IsFalse(mayMatch("i2cFault != 0", index));
+        Assert::IsFalse(mayMatch("shutdown", index));
+        Assert::IsTrue (mayMatch("!shutdown", index));
+        Assert::IsFalse(mayMatch("onCharger == 0", index));
+        Assert::IsTrue (mayMatch("battery_volt < 3600", index));
+        Assert::IsFalse(mayMatch("battery_volt < 3500", index));
+        Assert::IsFalse(mayMatch("battery_volt - 3000 > 700", index));
+        Assert::IsTrue (mayMatch("battery_volt < 3500 || onCharger", index));
+        Assert::IsFalse(mayMatch("battery_volt < 3500 && cliffSense[2] < 200", index));
+        Assert::IsTrue (mayMatch("cliffSense[2] < 200", index));
+        Assert::IsFalse(mayMatch("type == ack", index));
+        Assert::IsTrue (mayMatch("type != ack", index));
+        Assert::IsFalse(mayMatch("type == dataFrame", index, false));
+        Assert::IsTrue (mayMatch("", index));
+        Assert::IsTrue (mayMatch("", index, false));
+
+        // a term with a field is false for the frames without the fields
+        CaptureIndex acks = {};
+        Ack ack = {1};
+        AddToIndex(acks, true, MessageType::ack, (const uint8_t*) &ack, sizeof(ack));
+        Assert::IsFalse(mayMatch("i2cFault == 0", acks));
+        Assert::IsFalse(mayMatch("!(i2cFault == 0)", acks));
+        Assert::IsTrue (mayMatch("type == ack || i2cFault != 0", acks));
+        Assert::IsFalse(mayMatch("type == ack && i2cFault == 0", acks));
+        AddToIndex(index, true, MessageType::ack, (const uint8_t*) &ack, sizeof(ack));
+        Assert::IsTrue (mayMatch("type == ack || (type == dataFrame && i2cFault != 0)", index));
+        Assert::IsFalse(mayMatch("i2cFault != 0", index));
+    }
+
+    /// Test Method for writing and reading a capture:
+    /// The frames are read back as written, across the blocks.
+    TEST_METHOD(TestRoundTrip)
+    {
+        writeCapture(1000, 500, 509);
+        std::unique_ptr<CaptureReader> reader(new CaptureReader());
+        std::vector<uint32_t> sequenceNumbers;
+        Assert::AreEqual((size_t) 1010, readCapture(*reader, nullptr, &sequenceNumbers));
+        Assert::AreEqual((size_t) 1000, sequenceNumbers.size());
+        for (size_t idx = 0; idx < sequenceNumbers.size(); idx++)
+            Assert::AreEqual((uint32_t) idx, sequenceNumbers[idx]);
+        Assert::IsTrue(reader->numBlocks > 10);
+        Assert::AreEqual((size_t) 0, reader->numSkipped);
+        remove(path);
+    }
+
+    /// Test Method for a search:
+    /// The blocks without the fault are skipped, and the same frames are
+    /// found as when every block is read.  The speed up is logged.
+    TEST_METHOD(TestSearch)
+    {
+        writeCapture(50000, 30000, 30009);
+        std::unique_ptr<CaptureReader> reader(new CaptureReader());
+
+        Filter filter;
+        Assert::IsTrue(filter.compile("i2cFault != 0"));
+        std::vector<uint32_t> found;
+        auto start = std::chrono::steady_clock::now();
+        Assert::AreEqual((size_t) 10, readCapture(*reader, &filter, &found));
+        std::chrono::duration<double> indexed = std::chrono::steady_clock::now() - start;
+        Assert::AreEqual((uint32_t) 30000, found[0]);
+        Assert::IsTrue(reader->numSkipped >= reader->numBlocks - 2);
+
+        // read every block, checking each frame
+        size_t matched = 0;
+        start = std::chrono::steady_clock::now();
+        Assert::IsTrue(reader->open(path));
+        CaptureFrame frame;
+        while (reader->next(frame))
+            matched += filter.match(frame.type, frame.payload, frame.size);
+        std::chrono::duration<double> scanned = std::chrono::steady_clock::now() - start;
+        Assert::AreEqual((size_t) 10, matched);
+
+        Logger::WriteMessage(("search: " + std::to_string(reader->numBlocks) + " blocks, "
+                              + std::to_string(scanned.count() * 1000) + " ms to scan, "
+                              + std::to_string(indexed.count() * 1000) + " ms with the index\n").c_str());
+        remove(path);
+    }
+};
@@ -0,0 +1,105 @@
+#include <vector>
+#include <cstdint>
+
+#include "../src/charge.cpp"
+
+#include <CppUnitTest.h>
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+using namespace Spine;
+
+TEST_CLASS(ChargeTests)
+{
+public:
+
+    /// Feed the analyser a number of frames in the given state
+    static void feed(ChargeAnalyser& analyser, B2HDataFrame& frame, int numFrames)
+    {
+        for (int idx = 0; idx < numFrames; idx++)
+        {
+            analyser.update(frame);
+            frame.sequenceNumber++;
+            frame.battery_volt++;
+        }
+    }
+
+    /// Test Method for a docking session:
+    /// Dock, charge, and undock; the session record has the durations.
+    TEST_METHOD(TestSession)
+    {
+        ChargeAnalyser analyser;
+        B2HDataFrame frame = {};
+        frame.battery_volt = 2800;
+        feed(analyser, frame, 20);
+
+        // dock, start charging a little later
+        frame.onCharger = 1;
+        frame.charger_volt = 3600;
+        feed(analyser, frame, 50);
+        frame.charging = 1;
+        feed(analyser, frame, 1000);
+
+        // undock
+        frame.onCharger = 0;
+        frame.charging = 0;
+        frame.charger_volt = 0;
+        feed(analyser, frame, 20);
+
+        Assert::AreEqual((uint32_t) 1, analyser.stats.numSessions);
+        Assert::AreEqual((uint32_t) 1, analyser.stats.numSuccessful);
+        auto& session = analyser.last;
+        Assert::AreEqual((uint32_t) 20 + defaultChargeConfig.debounceFrames - 1, session.startSequence);
+        Assert::AreEqual((uint32_t) 1050, session.dockedFrames);
+        Assert::AreEqual((uint32_t) 1000, session.chargingFrames);
+        Assert::AreEqual((uint32_t) 50, session.chargeDelayFrames);
+        Assert::AreEqual((int) 1, (int) session.numChargeStarts);
+        Assert::AreEqual((int16_t) 3600, session.maxCharger_volt);
+        Assert::IsFalse(session.truncated);
+
+        // the curve covers the whole session at a coarser stride
+        Assert::IsTrue(session.numCurvePoints <= CHARGE_CURVE_POINTS);
+        Assert::IsTrue(session.curveStride * session.numCurvePoints >= 1000);
+        Assert::AreEqual(session.startBattery_volt, session.curve[0]);
+        Assert::AreEqual((int16_t)(session.curve[0] + session.curveStride), session.curve[1]);
+    }
+
+    /// Test Method for contact bounce:
+    /// A glitch shorter than the debounce does not start a session.
+    TEST_METHOD(TestDebounce)
+    {
+        ChargeAnalyser analyser;
+        B2HDataFrame frame = {};
+        frame.onCharger = 1;
+        feed(analyser, frame, defaultChargeConfig.debounceFrames - 1);
+        frame.onCharger = 0;
+        feed(analyser, frame, 100);
+
+        Assert::IsFalse(analyser.finish());
+        Assert::AreEqual((uint32_t) 0, analyser.stats.numSessions);
+    }
+
+    /// Test Method for scanning a capture:
+    /// Sessions are found in the raw bytes, and a session still in progress
+    /// at the end is closed out as truncated.
+    TEST_METHOD(TestScan)
+    {
+        std::vector<uint8_t> capture = {0x12, 0xAA, 0x34};
+        B2HDataFrame frame = {};
+        frame.onCharger = 1;
+        frame.charging = 1;
+        for (int idx = 0; idx < 40; idx++, frame.sequenceNumber++)
+        {
+            uint8_t header[payload_ofs] = {0xAA, 'B', '2', 'H', 0x66, 0x64, 0x00, 0x03};
+            capture.insert(capture.end(), header, header + sizeof(header));
+            capture.insert(capture.end(), (uint8_t*) &frame, (uint8_t*)(&frame + 1));
+            capture.insert(capture.end(), 4, 0);  // the crc
+        }
+
+        ChargeAnalyser analyser;
+        // leave off the end of the last frame
+        auto examined = analyser.scan(capture.data(), capture.size() - 10);
+        Assert::AreEqual(capture.size() - (payload_ofs + 768 + 4), examined);
+        Assert::IsTrue(analyser.finish());
+        Assert::IsTrue(analyser.last.truncated);
+        Assert::AreEqual((uint32_t) 39 - defaultChargeConfig.debounceFrames + 1, analyser.last.dockedFrames);
+    }
+};
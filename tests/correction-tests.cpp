@@ -0,0 +1,145 @@
+#include <vector>
+#include <cstdint>
+#include <chrono>
+#include <random>
+#include <string>
+
+#include "../src/correction.cpp"
+
+#include <CppUnitTest.h>
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+using namespace Spine;
+
+TEST_CLASS(CorrectionTests)
+{
+public:
+
+    /** Make a random payload
+        @param size the size of the payload
+        @return the payload
+    */
+    static std::vector<uint8_t> payload(size_t size)
+    {
+        std::mt19937 random((uint32_t) size);
+        std::vector<uint8_t> bytes(size);
+        for (auto& byte : bytes)
+            byte = (uint8_t) random();
+        return bytes;
+    }
+
+    /** Flip bits of a payload and its CRC, and try to correct them
+        @param original the payload
+        @param bits the bits to flip; those past the payload are in the CRC
+        @param corrected the payload and CRC after the correction
+        @param crc the CRC after the correction
+        @return true if the frame was corrected
+    */
+    static bool flipAndCorrect(const std::vector<uint8_t>& original, const std::vector<size_t>& bits, std::vector<uint8_t>& corrected, uint32_t& crc)
+    {
+        corrected = original;
+        crc = Crc32(CRC32_INITIAL, original.data(), original.size());
+        for (auto bit : bits)
+        {
+            if (bit < 8*original.size())
+                corrected[bit/8] ^= (uint8_t)(1u << (bit%8));
+            else
+                crc ^= 1u << (bit - 8*original.size());
+        }
+        auto computed = Crc32(CRC32_INITIAL, corrected.data(), corrected.size());
+        return CorrectBitError(corrected.data(), corrected.size(), crc, computed ^ crc);
+    }
+
+    /// Test Method for a bit in error:
+    /// Every bit of a data frame, and its CRC, is corrected.
+    TEST_METHOD(TestEveryBit)
+    {
+        auto original = payload(768);
+        auto expectedCrc = Crc32(CRC32_INITIAL, original.data(), original.size());
+        std::vector<uint8_t> corrected;
+        uint32_t crc;
+        for (size_t bit = 0; bit < 8*original.size() + 32; bit++)
+        {
+            Assert::IsTrue(flipAndCorrect(original, {bit}, corrected, crc));
+            Assert::IsTrue(original == corrected);
+            Assert::AreEqual(expectedCrc, crc);
+        }
+    }
+
+    /// Test Method for the other payload sizes:
+    /// The one table corrects the shorter payloads too.
+    TEST_METHOD(TestSizes)
+    {
+        for (size_t size : {1, 16, 32, 40, 64})
+        {
+            auto original = payload(size);
+            std::vector<uint8_t> corrected;
+            uint32_t crc;
+            for (size_t bit = 0; bit < 8*size; bit++)
+            {
+                Assert::IsTrue(flipAndCorrect(original, {bit}, corrected, crc));
+                Assert::IsTrue(original == corrected);
+            }
+        }
+    }
+
+    /// Test Method for two bits in error:
+    /// They are never mistaken for one, and the payload is left alone.
+    TEST_METHOD(TestTwoBits)
+    {
+        auto original = payload(768);
+        std::mt19937 random(1);
+        std::uniform_int_distribution<size_t> uniform(0, 8*original.size() + 31);
+        std::vector<uint8_t> corrected;
+        uint32_t crc;
+        for (int trial = 0; trial < 20000; trial++)
+        {
+            size_t a = uniform(random), b = uniform(random);
+            if (a == b)
+                continue;
+            Assert::IsFalse(flipAndCorrect(original, {a, b}, corrected, crc));
+        }
+
+        // a good frame has nothing to correct
+        Assert::IsFalse(flipAndCorrect(original, {}, corrected, crc));
+    }
+
+    /// Test Method for the payloads past the table:
+    /// They are not corrected.
+    TEST_METHOD(TestTooLong)
+    {
+        auto original = payload(SPINE_CORRECT_MAX_PAYLOAD + 1);
+        std::vector<uint8_t> corrected;
+        uint32_t crc;
+        Assert::IsFalse(flipAndCorrect(original, {5}, corrected, crc));
+    }
+
+    /// Test Method for the cost:
+    /// Log the time to correct a data frame, not counting the CRC.
+    TEST_METHOD(TestSpeed)
+    {
+        auto original = payload(768);
+        auto crc = Crc32(CRC32_INITIAL, original.data(), original.size());
+        std::vector<uint32_t> syndromes;
+        for (size_t bit = 0; bit < 8*original.size(); bit++)
+        {
+            auto flipped = original;
+            flipped[bit/8] ^= (uint8_t)(1u << (bit%8));
+            syndromes.push_back(Crc32(CRC32_INITIAL, flipped.data(), flipped.size()) ^ crc);
+        }
+
+        // flip each bit back and forth, so the payload ends up as it began
+        auto buffer = original;
+        size_t numCorrected = 0;
+        auto start = std::chrono::steady_clock::now();
+        for (int pass = 0; pass < 20; pass++)
+            for (auto syndrome : syndromes)
+            {
+                uint32_t frameCrc = crc;
+                numCorrected += CorrectBitError(buffer.data(), buffer.size(), frameCrc, syndrome);
+            }
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        Assert::AreEqual(20*syndromes.size(), numCorrected);
+        Assert::IsTrue(original == buffer);
+        Logger::WriteMessage(("correction: " + std::to_string(seconds * 1e9 / numCorrected) + " ns/frame\n").c_str());
+    }
+};
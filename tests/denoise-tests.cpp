@@ -0,0 +1,165 @@
+#include <vector>
+#include <cstdint>
+#include <chrono>
+#include <cmath>
+#include <random>
+#include <string>
+
+#include "../src/denoise.cpp"
+
+#include <CppUnitTest.h>
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+using namespace Spine;
+
+TEST_CLASS(DenoiseTests)
+{
+public:
+
+    /** Make the samples of tone bursts, like words
+        @param count the number of samples
+        @param amplitude the amplitude of the tone, 0 for none
+        @return the samples; the tone is on for 0.25s of each 0.75s
+    */
+    static std::vector<double> bursts(size_t count, double amplitude)
+    {
+        std::vector<double> samples(count);
+        for (size_t idx = 0; idx < count; idx++)
+        {
+            bool on = (idx % 11719) < 3906;
+            samples[idx] = on ? amplitude*sin(2*3.14159265358979*1000*idx / MICROPHONE_SAMPLE_RATE) : 0;
+        }
+        return samples;
+    }
+
+    /** Make the samples of noise
+        @param count the number of samples
+        @param deviation the standard deviation of the noise
+        @return the samples
+    */
+    static std::vector<double> noise(size_t count, double deviation)
+    {
+        std::mt19937 random(1);
+        std::normal_distribution<double> normal(0, deviation);
+        std::vector<double> samples(count);
+        for (auto& value : samples)
+            value = normal(random);
+        return samples;
+    }
+
+    /** Run samples through the noise suppressor, a data frame at a time
+        @param denoise the noise suppressor
+        @param in the samples
+        @return the samples out
+    */
+    static std::vector<int16_t> process(NoiseSuppressor& denoise, const std::vector<double>& in)
+    {
+        std::vector<int16_t> samples(in.size()), out(in.size());
+        for (size_t idx = 0; idx < in.size(); idx++)
+            samples[idx] = (int16_t) lround(in[idx]);
+        for (size_t idx = 0; idx + MICROPHONE_SAMPLES_PER_FRAME <= in.size(); idx += MICROPHONE_SAMPLES_PER_FRAME)
+            denoise.process(samples.data() + idx, out.data() + idx, MICROPHONE_SAMPLES_PER_FRAME);
+        return out;
+    }
+
+    /// Test Method for the inverse FFT:
+    /// It gives back the samples.
+    TEST_METHOD(TestInverseFft)
+    {
+        const size_t N = 64;
+        std::mt19937 random(1);
+        std::uniform_real_distribution<float> uniform(-1, 1);
+        float in[N], spectrum[N+2], out[N];
+        for (auto& value : in)
+            value = uniform(random);
+
+        RealFft<N> fft;
+        fft.forward(in, spectrum);
+        fft.inverse(spectrum, out);
+        for (size_t idx = 0; idx < N; idx++)
+            Assert::IsTrue(fabs(in[idx] - out[idx]) < 1e-5);
+    }
+
+    /// Test Method for the overlap-add:
+    /// With a gain of 1, the output is the input, delayed by the latency.
+    TEST_METHOD(TestReconstruction)
+    {
+        NoiseSuppressorConfig config = defaultNoiseSuppressorConfig;
+        config.minGain = 1;
+        NoiseSuppressor denoise(config);
+        auto in = noise(8000, 3000);
+        auto out = process(denoise, in);
+        for (size_t idx = NoiseSuppressor::latency; idx < out.size(); idx++)
+            Assert::IsTrue(abs(out[idx] - (int) lround(in[idx - NoiseSuppressor::latency])) <= 1);
+        Assert::AreEqual((uint32_t)(8000 / NoiseSuppressor::hop), denoise.numFrames);
+    }
+
+    /// Test Method for steady noise:
+    /// It is turned down, once the noise floor is found.
+    TEST_METHOD(TestNoise)
+    {
+        NoiseSuppressor denoise;
+        auto in = noise(3*MICROPHONE_SAMPLE_RATE, 1000);
+        auto out = process(denoise, in);
+
+        double inPower = 0, outPower = 0;
+        for (size_t idx = MICROPHONE_SAMPLE_RATE; idx < out.size(); idx++)
+        {
+            inPower += in[idx] * in[idx];
+            outPower += (double) out[idx] * out[idx];
+        }
+        double ratio = outPower / inPower;
+        Logger::WriteMessage(("noise: " + std::to_string(10*log10(ratio)) + " dB\n").c_str());
+        Assert::IsTrue(ratio < 0.1);
+    }
+
+    /// Test Method for tone bursts in noise:
+    /// The output is closer to the bursts than the input.
+    TEST_METHOD(TestBursts)
+    {
+        NoiseSuppressor denoise;
+        size_t count = 4*MICROPHONE_SAMPLE_RATE;
+        auto clean = bursts(count, 3000);
+        auto hum = noise(count, 1000);
+        std::vector<double> in(count);
+        for (size_t idx = 0; idx < count; idx++)
+            in[idx] = clean[idx] + hum[idx];
+        auto out = process(denoise, in);
+
+        // the signal to error ratio, after the first second
+        double signal = 0, inError = 0, outError = 0;
+        for (size_t idx = MICROPHONE_SAMPLE_RATE; idx + NoiseSuppressor::latency < count; idx++)
+        {
+            double error = out[idx + NoiseSuppressor::latency] - clean[idx];
+            signal += clean[idx] * clean[idx];
+            inError += hum[idx] * hum[idx];
+            outError += error * error;
+        }
+        double before = 10*log10(signal / inError), after = 10*log10(signal / outError);
+        Logger::WriteMessage(("bursts: " + std::to_string(before) + " dB to " + std::to_string(after) + " dB SNR\n").c_str());
+        Assert::IsTrue(after > before + 3);
+    }
+
+    /// Test Method for the cost:
+    /// Log the time per data frame, against the time between data frames,
+    /// and the latency.
+    TEST_METHOD(TestSpeed)
+    {
+        NoiseSuppressor denoise;
+        auto in = noise(10*MICROPHONE_SAMPLE_RATE, 1000);
+        std::vector<int16_t> samples(in.size());
+        for (size_t idx = 0; idx < in.size(); idx++)
+            samples[idx] = (int16_t) lround(in[idx]);
+
+        size_t numDataFrames = 0;
+        auto start = std::chrono::steady_clock::now();
+        for (size_t idx = 0; idx + MICROPHONE_SAMPLES_PER_FRAME <= samples.size(); idx += MICROPHONE_SAMPLES_PER_FRAME)
+        {
+            denoise.process(samples.data() + idx, samples.data() + idx, MICROPHONE_SAMPLES_PER_FRAME);
+            numDataFrames++;
+        }
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        Logger::WriteMessage(("denoise: " + std::to_string(seconds * 1e6 / numDataFrames) + " us/data frame, of "
+                              + std::to_string(1e6 * MICROPHONE_SAMPLES_PER_FRAME / MICROPHONE_SAMPLE_RATE) + " us; latency "
+                              + std::to_string(1e3 * NoiseSuppressor::latency / MICROPHONE_SAMPLE_RATE) + " ms\n").c_str());
+    }
+};
@@ -0,0 +1,273 @@
+#include <vector>
+#include <cstdint>
+#include <string>
+#include <algorithm>
+
+#include "../src/earlyaudio.cpp"
+#include "testFrames.h"
+
+#include <CppUnitTest.h>
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+using namespace Spine;
+
+/// A consumer that records what it was given
+struct Recorder
+{
+    /// A block of samples
+    struct Block
+    {
+        uint32_t frame;
+        size_t first, count;
+        bool speculative;
+        std::vector<int16_t> samples;
+
+        /// The number of bytes fed when the block was passed on
+        size_t fed;
+    };
+
+    std::vector<Block> blocks;
+
+    /// The frames committed (true) and rolled back (false)
+    std::vector<std::pair<uint32_t, bool>> verdicts;
+
+    /// The number of bytes fed so far
+    size_t* fed;
+
+    static void onSamples(void* context, uint32_t frame, size_t first, const int16_t* samples, size_t count, bool speculative)
+    {
+        auto self = (Recorder*) context;
+        self->blocks.push_back({frame, first, count, speculative, std::vector<int16_t>(samples, samples + count*MICROPHONE_COUNT), *self->fed});
+    }
+
+    static void onVerdict(void* context, uint32_t frame, bool good)
+    {
+        ((Recorder*) context)->verdicts.push_back({frame, good});
+    }
+
+    AudioConsumer consumer(bool speculative)
+    {
+        return {onSamples, onVerdict, this, speculative};
+    }
+};
+
+
+TEST_CLASS(EarlyAudioTests)
+{
+public:
+
+    /** Append a data frame from the body board
+        @param stream the bytes
+        @param mark the value of the first sample; each sample after is one more
+        @param badCrc true to spoil the CRC
+    */
+    static void appendDataFrame(std::vector<uint8_t>& stream, int16_t mark, bool badCrc = false)
+    {
+        B2HDataFrame data;
+        memset(&data, 0, sizeof(data));
+        for (size_t idx = 0; idx < MICROPHONE_SAMPLES_PER_FRAME*MICROPHONE_COUNT; idx++)
+            data.mic_samples[idx] = (int16_t)(mark + idx);
+        TestFrames::appendFrame(stream, true, MessageType::dataFrame, &data, sizeof(data), badCrc);
+    }
+
+    /// Test Method for the speculative blocks:
+    /// They are passed on as they arrive, before the CRC, then committed;
+    /// the other consumer gets the samples once the CRC has passed.
+    TEST_METHOD(TestSpeculative)
+    {
+        std::vector<uint8_t> stream;
+        appendDataFrame(stream, 100);
+
+        size_t fed = 0;
+        Recorder early, late;
+        early.fed = late.fed = &fed;
+        EarlyAudioReceiver audio;
+        Assert::IsTrue(audio.subscribe(early.consumer(true)));
+        Assert::IsTrue(audio.subscribe(late.consumer(false)));
+        for (; fed < stream.size(); fed++)
+            audio.receive(stream.data() + fed, 1, 0);
+
+        const size_t numBlocks = MICROPHONE_SAMPLES_PER_FRAME / EARLY_AUDIO_BLOCK_SAMPLES;
+        Assert::AreEqual(numBlocks, early.blocks.size());
+        for (size_t idx = 0; idx < numBlocks; idx++)
+        {
+            auto& block = early.blocks[idx];
+            Assert::IsTrue(block.speculative);
+            Assert::AreEqual(idx * EARLY_AUDIO_BLOCK_SAMPLES, block.first);
+            Assert::AreEqual((int16_t)(100 + block.first*MICROPHONE_COUNT), block.samples[0]);
+            // passed on as soon as its last byte was in
+            Assert::AreEqual(payload_ofs + offsetof(B2HDataFrame, mic_samples) + (block.first + block.count)*MICROPHONE_COUNT*2 - 1, block.fed);
+        }
+        Assert::AreEqual((size_t) 1, early.verdicts.size());
+        Assert::IsTrue(early.verdicts[0].second);
+
+        Assert::AreEqual((size_t) 1, late.blocks.size());
+        Assert::IsFalse(late.blocks[0].speculative);
+        Assert::AreEqual((size_t) MICROPHONE_SAMPLES_PER_FRAME, late.blocks[0].count);
+        Assert::AreEqual(stream.size() - 1, late.blocks[0].fed);
+        Assert::IsTrue(late.verdicts.empty());
+        Assert::AreEqual(1u, audio.numCommitted);
+    }
+
+    /// Test Method for a bad CRC:
+    /// The speculative samples are rolled back; the other consumer never
+    /// sees them.
+    TEST_METHOD(TestRollback)
+    {
+        std::vector<uint8_t> stream;
+        appendDataFrame(stream, 0, true);
+        appendDataFrame(stream, 1000);
+
+        size_t fed = 0;
+        Recorder early, late;
+        early.fed = late.fed = &fed;
+        EarlyAudioReceiver audio;
+        audio.subscribe(early.consumer(true));
+        audio.subscribe(late.consumer(false));
+        audio.receive(stream.data(), stream.size(), 0);
+
+        Assert::AreEqual((size_t) 2, early.verdicts.size());
+        Assert::IsTrue(std::make_pair(0u, false) == early.verdicts[0]);
+        Assert::IsTrue(std::make_pair(1u, true) == early.verdicts[1]);
+        Assert::AreEqual((size_t) 1, late.blocks.size());
+        Assert::AreEqual(1u, late.blocks[0].frame);
+        Assert::AreEqual((int16_t) 1000, late.blocks[0].samples[0]);
+        Assert::AreEqual(1u, audio.numRolledBack);
+        Assert::AreEqual(1u, audio.numCommitted);
+    }
+
+    /// Test Method for a truncated frame:
+    /// It is rolled back once it has had the time to arrive, and the next
+    /// frame is received.
+    TEST_METHOD(TestExpire)
+    {
+        std::vector<uint8_t> stream;
+        appendDataFrame(stream, 0);
+        size_t fed = 0;
+        Recorder early;
+        early.fed = &fed;
+        EarlyAudioReceiver audio;
+        audio.subscribe(early.consumer(true));
+
+        audio.receive(stream.data(), stream.size() / 2, 1000);
+        Assert::IsFalse(audio.expire(1000 + 2000));
+        Assert::IsTrue(audio.expire(1000 + 5000));
+        Assert::AreEqual((size_t) 1, early.verdicts.size());
+        Assert::IsFalse(early.verdicts[0].second);
+
+        audio.receive(stream.data(), stream.size(), 10000);
+        Assert::AreEqual((size_t) 2, early.verdicts.size());
+        Assert::IsTrue(early.verdicts[1].second);
+        Assert::IsFalse(audio.expire(20000));
+    }
+
+    /// Test Method for a frame whose CRC the caller checks:
+    /// It is fed without its CRC, and committed or rolled back as settled;
+    /// the next frame is then received from its sync.
+    TEST_METHOD(TestSettle)
+    {
+        std::vector<uint8_t> stream;
+        appendDataFrame(stream, 0);
+        size_t fed = 0;
+        Recorder early, late;
+        early.fed = late.fed = &fed;
+        EarlyAudioReceiver audio;
+        audio.subscribe(early.consumer(true));
+        audio.subscribe(late.consumer(false));
+
+        audio.receive(stream.data(), stream.size() - 4, 0);
+        audio.settle(false);
+        Assert::AreEqual((size_t) 1, early.verdicts.size());
+        Assert::IsFalse(early.verdicts[0].second);
+        Assert::AreEqual((size_t) 0, late.blocks.size());
+
+        audio.receive(stream.data(), stream.size() - 4, 0);
+        audio.settle(true);
+        Assert::AreEqual((size_t) 2, early.verdicts.size());
+        Assert::IsTrue(early.verdicts[1].second);
+        Assert::AreEqual((size_t) 1, late.blocks.size());
+        Assert::AreEqual(1u, late.blocks[0].frame);
+
+        // nothing to settle between the frames
+        audio.settle(true);
+        Assert::AreEqual(1u, audio.numRolledBack);
+        Assert::AreEqual(1u, audio.numCommitted);
+    }
+
+    /// Test Method for the other frames and filler:
+    /// Only the samples of the data frames are passed on.
+    TEST_METHOD(TestOtherFrames)
+    {
+        std::vector<uint8_t> stream = {0xAA, 0xAA, 'B', '2', 0x55};
+        // an ack (the payload is skipped, sync bytes and all)
+        const uint8_t ack[] = {0xAA, 'B', '2', 'H', 0x61, 0x6B, 4, 0, 0xAA, 'B', '2', 'H', 0, 0, 0, 0};
+        stream.insert(stream.end(), ack, ack + sizeof(ack));
+        appendDataFrame(stream, 7);
+        // a bad size
+        const uint8_t bad[] = {0xAA, 'B', '2', 'H', 0x66, 0x64, 4, 0};
+        stream.insert(stream.end(), bad, bad + sizeof(bad));
+        appendDataFrame(stream, 9);
+
+        size_t fed = 0;
+        Recorder late;
+        late.fed = &fed;
+        EarlyAudioReceiver audio;
+        audio.subscribe(late.consumer(false));
+        audio.receive(stream.data(), stream.size(), 0);
+        Assert::AreEqual((size_t) 2, late.blocks.size());
+        Assert::AreEqual((int16_t) 7, late.blocks[0].samples[0]);
+        Assert::AreEqual((int16_t) 9, late.blocks[1].samples[0]);
+    }
+
+    /// Test Method for the latency:
+    /// The frames arrive at SPINE_BAUD_RATE, handed over 32 bytes at a time
+    /// (as the UART FIFO would).  Log the time from the last byte of each
+    /// sample arriving to the sample being passed on, for each consumer.
+    TEST_METHOD(TestLatency)
+    {
+        std::vector<uint8_t> stream;
+        const size_t numFrames = 200, chunk = 32;
+        for (size_t idx = 0; idx < numFrames; idx++)
+            appendDataFrame(stream, (int16_t) idx);
+        const double byte_us = 10 * 1e6 / SPINE_BAUD_RATE;
+
+        size_t fed = 0;
+        Recorder early, late;
+        early.fed = late.fed = &fed;
+        EarlyAudioReceiver audio;
+        audio.subscribe(early.consumer(true));
+        audio.subscribe(late.consumer(false));
+        for (; fed < stream.size(); )
+        {
+            auto num = std::min(chunk, stream.size() - fed);
+            fed += num;
+            audio.receive(stream.data() + fed - num, num, (uint32_t)(fed * byte_us));
+        }
+
+        auto frameSize = stream.size() / numFrames;
+        for (auto recorder : {&early, &late})
+        {
+            double total = 0, most = 0;
+            size_t numSamples = 0;
+            for (auto& block : recorder->blocks)
+            {
+                auto delivered = block.fed * byte_us;
+                for (size_t idx = block.first; idx < block.first + block.count; idx++)
+                {
+                    // the last byte of the sample
+                    auto last = block.frame*frameSize + payload_ofs + offsetof(B2HDataFrame, mic_samples) + (idx+1)*MICROPHONE_COUNT*2;
+                    auto latency = delivered - last * byte_us;
+                    total += latency;
+                    most = std::max(most, latency);
+                    numSamples++;
+                }
+            }
+            Assert::AreEqual(numFrames * MICROPHONE_SAMPLES_PER_FRAME, numSamples);
+            Logger::WriteMessage(((recorder == &early ? "early audio speculative: " : "early audio committed:   ")
+                                  + std::to_string(total / numSamples) + " us mean, " + std::to_string(most) + " us most\n").c_str());
+            if (recorder == &early)
+                Assert::IsTrue(most < (chunk + EARLY_AUDIO_BLOCK_SAMPLES*MICROPHONE_COUNT*2) * byte_us);
+            else
+                Assert::IsTrue(total / numSamples > 1000);
+        }
+    }
+};
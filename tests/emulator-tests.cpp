@@ -0,0 +1,193 @@
+#include <vector>
+#include <cstdint>
+#include <string>
+#include <chrono>
+
+#include "../src/emulator.cpp"
+#include "../src/tof.h"
+#include "testFrames.h"
+
+#include <CppUnitTest.h>
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+using namespace Spine;
+
+TEST_CLASS(EmulatorTests)
+{
+public:
+
+    /** Decode the frame the emulator built, as the head board would
+        @param body the emulator
+        @return the data frame
+    */
+    static B2HDataFrame decode(const BodyEmulator& body)
+    {
+        MessageType message_type;
+        size_t payload_size;
+        auto ptr = B2H::FindMessage(body.frame.data(), body.frame.size(), message_type, payload_size);
+        Assert::IsTrue(MessageType::dataFrame == message_type);
+        Assert::AreEqual(sizeof(B2HDataFrame), payload_size);
+        B2HDataFrame data;
+        memcpy(&data, ptr + payload_ofs, sizeof(data));
+        return data;
+    }
+
+    /** Build the frame of a motor command, as the head board would
+        @param sequenceNumber the sequence number
+        @param power the duty cycle of each motor
+        @return the frame
+    */
+    static std::vector<uint8_t> commandFrame(uint32_t sequenceNumber, const int16_t (&power)[MOTOR_COUNT])
+    {
+        H2BDataFrame data;
+        memset(&data, 0, sizeof(data));
+        data.sequenceNumber = sequenceNumber;
+        memcpy(data.motorPower, power, sizeof(power));
+        return TestFrames::makeFrame(false, MessageType::dataFrame, &data, sizeof(data));
+    }
+
+    /// Test Method for the cadence:
+    /// A frame each period, numbered in order, that the head board accepts.
+    TEST_METHOD(TestCadence)
+    {
+        BodyEmulator body;
+        for (uint32_t idx = 0; idx < 195; idx++)
+        {
+            body.step();
+            auto data = decode(body);
+            Assert::AreEqual(idx, data.sequenceNumber);
+            Assert::AreEqual((uint8_t) 1, (uint8_t) data.sensorsOn);
+            Assert::AreEqual(defaultBodyConfig.cliffFloor, data.cliffSense[0]);
+        }
+        // about a second
+        Assert::IsTrue(body.now_us > 990000 && body.now_us < 1010000);
+    }
+
+    /// Test Method for the motor dynamics:
+    /// The speed approaches that of the duty, the stops hold the lift and head,
+    /// and the dead band doesn't move the motor.
+    TEST_METHOD(TestMotors)
+    {
+        BodyEmulator body;
+        H2BDataFrame command;
+        memset(&command, 0, sizeof(command));
+        command.motorPower[(int) Motor::backRight] = 32767;
+        command.motorPower[(int) Motor::backLeft ] = 2000;
+        body.command(command);
+
+        // after 10 time constants, at full speed
+        for (int idx = 0; idx < 60; idx++)
+            body.step();
+        auto data = decode(body);
+        auto expected = defaultBodyConfig.motor[(int) Motor::backRight].maxSpeed * B2H_FRAME_PERIOD_US * 1e-6f;
+        Assert::IsTrue(abs(data.motor[(int) Motor::backRight].delta - expected) <= 1);
+        Assert::AreEqual((uint8_t) 1, (uint8_t) data.headEncoderChanged);
+        Assert::AreEqual(0, data.motor[(int) Motor::backLeft].position);
+        Assert::AreEqual((uint8_t) 0, (uint8_t) data.liftEncoderChanged);
+
+        // held at the stop; the time since the last change grows
+        for (int idx = 0; idx < 200; idx++)
+            body.step();
+        data = decode(body);
+        Assert::AreEqual(defaultBodyConfig.motor[(int) Motor::backRight].maxPosition, data.motor[(int) Motor::backRight].position);
+        Assert::AreEqual(0, data.motor[(int) Motor::backRight].delta);
+        Assert::AreEqual((uint8_t) 0, (uint8_t) data.headEncoderChanged);
+        Assert::IsTrue(data.motor[(int) Motor::backRight].time > 100000);
+    }
+
+    /// Test Method for a closed loop:
+    /// The head is driven to an angle by commands, through the framing, from
+    /// the encoder feedback.
+    TEST_METHOD(TestClosedLoop)
+    {
+        BodyEmulator body;
+        const int32_t target = 400;
+        int32_t position = 0;
+        for (uint32_t idx = 0; idx < 200; idx++)
+        {
+            // enough gain that the dead band is within a few ticks
+            int32_t power = (target - position) * 1000;
+            power = power > 32767 ? 32767 : power < -32767 ? -32767 : power;
+            auto bytes = commandFrame(idx, {0, 0, 0, (int16_t) power});
+            // in pieces, as a serial port would deliver them
+            Assert::AreEqual((size_t) 0, body.receive(bytes.data(), 10));
+            Assert::AreEqual((size_t) 1, body.receive(bytes.data() + 10, bytes.size() - 10));
+            body.step();
+            position = decode(body).motor[(int) Motor::backRight].position;
+        }
+        Assert::AreEqual(200u, body.numCommands);
+        Assert::IsTrue(abs(position - target) <= 5);
+    }
+
+    /// Test Method for the world:
+    /// The time of flight ranges the box ahead; driving into it stalls the
+    /// wheels; driving off the table drops the front cliff sensors first.
+    TEST_METHOD(TestWorld)
+    {
+        BodyEmulator body;
+        body.step();
+        auto data = decode(body);
+        Assert::AreEqual((uint8_t) 0, data.prox_status);
+        Assert::AreEqual((uint16_t) 120, data.prox_range_mm);
+        auto reading = TofReconstruction::reconstruct(data, defaultTofConfig);
+        Assert::IsTrue(reading.valid);
+        Assert::IsTrue(reading.reflectivity > 230 && reading.reflectivity < 280);
+
+        // drive into the box; the stall detector sees it
+        StallDetector stall;
+        H2BDataFrame command;
+        memset(&command, 0, sizeof(command));
+        command.motorPower[0] = command.motorPower[1] = 20000;
+        for (int idx = 0; idx < 400; idx++)
+        {
+            body.command(command);
+            stall.command(command, (uint32_t) body.now_us);
+            body.step();
+            stall.feedback(decode(body), (uint32_t) body.now_us);
+        }
+        Assert::IsTrue(body.blocked);
+        Assert::IsTrue(body.pose.x_mm < 450 - defaultBodyConfig.radius_mm + 1);
+        Assert::IsTrue(MotorFault::stalled == stall.fault(Motor::frontLeft));
+        Assert::IsTrue(decode(body).prox_range_mm < 10);
+
+        // turn away from the box, and drive off the edge
+        body.place({100, 200, 3.14159265f});
+        memset(&command, 0, sizeof(command));
+        command.motorPower[0] = command.motorPower[1] = 20000;
+        body.command(command);
+        for (int idx = 0; idx < 400 && decode(body).cliffSense[0] != defaultBodyConfig.cliffDrop; idx++)
+            body.step();
+        data = decode(body);
+        Assert::AreEqual(defaultBodyConfig.cliffDrop , data.cliffSense[0]);
+        Assert::AreEqual(defaultBodyConfig.cliffDrop , data.cliffSense[1]);
+        Assert::AreEqual(defaultBodyConfig.cliffFloor, data.cliffSense[2]);
+        Assert::IsTrue(body.pose.x_mm > 25 && body.pose.x_mm < 35);
+        Assert::AreEqual((uint8_t) 2, data.prox_status);
+    }
+
+    /// Test Method for the speed:
+    /// Log how much faster than real time a closed loop runs, through the
+    /// framing in both directions.
+    TEST_METHOD(TestFasterThanRealTime)
+    {
+        BodyEmulator body;
+        const uint32_t numFrames = 195 * 60;
+        auto start = std::chrono::steady_clock::now();
+        int32_t position = 0;
+        for (uint32_t idx = 0; idx < numFrames; idx++)
+        {
+            int32_t target = idx / 195 % 2 ? 600 : -200;
+            int32_t power = (target - position) * 200;
+            power = power > 32767 ? 32767 : power < -32767 ? -32767 : power;
+            auto bytes = commandFrame(idx, {8000, -8000, 0, (int16_t) power});
+            body.receive(bytes.data(), bytes.size());
+            body.step();
+            position = decode(body).motor[(int) Motor::backRight].position;
+        }
+        std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+        double simulated = body.now_us * 1e-6;
+        Logger::WriteMessage(("emulator: " + std::to_string(simulated) + " s simulated in " + std::to_string(elapsed.count())
+                              + " s, " + std::to_string(simulated / elapsed.count()) + "x real time, "
+                              + std::to_string(numFrames / elapsed.count()) + " frames/s\n").c_str());
+        Assert::IsTrue(simulated > elapsed.count());
+    }
+};
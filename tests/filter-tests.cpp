@@ -0,0 +1,149 @@
+#include <vector>
+#include <cstdint>
+#include <chrono>
+#include <string>
+
+#include "../src/filter.cpp"
+
+#include <CppUnitTest.h>
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+using namespace Spine;
+
+TEST_CLASS(FilterTests)
+{
+public:
+
+    /// Check a data frame from the body board against an expression
+    static bool matches(const char* expression, const B2HDataFrame& frame)
+    {
+        Filter filter;
+        Assert::IsTrue(filter.compile(expression));
+        return filter.match(MessageType::dataFrame, (const uint8_t*) &frame, sizeof(frame));
+    }
+
+    /// Test Method for the fields:
+    /// Array elements, flag bits and members of the motor states are compared
+    /// as they are in the frame.
+    TEST_METHOD(TestFields)
+    {
+        B2HDataFrame frame = {};
+        frame.cliffSense[1] = 250;
+        frame.cliffSense[2] = 150;
+        frame.onCharger = 0;
+        frame.motor[3].delta = -5;
+        frame.sequenceNumber = 0x80000001UL;
+
+        Assert::IsTrue (matches("cliffSense[2] < 200 && onCharger == 0", frame));
+        Assert::IsFalse(matches("cliffSense[1] < 200 && onCharger == 0", frame));
+        frame.onCharger = 1;
+        Assert::IsFalse(matches("cliffSense[2] < 200 && onCharger == 0", frame));
+        Assert::IsTrue (matches("cliffSense[2] < 200 || onCharger == 0", frame));
+        Assert::IsTrue (matches("motor.delta[3] == -5", frame));
+        Assert::IsTrue (matches("motor.delta[3] + 5 == 0 && !(motor.delta[3] > 0)", frame));
+        Assert::IsTrue (matches("sequenceNumber > 0x80000000", frame));
+        Assert::IsTrue (matches("(sequenceNumber & 1) != 0", frame));
+        Assert::IsTrue (matches("type == dataFrame", frame));
+    }
+
+    /// Test Method for the message type:
+    /// The fields are only in the data frames, so a term using a field is
+    /// false for the other messages, but the other terms still select them.
+    TEST_METHOD(TestMessageType)
+    {
+        Ack ack = {1};
+        Filter filter;
+        Assert::IsTrue(filter.compile("type == ack"));
+        Assert::IsTrue(filter.match(MessageType::ack, (const uint8_t*) &ack, sizeof(ack)));
+        Assert::IsFalse(filter.match(MessageType::version, (const uint8_t*) &ack, sizeof(ack)));
+
+        Assert::IsTrue(filter.compile("type == ack || cliffSense[0] == 0"));
+        Assert::IsTrue(filter.match(MessageType::ack, (const uint8_t*) &ack, sizeof(ack)));
+        Assert::IsTrue(filter.compile("cliffSense[0] == 0"));
+        Assert::IsFalse(filter.match(MessageType::ack, (const uint8_t*) &ack, sizeof(ack)));
+        Assert::IsTrue(filter.compile("!(cliffSense[0] == 0)"));
+        Assert::IsFalse(filter.match(MessageType::ack, (const uint8_t*) &ack, sizeof(ack)));
+        Assert::IsTrue(filter.compile("type == ack && cliffSense[0] == 0"));
+        Assert::IsFalse(filter.match(MessageType::ack, (const uint8_t*) &ack, sizeof(ack)));
+
+        B2HDataFrame data = {};
+        Assert::IsTrue(filter.compile("type == ack || (type == dataFrame && i2cFault != 0)"));
+        Assert::IsTrue(filter.match(MessageType::ack, (const uint8_t*) &ack, sizeof(ack)));
+        Assert::IsFalse(filter.match(MessageType::dataFrame, (const uint8_t*) &data, sizeof(data)));
+        data.i2cFault = 1;
+        Assert::IsTrue(filter.match(MessageType::dataFrame, (const uint8_t*) &data, sizeof(data)));
+        Assert::IsFalse(filter.match(MessageType::dataFrame, (const uint8_t*) &data, offsetof(B2HDataFrame, i2cFault)));
+
+        // an empty expression selects every frame
+        Assert::IsTrue(filter.compile(" "));
+        Assert::IsFalse(filter.active());
+        Assert::IsTrue(filter.match(MessageType::version, nullptr, 0));
+
+        // the fields of the head board's frames
+        H2BDataFrame frame = {};
+        frame.motorPower[1] = -100;
+        Assert::IsTrue(filter.compile("motorPower[1] < 0", false));
+        Assert::IsTrue(filter.match(MessageType::dataFrame, (const uint8_t*) &frame, sizeof(frame)));
+        Assert::IsFalse(filter.compile("cliffSense[0] < 0", false));
+    }
+
+    /// Test Method for the constant folding:
+    /// The parts of the expression that don't depend on the frame are
+    /// reduced to a constant when compiled.
+    TEST_METHOD(TestFolding)
+    {
+        Filter filter;
+        Assert::IsTrue(filter.compile("cliffSense[2] < 100 + 100"));
+        // field, constant, lt
+        Assert::AreEqual((size_t) 3, filter.size());
+
+        Assert::IsTrue(filter.compile("cliffSense[2] < (100 + 0x64) && -(1 - 2) == 1"));
+        // field, constant, lt, constant, land
+        Assert::AreEqual((size_t) 5, filter.size());
+
+        Assert::IsTrue(filter.compile("dataFrame == 0x6466"));
+        Assert::AreEqual((size_t) 1, filter.size());
+        Assert::IsTrue(filter.match(MessageType::ack, nullptr, 0));
+    }
+
+    /// Test Method for the errors:
+    /// The error is reported, with where it is in the expression.
+    TEST_METHOD(TestErrors)
+    {
+        Filter filter;
+        Assert::IsFalse(filter.compile("cliffSense[4] < 200"));
+        Assert::AreEqual("the index is past the end of the field", filter.error);
+
+        Assert::IsFalse(filter.compile("cliffSense[2] < 200 && onCharge == 0"));
+        Assert::AreEqual("unknown field", filter.error);
+        Assert::AreEqual((size_t) 23, filter.errorPos);
+        Assert::IsFalse(filter.active());
+
+        Assert::IsFalse(filter.compile("(onCharger == 0"));
+        Assert::AreEqual("expected )", filter.error);
+
+        Assert::IsFalse(filter.compile("onCharger 0"));
+        Assert::AreEqual("expected an operator", filter.error);
+    }
+
+    /// Test Method for the throughput:
+    /// The time to check a data frame, in frames per second.
+    TEST_METHOD(TestThroughput)
+    {
+        B2HDataFrame frame = {};
+        frame.cliffSense[2] = 150;
+        Filter filter;
+        Assert::IsTrue(filter.compile("cliffSense[2] < 200 && onCharger == 0 && (motor.delta[0] != 0 || i2cFault == 0)"));
+
+        const size_t numFrames = 1000000;
+        size_t matched = 0;
+        auto start = std::chrono::steady_clock::now();
+        for (size_t idx = 0; idx < numFrames; idx++)
+        {
+            frame.sequenceNumber = (uint32_t) idx;
+            matched += filter.match(MessageType::dataFrame, (const uint8_t*) &frame, sizeof(frame));
+        }
+        std::chrono::duration<double> seconds = std::chrono::steady_clock::now() - start;
+        Assert::AreEqual(numFrames, matched);
+        Logger::WriteMessage(("filter: " + std::to_string((long) (numFrames / seconds.count())) + " frames/s\n").c_str());
+    }
+};
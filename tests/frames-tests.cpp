@@ -0,0 +1,109 @@
+#include <vector>
+#include <cstdint>
+
+#define Stream MockStream
+#include "mockStream.h"
+
+#include "../src/spine.h"
+#include "../src/frames.h"
+
+// defined in spine.cpp (built with spine-tests.cpp), not declared in spine.h
+namespace Spine { namespace H2B { size_t populateHeader(uint8_t* buffer, MessageType message_type); } }
+
+#include <CppUnitTest.h>
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+using namespace Spine;
+
+TEST_CLASS(FramesTests)
+{
+public:
+
+    /// The CRC, computed a bit at a time
+    static uint32_t bitwiseCrc32(uint32_t crc, const uint8_t* data, size_t size)
+    {
+        crc = ~crc;
+        for (size_t idx = 0; idx < size; idx++)
+        {
+            crc ^= data[idx];
+            for (int bit = 0; bit < 8; bit++)
+                crc = (crc >> 1) ^ ((crc & 1) ? 0xEDB88320UL : 0);
+        }
+        return ~crc;
+    }
+
+    /// Test Method for the CRC:
+    /// The table driven CRC matches the bit at a time CRC.
+    TEST_METHOD(TestCrc32)
+    {
+        uint8_t data[768];
+        for (size_t idx = 0; idx < sizeof(data); idx++)
+            data[idx] = (uint8_t)(idx * 37 + 11);
+
+        Assert::AreEqual(bitwiseCrc32(CRC32_INITIAL, data, sizeof(data)), Crc32(CRC32_INITIAL, data, sizeof(data)));
+        Assert::AreEqual(bitwiseCrc32(0, data, 13), Crc32(0, data, 13));
+    }
+
+    /// Test Method for the sliced CRC:
+    /// The CRC taken 8 bytes at a time matches the byte-wise CRC, for every
+    /// alignment and length of tail.
+    TEST_METHOD(TestCrc32Sliced)
+    {
+        uint8_t data[768];
+        for (size_t idx = 0; idx < sizeof(data); idx++)
+            data[idx] = (uint8_t)(idx * 37 + 11);
+
+        for (size_t start = 0; start < 8; start++)
+            for (size_t size = 0; size < 24; size++)
+                Assert::AreEqual(Crc32(CRC32_INITIAL, data + start, size), Crc32Sliced(CRC32_INITIAL, data + start, size));
+        Assert::AreEqual(Crc32(CRC32_INITIAL, data, sizeof(data)), Crc32Sliced(CRC32_INITIAL, data, sizeof(data)));
+        Assert::AreEqual(Crc32(0, data + 1, 700), Crc32Sliced(0, data + 1, 700));
+    }
+
+    /// Test Method for the constant frames:
+    /// The header of each constant frame matches the one populated at run time.
+    TEST_METHOD(TestConstantFramesMatchPopulateHeader)
+    {
+        const std::pair<MessageType, const uint8_t*> frames[] = {
+            {MessageType::shutdown, H2B::shutdownFrame.data()},
+            {MessageType::mode    , H2B::modeFrame.data()},
+            {MessageType::version , H2B::versionFrame.data()},
+            {MessageType::validate, H2B::validateFrame.data()},
+            {MessageType::erase   , H2B::eraseFrame.data()},
+        };
+        for (auto& frame : frames)
+        {
+            uint8_t buffer[payload_ofs];
+            Assert::AreEqual((size_t) 0, H2B::populateHeader(buffer, frame.first));
+            for (int idx = 0; idx < payload_ofs; idx++)
+                Assert::AreEqual(buffer[idx], frame.second[idx]);
+        }
+    }
+
+    /// Test Method for a constant payload:
+    /// The payload is copied into the frame, and followed by its CRC.
+    TEST_METHOD(TestConstantPayload)
+    {
+        static constexpr uint8_t lightsOff[16] = {1, 2, 3};
+        constexpr auto frame = H2B::ConstantFrame<MessageType::lights>(lightsOff);
+        static_assert(frame.size() == payload_ofs + 16 + 4, "The lights frame is the wrong size");
+
+        Assert::AreEqual((uint8_t) 3, frame[payload_ofs + 2]);
+        auto crc = frame.data() + payload_ofs + 16;
+        uint32_t crcInFrame = crc[0] | crc[1] << 8 | crc[2] << 16 | (uint32_t) crc[3] << 24;
+        Assert::AreEqual(Crc32(CRC32_INITIAL, lightsOff, 16), crcInFrame);
+    }
+
+    /// Test Method for sending a constant frame:
+    /// The whole frame is written at once.
+    TEST_METHOD(TestSendFrame)
+    {
+        MockStream mockStream;
+        SendFrame(mockStream, H2B::versionFrame);
+
+        uint8_t sent[sizeof(H2B::versionFrame)];
+        mockStream.readBytes(sent, sizeof(sent));
+        for (size_t idx = 0; idx < sizeof(sent); idx++)
+            Assert::AreEqual(H2B::versionFrame[idx], sent[idx]);
+        Assert::AreEqual(-1, mockStream.read());
+    }
+};
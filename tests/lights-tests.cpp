@@ -0,0 +1,140 @@
+#include <vector>
+#include <cstdint>
+#include <string>
+
+#include "../src/lights.cpp"
+
+#include <CppUnitTest.h>
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+using namespace Spine;
+
+TEST_CLASS(LightsTests)
+{
+public:
+
+    /** Check that the frame has the header, and the CRC of its payload
+        @param animator the animator
+    */
+    static void checkFrame(const LightsAnimator& animator)
+    {
+        const uint8_t header[payload_ofs] = {0xAA, 'H', '2', 'B', 0x6C, 0x73, 16, 0};
+        for (size_t idx = 0; idx < payload_ofs; idx++)
+            Assert::AreEqual(header[idx], animator.frame[idx]);
+
+        auto payload = animator.frame.data() + payload_ofs;
+        auto crc = payload + sizeof(Lights);
+        uint32_t crcInFrame = crc[0] | crc[1] << 8 | crc[2] << 16 | (uint32_t) crc[3] << 24;
+        Assert::AreEqual(Crc32(CRC32_INITIAL, payload, sizeof(Lights)), crcInFrame);
+    }
+
+    /** Tick an animation, as an app would, and count the frames sent
+        @param animation the animation
+        @param tick_ms the time between ticks
+        @param duration_ms how long to run
+        @return the number of frames sent
+    */
+    static uint32_t run(const LightAnimation& animation, uint32_t tick_ms, uint32_t duration_ms)
+    {
+        LightsAnimator animator;
+        animator.start(animation, 0);
+        for (uint32_t now = 0; now < duration_ms; now += tick_ms)
+            animator.tick(now);
+        return animator.numFrames;
+    }
+
+    /// Test Method for a solid color:
+    /// The frame is sent once, then only to refresh it.
+    TEST_METHOD(TestSolid)
+    {
+        LightsAnimator animator;
+        animator.start({LightPattern::solid, {10, 20, 30}, {}, 1000}, 100);
+        Assert::IsTrue(animator.tick(100));
+        checkFrame(animator);
+        for (size_t led = 0; led < LightsAnimator::numLEDs; led++)
+        {
+            Assert::AreEqual((uint8_t) 10, animator.frame[payload_ofs + 4*led]);
+            Assert::AreEqual((uint8_t) 20, animator.frame[payload_ofs + 4*led + 1]);
+            Assert::AreEqual((uint8_t) 30, animator.frame[payload_ofs + 4*led + 2]);
+            Assert::AreEqual((uint8_t) 0, animator.frame[payload_ofs + 4*led + 3]);
+        }
+
+        Assert::IsFalse(animator.tick(105));
+        Assert::IsFalse(animator.tick(100 + LIGHTS_REFRESH_MS - 1));
+        Assert::IsTrue(animator.tick(100 + LIGHTS_REFRESH_MS));
+        Assert::AreEqual(2u, animator.numFrames);
+    }
+
+    /// Test Method for the CRC:
+    /// The CRC updated from the changes matches the CRC of the payload.
+    TEST_METHOD(TestIncrementalCrc)
+    {
+        LightsAnimator animator;
+        const LightAnimation animations[] =
+        {
+            {LightPattern::pulse  , {255, 0, 128}, {}, 700},
+            {LightPattern::spinner, {0, 255, 0}, {}, 300},
+            {LightPattern::fade   , {255, 255, 255}, {0, 0, 64}, 400},
+            {LightPattern::off    , {}, {}, 100},
+        };
+        uint32_t now = 0;
+        for (auto& animation : animations)
+        {
+            animator.start(animation, now);
+            for (int tick = 0; tick < 200; tick++, now += 7)
+                if (animator.tick(now))
+                    checkFrame(animator);
+        }
+    }
+
+    /// Test Method for the pulse and spinner:
+    /// They go through the keyframes, and back to the start, each period.
+    TEST_METHOD(TestKeyframes)
+    {
+        LightsAnimator animator;
+        Lights lights;
+        animator.start({LightPattern::pulse, {200, 100, 0}, {}, 1000}, 0);
+        animator.render(0, lights);
+        Assert::AreEqual((uint8_t) 0, lights.ledColors[0]);
+        animator.render(500, lights);
+        Assert::AreEqual((uint8_t) 200, lights.ledColors[0]);
+        Assert::AreEqual((uint8_t) 100, lights.ledColors[1]);
+        animator.render(1000, lights);
+        Assert::AreEqual((uint8_t) 0, lights.ledColors[0]);
+
+        // the head of the spinner is on the second LED a quarter of the way
+        animator.start({LightPattern::spinner, {0, 0, 255}, {}, 1000}, 0);
+        animator.render(250, lights);
+        Assert::AreEqual((uint8_t) 255, lights.ledColors[4 + 2]);
+        Assert::IsTrue(lights.ledColors[2] > 0 && lights.ledColors[2] < 255);
+        Assert::AreEqual((uint8_t) 0, lights.ledColors[8 + 2]);
+
+        // the fade holds the second color when it is done
+        animator.start({LightPattern::fade, {255, 0, 0}, {0, 255, 0}, 1000}, 0);
+        animator.render(5000, lights);
+        Assert::AreEqual((uint8_t) 0, lights.ledColors[0]);
+        Assert::AreEqual((uint8_t) 255, lights.ledColors[1]);
+    }
+
+    /// Test Method for the frames saved:
+    /// Log the frames/s sent for typical animations, against a lights
+    /// message each data frame tick (5ms).
+    TEST_METHOD(TestFramesSaved)
+    {
+        const uint32_t tick_ms = 5, duration_ms = 10000;
+        const struct { const char* name; LightAnimation animation; } animations[] =
+        {
+            {"solid"  , {LightPattern::solid  , {0, 0, 255}, {}, 1000}},
+            {"fade"   , {LightPattern::fade   , {0, 0, 0}, {255, 128, 0}, 500}},
+            {"pulse"  , {LightPattern::pulse  , {0, 0, 255}, {}, 2000}},
+            {"spinner", {LightPattern::spinner, {0, 255, 0}, {}, 1000}},
+        };
+        for (auto& test : animations)
+        {
+            auto frames = run(test.animation, tick_ms, duration_ms);
+            double sent = frames * 1000.0 / duration_ms, ticks = 1000.0 / tick_ms;
+            Logger::WriteMessage(("lights " + std::string(test.name) + ": " + std::to_string(sent) + " frames/s of "
+                                  + std::to_string(ticks) + ", " + std::to_string(ticks - sent) + " frames/s saved\n").c_str());
+            Assert::IsTrue(sent <= LIGHTS_KEYFRAMES * 1000.0 / test.animation.period_ms + 1000.0 / LIGHTS_REFRESH_MS);
+        }
+    }
+};
@@ -35,6 +35,19 @@ public:
         Assert::IsFalse(process(frame)); // Expecting false as no modification
     }
 
+    TEST_METHOD(TestProcessH2BDataFrame)
+    {
+        H2BDataFrame frame = {};
+        frame.motorPower[0] = 16000;
+        Assert::IsFalse(process(frame)); // Expecting false as no modification
+    }
+
+    TEST_METHOD(TestProcessHead2BodyDataFrame)
+    {
+        MessageType msgType = MessageType::dataFrame;
+        Assert::IsFalse(processHead2Body(msgType)); // Expecting false as no modification
+    }
+
     TEST_METHOD(TestProcessBody2HeadAck)
     {
         MessageType msgType = MessageType::ack;
@@ -0,0 +1,204 @@
+#include <vector>
+#include <deque>
+#include <cstdint>
+#include <string>
+
+#include "../src/mailbox.cpp"
+#include "testFrames.h"
+
+#include <CppUnitTest.h>
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+using namespace Spine;
+
+/// A link to the body board that takes a limited number of bytes
+struct SlowLink
+{
+    /// The room in the transmit buffer
+    size_t room = 1 << 20;
+
+    /// The frames written
+    std::vector<std::vector<uint8_t>> sent;
+
+    int availableForWrite() { return (int) room; }
+
+    void write(const uint8_t* data, size_t size)
+    {
+        Assert::IsTrue(size <= room);
+        room -= size;
+        sent.emplace_back(data, data + size);
+    }
+};
+
+/// A link to the body board with only the FIFO for a transmit buffer; a
+/// write larger than the room blocks while the FIFO drains
+struct SmallFifo
+{
+    /// The size of the FIFO, and the room in it
+    size_t size = 128, room = 128;
+
+    /// The frames written
+    std::vector<std::vector<uint8_t>> sent;
+
+    int availableForWrite() { return (int) room; }
+
+    void write(const uint8_t* data, size_t count)
+    {
+        // a frame is only written past the room if the FIFO was empty
+        Assert::IsTrue(count <= room || room == size);
+        room = count < room ? room - count : 0;
+        sent.emplace_back(data, data + count);
+    }
+
+    /// The FIFO has been sent
+    void drain() { room = size; }
+};
+
+TEST_CLASS(MailboxTests)
+{
+public:
+
+    /** Make a frame from the head board
+        @param message_type the type of the message
+        @param mark the first byte of the payload, to tell the frames apart
+        @return the frame
+    */
+    static std::vector<uint8_t> frame(MessageType message_type, uint8_t mark = 0)
+    {
+        std::vector<uint8_t> payload((size_t) H2B::size(message_type));
+        if (!payload.empty())
+            payload[0] = mark;
+        return TestFrames::makeFrame(false, message_type, payload.data(), payload.size());
+    }
+
+    /// Put a frame in the mailbox
+    static bool put(H2BMailbox& mailbox, const std::vector<uint8_t>& bytes, uint32_t now_us)
+    {
+        return mailbox.put(bytes.data(), bytes.size(), now_us);
+    }
+
+    /// Test Method for the data frames and lights:
+    /// The newest replaces the one waiting.
+    TEST_METHOD(TestLatestWins)
+    {
+        H2BMailbox mailbox;
+        SlowLink link;
+        put(mailbox, frame(MessageType::dataFrame, 1), 0);
+        put(mailbox, frame(MessageType::lights, 2), 10);
+        put(mailbox, frame(MessageType::dataFrame, 3), 20);
+        put(mailbox, frame(MessageType::lights, 4), 30);
+        Assert::AreEqual(2u, mailbox.numReplaced);
+
+        Assert::AreEqual((size_t) 2, mailbox.send(link, 100));
+        Assert::AreEqual((size_t) 2, link.sent.size());
+        Assert::IsTrue(frame(MessageType::dataFrame, 3) == link.sent[0]);
+        Assert::IsTrue(frame(MessageType::lights, 4) == link.sent[1]);
+        Assert::AreEqual(80u, mailbox.maxAge_us);
+        Assert::AreEqual((size_t) 0, mailbox.send(link, 200));
+    }
+
+    /// Test Method for the frames that must be delivered:
+    /// They are each sent, in order, ahead of the slots.
+    TEST_METHOD(TestQueue)
+    {
+        H2BMailbox mailbox;
+        SlowLink link;
+        put(mailbox, frame(MessageType::dataFrame, 1), 0);
+        put(mailbox, frame(MessageType::mode), 1);
+        put(mailbox, frame(MessageType::version), 2);
+        put(mailbox, frame(MessageType::mode), 3);
+        put(mailbox, frame(MessageType::shutdown), 4);
+        Assert::IsFalse(put(mailbox, frame(MessageType::version), 5));
+        Assert::AreEqual(1u, mailbox.numDropped);
+
+        mailbox.send(link, 10);
+        Assert::AreEqual((size_t) 5, link.sent.size());
+        Assert::IsTrue(frame(MessageType::mode)     == link.sent[0]);
+        Assert::IsTrue(frame(MessageType::version)  == link.sent[1]);
+        Assert::IsTrue(frame(MessageType::mode)     == link.sent[2]);
+        Assert::IsTrue(frame(MessageType::shutdown) == link.sent[3]);
+        Assert::IsTrue(frame(MessageType::dataFrame, 1) == link.sent[4]);
+        Assert::AreEqual(5u, mailbox.numSent);
+    }
+
+    /// Test Method for a full link:
+    /// Nothing is written until there is room for the whole frame.
+    TEST_METHOD(TestNoRoom)
+    {
+        H2BMailbox mailbox;
+        SlowLink link;
+        auto bytes = frame(MessageType::dataFrame);
+        put(mailbox, bytes, 0);
+        link.room = bytes.size() - 1;
+        Assert::AreEqual((size_t) 0, mailbox.send(link, 10));
+        link.room = bytes.size();
+        Assert::AreEqual((size_t) 1, mailbox.send(link, 20));
+    }
+
+    /// Test Method for a frame larger than the transmit buffer:
+    /// It is written once the buffer has emptied, and doesn't hold up the
+    /// frames after it.
+    TEST_METHOD(TestLargerThanBuffer)
+    {
+        H2BMailbox mailbox;
+        SmallFifo link;
+        auto update = frame(MessageType::updateFirmware, 1);
+        Assert::IsTrue(update.size() > link.size);
+        put(mailbox, update, 0);
+        put(mailbox, frame(MessageType::dataFrame, 2), 0);
+
+        // the size of the buffer isn't known until the stream has been seen
+        Assert::AreEqual((size_t) 0, mailbox.send(link, 10));
+        Assert::AreEqual((size_t) 1, mailbox.send(link, 20));
+        Assert::IsTrue(update == link.sent[0]);
+
+        // the data frame waits for room, then goes
+        Assert::AreEqual((size_t) 0, mailbox.send(link, 30));
+        link.drain();
+        Assert::AreEqual((size_t) 1, mailbox.send(link, 40));
+        Assert::IsTrue(frame(MessageType::dataFrame, 2) == link.sent[1]);
+        Assert::AreEqual(2u, mailbox.numSent);
+    }
+
+    /// Test Method for congestion:
+    /// The head board sends a data frame every 2ms, and the link takes one
+    /// every 5ms.  Log the staleness of the commands sent, against a queue.
+    TEST_METHOD(TestStaleness)
+    {
+        H2BMailbox mailbox;
+        SlowLink link;
+        auto bytes = frame(MessageType::dataFrame);
+
+        // a queue, for comparison
+        std::deque<uint32_t> fifo;
+        uint64_t fifoTotal = 0;
+        uint32_t fifoMax = 0, fifoSent = 0;
+
+        for (uint32_t now = 0; now < 2000000; now += 1000)
+        {
+            if (!(now % 2000))
+            {
+                put(mailbox, bytes, now);
+                fifo.push_back(now);
+            }
+            if (!(now % 5000))
+            {
+                link.room = bytes.size();
+                mailbox.send(link, now);
+                if (!fifo.empty())
+                {
+                    auto age = now - fifo.front();
+                    fifo.pop_front();
+                    fifoTotal += age;
+                    fifoMax = age > fifoMax ? age : fifoMax;
+                    fifoSent++;
+                }
+            }
+        }
+        Logger::WriteMessage(("staleness: mailbox mean " + std::to_string(mailbox.totalAge_us / mailbox.numSent)
+                              + " us, max " + std::to_string(mailbox.maxAge_us)
+                              + " us; queue mean " + std::to_string(fifoTotal / fifoSent)
+                              + " us, max " + std::to_string(fifoMax) + " us\n").c_str());
+        Assert::IsTrue(mailbox.maxAge_us <= 2000);
+        Assert::IsTrue(fifoMax > 500000);
+    }
+};
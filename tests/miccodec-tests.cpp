@@ -0,0 +1,151 @@
+#include <vector>
+#include <cstdint>
+#include <chrono>
+#include <cmath>
+#include <random>
+#include <string>
+
+#include "../src/miccodec.cpp"
+
+#include <CppUnitTest.h>
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+using namespace Spine;
+
+TEST_CLASS(MicCodecTests)
+{
+public:
+
+    /** Make the data frames of a sound heard by the 4 microphones: a tone
+        and noise, arriving at each microphone a sample later than the one
+        before
+        @param numFrames the number of frames
+        @param seed the seed of the noise
+        @return the frames
+    */
+    static std::vector<B2HDataFrame> sound(size_t numFrames, unsigned seed)
+    {
+        std::mt19937 random(seed);
+        std::normal_distribution<double> noise(0, 30);
+        std::vector<B2HDataFrame> frames(numFrames);
+        for (size_t frame = 0; frame < numFrames; frame++)
+        {
+            frames[frame] = {};
+            frames[frame].sequenceNumber = (uint32_t) frame;
+            for (size_t idx = 0; idx < MICROPHONE_SAMPLES_PER_FRAME; idx++)
+                for (size_t mic = 0; mic < MICROPHONE_COUNT; mic++)
+                {
+                    double t = (double)(frame*MICROPHONE_SAMPLES_PER_FRAME + idx - mic) / MICROPHONE_SAMPLE_RATE;
+                    frames[frame].mic_samples[idx*MICROPHONE_COUNT + mic] = (int16_t) (4000*sin(2*3.14159265358979*440*t) + noise(random));
+                }
+        }
+        return frames;
+    }
+
+    /// Code and decode each frame, checking the samples come back the same
+    static void roundTrip(const std::vector<B2HDataFrame>& frames, MicEncoder& encoder)
+    {
+        MicDecoder decoder;
+        uint8_t block[micBlockMaxSize];
+        for (auto& frame : frames)
+        {
+            auto size = encoder.encode(frame, block, sizeof(block));
+            Assert::IsTrue(size > 0);
+
+            uint32_t sequenceNumber;
+            int16_t samples[micBlockSamples];
+            Assert::AreEqual(size, decoder.decode(block, size, sequenceNumber, samples));
+            Assert::AreEqual(frame.sequenceNumber, sequenceNumber);
+            Assert::AreEqual(0, memcmp(samples, frame.mic_samples, sizeof(samples)));
+        }
+    }
+
+    /// Test Method for a sound:
+    /// The samples are decoded exactly, and take much less space.
+    TEST_METHOD(TestSound)
+    {
+        MicEncoder encoder;
+        roundTrip(sound(200, 1), encoder);
+        double ratio = (double) encoder.numCodedBytes / encoder.numSampleBytes;
+        Logger::WriteMessage(("sound: ratio " + std::to_string(ratio) + "\n").c_str());
+        Assert::IsTrue(ratio < 0.7);
+    }
+
+    /// Test Method for the extremes:
+    /// Silence, full scale noise, and full scale steps are decoded exactly.
+    TEST_METHOD(TestExtremes)
+    {
+        std::mt19937 random(2);
+        std::vector<B2HDataFrame> frames(3);
+        for (auto& frame : frames)
+            frame = {};
+        for (size_t idx = 0; idx < micBlockSamples; idx++)
+        {
+            frames[1].mic_samples[idx] = (int16_t) random();
+            frames[2].mic_samples[idx] = (idx / MICROPHONE_COUNT) & 1 ? 32767 : -32768;
+        }
+        MicEncoder encoder;
+        roundTrip(frames, encoder);
+
+        // silence takes a bit per sample
+        uint8_t block[micBlockMaxSize];
+        Assert::AreEqual(4 + MICROPHONE_COUNT + micBlockSamples/8, encoder.encode(frames[0], block, sizeof(block)));
+
+        // too small a buffer
+        Assert::AreEqual((size_t) 0, encoder.encode(frames[1], block, 100));
+    }
+
+    /// Test Method for the missing frames:
+    /// The gaps in the sequence numbers are counted, and a truncated block
+    /// is rejected.
+    TEST_METHOD(TestGaps)
+    {
+        auto frames = sound(10, 3);
+        MicEncoder encoder;
+        MicDecoder decoder;
+        uint8_t block[micBlockMaxSize];
+        uint32_t sequenceNumber;
+        int16_t samples[micBlockSamples];
+        for (size_t idx : {0, 1, 2, 5, 6, 9})
+        {
+            auto size = encoder.encode(frames[idx], block, sizeof(block));
+            Assert::AreEqual(size, decoder.decode(block, size, sequenceNumber, samples));
+        }
+        Assert::AreEqual((size_t) 2, decoder.numGaps);
+        Assert::AreEqual((size_t) 4, decoder.numMissing);
+
+        auto size = encoder.encode(frames[0], block, sizeof(block));
+        Assert::AreEqual((size_t) 0, decoder.decode(block, size/2, sequenceNumber, samples));
+    }
+
+    /// Test Method for the speed:
+    /// The coding and decoding speeds (in MB/s of samples) are logged.
+    TEST_METHOD(TestSpeed)
+    {
+        auto frames = sound(2000, 4);
+        std::vector<uint8_t> blocks(frames.size() * micBlockMaxSize);
+        std::vector<size_t> sizes;
+        MicEncoder encoder;
+        size_t offset = 0;
+        auto start = std::chrono::steady_clock::now();
+        for (auto& frame : frames)
+        {
+            sizes.push_back(encoder.encode(frame, blocks.data()+offset, micBlockMaxSize));
+            offset += sizes.back();
+        }
+        std::chrono::duration<double> encoding = std::chrono::steady_clock::now() - start;
+
+        MicDecoder decoder;
+        offset = 0;
+        uint32_t sequenceNumber;
+        int16_t samples[micBlockSamples];
+        start = std::chrono::steady_clock::now();
+        for (auto size : sizes)
+            offset += decoder.decode(blocks.data()+offset, size, sequenceNumber, samples);
+        std::chrono::duration<double> decoding = std::chrono::steady_clock::now() - start;
+        Assert::AreEqual((size_t) encoder.numCodedBytes, offset);
+
+        double megabytes = encoder.numSampleBytes / 1e6;
+        Logger::WriteMessage(("codec: " + std::to_string(megabytes / encoding.count()) + " MB/s coding, "
+                              + std::to_string(megabytes / decoding.count()) + " MB/s decoding\n").c_str());
+    }
+};
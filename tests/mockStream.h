@@ -2,7 +2,7 @@
 class MockStream
 {
 public:
-    MockStream() : readIndex(0) {}
+    MockStream() : timeout(1000), readIndex(0) {}
 
     void write(uint8_t data){}
 
@@ -12,6 +12,18 @@ public:
         buffer.insert(buffer.end(), data, data + size);
     }
 
+    // The number of bytes that can be written without blocking
+    int availableForWrite()
+    {
+        return 1 << 20;
+    }
+
+    // The number of bytes that can be read
+    int available()
+    {
+        return (int)(buffer.size() - readIndex);
+    }
+
     // Simulate reading from the stream
     int read()
     {
@@ -22,13 +34,21 @@ public:
         return -1; // Indicate end of stream
     }
 
-    // Simulate reading multiple bytes
-    void readBytes(uint8_t* outBuffer, size_t size)
+    // Simulate reading multiple bytes, returning the number read
+    size_t readBytes(uint8_t* outBuffer, size_t size)
     {
-        for (size_t i = 0; i < size && readIndex < buffer.size(); ++i)
+        size_t i = 0;
+        for (; i < size && readIndex < buffer.size(); ++i)
         {
             outBuffer[i] = buffer[readIndex++];
         }
+        return i;
+    }
+
+    // Set the time (in milliseconds) to wait for bytes
+    void setTimeout(unsigned long ms)
+    {
+        timeout = ms;
     }
 
     // Set the buffer for testing
@@ -45,6 +65,9 @@ public:
         readIndex = 0;
     }
 
+    // The last timeout set
+    unsigned long timeout;
+
 private:
     std::vector<uint8_t> buffer;
     size_t readIndex;
@@ -0,0 +1,129 @@
+#include <vector>
+#include <cstdint>
+
+#define Stream MockStream
+#include "mockStream.h"
+
+#include <esp32/rom/crc.h>
+#include "../src/crc.h"
+#include "../src/spine.h"
+#include "../src/bringup.h"
+#include "../src/capi.h"
+#include "../src/earlyaudio.h"
+#include "oracle.h"
+
+#include <CppUnitTest.h>
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+using namespace Spine;
+
+TEST_CLASS(OracleTests)
+{
+public:
+
+    /** Run each decoder over the stream, and check that it agrees with the reference
+        @param stream the bytes received
+        @param b2h true for the frames from the body board, false for the head board
+        @return the result of ReceiveMessage itself, with its divergences
+    */
+    static Oracle::Result check(const std::vector<uint8_t>& stream, bool b2h)
+    {
+        Oracle::Result results[] =
+        {
+            Oracle::run("reference", Oracle::reference  , true , stream, b2h),
+            Oracle::run("bringup"  , Oracle::bringup    , true , stream, b2h),
+            Oracle::run("find"     , Oracle::findMessage, false, stream, b2h),
+            Oracle::run("capi"     , Oracle::capi       , false, stream, b2h),
+            Oracle::run("early"    , Oracle::earlyAudio , false, stream, b2h, (int) MessageType::dataFrame),
+        };
+        for (auto& result : results)
+        {
+            // the link bring-up and the early audio only receive from the
+            // body board
+            if (!b2h && (!strcmp(result.name, "bringup") || !strcmp(result.name, "early")))
+                continue;
+            Logger::WriteMessage(Oracle::describe(result, stream.size()).c_str());
+            Assert::AreEqual((size_t) 0, result.numMismatches);
+        }
+        Assert::IsTrue(results[0].numFrames > 0);
+        return results[0];
+    }
+
+    /// Test Method for the frames from the body board:
+    /// Each decoder finds the same frames, and rejects the same bad ones, as
+    /// the reference.
+    TEST_METHOD(TestRandomB2H)
+    {
+        // the false starts were there to be lost
+        Assert::IsTrue(check(Oracle::randomStream(2000, true, 1), true).numDivergences > 0);
+    }
+
+    /// Test Method for the frames from the head board:
+    /// Each decoder finds the same frames as the reference.
+    TEST_METHOD(TestRandomH2B)
+    {
+        Assert::IsTrue(check(Oracle::randomStream(1000, false, 2), false).numDivergences > 0);
+    }
+
+    /// Test Method for the false starts:
+    /// A frame just after the start of a sync, or the other direction's
+    /// sync, is found by the decoders; ReceiveMessage loses those whose sync
+    /// byte broke the false start, and this is recorded as a divergence.
+    TEST_METHOD(TestFalseStarts)
+    {
+        std::mt19937 random(5);
+        std::vector<uint8_t> stream;
+        const char* starts[] = {"\xAA", "\xAA" "B", "\xAA" "B2", "\xAA" "H2B", "\xAA" "B2B"};
+        for (auto start : starts)
+        {
+            stream.insert(stream.end(), start, start + strlen(start));
+            Oracle::appendFrame(stream, "B2H", MessageType::ack, sizeof(Ack), random);
+        }
+        Oracle::Output expected = {};
+        Oracle::resynchronised(stream, true, expected);
+        Assert::AreEqual((size_t) 5, expected.events.size());
+        Assert::AreEqual((uint64_t) 1+2+3+4+4, expected.numSkipped);
+
+        // the first three are lost, and their bytes skipped
+        auto reference = check(stream, true);
+        Assert::AreEqual((size_t) 2, reference.numFrames);
+        Assert::AreEqual((size_t) 3+1, reference.numDivergences);
+    }
+
+    /// Test Method for a capture of the body board booting:
+    /// The reset preamble and banner, the answer to the version request, and
+    /// the data frames.
+    TEST_METHOD(TestBootCapture)
+    {
+        std::mt19937 random(3);
+        uint8_t preamble[] = {0xFF, 0x16, 0x92, 0x16, 0x1F, 0x16, 0xCF, 0x16, 0xFF, 0x16, 0xFF, 0x16, 0xFF, 0x16, 0xFF, 0x16};
+        std::vector<uint8_t> stream(preamble, preamble+sizeof(preamble));
+        for (auto ch : "\nbooted\n")
+            stream.push_back((uint8_t) ch);
+        Oracle::appendFrame(stream, "B2H", MessageType::version, B2H::size(MessageType::version), random);
+        for (int idx = 0; idx < 100; idx++)
+            Oracle::appendFrame(stream, "B2H", MessageType::dataFrame, sizeof(B2HDataFrame), random);
+        check(stream, true);
+    }
+
+    /// Test Method for the rejection reasons:
+    /// A bad CRC, and a type that doesn't match the size, are each reported.
+    TEST_METHOD(TestRejectionReasons)
+    {
+        std::mt19937 random(4);
+        std::vector<uint8_t> stream;
+        Oracle::appendFrame(stream, "B2H", MessageType::ack, sizeof(Ack), random);
+        Oracle::appendFrame(stream, "B2H", MessageType::ack, sizeof(Ack), random, FrameError::crc);
+        Oracle::appendFrame(stream, "B2H", MessageType::ack, sizeof(Ack), random, FrameError::typeSize);
+        Oracle::appendFrame(stream, "B2H", MessageType::ack, sizeof(Ack), random);
+
+        Oracle::Output output = {};
+        Oracle::reference(stream, true, output);
+        auto& events = output.events;
+        Assert::AreEqual((size_t) 4, events.size());
+        Assert::AreEqual((int) MessageType::ack, events[0].type);
+        Assert::AreEqual((int) FrameError::crc, (int) events[1].error);
+        Assert::AreEqual((int) FrameError::typeSize, (int) events[2].error);
+        Assert::AreEqual((int) MessageType::ack, events[3].type);
+        check(stream, true);
+    }
+};
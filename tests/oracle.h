@@ -0,0 +1,605 @@
+/* Differential harness: the frame decoders against the reference
+   Copyright 2024 Randall Maas
+*//**@file
+    @brief Differential harness: the frame decoders against the reference.
+
+    There are several ways to decode the frames: ReceiveMessage (the
+    reference), the rolling sync match of LinkBringup, FindMessage over a
+    buffer, the C interface, and the early audio receiver (which only passes
+    on the data frames).  Each is run over the same byte stream, and
+    what it emits is compared with the reference:
+
+    - the frames accepted: their type, where they start in the stream, and
+      the bytes that would be forwarded (the header, payload and CRC)
+    - the frames rejected, why, and where (for the decoders that report it)
+    - the bytes skipped: looking for the sync (for the decoders that report
+      the rejected frames), or that weren't part of a good frame (for those
+      that don't, as the bytes of the rejected frames are skipped too)
+
+    The filler and payloads have sync bytes and partial sync headers in
+    them, so the decoders must resynchronise after a false start.  The
+    decoders are compared with the reference restarted on the byte after
+    each false start, as the rolling sync match and FindMessage do.
+    ReceiveMessage itself takes the byte that broke the false start, so it
+    loses a frame whose sync byte that was; the frames it loses (and any
+    difference in the bytes skipped) are recorded as divergences rather than
+    mismatches.  The C interface holds the tail of the stream that might be
+    the start of a frame, waiting for more bytes; that is recorded as a
+    divergence too.
+
+    The time each decoder takes is reported with the mismatches, so that a
+    faster decoder is only faster if it also agrees.
+
+    The decoders under test must be included before this file.
+*/
+#pragma once
+#include <vector>
+#include <string>
+#include <chrono>
+#include <random>
+#include <stdio.h>
+#include "testFrames.h"
+
+namespace Oracle {
+
+using namespace Spine;
+
+/// The offset of a frame whose start the decoder doesn't report
+constexpr size_t unknown = (size_t) -1;
+
+/// A frame accepted, or rejected, by a decoder
+struct Event
+{
+    /// The message type, -1 if the frame was rejected
+    int type;
+
+    /// Why the frame was rejected
+    FrameError error;
+
+    /// The bytes of the frame that would be forwarded
+    std::vector<uint8_t> bytes;
+
+    /// The offset of the start of the frame in the stream, or unknown
+    size_t offset;
+
+    bool operator==(const Event& other) const
+    {
+        return type == other.type && error == other.error && bytes == other.bytes
+            && (offset == unknown || other.offset == unknown || offset == other.offset);
+    }
+};
+
+/// A false start: the bytes taken by a search for the sync that failed
+struct Span
+{
+    size_t start, end;
+};
+
+/// What a decoder emits over a stream
+struct Output
+{
+    /// The frames accepted and rejected
+    std::vector<Event> events;
+
+    /// The bytes skipped, as the decoder counts them
+    uint64_t numSkipped;
+
+    /// The false starts that took more than one byte (ReceiveMessage only)
+    std::vector<Span> falseStarts;
+};
+
+/** A decoder under test
+    @param stream the bytes received
+    @param b2h true for the frames from the body board, false for the head board
+    @param output the frames accepted and rejected, and the bytes skipped
+*/
+typedef void (*Decoder)(const std::vector<uint8_t>& stream, bool b2h, Output& output);
+
+/// The result of one decoder over a stream
+struct Result
+{
+    /// The name of the decoder
+    const char* name;
+
+    /// The number of frames accepted
+    size_t numFrames;
+
+    /// The number of frames rejected
+    size_t numRejected;
+
+    /// The number of bytes skipped
+    uint64_t numSkipped;
+
+    /// The number of events, or counts, that don't match the reference
+    size_t numMismatches;
+
+    /// A description of the first mismatch
+    std::string firstMismatch;
+
+    /// The number of known differences from the reference
+    size_t numDivergences;
+
+    /// A description of the first divergence
+    std::string firstDivergence;
+
+    /// The time taken (in seconds)
+    double seconds;
+};
+
+
+/** Record a frame accepted, or rejected, by one of the stream decoders
+    @param events the events
+    @param message_type the type returned by the decoder
+    @param recv_buffer the buffer the frame was received into
+    @param payload_size the size of the payload
+    @param error why the frame was rejected
+    @param position the offset in the stream after the frame
+*/
+inline void record(std::vector<Event>& events, MessageType message_type, const uint8_t* recv_buffer, size_t payload_size, FrameError error, size_t position)
+{
+    // the frame took up the header and, unless the type was wrong, the
+    // payload and CRC
+    // assumes alignment, little endian host
+    size_t length = *(const uint16_t*)(recv_buffer+payload_size_ofs);
+    size_t taken = error == FrameError::typeSize ? (size_t) payload_ofs : payload_ofs + length + 4;
+    size_t offset = error == FrameError::truncated ? unknown : position - taken;
+    if ((int) message_type != -1)
+        events.push_back({(int) message_type, FrameError::none, std::vector<uint8_t>(recv_buffer, recv_buffer+payload_ofs+payload_size+4), offset});
+    // running out of bytes, or missing the sync, isn't a frame
+    else if (error != FrameError::sync)
+        events.push_back({-1, error, {}, offset});
+}
+
+
+/** ReceiveMessage, from an offset in the stream
+    @param b2h true for the frames from the body board, false for the head board
+    @param in the stream to receive from
+    @param position the offset in the stream of the next byte of in; moved
+           past the bytes taken
+    @param output the frames accepted and rejected
+    @return true if the sync was found, false if not
+*/
+inline bool receive(bool b2h, MockStream& in, size_t& position, Output& output)
+{
+    size_t payload_size, before = (size_t) in.available();
+    auto message_type = b2h ? B2H::ReceiveMessage(in, payload_size) : H2B::ReceiveMessage(in, payload_size);
+    auto error = b2h ? B2H::recv_error : H2B::recv_error;
+    position += before - (size_t) in.available();
+    record(output.events, message_type, b2h ? B2H::recv_buffer : H2B::recv_buffer, payload_size, error, position);
+    return error != FrameError::sync;
+}
+
+
+/// The reference: ReceiveMessage
+inline void reference(const std::vector<uint8_t>& stream, bool b2h, Output& output)
+{
+    MockStream in;
+    in.setBuffer(stream);
+    size_t position = 0;
+    while (in.available())
+    {
+        auto start = position;
+        if (receive(b2h, in, position, output))
+            continue;
+        output.numSkipped += position - start;
+        if (position - start > 1)
+            output.falseStarts.push_back({start, position});
+    }
+}
+
+
+/** The reference restarted on the byte after each false start, as the
+    decoders are expected to behave
+    @param stream the bytes received
+    @param b2h true for the frames from the body board, false for the head board
+    @param output the frames accepted and rejected, and the bytes skipped
+           looking for the sync
+*/
+inline void resynchronised(const std::vector<uint8_t>& stream, bool b2h, Output& output)
+{
+    // each search gets at most the largest frame
+    size_t window = b2h ? B2H::recv_buffer_size : H2B::recv_buffer_size;
+    MockStream in;
+    for (size_t position = 0; position < stream.size(); )
+    {
+        if (stream[position] != 0xAA)
+        {
+            position++;
+            output.numSkipped++;
+            continue;
+        }
+        auto start = position;
+        in.setBuffer(std::vector<uint8_t>(stream.begin() + start, stream.begin() + std::min(stream.size(), start + window)));
+        if (receive(b2h, in, position, output))
+            continue;
+        position = start + 1;
+        output.numSkipped++;
+    }
+}
+
+
+/// The rolling sync match of the link bring-up (from the body board only)
+inline void bringup(const std::vector<uint8_t>& stream, bool b2h, Output& output)
+{
+    (void) b2h;
+    LinkBringup link;
+    MockStream in;
+    in.setBuffer(stream);
+    while (in.available())
+    {
+        size_t payload_size;
+        B2H::recv_error = FrameError::sync;
+        auto message_type = link.receive(in, payload_size);
+        record(output.events, message_type, B2H::recv_buffer, payload_size, B2H::recv_error, stream.size() - (size_t) in.available());
+    }
+    output.numSkipped = link.numSkipped;
+}
+
+
+/// FindMessage over the whole stream in memory; it doesn't report rejections
+inline void findMessage(const std::vector<uint8_t>& stream, bool b2h, Output& output)
+{
+    auto ptr = stream.data();
+    auto end = ptr + stream.size();
+    for (;;)
+    {
+        MessageType message_type;
+        size_t payload_size;
+        auto found = b2h ? B2H::FindMessage(ptr, end-ptr, message_type, payload_size)
+                         : H2B::FindMessage(ptr, end-ptr, message_type, payload_size);
+        if ((int) message_type == -1)
+        {
+            output.numSkipped += end - ptr;
+            return;
+        }
+        output.numSkipped += found - ptr;
+        auto size = payload_ofs + payload_size + 4;
+        output.events.push_back({(int) message_type, FrameError::none, std::vector<uint8_t>(found, found+size), (size_t)(found - stream.data())});
+        ptr = found + size;
+    }
+}
+
+
+/// The C interface, fed in pieces of random sizes; it doesn't report
+/// rejections, or where the frames start
+inline void capi(const std::vector<uint8_t>& stream, bool b2h, Output& output)
+{
+    std::mt19937 random(1);
+    auto link = spine_open_buffer(b2h ? SPINE_B2H : SPINE_H2B);
+    size_t offset = 0;
+    spine_frame frame;
+    while (offset < stream.size())
+    {
+        auto size = std::min((size_t)(random() % 2000), stream.size() - offset);
+        offset += spine_feed(link, stream.data()+offset, size, offset);
+        while (spine_poll(link, &frame) > 0)
+        {
+            auto start = frame.payload - payload_ofs;
+            output.events.push_back({frame.type, FrameError::none, std::vector<uint8_t>(start, start+payload_ofs+frame.size+4), unknown});
+            spine_release(link, &frame);
+        }
+    }
+    spine_stats stats;
+    spine_get_stats(link, &stats);
+    output.numSkipped = stats.numSkipped;
+    spine_close(link);
+}
+
+
+/** The number of bytes in the good frames
+    @param events the events
+    @return the number of bytes
+*/
+inline uint64_t goodBytes(const std::vector<Event>& events)
+{
+    uint64_t num = 0;
+    for (auto& event : events)
+        num += event.bytes.size();
+    return num;
+}
+
+
+/// The early audio receiver, fed a byte at a time (from the body board
+/// only); it only reports the data frames, once their CRC has passed, and
+/// doesn't count the bytes skipped
+inline void earlyAudio(const std::vector<uint8_t>& stream, bool b2h, Output& output)
+{
+    (void) b2h;
+    struct Context
+    {
+        const std::vector<uint8_t>* stream;
+        size_t position;
+        Output* output;
+    } context = {&stream, 0, &output};
+    auto samples = [](void* ctx, uint32_t frame, size_t first, const int16_t* samples, size_t count, bool speculative)
+    {
+        (void) frame, (void) first, (void) speculative;
+        auto& context = *(Context*) ctx;
+        // the frame ends with the byte just fed in; the samples are those
+        // passed on, rather than those in the stream
+        auto size = payload_ofs + sizeof(B2HDataFrame) + 4;
+        auto start = context.position + 1 - size;
+        std::vector<uint8_t> bytes(context.stream->begin() + start, context.stream->begin() + start + size);
+        memcpy(bytes.data() + payload_ofs + offsetof(B2HDataFrame, mic_samples), samples, count * MICROPHONE_COUNT * sizeof(int16_t));
+        context.output->events.push_back({(int) MessageType::dataFrame, FrameError::none, bytes, start});
+    };
+    EarlyAudioReceiver audio;
+    audio.subscribe({samples, nullptr, &context, false});
+    for (; context.position < stream.size(); context.position++)
+        audio.receive(stream.data() + context.position, 1, 0);
+    output.numSkipped = stream.size() - goodBytes(output.events);
+}
+
+
+/** Note a mismatch, or a divergence
+    @param count the number of them
+    @param first the description of the first
+    @param name the name of the decoder
+    @param text what is different
+*/
+inline void note(size_t& count, std::string& first, const char* name, const std::string& text)
+{
+    if (!count++)
+        first = std::string(name) + ": " + text;
+}
+
+
+/** Describe an event
+    @param event the event, or null if there is none
+    @return the description
+*/
+inline std::string describe(const Event* event)
+{
+    if (!event)
+        return "nothing";
+    char text[80];
+    snprintf(text, sizeof(text), "type %d (error %d) at %lld", event->type, (int) event->error,
+        event->offset == unknown ? -1LL : (long long) event->offset);
+    return text;
+}
+
+
+/** Compare the events and counts of a decoder with what is expected
+    @param name the name of the decoder
+    @param stream the bytes received
+    @param expected the output of the reference, restarted after each false start
+    @param output the output of the decoder
+    @param rejections true if the decoder reports the rejected frames
+    @param result the counts, and the first mismatch and divergence
+    @param only the only message type the decoder reports, or -1 for all
+*/
+inline void compare(const char* name, const std::vector<uint8_t>& stream, const Output& expected, const Output& output, bool rejections, Result& result, int only = -1)
+{
+    // only compare what the decoder reports
+    std::vector<const Event*> want, got;
+    uint64_t wantBytes = 0;
+    for (auto& event : expected.events)
+        if ((rejections || event.type != -1) && (only == -1 || event.type == only))
+        {
+            want.push_back(&event);
+            wantBytes += event.bytes.size();
+        }
+    for (auto& event : output.events)
+    {
+        got.push_back(&event);
+        if (event.type == -1)
+            result.numRejected++;
+        else
+            result.numFrames++;
+    }
+    result.numSkipped = output.numSkipped;
+
+    // ReceiveMessage loses the frames that start on the byte that broke a
+    // false start
+    auto lost = [&](const Event* event)
+    {
+        for (auto& span : output.falseStarts)
+            if (event->offset != unknown && span.start < event->offset && event->offset < span.end)
+                return true;
+        return false;
+    };
+    uint64_t lostBytes = 0;
+    size_t idx = 0, at = 0;
+    while (idx < want.size() || at < got.size())
+    {
+        if (idx < want.size() && at < got.size() && *want[idx] == *got[at])
+        {
+            idx++, at++;
+            continue;
+        }
+        if (idx < want.size() && lost(want[idx]))
+        {
+            lostBytes += want[idx]->bytes.size();
+            note(result.numDivergences, result.firstDivergence, name, "lost " + describe(want[idx]) + " to a false start");
+            idx++;
+            continue;
+        }
+        note(result.numMismatches, result.firstMismatch, name, "event " + std::to_string(at) + ": expected "
+             + describe(idx < want.size() ? want[idx] : nullptr) + ", got " + describe(at < got.size() ? got[at] : nullptr));
+        idx++, at++;
+    }
+
+    // the bytes skipped looking for the sync, or that weren't part of a good
+    // frame
+    uint64_t skipped = rejections ? expected.numSkipped : stream.size() - wantBytes;
+    if (output.numSkipped == skipped)
+        return;
+    char text[120];
+    snprintf(text, sizeof(text), "skipped %llu bytes, expected %llu", (unsigned long long) output.numSkipped, (unsigned long long) skipped);
+
+    // the frames lost are skipped; the C interface holds the tail that may
+    // be the start of a frame
+    if ((lostBytes && output.numSkipped > skipped)
+        || (!strcmp(name, "capi") && output.numSkipped < skipped && skipped - output.numSkipped < payload_ofs))
+        note(result.numDivergences, result.firstDivergence, name, text);
+    else
+        note(result.numMismatches, result.firstMismatch, name, text);
+}
+
+
+/** Run a stream through the reference and a decoder under test
+    @param name the name of the decoder
+    @param decoder the decoder
+    @param rejections true if the decoder reports the rejected frames
+    @param stream the bytes received
+    @param b2h true for the frames from the body board, false for the head board
+    @param only the only message type the decoder reports, or -1 for all
+    @return the counts, mismatches, divergences and time of the decoder
+*/
+inline Result run(const char* name, Decoder decoder, bool rejections, const std::vector<uint8_t>& stream, bool b2h, int only = -1)
+{
+    Output expected = {}, output = {};
+    resynchronised(stream, b2h, expected);
+
+    auto start = std::chrono::steady_clock::now();
+    decoder(stream, b2h, output);
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+    Result result = {name, 0, 0, 0, 0, "", 0, "", elapsed.count()};
+    compare(name, stream, expected, output, rejections, result, only);
+    return result;
+}
+
+
+/** Describe a result, for the test log
+    @param result the result of a decoder
+    @param numBytes the size of the stream
+    @return the description
+*/
+inline std::string describe(const Result& result, size_t numBytes)
+{
+    char text[200];
+    snprintf(text, sizeof(text), "%-10s %6u frames %5u rejected %7llu skipped %4u mismatches %4u divergences %8.1f MB/s",
+        result.name, (unsigned) result.numFrames, (unsigned) result.numRejected, (unsigned long long) result.numSkipped,
+        (unsigned) result.numMismatches, (unsigned) result.numDivergences, result.seconds > 0 ? numBytes / result.seconds / 1e6 : 0.0);
+    return text + (result.numMismatches ? "  " + result.firstMismatch : std::string())
+                + (result.numDivergences ? "  " + result.firstDivergence : std::string());
+}
+
+
+/** Make a random byte
+    @param random the random number generator
+    @return the byte
+*/
+inline uint8_t randomByte(std::mt19937& random)
+{
+    return (uint8_t) random();
+}
+
+
+/** Put the start of the sync in place: the sync byte, and maybe one or two
+    of the characters after it, but not the whole sync
+    @param bytes where to put it
+    @param size the room
+    @param tag the three characters following the sync byte
+    @param random the random number generator
+    @return the number of bytes put in place
+*/
+inline size_t partialSync(uint8_t* bytes, size_t size, const char* tag, std::mt19937& random)
+{
+    size_t length = std::min((size_t)(1 + random() % 3), size);
+    bytes[0] = 0xAA;
+    for (size_t idx = 1; idx < length; idx++)
+        bytes[idx] = (uint8_t) tag[idx-1];
+    // a byte after it mustn't complete it
+    if (length < size && bytes[length] == (uint8_t) tag[length-1])
+        bytes[length] ^= 1;
+    return length;
+}
+
+
+/** Append a frame, good or bad
+    @param stream the bytes
+    @param tag the three characters following the sync byte
+    @param message_type the type of the message
+    @param payload_size the size of the payload
+    @param random the random number generator, for the payload
+    @param error the error to put in the frame
+*/
+inline void appendFrame(std::vector<uint8_t>& stream, const char* tag, MessageType message_type, size_t payload_size, std::mt19937& random, FrameError error = FrameError::none)
+{
+    std::vector<uint8_t> payload(payload_size);
+    for (size_t idx = 0; idx < payload_size; idx++)
+        payload[idx] = randomByte(random);
+    // a false start or two in the payload
+    for (auto num = payload_size ? random() % 3 : 0; num; num--)
+    {
+        auto idx = random() % payload_size;
+        partialSync(payload.data()+idx, payload_size-idx, tag, random);
+    }
+    if (error == FrameError::typeSize)
+        message_type = (MessageType) 0x0101;
+    TestFrames::appendFrame(stream, tag[0] == 'B', message_type, payload.data(), payload_size, error == FrameError::crc);
+}
+
+
+/** Append filler: random bytes, false starts of the sync, and the sync of
+    the other direction
+    @param stream the bytes
+    @param tag the three characters following the sync byte
+    @param size the number of bytes of filler
+    @param random the random number generator
+*/
+inline void appendFiller(std::vector<uint8_t>& stream, const char* tag, size_t size, std::mt19937& random)
+{
+    auto start = stream.size();
+    stream.resize(start + size);
+    auto other = tag[0] == 'B' ? "H2B" : "B2H";
+    for (size_t idx = 0; idx < size; )
+    {
+        auto bytes = stream.data() + start + idx;
+        auto choice = random() % 8;
+        if (choice == 0)
+            idx += partialSync(bytes, size-idx, tag, random);
+        else if (choice == 1 && size-idx >= 4)
+        {
+            bytes[0] = 0xAA;
+            memcpy(bytes+1, other, 3);
+            idx += 4;
+        }
+        else
+        {
+            bytes[0] = randomByte(random);
+            idx++;
+        }
+    }
+}
+
+
+/** Make a random stream of frames, bad frames and filler
+    @param numFrames the number of frames
+    @param b2h true for the frames from the body board, false for the head board
+    @param seed the seed for the random numbers
+    @return the stream
+*/
+inline std::vector<uint8_t> randomStream(size_t numFrames, bool b2h, uint32_t seed)
+{
+    std::mt19937 random(seed);
+    std::vector<uint8_t> stream;
+    auto tag = b2h ? "B2H" : "H2B";
+    auto size_of = b2h ? B2H::size : H2B::size;
+    for (size_t idx = 0; idx < numFrames; idx++)
+    {
+        // some filler between the frames, and false starts just before them
+        if (random() % 4 == 0)
+            appendFiller(stream, tag, random() % 40, random);
+        if (random() % 8 == 0)
+        {
+            uint8_t bytes[3];
+            stream.insert(stream.end(), bytes, bytes + partialSync(bytes, sizeof(bytes), tag, random));
+        }
+
+        // pick a message type for this direction
+        MessageType message_type;
+        do
+            message_type = messageTypes[random() % (sizeof(messageTypes)/sizeof(messageTypes[0]))];
+        while (size_of(message_type) < 0);
+
+        auto choice = random() % 16;
+        auto error = choice == 0 ? FrameError::crc : choice == 1 ? FrameError::typeSize : FrameError::none;
+        appendFrame(stream, tag, message_type, size_of(message_type), random, error);
+    }
+    return stream;
+}
+
+}
@@ -0,0 +1,260 @@
+#include <vector>
+#include <cstdint>
+#include <chrono>
+#include <memory>
+#include <string>
+
+#include <esp32/rom/crc.h>
+#include "../src/crc.h"
+#include "../src/pcapng.cpp"
+
+#include <CppUnitTest.h>
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+using namespace Spine;
+
+TEST_CLASS(PcapngTests)
+{
+public:
+
+    /// The files written by the tests
+    static constexpr const char* path = "pcapng-tests.pcapng";
+    static constexpr const char* capturePath = "pcapng-tests.cap";
+
+    /** Read the whole file
+        @param name the path of the file
+        @return the bytes
+    */
+    static std::vector<uint8_t> readFile(const char* name)
+    {
+        std::vector<uint8_t> bytes;
+        auto file = fopen(name, "rb");
+        Assert::IsNotNull(file);
+        uint8_t chunk[4096];
+        for (size_t num; (num = fread(chunk, 1, sizeof(chunk), file)) > 0; )
+            bytes.insert(bytes.end(), chunk, chunk + num);
+        fclose(file);
+        return bytes;
+    }
+
+    /// Append a 32 bit value
+    static void append32(std::vector<uint8_t>& bytes, uint32_t value)
+    {
+        bytes.insert(bytes.end(), (const uint8_t*) &value, (const uint8_t*) &value + 4);
+    }
+
+    /// Test Method for writing and reading back:
+    /// The frames come back with their direction, time, type, payload and
+    /// CRC status.
+    TEST_METHOD(TestRoundTrip)
+    {
+        std::unique_ptr<PcapngWriter> writer(new PcapngWriter());
+        Assert::IsTrue(writer->open(path));
+        B2HDataFrame body = {};
+        body.sequenceNumber = 42;
+        H2BDataFrame head = {};
+        head.motorPower[3] = -1234;
+        Ack ack = {7};
+        Assert::IsTrue(writer->write(true , MessageType::dataFrame, (const uint8_t*) &body, sizeof(body), 5000000000ULL));
+        Assert::IsTrue(writer->write(false, MessageType::dataFrame, (const uint8_t*) &head, sizeof(head), 5000000001ULL));
+        Assert::IsTrue(writer->write(true , MessageType::ack      , (const uint8_t*) &ack , sizeof(ack) , 5000000002ULL, true));
+        Assert::IsTrue(writer->write(false, MessageType::shutdown , nullptr, 0, 5000000003ULL));
+        Assert::IsTrue(writer->close());
+
+        std::unique_ptr<PcapngReader> reader(new PcapngReader());
+        Assert::IsTrue(reader->open(path));
+        PcapngFrame frame;
+        Assert::IsTrue(reader->next(frame));
+        Assert::IsTrue(frame.b2h && frame.type == MessageType::dataFrame && !frame.crcError);
+        Assert::AreEqual((uint64_t) 5000000000, frame.timestamp_ns);
+        Assert::AreEqual(sizeof(body), frame.size);
+        Assert::AreEqual(42u, ((const B2HDataFrame*) frame.payload)->sequenceNumber);
+
+        Assert::IsTrue(reader->next(frame));
+        Assert::IsTrue(!frame.b2h && frame.type == MessageType::dataFrame);
+        Assert::AreEqual((int16_t) -1234, ((const H2BDataFrame*) frame.payload)->motorPower[3]);
+
+        Assert::IsTrue(reader->next(frame));
+        Assert::IsTrue(frame.b2h && frame.type == MessageType::ack && frame.crcError);
+        Assert::AreEqual(7, ((const Ack*) frame.payload)->value);
+
+        Assert::IsTrue(reader->next(frame));
+        Assert::IsTrue(!frame.b2h && frame.type == MessageType::shutdown && frame.size == 0);
+        Assert::AreEqual((uint64_t) 5000000003, frame.timestamp_ns);
+        Assert::IsFalse(reader->next(frame));
+        Assert::AreEqual((size_t) 6, reader->numBlocks);
+        Assert::AreEqual((size_t) 0, reader->numSkipped);
+    }
+
+    /// Test Method for the layout:
+    /// The section header, the interface (link type, time stamp resolution)
+    /// and the packet's flags are where the packet tools look for them.
+    TEST_METHOD(TestLayout)
+    {
+        std::unique_ptr<PcapngWriter> writer(new PcapngWriter());
+        Assert::IsTrue(writer->open(path));
+        Ack ack = {1};
+        Assert::IsTrue(writer->write(false, MessageType::ack, (const uint8_t*) &ack, sizeof(ack), 0x123456789ULL, true));
+        Assert::IsTrue(writer->close());
+        auto bytes = readFile(path);
+
+        auto get32 = [&](size_t ofs) { uint32_t value; memcpy(&value, bytes.data() + ofs, 4); return value; };
+        Assert::AreEqual(0x0A0D0D0Au, get32(0));
+        Assert::AreEqual(0x1A2B3C4Du, get32(8));
+        auto shbSize = get32(4);
+        Assert::AreEqual(shbSize, get32(shbSize - 4));
+
+        // the interface: LINKTYPE_USER0, with if_tsresol of 9
+        auto idb = shbSize;
+        Assert::AreEqual(1u, get32(idb));
+        Assert::AreEqual((uint8_t) 147, bytes[idb + 8]);
+        bool nanoseconds = false;
+        for (size_t ofs = idb + 16; ofs < idb + get32(idb + 4) - 4 && get32(ofs) & 0xFFFF; ofs += 4 + ((get32(ofs) >> 16) + 3) / 4 * 4)
+            nanoseconds |= (get32(ofs) & 0xFFFF) == 9 && bytes[ofs + 4] == 9;
+        Assert::IsTrue(nanoseconds);
+
+        // the packet: the time stamp, the frame, and the outbound direction
+        // with the CRC error in the flags
+        auto epb = idb + get32(idb + 4);
+        Assert::AreEqual(6u, get32(epb));
+        Assert::AreEqual(1u, get32(epb + 12));
+        Assert::AreEqual(0x23456789u, get32(epb + 16));
+        Assert::AreEqual((uint32_t)(payload_ofs + sizeof(ack)), get32(epb + 20));
+        Assert::AreEqual((uint8_t) 0xAA, bytes[epb + 28]);
+        Assert::AreEqual((uint8_t) 'H', bytes[epb + 29]);
+        auto options = epb + 28 + payload_ofs + sizeof(ack);
+        Assert::AreEqual(0x00040002u, get32(options));
+        Assert::AreEqual(2u | (1u << 24), get32(options + 4));
+        Assert::AreEqual((size_t)(epb + get32(epb + 4)), (size_t) bytes.size());
+    }
+
+    /// Test Method for a file from another tool:
+    /// The other blocks and interfaces are skipped, the time stamps are in
+    /// the interface's resolution, and the direction comes from the frame.
+    TEST_METHOD(TestOtherFile)
+    {
+        std::vector<uint8_t> bytes;
+        // a section header, without options
+        append32(bytes, 0x0A0D0D0A); append32(bytes, 28); append32(bytes, 0x1A2B3C4D);
+        append32(bytes, 1); append32(bytes, 0xFFFFFFFF); append32(bytes, 0xFFFFFFFF); append32(bytes, 28);
+        // an Ethernet interface, and a spine interface in microseconds
+        append32(bytes, 1); append32(bytes, 20); append32(bytes, 1); append32(bytes, 0); append32(bytes, 20);
+        append32(bytes, 1); append32(bytes, 20); append32(bytes, 147); append32(bytes, 0); append32(bytes, 20);
+        // a block of some other kind
+        append32(bytes, 0xBAD); append32(bytes, 16); append32(bytes, 0); append32(bytes, 16);
+        // a packet on the Ethernet interface, then a frame on the spine one
+        const uint8_t frame[payload_ofs + 4] = {0xAA, 'B', '2', 'H', 0x61, 0x6B, 4, 0, 5, 0, 0, 0};
+        for (uint32_t idx = 0; idx < 2; idx++)
+        {
+            append32(bytes, 6); append32(bytes, 28 + sizeof(frame) + 4); append32(bytes, idx);
+            append32(bytes, 0); append32(bytes, 1000 + idx);
+            append32(bytes, sizeof(frame)); append32(bytes, sizeof(frame));
+            bytes.insert(bytes.end(), frame, frame + sizeof(frame));
+            append32(bytes, 28 + sizeof(frame) + 4);
+        }
+        auto file = fopen(path, "wb");
+        fwrite(bytes.data(), 1, bytes.size(), file);
+        fclose(file);
+
+        std::unique_ptr<PcapngReader> reader(new PcapngReader());
+        Assert::IsTrue(reader->open(path));
+        PcapngFrame read;
+        Assert::IsTrue(reader->next(read));
+        Assert::IsTrue(read.b2h && read.type == MessageType::ack && !read.crcError);
+        Assert::AreEqual((uint64_t) 1001000, read.timestamp_ns);
+        Assert::AreEqual(5, ((const Ack*) read.payload)->value);
+        Assert::IsFalse(reader->next(read));
+        Assert::AreEqual((size_t) 2, reader->numSkipped);
+    }
+
+    /// Test Method for a large file:
+    /// The blocks straddling the buffer are read, and the frames go back
+    /// through the decoder.
+    TEST_METHOD(TestDecode)
+    {
+        const size_t numFrames = 3 * PCAPNG_BUFFER_SIZE / sizeof(B2HDataFrame);
+        std::unique_ptr<PcapngWriter> writer(new PcapngWriter());
+        Assert::IsTrue(writer->open(path));
+        B2HDataFrame body = {};
+        for (size_t idx = 0; idx < numFrames; idx++)
+        {
+            body.sequenceNumber = (uint32_t) idx;
+            Assert::IsTrue(writer->write(true, MessageType::dataFrame, (const uint8_t*) &body, sizeof(body), idx * 5120000ULL));
+        }
+        Assert::IsTrue(writer->close());
+
+        std::unique_ptr<PcapngReader> reader(new PcapngReader());
+        Assert::IsTrue(reader->open(path));
+        PcapngFrame frame;
+        size_t num = 0;
+        std::vector<uint8_t> wire;
+        while (reader->next(frame))
+        {
+            // the frame on the wire: the packet and its CRC
+            auto packet = frame.payload - payload_ofs;
+            wire.assign(packet, packet + payload_ofs + frame.size);
+            uint32_t crc = crc32_le(CRC32_INITIAL, wire.data() + payload_ofs, (uint32_t) frame.size);
+            wire.insert(wire.end(), (const uint8_t*) &crc, (const uint8_t*) &crc + 4);
+
+            MessageType message_type;
+            size_t payload_size;
+            auto ptr = B2H::FindMessage(wire.data(), wire.size(), message_type, payload_size);
+            Assert::IsTrue(ptr == wire.data() && message_type == MessageType::dataFrame);
+            Assert::AreEqual((uint32_t) num, ((const B2HDataFrame*)(ptr + payload_ofs))->sequenceNumber);
+            Assert::AreEqual((uint64_t)(num * 5120000ULL), frame.timestamp_ns);
+            num++;
+        }
+        Assert::AreEqual(numFrames, num);
+    }
+
+    /// Test Method for the speed:
+    /// Log the rate of converting a capture to pcapng, and of reading it back.
+    TEST_METHOD(TestConvertSpeed)
+    {
+        const size_t numFrames = 40000;
+        {
+            std::unique_ptr<CaptureWriter> capture(new CaptureWriter());
+            Assert::IsTrue(capture->open(capturePath));
+            B2HDataFrame body = {};
+            H2BDataFrame head = {};
+            for (size_t idx = 0; idx < numFrames; idx++)
+            {
+                body.sequenceNumber = head.sequenceNumber = (uint32_t) idx;
+                Assert::IsTrue(capture->write(true , MessageType::dataFrame, (const uint8_t*) &body, sizeof(body), idx * 5120000ULL));
+                Assert::IsTrue(capture->write(false, MessageType::dataFrame, (const uint8_t*) &head, sizeof(head), idx * 5120000ULL + 1000));
+            }
+            Assert::IsTrue(capture->close());
+        }
+
+        auto start = std::chrono::steady_clock::now();
+        std::unique_ptr<CaptureReader> capture(new CaptureReader());
+        std::unique_ptr<PcapngWriter> writer(new PcapngWriter());
+        Assert::IsTrue(capture->open(capturePath));
+        Assert::IsTrue(writer->open(path));
+        CaptureFrame frame;
+        while (capture->next(frame))
+            Assert::IsTrue(writer->write(frame.b2h, frame.type, frame.payload, frame.size, frame.timestamp_ns));
+        Assert::IsTrue(writer->close());
+        std::chrono::duration<double> converting = std::chrono::steady_clock::now() - start;
+        Assert::AreEqual(2 * numFrames, writer->numFrames);
+
+        start = std::chrono::steady_clock::now();
+        std::unique_ptr<PcapngReader> reader(new PcapngReader());
+        Assert::IsTrue(reader->open(path));
+        PcapngFrame read;
+        size_t num = 0, payloadBytes = 0;
+        while (reader->next(read))
+        {
+            num++;
+            payloadBytes += read.size;
+        }
+        std::chrono::duration<double> reading = std::chrono::steady_clock::now() - start;
+        Assert::AreEqual(2 * numFrames, num);
+
+        auto size = (double) readFile(path).size();
+        Logger::WriteMessage(("pcapng: " + std::to_string(size / converting.count() / 1e9) + " GB/s converting, "
+                              + std::to_string(size / reading.count() / 1e9) + " GB/s reading, "
+                              + std::to_string(payloadBytes / 1e6) + " MB of payload\n").c_str());
+        remove(capturePath);
+        remove(path);
+    }
+};
@@ -0,0 +1,60 @@
+#include <vector>
+#include <cstdint>
+
+#include "../src/predictor.cpp"
+
+#include <CppUnitTest.h>
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+using namespace Spine;
+
+TEST_CLASS(PredictorTests)
+{
+public:
+
+    /// Test Method for learning the period:
+    /// The period converges on the cadence of the frames, even when it is
+    /// not the nominal one.
+    TEST_METHOD(TestLearnPeriod)
+    {
+        FramePredictor predictor;
+        uint32_t now = 1000;
+        for (uint32_t seq = 0; seq < 100; seq++, now += 5000)
+            predictor.observe(seq, now);
+
+        Assert::AreEqual(5000.0, (double) predictor.period_us(), 10.0);
+        Assert::AreEqual((uint32_t)(now - 5000 + predictor.period_us()), predictor.nextExpected());
+    }
+
+    /// Test Method for lost frames:
+    /// A gap in the sequence numbers is not mistaken for a long period.
+    TEST_METHOD(TestLostFrames)
+    {
+        FramePredictor predictor;
+        uint32_t now = 0;
+        for (uint32_t seq = 0; seq < 50; seq++, now += B2H_FRAME_PERIOD_US)
+        {
+            // drop every fifth frame
+            if (seq % 5 != 4)
+                predictor.observe(seq, now);
+        }
+        Assert::AreEqual((double) B2H_FRAME_PERIOD_US, (double) predictor.period_us(), 2.0);
+        Assert::IsTrue(predictor.jitter_us() < 10);
+    }
+
+    /// Test Method for the sleep time:
+    /// No sleep until the period is learned; after, sleep until the guard
+    /// time before the next frame.
+    TEST_METHOD(TestSleepTime)
+    {
+        FramePredictor predictor;
+        predictor.observe(1, 10000);
+        Assert::AreEqual((uint32_t) 0, predictor.sleepTime(10100));
+
+        predictor.observe(2, 10000 + B2H_FRAME_PERIOD_US);
+        auto next = predictor.nextExpected();
+        Assert::AreEqual((uint32_t)(next - predictor.minGuard_us - (10000 + B2H_FRAME_PERIOD_US)),
+                         predictor.sleepTime(10000 + B2H_FRAME_PERIOD_US));
+        Assert::AreEqual((uint32_t) 0, predictor.sleepTime(next));
+        Assert::AreEqual((uint32_t) 0, predictor.sleepTime(next + 100000));
+    }
+};
@@ -0,0 +1,131 @@
+#include <vector>
+#include <cstdint>
+
+#include "../src/schema.cpp"
+
+#include <CppUnitTest.h>
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+using namespace Spine;
+
+TEST_CLASS(SchemaTests)
+{
+public:
+
+    /// Find a field of the body board's data frame
+    static const FieldInfo& field(const char* name)
+    {
+        auto found = FindField(b2hDataFrameFields, COUNT_OF(b2hDataFrameFields), name, strlen(name));
+        Assert::IsNotNull(found);
+        return *found;
+    }
+
+    /// Remembers the payload struct it was called with
+    struct Handler
+    {
+        const char* called = nullptr;
+        bool operator()(B2HDataFrame&) { called = "B2HDataFrame"; return true; }
+        bool operator()(H2BDataFrame&) { called = "H2BDataFrame"; return true; }
+        bool operator()(Ack&)          { called = "Ack"; return false; }
+        template<typename T> bool operator()(T&) { called = "other"; return false; }
+    };
+
+    /// Test Method for the size tables:
+    /// The sizes come from the schema, and match the payload structs.
+    TEST_METHOD(TestSizes)
+    {
+        Assert::AreEqual((int) sizeof(B2HDataFrame), B2H::size(MessageType::dataFrame));
+        Assert::AreEqual((int) sizeof(H2BDataFrame), H2B::size(MessageType::dataFrame));
+        Assert::AreEqual((int) sizeof(Ack), B2H::size(MessageType::ack));
+        Assert::AreEqual(-1, H2B::size(MessageType::ack));
+        Assert::AreEqual(-1, B2H::size(MessageType::lights));
+        Assert::AreEqual("version", MessageName(MessageType::version));
+        Assert::IsNull(MessageName((MessageType) 0x1234));
+    }
+
+    /// Test Method for reading the fields:
+    /// Scalars, arrays, members of the motor states, and flag bits are read
+    /// from where the struct puts them.
+    TEST_METHOD(TestReadFields)
+    {
+        B2HDataFrame frame = {};
+        frame.cliffSense[2] = 199;
+        frame.motor[3].delta = -5;
+        frame.battery_volt = -2;
+        frame.onCharger = 1;
+        frame.shutdown = 1;
+        frame.liftEncoderChanged = 1;
+        auto payload = (const uint8_t*) &frame;
+
+        Assert::AreEqual((int32_t) 199, ReadField(field("cliffSense"), payload, 2));
+        Assert::AreEqual((int32_t) -5, ReadField(field("motor.delta"), payload, 3));
+        Assert::AreEqual((int32_t) -2, ReadField(field("battery_volt"), payload));
+        Assert::AreEqual((int32_t) 1, ReadField(field("onCharger"), payload));
+        Assert::AreEqual((int32_t) 0, ReadField(field("charging"), payload));
+        Assert::AreEqual((int32_t) 1, ReadField(field("shutdown"), payload));
+        Assert::AreEqual((int32_t) 1, ReadField(field("liftEncoderChanged"), payload));
+        Assert::AreEqual((int32_t) 0, ReadField(field("headEncoderChanged"), payload));
+        Assert::AreEqual((uint16_t) 320, field("mic_samples").count);
+        Assert::IsNull(FindField(b2hDataFrameFields, COUNT_OF(b2hDataFrameFields), "cliff", 5));
+    }
+
+    /// Test Method for the layout check:
+    /// A field table with a gap, or out of order, doesn't match the struct.
+    TEST_METHOD(TestLayoutCheck)
+    {
+        constexpr FieldInfo gap[] =
+        {
+            {"a", 0, FieldType::u16, 1, 2, 0, 0},
+            {"b", 4, FieldType::u16, 1, 2, 0, 0},
+        };
+        constexpr FieldInfo good[] =
+        {
+            {"a", 0, FieldType::u16, 1, 2, 0, 0},
+            {"b", 2, FieldType::u16, 1, 2, 0, 0},
+        };
+        static_assert(!checkLayout(gap, 2, 6), "the gap should be found");
+        static_assert(checkLayout(good, 2, 4), "the fields should match");
+        Assert::IsTrue(checkLayout(b2hDataFrameFields, COUNT_OF(b2hDataFrameFields), sizeof(B2HDataFrame)));
+    }
+
+    /// Test Method for the dispatch:
+    /// The payload is passed as the struct for its type and direction.
+    TEST_METHOD(TestDispatch)
+    {
+        uint8_t payload[sizeof(B2HDataFrame)] = {};
+        Handler handler;
+        Assert::IsTrue(DispatchB2H(MessageType::dataFrame, payload, handler));
+        Assert::AreEqual("B2HDataFrame", handler.called);
+        Assert::IsTrue(DispatchH2B(MessageType::dataFrame, payload, handler));
+        Assert::AreEqual("H2BDataFrame", handler.called);
+        Assert::IsFalse(DispatchB2H(MessageType::ack, payload, handler));
+        Assert::AreEqual("Ack", handler.called);
+
+        // not sent from the head board
+        handler.called = nullptr;
+        Assert::IsFalse(DispatchH2B(MessageType::ack, payload, handler));
+        Assert::IsNull(handler.called);
+    }
+
+    /// Test Method for the printers:
+    /// The message is printed with its name and fields.
+    TEST_METHOD(TestFormat)
+    {
+        char text[200];
+        Ack ack = {1};
+        FormatMessage(text, sizeof(text), true, MessageType::ack, (const uint8_t*) &ack, sizeof(ack));
+        Assert::AreEqual("B2H ack: value=1", text);
+
+        H2BDataFrame frame = {};
+        frame.sequenceNumber = 7;
+        frame.motorPower[1] = -100;
+        FormatMessage(text, sizeof(text), false, MessageType::dataFrame, (const uint8_t*) &frame, sizeof(frame));
+        Assert::AreEqual("H2B dataFrame: sequenceNumber=7 powerFlags=0 reserved1=[0,0,0] motorPower=[0,-100,0,0] ledColors=[16] reserved_=[32]", text);
+
+        FormatMessage(text, sizeof(text), true, MessageType::version, (const uint8_t*) &frame, 40);
+        Assert::AreEqual("B2H version: 40 bytes", text);
+
+        // truncated to fit
+        Assert::AreEqual((size_t) 9, FormatMessage(text, 10, true, MessageType::ack, (const uint8_t*) &ack, sizeof(ack)));
+        Assert::AreEqual("B2H ack: ", text);
+    }
+};
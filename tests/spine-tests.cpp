@@ -5,6 +5,7 @@
 #include "mockStream.h"
 
 #include "../src/spine.cpp"
+#include "testFrames.h"
 
 #include <CppUnitTest.h>
 using namespace Microsoft::VisualStudio::CppUnitTestFramework;
@@ -209,8 +210,8 @@ public:
         Assert::AreEqual('\0', dataChar->text[numBytes]); // Check null termination
 
         // Check the CRC
-        auto expectedCrc = crc32(~0UL, buffer + payload_ofs, (int) messageSize);
-        auto actualCrc = LE::uint32(buffer + payload_ofs + messageSize + 4);
+        auto expectedCrc = crc32(CRC32_INITIAL, buffer + payload_ofs, (int) messageSize);
+        auto actualCrc = LE::uint32(buffer + payload_ofs + messageSize);
         Assert::AreEqual(expectedCrc, actualCrc);
     }
 
@@ -239,8 +240,8 @@ public:
         Assert::AreEqual('\0', dataChar->text[numBytes]); // Check null termination
 
         // Check the CRC
-        auto expectedCrc = crc32(~0UL, buffer + payload_ofs, (int) messageSize);
-        auto actualCrc = LE::uint32(buffer + payload_ofs + messageSize + 4);
+        auto expectedCrc = crc32(CRC32_INITIAL, buffer + payload_ofs, (int) messageSize);
+        auto actualCrc = LE::uint32(buffer + payload_ofs + messageSize);
         Assert::AreEqual(expectedCrc, actualCrc);
     }
 
@@ -259,7 +260,7 @@ public:
             // Payload (example data)
             'H', 'e', 'l', 'l', 'o', ' ', 'H', '2', 'B', '!', 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
             // CRC (example, should be calculated based on the payload)
-            0xDE, 0xAD, 0xBE, 0xEF // Placeholder CRC
+            0, 0, 0, 0 // Placeholder CRC (the mock CRC is 0)
         };
 
         // Set the buffer for the mock stream
@@ -343,7 +344,7 @@ public:
             0x64, 0x63, // Message type dataCharacter
             32, 0x00, // Payload size (32)
             // Payload (example data)
-            'H', 'e', 'l', 'l', 'o', ' ', 'B', '2', 'H', '!', 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+            'H', 'e', 'l', 'l', 'o', ' ', 'B', '2', 'H', '!', 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
             // CRC (example, should be calculated based on the payload)
             0, 0, 0, 0 // Placeholder CRC
         };
@@ -416,6 +417,90 @@ public:
         Assert::AreEqual((size_t)0, payload_size);
     }
 
+    /// @brief Test Method for a Truncated Frame:
+    /// This test simulates a data frame that is cut short partway through the payload.
+    /// It checks that the frame is given up as truncated, and that the receiver
+    /// waited only about the time the frame takes to arrive at 3Mbaud.
+    TEST_METHOD(TestB2H_ReceiveMessage_Truncated)
+    {
+        MockStream mockStream;
+        std::vector<uint8_t> frame = {
+            0xAA, 'B', '2', 'H', // Sync bytes
+            0x66, 0x64, // Message type dataFrame
+            0x00, 0x03, // Payload size (768)
+        };
+        // only half of the payload arrives
+        frame.resize(frame.size() + 384);
+        mockStream.setBuffer(frame);
+        mockStream.setTimeout(100);
+
+        size_t payload_size = 0;
+        MessageType result = B2H::ReceiveMessage(mockStream, payload_size);
+        Assert::AreEqual(-1, (int) result);
+        Assert::AreEqual((size_t)0, payload_size);
+        Assert::AreEqual((int) FrameError::truncated, (int) B2H::recv_error);
+
+        // the worst case stall was the 100ms stream timeout; now it is the
+        // time for the 772 bytes of the payload and CRC, plus the slack
+#if SPINE_EARLY_AUDIO
+        // (or for the block of samples that didn't arrive, when they are
+        // read a block at a time)
+        constexpr size_t blockSize = EARLY_AUDIO_BLOCK_SAMPLES * MICROPHONE_COUNT * sizeof(int16_t);
+        Assert::AreEqual((blockSize*10*1000 + SPINE_BAUD_RATE-1) / SPINE_BAUD_RATE + SPINE_READ_SLACK_MS, mockStream.timeout);
+#else
+        Assert::AreEqual(4ul, mockStream.timeout);
+#endif
+        Logger::WriteMessage(("worst case stall on a truncated frame: 100 ms before, "
+                              + std::to_string(mockStream.timeout) + " ms after\n").c_str());
+    }
+
+#if SPINE_EARLY_AUDIO
+    /// @brief Test Method for the Early Audio:
+    /// This test receives a data frame, and a copy with a bad CRC.  It checks
+    /// that the samples are passed on as they are read, then committed, and
+    /// rolled back for the bad copy.
+    TEST_METHOD(TestB2H_ReceiveMessage_EarlyAudio)
+    {
+        struct Counts
+        {
+            size_t blocks, committed, rolledBack;
+            int16_t first;
+        } counts = {};
+        auto onSamples = [](void* context, uint32_t, size_t first, const int16_t* samples, size_t, bool)
+        {
+            auto& counts = *(Counts*) context;
+            if (!first)
+                counts.first = samples[0];
+            counts.blocks++;
+        };
+        auto onVerdict = [](void* context, uint32_t, bool good)
+        {
+            auto& counts = *(Counts*) context;
+            (good ? counts.committed : counts.rolledBack)++;
+        };
+        Assert::IsTrue(B2H::earlyAudio.subscribe({onSamples, onVerdict, &counts, true}));
+
+        B2HDataFrame data;
+        memset(&data, 0, sizeof(data));
+        data.mic_samples[0] = 1234;
+        std::vector<uint8_t> stream;
+        TestFrames::appendFrame(stream, true, MessageType::dataFrame, &data, sizeof(data));
+        TestFrames::appendFrame(stream, true, MessageType::dataFrame, &data, sizeof(data), true);
+        MockStream mockStream;
+        mockStream.setBuffer(stream);
+
+        size_t payload_size = 0;
+        Assert::AreEqual((int) MessageType::dataFrame, (int) B2H::ReceiveMessage(mockStream, payload_size));
+        Assert::AreEqual((size_t) MICROPHONE_SAMPLES_PER_FRAME / EARLY_AUDIO_BLOCK_SAMPLES, counts.blocks);
+        Assert::AreEqual((int16_t) 1234, counts.first);
+        Assert::AreEqual((size_t) 1, counts.committed);
+
+        Assert::AreEqual(-1, (int) B2H::ReceiveMessage(mockStream, payload_size));
+        Assert::AreEqual((size_t) 2 * MICROPHONE_SAMPLES_PER_FRAME / EARLY_AUDIO_BLOCK_SAMPLES, counts.blocks);
+        Assert::AreEqual((size_t) 1, counts.rolledBack);
+    }
+#endif
+
 
     /// @brief Test Method for Sending a Message:
     /// This test simulates sending a message from the body board to the head board.
@@ -478,4 +563,15 @@ public:
             Assert::AreEqual(testMessage[i], sentBuffer[i]);
         }
     }
+
+    /// Test Method for the sizes of the receive buffers:
+    /// Each buffer is sized for the largest payload in its direction, with
+    /// room for the header and the CRC.
+    TEST_METHOD(TestReceiveBufferSizes)
+    {
+        Assert::AreEqual((size_t) 1028, H2B::max_payload_size);
+        Assert::AreEqual((size_t)  768, B2H::max_payload_size);
+        Assert::AreEqual((size_t) payload_ofs+1028+4, sizeof(H2B::recv_buffer));
+        Assert::AreEqual((size_t) payload_ofs+ 768+4, sizeof(B2H::recv_buffer));
+    }
 };
@@ -0,0 +1,123 @@
+#include <vector>
+#include <cstdint>
+
+#include "../src/stall.cpp"
+
+#include <CppUnitTest.h>
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+using namespace Spine;
+
+/// The time between data frames, in microseconds
+static const uint32_t framePeriod_us = 5120;
+
+TEST_CLASS(StallTests)
+{
+public:
+
+    /// Drive the left wheel at the given power, with the encoder reporting the
+    /// given motion on each frame.
+    static void drive(StallDetector& detector, int16_t power, int32_t delta, int numFrames)
+    {
+        H2BDataFrame command = {};
+        B2HDataFrame feedback = {};
+        command.motorPower[(int)Motor::frontLeft] = power;
+        feedback.motor[(int)Motor::frontLeft].delta = delta;
+
+        uint32_t now = 1000000;
+        for (int idx = 0; idx < numFrames; idx++, now += framePeriod_us)
+        {
+            detector.command(command, now);
+            detector.feedback(feedback, now + framePeriod_us/2);
+        }
+    }
+
+    /// Test Method for a motor moving as expected:
+    /// The left wheel moves at the expected speed, so no fault is flagged.
+    TEST_METHOD(TestMovingMotor)
+    {
+        StallDetector detector;
+        drive(detector, 16384, 20, 20);
+
+        Assert::AreEqual((int) MotorFault::none, (int) detector.fault(Motor::frontLeft));
+        Assert::AreEqual(20, detector.expected(Motor::frontLeft));
+        Assert::AreEqual(20, detector.actual(Motor::frontLeft));
+        Assert::AreEqual((uint32_t) 0, detector.numStalls);
+    }
+
+    /// Test Method for a stalled motor:
+    /// The left wheel is driven, but the encoder does not move.  The stall is
+    /// flagged after the configured number of frames, not before.
+    TEST_METHOD(TestStalledMotor)
+    {
+        StallDetector detector;
+        drive(detector, 16384, 0, defaultStallConfig.faultFrames);
+        Assert::AreEqual((int) MotorFault::none, (int) detector.fault(Motor::frontLeft));
+
+        drive(detector, 16384, 0, defaultStallConfig.faultFrames + 2);
+        Assert::AreEqual((int) MotorFault::stalled, (int) detector.fault(Motor::frontLeft));
+        Assert::AreEqual((int) MotorFault::none, (int) detector.fault(Motor::frontRight));
+        Assert::AreEqual((uint32_t) 1, detector.numStalls);
+    }
+
+    /// Test Method for a jammed motor:
+    /// The encoder moves against the commanded direction.
+    TEST_METHOD(TestJammedMotor)
+    {
+        StallDetector detector;
+        drive(detector, 16384, -5, 2*defaultStallConfig.faultFrames);
+        Assert::AreEqual((int) MotorFault::jammed, (int) detector.fault(Motor::frontLeft));
+        Assert::AreEqual((uint32_t) 1, detector.numJams);
+    }
+
+    /// Test Method for an idle motor:
+    /// A motor that is not driven is never flagged, even if it is stationary.
+    TEST_METHOD(TestIdleMotor)
+    {
+        StallDetector detector;
+        drive(detector, 0, 0, 2*defaultStallConfig.faultFrames);
+        Assert::AreEqual((int) MotorFault::none, (int) detector.fault(Motor::frontLeft));
+    }
+
+    /// Test Method for the response delay:
+    /// Feedback that arrives before the command could have taken effect is
+    /// compared against the previous command.
+    TEST_METHOD(TestResponseDelay)
+    {
+        StallDetector detector;
+        H2BDataFrame command = {};
+        B2HDataFrame feedback = {};
+
+        command.motorPower[(int)Motor::frontLeft] = 32767;
+        detector.command(command, 1000);
+        detector.feedback(feedback, 1000 + defaultStallConfig.responseDelay_us - 1);
+        Assert::AreEqual(0, detector.expected(Motor::frontLeft));
+
+        detector.feedback(feedback, 1000 + defaultStallConfig.responseDelay_us);
+        Assert::AreEqual(defaultStallConfig.fullScaleTicks[0], detector.expected(Motor::frontLeft));
+    }
+
+    /// Test Method for the lift at the smallest power:
+    /// The lift's full scale speed is a few ticks a frame, so at minPower it
+    /// is expected to move a fraction of a tick; standing still is a stall,
+    /// a tick a frame isn't.
+    TEST_METHOD(TestLiftStallAtMinPower)
+    {
+        for (int32_t delta = 0; delta < 2; delta++)
+        {
+            StallDetector detector;
+            H2BDataFrame command = {};
+            B2HDataFrame feedback = {};
+            command.motorPower[(int)Motor::backLeft] = defaultStallConfig.minPower;
+            feedback.motor[(int)Motor::backLeft].delta = delta;
+
+            uint32_t now = 1000000;
+            for (int idx = 0; idx < 2*defaultStallConfig.faultFrames; idx++, now += framePeriod_us)
+            {
+                detector.command(command, now);
+                detector.feedback(feedback, now + framePeriod_us/2);
+            }
+            Assert::AreEqual(1, detector.expected(Motor::backLeft));
+            Assert::IsTrue(detector.fault(Motor::backLeft) == (delta ? MotorFault::none : MotorFault::stalled));
+        }
+    }
+};
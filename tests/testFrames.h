@@ -0,0 +1,59 @@
+/* Frames built for the tests
+   Copyright 2024 Randall Maas
+*//**@file
+    @brief Frames built for the tests.
+
+    The tests that feed frames to a decoder, or check the frames sent, build
+    them here.  The CRC is computed with crc32_le(), as the framing does: in
+    the tests that is the mock's.
+
+    spine.h must be included before this file.
+*/
+#pragma once
+#include <vector>
+#include <string.h>
+#include <esp32/rom/crc.h>
+#include "../src/crc.h"
+
+namespace TestFrames {
+
+using namespace Spine;
+
+/** Build a frame
+    @param b2h true for a frame from the body board, false for the head board
+    @param message_type the type of the message
+    @param payload the payload, or null for a payload of zeros
+    @param size the size of the payload
+    @param badCrc true to spoil the CRC
+    @return the bytes of the frame
+*/
+inline std::vector<uint8_t> makeFrame(bool b2h, MessageType message_type, const void* payload, size_t size, bool badCrc = false)
+{
+    std::vector<uint8_t> bytes = {0xAA, (uint8_t)(b2h ? 'B' : 'H'), '2', (uint8_t)(b2h ? 'H' : 'B'),
+                                  (uint8_t) message_type, (uint8_t)((uint16_t) message_type >> 8),
+                                  (uint8_t) size, (uint8_t)(size >> 8)};
+    bytes.resize(payload_ofs + size + 4);
+    if (payload && size)
+        memcpy(bytes.data() + payload_ofs, payload, size);
+    uint32_t crc = crc32_le(CRC32_INITIAL, bytes.data() + payload_ofs, (uint32_t) size);
+    if (badCrc)
+        crc ^= 0x00010000;
+    memcpy(bytes.data() + payload_ofs + size, &crc, 4);
+    return bytes;
+}
+
+/** Append a frame to a stream
+    @param stream the bytes
+    @param b2h true for a frame from the body board, false for the head board
+    @param message_type the type of the message
+    @param payload the payload, or null for a payload of zeros
+    @param size the size of the payload
+    @param badCrc true to spoil the CRC
+*/
+inline void appendFrame(std::vector<uint8_t>& stream, bool b2h, MessageType message_type, const void* payload, size_t size, bool badCrc = false)
+{
+    auto bytes = makeFrame(b2h, message_type, payload, size, badCrc);
+    stream.insert(stream.end(), bytes.begin(), bytes.end());
+}
+
+}
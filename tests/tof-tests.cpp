@@ -0,0 +1,102 @@
+#include <vector>
+#include <cstdint>
+
+#include "../src/tof.cpp"
+
+#include <CppUnitTest.h>
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+using namespace Spine;
+
+TEST_CLASS(TofTests)
+{
+public:
+
+    /// Make a data frame with a time of flight reading
+    static B2HDataFrame reading(uint16_t range_mm, uint16_t signalRate, uint16_t spads)
+    {
+        B2HDataFrame frame = {};
+        frame.prox_status = 0;
+        frame.prox_range_mm = range_mm;
+        frame.prox_signalRate_mcps = signalRate;
+        frame.prox_ambient = 64;        // 0.5 Mcps
+        frame.prox_SPADCount = spads;
+        frame.prox_sampleCount = 10;    // 10us of integration
+        return frame;
+    }
+
+    /// Test Method for the counts:
+    /// The counts are the rate times the integration time.
+    TEST_METHOD(TestCounts)
+    {
+        auto frame = reading(100, 128*20, 10*256);   // 20 Mcps, 10 SPADs
+        auto result = TofReconstruction::reconstruct(frame, defaultTofConfig);
+
+        Assert::IsTrue(result.valid);
+        Assert::AreEqual((uint32_t) 200, result.signalCounts);
+        Assert::AreEqual((uint32_t) 5, result.ambientCounts);
+        Assert::AreEqual((uint16_t) 2000, result.signalPerSpad_kcps);
+    }
+
+    /// Test Method for the reflectivity:
+    /// The same target at twice the range gives a quarter of the signal, and
+    /// the same reflectivity.
+    TEST_METHOD(TestReflectivity)
+    {
+        auto near = TofReconstruction::reconstruct(reading(100, 128*20, 10*256), defaultTofConfig);
+        auto far  = TofReconstruction::reconstruct(reading(200, 128*5 , 10*256), defaultTofConfig);
+
+        Assert::AreEqual((uint32_t) 256, near.reflectivity);
+        Assert::AreEqual((uint32_t) 256, far.reflectivity);
+    }
+
+    /// Test Method for a strong, distant reading:
+    /// The signal per SPAD is clamped, and the reflectivity worked out from
+    /// the clamped value without overflowing.
+    TEST_METHOD(TestStrongReading)
+    {
+        auto result = TofReconstruction::reconstruct(reading(0xFFFF, 0xFFFF, 1), defaultTofConfig);
+
+        Assert::AreEqual((uint16_t) 0xFFFF, result.signalPerSpad_kcps);
+        Assert::AreEqual((uint32_t)(0xFFFFULL * 0xFFFF * 0xFFFF * 256 / (2000 * 100 * 100)), result.reflectivity);
+    }
+
+    /// Test Method for the histograms:
+    /// The valid readings are accumulated into their range bin; the others
+    /// are only counted.
+    TEST_METHOD(TestHistogram)
+    {
+        TofReconstruction tof;
+        tof.update(reading(100, 128*20, 10*256));
+        tof.update(reading(120, 128*20, 10*256));
+        tof.update(reading(5000, 128, 10*256));
+
+        auto bad = reading(300, 128*20, 10*256);
+        bad.prox_status = 4;
+        tof.update(bad);
+
+        auto histogram = tof.snapshot();
+        Assert::AreEqual((uint32_t) 4, histogram.numReadings);
+        Assert::AreEqual((uint32_t) 2, histogram.bin[0].count);
+        Assert::AreEqual((uint64_t) 400, histogram.bin[0].signalCounts);
+        Assert::AreEqual((uint32_t) 0, histogram.bin[2].count);
+        Assert::AreEqual((uint32_t) 1, histogram.bin[TOF_BIN_COUNT-1].count);
+
+        tof.reset();
+        Assert::AreEqual((uint32_t) 0, tof.snapshot().numReadings);
+    }
+
+    /// Test Method for a bin width of 0:
+    /// The bins are taken to be 1mm wide, rather than dividing by zero.
+    TEST_METHOD(TestZeroBinWidth)
+    {
+        auto config = defaultTofConfig;
+        config.binWidth_mm = 0;
+        TofReconstruction tof(config);
+        tof.update(reading(3, 128*20, 10*256));
+        tof.update(reading(100, 128*20, 10*256));
+
+        auto histogram = tof.snapshot();
+        Assert::AreEqual((uint32_t) 1, histogram.bin[3].count);
+        Assert::AreEqual((uint32_t) 1, histogram.bin[TOF_BIN_COUNT-1].count);
+    }
+};
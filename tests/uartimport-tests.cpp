@@ -0,0 +1,245 @@
+#include <vector>
+#include <algorithm>
+#include <cstdint>
+#include <chrono>
+#include <memory>
+#include <string>
+
+#include "../src/uartimport.cpp"
+#include "testFrames.h"
+
+#include <CppUnitTest.h>
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+using namespace Spine;
+
+TEST_CLASS(UartImportTests)
+{
+public:
+
+    /// The files written by the tests
+    static constexpr const char* exportPath  = "uartimport-tests.csv";
+    static constexpr const char* capturePath = "uartimport-tests.cap";
+
+    /// The time of a byte at 3Mbaud (in nanoseconds)
+    static constexpr uint64_t byteTime = 3333;
+
+    /** Add the rows of the bytes, one every byteTime
+        @param rows the rows
+        @param channel 0 for the body board, 1 for the head board
+        @param start_ns the time of the first byte
+        @param bytes the bytes
+        @return the time of the last byte
+    */
+    static uint64_t addRows(std::vector<UartRecord>& rows, uint8_t channel, uint64_t start_ns, const std::vector<uint8_t>& bytes)
+    {
+        for (size_t idx = 0; idx < bytes.size(); idx++)
+            rows.push_back({start_ns + idx * byteTime, channel, bytes[idx]});
+        return start_ns + (bytes.size() - 1) * byteTime;
+    }
+
+    /** Write the rows as a CSV, in the order of their time
+        @param rows the rows
+        @param header the header line
+        @param saleae true for the columns of a Saleae export
+    */
+    static void writeCsv(std::vector<UartRecord>& rows, const char* header, bool saleae)
+    {
+        std::stable_sort(rows.begin(), rows.end(), [](const UartRecord& a, const UartRecord& b) { return a.timestamp_ns < b.timestamp_ns; });
+        auto file = fopen(exportPath, "wb");
+        fprintf(file, "%s\r\n", header);
+        for (auto& row : rows)
+        {
+            const char* name = row.channel ? "H2B" : "B2H";
+            uint64_t time_ns = row.timestamp_ns;
+            if (saleae)
+                fprintf(file, "\"%s\",\"data\",%llu.%09llu,3.333e-06,0x%02X\r\n", name, time_ns / 1000000000ULL, time_ns % 1000000000ULL, row.value);
+            else
+                fprintf(file, "%llu.%09llu,%s,%u\n", time_ns / 1000000000ULL, time_ns % 1000000000ULL, name, row.value);
+        }
+        fclose(file);
+    }
+
+    /** Import the export into the capture
+        @param importer the importer
+        @param binary true for the binary form
+        @param format the columns of the CSV
+    */
+    static void import(UartImporter& importer, bool binary, const UartCsvFormat& format = defaultCsvFormat)
+    {
+        std::unique_ptr<CaptureWriter> writer(new CaptureWriter());
+        Assert::IsTrue(writer->open(capturePath));
+        Assert::IsTrue(binary ? importer.importBinary(exportPath, *writer) : importer.importCsv(exportPath, *writer, format));
+        Assert::IsTrue(writer->close());
+    }
+
+    /// The rows of a short exchange, with noise and a frame with a bad CRC
+    static std::vector<UartRecord> exchange()
+    {
+        std::vector<UartRecord> rows;
+        Ack ack = {5};
+        uint8_t lights[16] = {1, 2, 3};
+        auto bad = TestFrames::makeFrame(true, MessageType::ack, &ack, sizeof(ack));
+        bad.back() = 1;
+
+        // the head board's frame ends after the body board's, though it starts first
+        addRows(rows, 1, 1000000, TestFrames::makeFrame(false, MessageType::lights, lights, sizeof(lights)));
+        addRows(rows, 0, 1000000 + 1000, {0x00, 0x55});
+        addRows(rows, 0, 1000000 + 8000, TestFrames::makeFrame(true, MessageType::ack, &ack, sizeof(ack)));
+        addRows(rows, 1, 2000000, TestFrames::makeFrame(false, MessageType::shutdown, nullptr, 0));
+        addRows(rows, 0, 3000000, bad);
+        return rows;
+    }
+
+    /// Check the capture of the exchange
+    static void checkExchange()
+    {
+        std::unique_ptr<CaptureReader> reader(new CaptureReader());
+        Assert::IsTrue(reader->open(capturePath));
+        CaptureFrame frame;
+        Assert::IsTrue(reader->next(frame));
+        Assert::IsTrue(frame.b2h && frame.type == MessageType::ack);
+        Assert::AreEqual(5, ((const Ack*) frame.payload)->value);
+        Assert::AreEqual(8000 + 15 * byteTime, frame.timestamp_ns);
+        Assert::IsTrue(reader->next(frame));
+        Assert::IsTrue(!frame.b2h && frame.type == MessageType::lights);
+        Assert::AreEqual((uint8_t) 3, frame.payload[2]);
+        Assert::AreEqual(27 * byteTime, frame.timestamp_ns);
+        Assert::IsTrue(reader->next(frame));
+        Assert::IsTrue(!frame.b2h && frame.type == MessageType::shutdown && frame.size == 0);
+        Assert::AreEqual(1000000 + 11 * byteTime, frame.timestamp_ns);
+        Assert::IsFalse(reader->next(frame));
+    }
+
+    /// Test Method for the numbers:
+    /// The times are read as nanoseconds, in either notation, and the bytes
+    /// in hex or decimal.
+    TEST_METHOD(TestNumbers)
+    {
+        auto time = [](const char* text, int64_t& ns) { return parseTime(text, text + strlen(text), ns); };
+        int64_t ns;
+        Assert::IsTrue(time("0.000012345", ns));          Assert::AreEqual((int64_t) 12345, ns);
+        Assert::IsTrue(time("1.23e-05", ns));             Assert::AreEqual((int64_t) 12300, ns);
+        Assert::IsTrue(time("4.5E+2", ns));               Assert::AreEqual((int64_t) 450000000000LL, ns);
+        Assert::IsTrue(time("-0.5", ns));                 Assert::AreEqual((int64_t) -500000000, ns);
+        Assert::IsTrue(time("12345678.123456789", ns));   Assert::AreEqual((int64_t) 12345678123456789LL, ns);
+        Assert::IsTrue(time("1.0000000019999", ns));      Assert::AreEqual((int64_t) 1000000001, ns);
+        Assert::IsTrue(time("00000000000000000000003", ns)); Assert::AreEqual((int64_t) 3000000000LL, ns);
+        Assert::IsTrue(time("7", ns));                    Assert::AreEqual((int64_t) 7000000000LL, ns);
+        Assert::IsTrue(time(".25", ns));                  Assert::AreEqual((int64_t) 250000000, ns);
+        Assert::IsFalse(time("", ns));
+        Assert::IsFalse(time("-", ns));
+        Assert::IsFalse(time("1.2.3", ns));
+        Assert::IsFalse(time("1e", ns));
+        Assert::IsFalse(time("12a", ns));
+        Assert::IsFalse(time("99999999999", ns));
+
+        auto byte = [](const char* text, uint8_t& value) { return parseByte(text, text + strlen(text), value); };
+        uint8_t value;
+        Assert::IsTrue(byte("0xAA", value)); Assert::AreEqual((uint8_t) 0xAA, value);
+        Assert::IsTrue(byte("0Xf", value));  Assert::AreEqual((uint8_t) 0x0F, value);
+        Assert::IsTrue(byte("170", value));  Assert::AreEqual((uint8_t) 170, value);
+        Assert::IsFalse(byte("256", value));
+        Assert::IsFalse(byte("0x", value));
+        Assert::IsFalse(byte("0x123", value));
+        Assert::IsFalse(byte("0xG1", value));
+        Assert::IsFalse(byte("", value));
+    }
+
+    /// Test Method for a CSV export:
+    /// The frames are found in each direction, and written in the order
+    /// they ended; the noise, the bad frame and the bad rows are skipped.
+    TEST_METHOD(TestCsv)
+    {
+        auto rows = exchange();
+        writeCsv(rows, "Time [s],Channel,Value", false);
+        // a row on another channel, and one that doesn't parse
+        auto file = fopen(exportPath, "ab");
+        fprintf(file, "0.004,TX,0xAA\n0.004,B2H\n\n");
+        fclose(file);
+
+        std::unique_ptr<UartImporter> importer(new UartImporter());
+        import(*importer, false);
+        checkExchange();
+        Assert::AreEqual(rows.size() + 2, importer->numRows);
+        Assert::AreEqual((size_t) 2, importer->numBadRows);
+        Assert::AreEqual((size_t) 3, importer->numFrames);
+        Assert::AreEqual((size_t) 2 + 16, importer->numSkipped);
+        Assert::AreEqual((size_t) 28 + 12, importer->numBytes[1]);
+    }
+
+    /// Test Method for the export of a Saleae analyser:
+    /// The quoted fields, the columns and the CRLF line ends.
+    TEST_METHOD(TestSaleae)
+    {
+        auto rows = exchange();
+        writeCsv(rows, "name,type,start_time,duration,data", true);
+        std::unique_ptr<UartImporter> importer(new UartImporter());
+        import(*importer, false, saleaeCsvFormat);
+        checkExchange();
+        Assert::AreEqual((size_t) 0, importer->numBadRows);
+    }
+
+    /// Test Method for the binary form:
+    /// The same frames, from the records; a record cut short is a bad row.
+    TEST_METHOD(TestBinary)
+    {
+        auto rows = exchange();
+        std::stable_sort(rows.begin(), rows.end(), [](const UartRecord& a, const UartRecord& b) { return a.timestamp_ns < b.timestamp_ns; });
+        auto file = fopen(exportPath, "wb");
+        fwrite(rows.data(), sizeof(UartRecord), rows.size(), file);
+        fwrite(rows.data(), 1, 3, file);
+        fclose(file);
+
+        std::unique_ptr<UartImporter> importer(new UartImporter());
+        import(*importer, true);
+        checkExchange();
+        Assert::AreEqual(rows.size() + 1, importer->numRows);
+        Assert::AreEqual((size_t) 1, importer->numBadRows);
+        Assert::AreEqual(rows.size() * sizeof(UartRecord) + 3, (size_t) importer->numInputBytes);
+    }
+
+    /// Test Method for a long export:
+    /// The rows span the refills of the buffer, and the streams are decoded
+    /// as they fill; the frames come out in order.  Log the rate.
+    TEST_METHOD(TestLongExport)
+    {
+        // a frame each way every 5ms; the data frame from the body board
+        // takes about 2.6ms
+        const size_t numFrames = 400;
+        std::vector<UartRecord> rows;
+        B2HDataFrame body = {};
+        H2BDataFrame head = {};
+        for (size_t idx = 0; idx < numFrames; idx++)
+        {
+            body.sequenceNumber = head.sequenceNumber = (uint32_t) idx;
+            addRows(rows, 0, idx * 5000000 + 7, TestFrames::makeFrame(true , MessageType::dataFrame, &body, sizeof(body)));
+            addRows(rows, 1, idx * 5000000 + 2000, TestFrames::makeFrame(false, MessageType::dataFrame, &head, sizeof(head)));
+        }
+        writeCsv(rows, "time,channel,value", false);
+
+        std::unique_ptr<UartImporter> importer(new UartImporter());
+        auto start = std::chrono::steady_clock::now();
+        import(*importer, false);
+        std::chrono::duration<double> seconds = std::chrono::steady_clock::now() - start;
+        Assert::IsTrue(importer->numInputBytes > UART_IMPORT_BUFFER_SIZE);
+        Assert::IsTrue(importer->numBytes[0] > UART_IMPORT_STREAM_SIZE);
+        Assert::AreEqual(2 * numFrames, importer->numFrames);
+        Assert::AreEqual((size_t) 0, importer->numSkipped + importer->numBadRows);
+
+        // the frame from the head board ends first
+        std::unique_ptr<CaptureReader> reader(new CaptureReader());
+        Assert::IsTrue(reader->open(capturePath));
+        CaptureFrame frame;
+        for (size_t idx = 0; idx < 2 * numFrames; idx++)
+        {
+            Assert::IsTrue(reader->next(frame));
+            Assert::AreEqual((bool)(idx & 1), frame.b2h);
+            Assert::AreEqual((uint32_t)(idx / 2), *(const uint32_t*) frame.payload);
+        }
+        Assert::IsFalse(reader->next(frame));
+
+        Logger::WriteMessage(("uartimport: " + std::to_string(importer->numInputBytes / seconds.count() / 1e6) + " MB/s of CSV\n").c_str());
+        remove(exportPath);
+        remove(capturePath);
+    }
+};